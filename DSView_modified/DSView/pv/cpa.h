@@ -10,4 +10,27 @@
 ************************************************************/
 #define CPA_SAMPLE_COUNT_SIZE 50000
 #define CPA_SAMPLE_COUNT_START 25000
-#define CPA_SAMPLE_COUNT_END (CPA_SAMPLE_COUNT_START + CPA_SAMPLE_COUNT_SIZE)
\ No newline at end of file
+#define CPA_SAMPLE_COUNT_END (CPA_SAMPLE_COUNT_START + CPA_SAMPLE_COUNT_SIZE)
+
+/*
+ * Signature qualifier: captures whose channel doesn't contain the
+ * reference segment of CPA_SIGNATURE_FILE (one sample per line, e.g. a
+ * trimmed trace export) with a normalized correlation of at least
+ * CPA_SIGNATURE_THRESHOLD are not exported. The search covers the
+ * start offsets CPA_SIGNATURE_SEARCH_START to _END (0 = end of the
+ * capture); the offset of every kept match goes to CPA_SIGNATURE_LOG.
+ * Without the reference file every capture is exported.
+ */
+#define CPA_SIGNATURE_FILE "./signature.csv"
+#define CPA_SIGNATURE_LOG "./signature.log"
+#define CPA_SIGNATURE_CHANNEL 0
+#define CPA_SIGNATURE_THRESHOLD 0.8
+#define CPA_SIGNATURE_SEARCH_START 0
+#define CPA_SIGNATURE_SEARCH_END 0
+#define CPA_SIGNATURE_DECIMATION 4
+
+/*
+ * Plaintext and ciphertext of every exported trace the device sends them
+ * for (the demo AES pattern), as "<capture>,<pt hex>,<ct hex>" lines.
+ */
+#define CPA_TEXTS_LOG "./texts.log"
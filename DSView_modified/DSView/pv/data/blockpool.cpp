@@ -0,0 +1,143 @@
+/*
+ * This file is part of the DSView project.
+ * DSView is based on PulseView.
+ *
+ * Copyright (C) 2013 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "blockpool.h"
+
+#include <stdlib.h>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+namespace pv {
+namespace data {
+
+BlockPool::BlockPool() :
+    _cached_bytes(0)
+{
+}
+
+BlockPool::~BlockPool()
+{
+    for (std::map<size_t, std::vector<void *> >::iterator i = _free_blocks.begin();
+         i != _free_blocks.end(); i++) {
+        for (std::vector<void *>::iterator j = i->second.begin();
+             j != i->second.end(); j++)
+            sys_free(*j, i->first);
+    }
+}
+
+void* BlockPool::alloc(size_t size)
+{
+    const size_t class_size = size_class(size);
+    {
+        boost::lock_guard<boost::mutex> lock(_mutex);
+        std::map<size_t, std::vector<void *> >::iterator i =
+            _free_blocks.find(class_size);
+        if (i != _free_blocks.end() && !i->second.empty()) {
+            void *const block = i->second.back();
+            i->second.pop_back();
+            _cached_bytes -= class_size;
+            return block;
+        }
+    }
+    return sys_alloc(class_size);
+}
+
+void BlockPool::release(void *block, size_t size)
+{
+    if (block == NULL)
+        return;
+
+    const size_t class_size = size_class(size);
+    {
+        boost::lock_guard<boost::mutex> lock(_mutex);
+        std::map<size_t, size_t>::const_iterator limit = _limits.find(class_size);
+        std::vector<void *> &blocks = _free_blocks[class_size];
+        if (limit == _limits.end() || blocks.size() < limit->second) {
+            blocks.push_back(block);
+            _cached_bytes += class_size;
+            return;
+        }
+    }
+    sys_free(block, class_size);
+}
+
+void BlockPool::trim(size_t size, size_t max_blocks)
+{
+    const size_t class_size = size_class(size);
+    boost::lock_guard<boost::mutex> lock(_mutex);
+    std::vector<void *> &blocks = _free_blocks[class_size];
+    while (blocks.size() > max_blocks) {
+        sys_free(blocks.back(), class_size);
+        blocks.pop_back();
+        _cached_bytes -= class_size;
+    }
+}
+
+void BlockPool::set_limit(size_t size, size_t max_blocks)
+{
+    {
+        boost::lock_guard<boost::mutex> lock(_mutex);
+        _limits[size_class(size)] = max_blocks;
+    }
+    trim(size, max_blocks);
+}
+
+uint64_t BlockPool::cached_bytes() const
+{
+    boost::lock_guard<boost::mutex> lock(_mutex);
+    return _cached_bytes;
+}
+
+size_t BlockPool::size_class(size_t size)
+{
+    return (size + PageSize - 1) & ~(PageSize - 1);
+}
+
+void* BlockPool::sys_alloc(size_t size)
+{
+#ifndef _WIN32
+    void *const block = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (block == MAP_FAILED)
+        return NULL;
+#ifdef MADV_HUGEPAGE
+    madvise(block, size, MADV_HUGEPAGE);
+#endif
+    return block;
+#else
+    return malloc(size);
+#endif
+}
+
+void BlockPool::sys_free(void *block, size_t size)
+{
+#ifndef _WIN32
+    munmap(block, size);
+#else
+    (void)size;
+    free(block);
+#endif
+}
+
+} // namespace data
+} // namespace pv
@@ -0,0 +1,85 @@
+/*
+ * This file is part of the DSView project.
+ * DSView is based on PulseView.
+ *
+ * Copyright (C) 2013 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+
+#ifndef DSVIEW_PV_DATA_BLOCKPOOL_H
+#define DSVIEW_PV_DATA_BLOCKPOOL_H
+
+#include <stdint.h>
+
+#include <map>
+#include <vector>
+
+#include <boost/thread.hpp>
+
+namespace pv {
+namespace data {
+
+/**
+ * Keeps released memory blocks for reuse, with one free list per
+ * size class, so that repeated captures of the same size run on warm
+ * memory instead of going back to the allocator for every block.
+ *
+ * Blocks are mapped straight from the system where possible and
+ * advised to be backed by transparent huge pages.
+ */
+class BlockPool
+{
+private:
+    static const size_t PageSize = 4096;
+
+public:
+    BlockPool();
+    ~BlockPool();
+
+    void* alloc(size_t size);
+    void release(void *block, size_t size);
+
+    /**
+     * Give cached blocks of the size class of size back to the system
+     * until at most max_blocks of them are left in the pool.
+     */
+    void trim(size_t size, size_t max_blocks);
+
+    /**
+     * Cap the free list of the size class of size at max_blocks, blocks
+     * released beyond it go back to the system right away.
+     */
+    void set_limit(size_t size, size_t max_blocks);
+
+    uint64_t cached_bytes() const;
+
+private:
+    static size_t size_class(size_t size);
+    static void* sys_alloc(size_t size);
+    static void sys_free(void *block, size_t size);
+
+private:
+    mutable boost::mutex _mutex;
+    std::map<size_t, std::vector<void *> > _free_blocks;
+    std::map<size_t, size_t> _limits;
+    uint64_t _cached_bytes;
+};
+
+} // namespace data
+} // namespace pv
+
+#endif // DSVIEW_PV_DATA_BLOCKPOOL_H
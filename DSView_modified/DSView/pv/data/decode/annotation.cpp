@@ -51,6 +51,17 @@ Annotation::Annotation(const srd_proto_data *const pdata) :
 	}
 }
 
+Annotation::Annotation(uint64_t start_sample, uint64_t end_sample,
+                       int format, int type,
+                       const std::vector<QString> &annotations) :
+    _start_sample(start_sample),
+    _end_sample(end_sample),
+    _format(format),
+    _type(type),
+    _annotations(annotations)
+{
+}
+
 Annotation::Annotation()
 {
     _start_sample = 0;
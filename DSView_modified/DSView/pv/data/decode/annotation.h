@@ -36,6 +36,8 @@ class Annotation
 {
 public:
 	Annotation(const srd_proto_data *const pdata);
+    Annotation(uint64_t start_sample, uint64_t end_sample, int format,
+               int type, const std::vector<QString> &annotations);
     Annotation();
     ~Annotation();
 
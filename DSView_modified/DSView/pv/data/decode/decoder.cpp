@@ -23,6 +23,10 @@
 
 #include "decoder.h"
 
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+
 using boost::shared_ptr;
 using std::set;
 using std::map;
@@ -176,6 +180,37 @@ int Decoder::get_channel_type(const srd_channel *ch)
     return ch->type;
 }
 
+QByteArray Decoder::digest(const srd_decoder *dec)
+{
+    char *const path = srd_decoder_path_get(dec);
+    if (!path)
+        return QByteArray();
+    const QString dir = QString::fromLocal8Bit(path);
+    g_free(path);
+    return digest(QString::fromUtf8(dec->id), dir);
+}
+
+QByteArray Decoder::digest(const QString &id, const QString &dir)
+{
+    const QDir scripts(dir);
+    if (dir.isEmpty() || !scripts.exists())
+        return QByteArray();
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(id.toUtf8());
+    foreach (const QString &name, scripts.entryList(QDir::Files, QDir::Name)) {
+        QFile file(scripts.filePath(name));
+        if (!file.open(QIODevice::ReadOnly))
+            return QByteArray();
+        const QByteArray data = file.readAll();
+        const quint64 size = data.size();
+        hash.addData(name.toUtf8());
+        hash.addData((const char *)&size, sizeof(size));
+        hash.addData(data);
+    }
+    return hash.result();
+}
+
 } // decode
 } // data
 } // pv
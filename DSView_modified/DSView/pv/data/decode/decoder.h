@@ -29,6 +29,9 @@
 
 #include <glib.h>
 
+#include <QByteArray>
+#include <QString>
+
 struct srd_decoder;
 struct srd_decoder_inst;
 struct srd_channel;
@@ -69,6 +72,14 @@ public:
 
     int get_channel_type(const srd_channel* ch);
 
+    /**
+     * A hash of the id of a decoder and of the files in the directory
+     * its scripts were loaded from, which changes with any edit of them.
+     * Empty if the directory is not known.
+     */
+    static QByteArray digest(const srd_decoder *dec);
+    static QByteArray digest(const QString &id, const QString &dir);
+
 private:
 	const srd_decoder *const _decoder;
 
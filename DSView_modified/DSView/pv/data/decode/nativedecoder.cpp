@@ -0,0 +1,1141 @@
+/*
+ * This file is part of the DSView project.
+ * DSView is based on PulseView.
+ *
+ * Copyright (C) 2016 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <libsigrokdecode4DSL/libsigrokdecode.h>
+
+#include <assert.h>
+#include <stdint.h>
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "nativedecoder.h"
+#include "annotation.h"
+#include "decoder.h"
+#include "../logicsnapshot.h"
+
+using std::map;
+using std::string;
+using std::vector;
+
+namespace pv {
+namespace data {
+namespace decode {
+
+namespace {
+
+QString hex_text(uint64_t value)
+{
+    return QString("%1").arg(value, 2, 16, QChar('0')).toUpper();
+}
+
+vector<QString> texts(const char *t0, const char *t1 = NULL,
+                      const char *t2 = NULL)
+{
+    vector<QString> v;
+    v.push_back(t0);
+    if (t1)
+        v.push_back(t1);
+    if (t2)
+        v.push_back(t2);
+    return v;
+}
+
+// None in the Python output
+GVariant* none()
+{
+    return g_variant_new_maybe(G_VARIANT_TYPE_VARIANT, NULL);
+}
+
+// [type, data] and [type, data1, data2] as the decoders put them
+GVariant* packet(const char *type, GVariant *data)
+{
+    return g_variant_new("(sv)", type, data);
+}
+
+GVariant* packet(const char *type, GVariant *data1, GVariant *data2)
+{
+    return g_variant_new("(svv)", type, data1, data2);
+}
+
+/**
+ * Port of decoders/0-spi and decoders/1-spi
+ */
+class SpiDecoder : public NativeDecoder
+{
+private:
+    // Data(ss, es, val) of a TRANSFER
+    struct Word
+    {
+        uint64_t ss;
+        uint64_t es;
+        uint64_t val;
+    };
+
+public:
+    SpiDecoder(const Decoder &dec, bool full) :
+        NativeDecoder(dec),
+        _full(full),
+        _oldclk(-1),
+        _oldcs(-1),
+        _bitcount(0),
+        _misodata(0),
+        _mosidata(0),
+        _ss_block(0),
+        _bitwidth(0),
+        _ss_transfer(UINT64_MAX),
+        _cs_notified(false),
+        _was_reset(false)
+    {
+    }
+
+protected:
+    bool start(const Decoder &dec, uint64_t samplerate)
+    {
+        QString cs_polarity, bitorder;
+        int64_t cpol, cpha;
+        if (samplerate == 0 ||
+            !option_string(dec, "cs_polarity", cs_polarity) ||
+            !option_int(dec, "cpol", cpol) ||
+            !option_int(dec, "cpha", cpha) ||
+            !option_string(dec, "bitorder", bitorder) ||
+            !option_int(dec, "wordsize", _ws))
+            return false;
+        if ((cpol != 0 && cpol != 1) || (cpha != 0 && cpha != 1) ||
+            _ws < 1 || _ws > 64)
+            return false;
+
+        // pins are (clk, miso, mosi, cs)
+        _have_miso = (channel_map()[1] != -1);
+        _have_mosi = (channel_map()[2] != -1);
+        _have_cs = (channel_map()[3] != -1);
+        if (!_have_miso && !_have_mosi)
+            return false;
+
+        const bool active_low = (cs_polarity == "active-low");
+        _msb_first = (bitorder == "msb-first");
+        // mode 0 and 3 sample on the rising clock edge
+        _exp_oldclk = (cpol == cpha) ? 0 : 1;
+        _exp_clk = !_exp_oldclk;
+        _mask = _have_cs ? 0x9 : 0x1;
+        _exp_cs_logic = active_low ? 0x0 : 0x8;
+        _asserted_oldcs = active_low ? 1 : 0;
+        _asserted_cs = active_low ? 0 : 1;
+        return true;
+    }
+
+    bool find_boundary(LogicSnapshot &snapshot, uint64_t &index,
+                       uint64_t end) const
+    {
+        if (_have_cs) {
+            // the next assertion of CS#
+            return find_idle_edge(snapshot, channel_map()[3], _asserted_cs,
+                                  1, index, end);
+        }
+
+        // a clock edge after a pause of some clock periods
+        const int clk = channel_map()[0];
+        bool last = snapshot.get_sample(index, clk);
+        uint64_t pos = index + 1;
+        uint64_t pre_edge = 0;
+        uint64_t period = UINT64_MAX;
+        for (int n = 0; n < 16 && snapshot.get_nxt_edge(pos, last, end, 1, clk); n++) {
+            if (n > 0)
+                period = std::min(period, pos - pre_edge);
+            pre_edge = pos;
+            last = !last;
+            pos++;
+        }
+        if (period == UINT64_MAX)
+            return false;
+        return find_idle_edge(snapshot, clk, -1, period * 16, index, end);
+    }
+
+    bool synced() const
+    {
+        if (_have_cs)
+            return _oldcs == _asserted_oldcs;
+        return _bitcount == 0;
+    }
+
+    void decode_samples()
+    {
+        uint64_t samplenum;
+        uint8_t pins[4];
+
+        while (next(samplenum, pins)) {
+            const int clk = pins[0];
+            int cs = pins[3];
+
+            _logic_mask = _mask;
+            _cur_pos = samplenum;
+            _edge_index = -1;
+
+            // tell the stacked decoders that there is no CS#
+            if (_full && !_have_cs && !_cs_notified) {
+                if (stacked())
+                    put_python(0, 0, packet("CS-CHANGE", none(), none()));
+                _cs_notified = true;
+            }
+
+            if (_oldcs == _asserted_oldcs && cs == _asserted_cs) {
+                _ss_transfer = samplenum;
+                _misobytes.clear();
+                _mosibytes.clear();
+                reset_decoder_state();
+            } else if (_oldcs == _asserted_cs && cs == _asserted_oldcs) {
+                if (_full && stacked())
+                    put_python(_ss_transfer, samplenum,
+                               packet("TRANSFER", words_variant(_mosibytes),
+                                      words_variant(_misobytes)));
+                // skip to the next assertion of CS#
+                _exp_logic = _exp_cs_logic;
+                cs = _asserted_oldcs;
+                _logic_mask = 0x8;
+                _edge_index = 3;
+            } else if (!_have_cs || cs == _asserted_cs) {
+                if (_oldclk == _exp_oldclk && clk == _exp_clk)
+                    handle_bit(samplenum, pins[1], pins[2]);
+            }
+
+            _oldclk = clk;
+            _oldcs = cs;
+        }
+    }
+
+private:
+    void reset_decoder_state()
+    {
+        _misodata = 0;
+        _mosidata = 0;
+        _misobits.clear();
+        _mosibits.clear();
+        _bitcount = 0;
+        _was_reset = true;
+    }
+
+    // a bit ends where the next one starts, the last one a period later
+    static void push_bit(vector<Bit> &bits, uint64_t value, uint64_t samplenum)
+    {
+        uint64_t es = samplenum;
+        if (!bits.empty()) {
+            es += samplenum - bits.back().ss;
+            bits.back().es = samplenum;
+        }
+        const Bit b = {value, samplenum, es};
+        bits.push_back(b);
+    }
+
+    static GVariant* words_variant(const vector<Word> &words)
+    {
+        GVariantBuilder builder;
+        g_variant_builder_init(&builder, G_VARIANT_TYPE("a(ttt)"));
+        for (vector<Word>::const_iterator i = words.begin(); i != words.end(); i++)
+            g_variant_builder_add(&builder, "(ttt)", (*i).ss, (*i).es, (*i).val);
+        return g_variant_builder_end(&builder);
+    }
+
+    void handle_bit(uint64_t samplenum, uint64_t miso, uint64_t mosi)
+    {
+        if (_bitcount == 0)
+            _ss_block = samplenum;
+        if (_bitcount == 1)
+            _bitwidth = samplenum - _ss_block;
+
+        const int64_t shift_cnt = _msb_first ? (_ws - 1 - _bitcount) : _bitcount;
+        if (_have_miso) {
+            _misodata |= miso << shift_cnt;
+            if (_full)
+                push_bit(_misobits, miso, samplenum);
+        }
+        if (_have_mosi) {
+            _mosidata |= mosi << shift_cnt;
+            if (_full)
+                push_bit(_mosibits, mosi, samplenum);
+        }
+
+        if (++_bitcount != _ws)
+            return;
+
+        if (_full) {
+            put_data();
+        } else {
+            const uint64_t es = samplenum + _bitwidth;
+            if (_have_miso)
+                put(_ss_block, es, 0, vector<QString>(1, hex_text(_misodata)));
+            if (_have_mosi)
+                put(_ss_block, es, 1, vector<QString>(1, hex_text(_mosidata)));
+        }
+
+        reset_decoder_state();
+    }
+
+    // putdata() of 1:spi. Until the first reset the data and bits of a
+    // missing channel are 0 and [] there rather than None.
+    void put_data()
+    {
+        if (_have_miso) {
+            const uint64_t ss = _misobits.front().ss;
+            const uint64_t es = _misobits.back().es;
+            if (stacked())
+                put_python(ss, es, packet("BITS",
+                    (_have_mosi || !_was_reset) ? bits_variant(_mosibits, true) : none(),
+                    bits_variant(_misobits, true)));
+            const Word w = {ss, es, _misodata};
+            _misobytes.push_back(w);
+            put_bits(_misobits, 2);
+            put(ss, es, 0, vector<QString>(1, hex_text(_misodata)));
+        }
+        if (_have_mosi) {
+            const uint64_t ss = _mosibits.front().ss;
+            const uint64_t es = _mosibits.back().es;
+            if (stacked())
+                put_python(ss, es, packet("DATA",
+                    g_variant_new_uint64(_mosidata),
+                    (_have_miso || !_was_reset) ? g_variant_new_uint64(_misodata) : none()));
+            const Word w = {ss, es, _mosidata};
+            _mosibytes.push_back(w);
+            put_bits(_mosibits, 3);
+            put(ss, es, 1, vector<QString>(1, hex_text(_mosidata)));
+        }
+    }
+
+private:
+    int64_t _ws;
+    bool _msb_first;
+    bool _have_miso, _have_mosi, _have_cs;
+    int _exp_oldclk, _exp_clk;
+    uint64_t _mask;
+    uint64_t _exp_cs_logic;
+    int _asserted_oldcs, _asserted_cs;
+    const bool _full;
+
+    int _oldclk;
+    int _oldcs;
+    int64_t _bitcount;
+    uint64_t _misodata, _mosidata;
+    uint64_t _ss_block;
+    uint64_t _bitwidth;
+
+    vector<Bit> _misobits, _mosibits;
+    vector<Word> _misobytes, _mosibytes;
+    uint64_t _ss_transfer;
+    bool _cs_notified;
+    bool _was_reset;
+};
+
+/**
+ * Port of decoders/0-uart and decoders/1-uart
+ */
+class UartDecoder : public NativeDecoder
+{
+private:
+    enum State {
+        FindStart,
+        GetStartBit,
+        GetDataBits,
+        GetParityBit,
+        GetStopBits
+    };
+
+public:
+    UartDecoder(const Decoder &dec, bool full) :
+        NativeDecoder(dec),
+        _full(full),
+        _state(FindStart),
+        _oldbit(-1),
+        _bitcount(0),
+        _databyte(0),
+        _bitstart(-1),
+        _bytestart(-1)
+    {
+    }
+
+protected:
+    bool start(const Decoder &dec, uint64_t samplerate)
+    {
+        int64_t baudrate;
+        QString bit_order, invert;
+        if (!option_int(dec, "baudrate", baudrate) ||
+            !option_int(dec, "num_data_bits", _num_data_bits) ||
+            !option_string(dec, "parity_type", _parity_type) ||
+            !option_double(dec, "num_stop_bits", _num_stop_bits) ||
+            !option_string(dec, "bit_order", bit_order) ||
+            !option_string(dec, "format", _format) ||
+            !option_string(dec, "invert", invert))
+            return false;
+        if (baudrate <= 0 || samplerate < (uint64_t)baudrate * 4 ||
+            _num_data_bits < 1 || _num_data_bits > 32)
+            return false;
+
+        _bit_width = (double)samplerate / (double)baudrate;
+        _lsb_first = (bit_order == "lsb-first");
+        _invert = (invert == "yes");
+        return true;
+    }
+
+    bool find_boundary(LogicSnapshot &snapshot, uint64_t &index,
+                       uint64_t end) const
+    {
+        // a start bit after the line has been idle for a whole frame
+        const uint64_t min_gap = ceil((_num_data_bits + 4) * _bit_width);
+        return find_idle_edge(snapshot, channel_map()[0], _invert ? 1 : 0,
+                              min_gap, index, end);
+    }
+
+    bool synced() const
+    {
+        return _state == FindStart;
+    }
+
+    void decode_samples()
+    {
+        uint64_t samplenum;
+        uint8_t pins[1];
+
+        while (next(samplenum, pins)) {
+            // in default case, the iteration gap is 1
+            _logic_mask = 0;
+            _edge_index = 0;
+
+            int signal = _invert ? !pins[0] : pins[0];
+
+            switch (_state) {
+            case FindStart:
+                if (_oldbit == 1 && signal == 0) {
+                    _bitstart = samplenum;
+                    _state = GetStartBit;
+                    advance((_bit_width - 1) / 2.0);
+                } else {
+                    _exp_logic = _invert ? 1 : 0;
+                    _logic_mask = 1;
+                    _cur_pos = samplenum;
+                    signal = 1;
+                }
+                break;
+            case GetStartBit:
+                if (_full && signal != 0) {
+                    put_python_bit(_bit_width, "INVALID STARTBIT", signal);
+                    put_bit(_bit_width, 5, texts("Frame error", "Frame err", "FE"));
+                }
+                _bitcount = 0;
+                _databyte = 0;
+                _state = GetDataBits;
+                if (_full)
+                    put_python_bit(_bit_width, "STARTBIT", signal);
+                put_bit(_bit_width, 1, texts("Start bit", "Start", "S"));
+                advance(_bit_width);
+                break;
+            case GetDataBits:
+                get_data_bits(samplenum, signal);
+                advance(_bit_width);
+                break;
+            case GetParityBit:
+                _bitstart += _bit_width;
+                _state = GetStopBits;
+                if (parity_ok(signal)) {
+                    if (_full)
+                        put_python_bit(_bit_width, "PARITYBIT", signal);
+                    put_bit(_bit_width, 2, texts("Parity bit", "Parity", "P"));
+                } else {
+                    if (_full && stacked())
+                        put_python(floor(_bitstart), floor(_bitstart + _bit_width),
+                                   packet("PARITY ERROR", g_variant_new_int64(0),
+                                          g_variant_new("(xx)", (gint64)0, (gint64)1)));
+                    put_bit(_bit_width, 3, texts("Parity error", "Parity err", "PE"));
+                }
+                advance(_bit_width);
+                break;
+            case GetStopBits:
+                _bitstart += _bit_width;
+                if (_full && signal != 1) {
+                    put_python_bit(_bit_width, "INVALID STOPBIT", signal);
+                    put_bit(_bit_width, 5, texts("Frame error", "Frame err", "FE"));
+                }
+                _state = FindStart;
+                if (_full)
+                    put_python_bit((int64_t)(_bit_width * _num_stop_bits),
+                                   "STOPBIT", signal);
+                put_bit((int64_t)(_bit_width * _num_stop_bits), 4,
+                        texts("Stop bit", "Stop", "T"));
+                advance((_num_stop_bits - 0.75) * _bit_width);
+                signal = 0;
+                break;
+            }
+
+            _oldbit = signal;
+        }
+    }
+
+private:
+    void put_bit(double width, int ann_class, const vector<QString> &t)
+    {
+        put(floor(_bitstart), floor(_bitstart + width), ann_class, t);
+    }
+
+    // [type, 0, value] over the bit
+    void put_python_bit(double width, const char *type, int value)
+    {
+        if (stacked())
+            put_python(floor(_bitstart), floor(_bitstart + width),
+                       packet(type, g_variant_new_int64(0),
+                              g_variant_new_int64(value)));
+    }
+
+    void get_data_bits(uint64_t samplenum, int signal)
+    {
+        _bitstart += _bit_width;
+        if (_bitcount == 0)
+            _bytestart = _bitstart;
+
+        if (_lsb_first) {
+            _databyte >>= 1;
+            _databyte |= (uint64_t)signal << (_num_data_bits - 1);
+        } else {
+            _databyte <<= 1;
+            _databyte |= (uint64_t)signal;
+        }
+
+        if (_full) {
+            put_bit(_bit_width, 6, vector<QString>(1, QString::number(signal)));
+            const uint64_t halfbit = _bit_width / 2;
+            const Bit bit = {(uint64_t)signal, samplenum - halfbit, samplenum + halfbit};
+            _databits.push_back(bit);
+        }
+
+        if (_bitcount < _num_data_bits - 1) {
+            _bitcount++;
+            return;
+        }
+
+        _state = (_parity_type == "none") ? GetStopBits : GetParityBit;
+
+        if (_full && stacked())
+            put_python(floor(_bytestart), floor(_bitstart + _bit_width),
+                       packet("DATA", g_variant_new_int64(0),
+                              g_variant_new("(t@aat)", _databyte,
+                                            bits_variant(_databits, false))));
+
+        const uint64_t b = _databyte;
+        QString text;
+        if (_format == "ascii")
+            text = (b >= 30 && b <= 126) ? QString(QChar((ushort)b)) :
+                                           "[" + hex_text(b) + "]";
+        else if (_format == "dec")
+            text = QString::number(b);
+        else if (_format == "hex")
+            text = hex_text(b);
+        else if (_format == "oct")
+            text = QString("%1").arg(b, 3, 8, QChar('0'));
+        else if (_format == "bin")
+            text = QString("%1").arg(b, 8, 2, QChar('0'));
+        if (!text.isNull())
+            put(floor(_bytestart), floor(_bitstart + _bit_width), 0,
+                vector<QString>(1, text));
+
+        _databits.clear();
+    }
+
+    bool parity_ok(int parity_bit) const
+    {
+        if (_parity_type == "zero")
+            return parity_bit == 0;
+        else if (_parity_type == "one")
+            return parity_bit == 1;
+
+        uint64_t ones = parity_bit;
+        for (uint64_t d = _databyte; d; d &= d - 1)
+            ones++;
+        if (_parity_type == "odd")
+            return (ones % 2) == 1;
+        else if (_parity_type == "even")
+            return (ones % 2) == 0;
+        return false;
+    }
+
+private:
+    int64_t _num_data_bits;
+    QString _parity_type;
+    double _num_stop_bits;
+    QString _format;
+    bool _lsb_first;
+    bool _invert;
+    double _bit_width;
+    const bool _full;
+
+    State _state;
+    int _oldbit;
+    int64_t _bitcount;
+    uint64_t _databyte;
+    double _bitstart;
+    double _bytestart;
+    vector<Bit> _databits;
+};
+
+/**
+ * Port of decoders/0-i2c and decoders/1-i2c
+ */
+class I2cDecoder : public NativeDecoder
+{
+private:
+    enum State {
+        FindStart,
+        FindAddress,
+        FindData,
+        FindAck
+    };
+
+public:
+    I2cDecoder(const Decoder &dec, bool full) :
+        NativeDecoder(dec),
+        _full(full),
+        _state(FindStart),
+        _oldscl(-1),
+        _oldsda(-1),
+        _bitcount(0),
+        _databyte(0),
+        _wr(-1),
+        _is_repeat_start(false),
+        _ss_byte(0),
+        _bitwidth(0)
+    {
+    }
+
+protected:
+    bool start(const Decoder &dec, uint64_t samplerate)
+    {
+        QString address_format;
+        if (samplerate == 0 ||
+            !option_string(dec, "address_format", address_format))
+            return false;
+        _shifted = (address_format == "shifted");
+        return true;
+    }
+
+    bool find_boundary(LogicSnapshot &snapshot, uint64_t &index,
+                       uint64_t end) const
+    {
+        // a start condition following a stop condition
+        const int scl = channel_map()[0];
+        const int sda = channel_map()[1];
+        bool last = snapshot.get_sample(index, sda);
+        uint64_t pos = index + 1;
+        uint64_t stop = 0;
+        bool have_stop = false;
+        for (unsigned int n = 0; n < MaxBoundaryEdges &&
+             snapshot.get_nxt_edge(pos, last, end, 1, sda); n++) {
+            last = !last;
+            if (!snapshot.get_sample(pos, scl)) {
+                have_stop = false;
+            } else if (last) {
+                stop = pos;
+                have_stop = true;
+            } else if (have_stop) {
+                // SCL has to stay high in between
+                uint64_t scl_pos = stop + 1;
+                if (!snapshot.get_nxt_edge(scl_pos, true, pos, 1, scl)) {
+                    index = pos;
+                    return true;
+                }
+                have_stop = false;
+            }
+            pos++;
+        }
+        return false;
+    }
+
+    bool synced() const
+    {
+        return _state == FindStart;
+    }
+
+    void decode_samples()
+    {
+        uint64_t samplenum;
+        uint8_t pins[2];
+
+        while (next(samplenum, pins)) {
+            int scl = pins[0];
+            int sda = pins[1];
+
+            _logic_mask = 0x3;
+            _cur_pos = samplenum;
+            _edge_index = -1;
+
+            const bool start_cond = (_oldsda == 1 && sda == 0 && scl == 1);
+            const bool stop_cond = (_oldsda == 0 && sda == 1 && scl == 1);
+            const bool scl_rise = (_oldscl == 0 && scl == 1);
+
+            switch (_state) {
+            case FindStart:
+                if (start_cond) {
+                    found_start(samplenum);
+                    // skip to the next rising edge of SCL
+                    _exp_logic = 0x1;
+                    _logic_mask = 0x1;
+                    _edge_index = 0;
+                    scl = 0;
+                } else {
+                    // skip to the next falling edge of SDA while SCL is high
+                    _exp_logic = 0x1;
+                    _logic_mask = 0x3;
+                    _edge_index = 1;
+                    sda = 1;
+                }
+                break;
+            case FindAddress:
+            case FindData:
+                if (scl_rise)
+                    found_byte(samplenum, sda);
+                else if (start_cond)
+                    found_start(samplenum);
+                else if (stop_cond)
+                    found_stop(samplenum);
+                break;
+            case FindAck:
+                if (scl_rise) {
+                    const uint64_t es = samplenum + _bitwidth;
+                    putp(samplenum, es, sda == 1 ? "NACK" : "ACK");
+                    if (sda == 1)
+                        put(samplenum, es, 4, texts("NACK", "N"));
+                    else
+                        put(samplenum, es, 3, texts("ACK", "A"));
+                    _state = FindData;
+                }
+                _exp_logic = 0x1;
+                _logic_mask = 0x1;
+                _edge_index = 0;
+                scl = 0;
+                break;
+            }
+
+            _oldscl = scl;
+            _oldsda = sda;
+        }
+    }
+
+private:
+    // [cmd, None] to the stacked decoders
+    void putp(uint64_t ss, uint64_t es, const char *cmd)
+    {
+        if (_full && stacked())
+            put_python(ss, es, packet(cmd, none()));
+    }
+
+    void found_start(uint64_t samplenum)
+    {
+        putp(samplenum, samplenum,
+             _is_repeat_start ? "START REPEAT" : "START");
+        if (_is_repeat_start)
+            put(samplenum, samplenum, 1, texts("Start repeat", "Sr"));
+        else
+            put(samplenum, samplenum, 0, texts("Start", "S"));
+        _state = FindAddress;
+        _bitcount = 0;
+        _databyte = 0;
+        _is_repeat_start = true;
+        _wr = -1;
+        _bits.clear();
+    }
+
+    void found_stop(uint64_t samplenum)
+    {
+        putp(samplenum, samplenum, "STOP");
+        put(samplenum, samplenum, 2, texts("Stop", "P"));
+        _state = FindStart;
+        _is_repeat_start = false;
+        _wr = -1;
+        _bits.clear();
+    }
+
+    // gather 7 bits of address plus the rd/wr bit, or 8 bits of data
+    void found_byte(uint64_t samplenum, int sda)
+    {
+        _databyte = (_databyte << 1) | sda;
+
+        if (_bitcount == 0)
+            _ss_byte = samplenum;
+        if (_full) {
+            // 1:i2c takes the bit width from the last two bits
+            if (_bitcount > 0)
+                _bits.back().es = samplenum;
+            const Bit bit = {(uint64_t)sda, samplenum, samplenum};
+            _bits.push_back(bit);
+            if (_bitcount == 7) {
+                const size_t n = _bits.size();
+                _bitwidth = _bits[n - 2].es - _bits[n - 3].es;
+                _bits.back().es += _bitwidth;
+            }
+        } else if (_bitcount == 1) {
+            _bitwidth = samplenum - _ss_byte;
+        }
+
+        if (_bitcount < 7) {
+            _bitcount++;
+            return;
+        }
+
+        if (_state == FindAddress) {
+            _wr = (_databyte & 1) ? 0 : 1;
+            if (_shifted)
+                _databyte >>= 1;
+            put_byte_bits(_ss_byte, samplenum, _wr ? "ADDRESS WRITE" : "ADDRESS READ");
+            put_byte(_ss_byte, samplenum, _wr ? 9 : 8,
+                     _wr ? "Address write" : "Address read",
+                     _wr ? "AW" : "AR");
+            if (_wr)
+                put(samplenum, samplenum + _bitwidth, 6, texts("Write", "Wr", "W"));
+            else
+                put(samplenum, samplenum + _bitwidth, 5, texts("Read", "Rd", "R"));
+        } else {
+            put_byte_bits(_ss_byte, samplenum + _bitwidth,
+                          _wr ? "DATA WRITE" : "DATA READ");
+            put_byte(_ss_byte, samplenum + _bitwidth, _wr ? 11 : 10,
+                     _wr ? "Data write" : "Data read",
+                     _wr ? "DW" : "DR");
+        }
+
+        _bitcount = 0;
+        _databyte = 0;
+        _bits.clear();
+        _state = FindAck;
+    }
+
+    // the bits and the byte to the stacked decoders, the bits annotated
+    void put_byte_bits(uint64_t ss, uint64_t es, const char *cmd)
+    {
+        if (!_full)
+            return;
+        if (stacked()) {
+            put_python(ss, es, packet("BITS", bits_variant(_bits, true)));
+            put_python(ss, es, packet(cmd, g_variant_new_uint64(_databyte)));
+        }
+        put_bits(_bits, 7);
+    }
+
+    void put_byte(uint64_t ss, uint64_t es, int ann_class,
+                  const char *name, const char *abbr)
+    {
+        const QString value = hex_text(_databyte);
+        vector<QString> t;
+        t.push_back(QString("%1: %2").arg(name).arg(value));
+        t.push_back(QString("%1: %2").arg(abbr).arg(value));
+        t.push_back(value);
+        put(ss, es, ann_class, t);
+    }
+
+private:
+    bool _shifted;
+    const bool _full;
+
+    State _state;
+    int _oldscl, _oldsda;
+    int _bitcount;
+    uint64_t _databyte;
+    int _wr;
+    bool _is_repeat_start;
+    uint64_t _ss_byte;
+    uint64_t _bitwidth;
+    vector<Bit> _bits;
+};
+
+} // anonymous namespace
+
+NativeDecoder::NativeDecoder(const Decoder &dec) :
+    _itercnt(0),
+    _logic_mask(0),
+    _exp_logic(0),
+    _edge_index(-1),
+    _cur_pos(0),
+    _decoder(dec.decoder()),
+    _start_samplenum(0),
+    _samplenum(0),
+    _inbuf(NULL),
+    _inbuf_const(NULL),
+    _di_cur_pos(0),
+    _di_logic_mask(0),
+    _di_exp_logic(0),
+    _di_edge_index(-1),
+    _cb(NULL),
+    _cb_data(NULL),
+    _di(NULL)
+{
+    assert(_decoder);
+
+    // same layout as srd_decoder_inst::dec_channelmap
+    _channel_map.assign(g_slist_length(_decoder->channels) +
+                        g_slist_length(_decoder->opt_channels), -1);
+    for (map<const srd_channel*, int>::const_iterator i = dec.channels().begin();
+         i != dec.channels().end(); i++)
+        _channel_map[(*i).first->order] = (*i).second;
+
+    for (const GSList *l = _decoder->ann_types; l; l = l->next)
+        _ann_types.push_back(GPOINTER_TO_INT(l->data));
+}
+
+NativeDecoder::~NativeDecoder()
+{
+}
+
+NativeDecoder* NativeDecoder::create(const Decoder &dec, uint64_t samplerate)
+{
+    const srd_decoder *const decc = dec.decoder();
+    assert(decc);
+
+    // the 1: decoders differ in what they put only
+    const bool full = (strncmp(decc->id, "1:", 2) == 0);
+    if (!full && strncmp(decc->id, "0:", 2) != 0)
+        return NULL;
+
+    NativeDecoder *native = NULL;
+    if (strcmp(decc->id + 2, "spi") == 0)
+        native = new SpiDecoder(dec, full);
+    else if (strcmp(decc->id + 2, "uart") == 0)
+        native = new UartDecoder(dec, full);
+    else if (strcmp(decc->id + 2, "i2c") == 0)
+        native = new I2cDecoder(dec, full);
+    else
+        return NULL;
+
+    if (!native->start(dec, samplerate)) {
+        delete native;
+        return NULL;
+    }
+    return native;
+}
+
+const srd_decoder* NativeDecoder::decoder() const
+{
+    return _decoder;
+}
+
+int NativeDecoder::num_channels() const
+{
+    return _channel_map.size();
+}
+
+const int* NativeDecoder::channel_map() const
+{
+    return _channel_map.data();
+}
+
+void NativeDecoder::set_callback(AnnotationCallback cb, void *cb_data)
+{
+    _cb = cb;
+    _cb_data = cb_data;
+}
+
+void NativeDecoder::set_instance(srd_decoder_inst *di)
+{
+    _di = di;
+}
+
+void NativeDecoder::decode(uint8_t chunk_type, uint64_t start_samplenum,
+                           uint64_t end_samplenum, const uint8_t *const *inbuf,
+                           const uint8_t *inbuf_const)
+{
+    assert(end_samplenum >= start_samplenum);
+
+    _start_samplenum = start_samplenum;
+    if (chunk_type == 0) {
+        _itercnt = 0;
+        _logic_mask = 0;
+    }
+    _inbuf = inbuf;
+    _inbuf_const = inbuf_const;
+    _samplenum = end_samplenum - start_samplenum + 1;
+
+    decode_samples();
+
+    if (_logic_mask == 0)
+        _itercnt -= _samplenum;
+}
+
+uint64_t NativeDecoder::cur_pos() const
+{
+    return _di_cur_pos;
+}
+
+uint64_t NativeDecoder::logic_mask() const
+{
+    return _di_logic_mask;
+}
+
+uint64_t NativeDecoder::exp_logic() const
+{
+    return _di_exp_logic;
+}
+
+int NativeDecoder::edge_index() const
+{
+    return _di_edge_index;
+}
+
+bool NativeDecoder::next(uint64_t &samplenum, uint8_t *pins)
+{
+    const uint64_t offset = floor(_itercnt);
+    _di_cur_pos = _cur_pos;
+    _di_logic_mask = _logic_mask;
+    _di_exp_logic = _exp_logic;
+    _di_edge_index = -1;
+    if (_logic_mask != 0 && _edge_index != -1)
+        _di_edge_index = _channel_map[_edge_index];
+
+    if (offset > _samplenum || _logic_mask != 0)
+        return false;
+
+    for (unsigned int i = 0; i < _channel_map.size(); i++)
+        pins[i] = logic_sample(i, offset);
+    samplenum = _start_samplenum + offset;
+    return true;
+}
+
+void NativeDecoder::advance(double count)
+{
+    // the Python logic object keeps the offset as a float
+    _itercnt = (float)(_itercnt + count);
+}
+
+uint8_t NativeDecoder::logic_sample(int ch, uint64_t offset) const
+{
+    if (_channel_map[ch] == -1)
+        return 0xff;
+    if (_inbuf[ch] == NULL)
+        return _inbuf_const[ch] ? 1 : 0;
+
+    const uint64_t inbuf_offset = offset + (_start_samplenum % 8);
+    return (_inbuf[ch][inbuf_offset / 8] & (1 << (inbuf_offset % 8))) ? 1 : 0;
+}
+
+void NativeDecoder::put(uint64_t ss, uint64_t es, int ann_class,
+                        const vector<QString> &texts)
+{
+    assert(ann_class < (int)_ann_types.size());
+    if (_cb)
+        _cb(_decoder, Annotation(ss, es, ann_class, _ann_types[ann_class], texts),
+            _cb_data);
+}
+
+void NativeDecoder::put_bits(const vector<Bit> &bits, int ann_class)
+{
+    for (vector<Bit>::const_iterator i = bits.begin(); i != bits.end(); i++)
+        put((*i).ss, (*i).es, ann_class,
+            vector<QString>(1, QString::number((*i).value)));
+}
+
+bool NativeDecoder::stacked() const
+{
+    return _di && _di->next_di;
+}
+
+void NativeDecoder::put_python(uint64_t ss, uint64_t es, GVariant *data)
+{
+    if (stacked())
+        srd_inst_put_python(_di, ss, es, data);
+    else
+        g_variant_unref(g_variant_ref_sink(data));
+}
+
+GVariant* NativeDecoder::bits_variant(const vector<Bit> &bits,
+                                      bool newest_first)
+{
+    GVariantBuilder builder;
+    g_variant_builder_init(&builder, G_VARIANT_TYPE("aat"));
+    for (size_t i = 0; i < bits.size(); i++) {
+        const Bit &b = newest_first ? bits[bits.size() - 1 - i] : bits[i];
+        const guint64 v[3] = {b.value, b.ss, b.es};
+        g_variant_builder_add_value(&builder,
+            g_variant_new_fixed_array(G_VARIANT_TYPE_UINT64, v, 3, sizeof(guint64)));
+    }
+    return g_variant_builder_end(&builder);
+}
+
+bool NativeDecoder::find_idle_edge(LogicSnapshot &snapshot, int sig, int level,
+                                   uint64_t min_gap, uint64_t &index, uint64_t end)
+{
+    bool last = snapshot.get_sample(index, sig);
+    uint64_t pre_edge = index;
+    uint64_t pos = index + 1;
+    for (unsigned int n = 0; n < MaxBoundaryEdges &&
+         snapshot.get_nxt_edge(pos, last, end, 1, sig); n++) {
+        last = !last;
+        if ((level == -1 || last == (level == 1)) && pos - pre_edge >= min_gap) {
+            index = pos;
+            return true;
+        }
+        pre_edge = pos;
+        pos++;
+    }
+    return false;
+}
+
+GVariant* NativeDecoder::option(const Decoder &dec, const char *id)
+{
+    const srd_decoder_option *sdo = NULL;
+    for (const GSList *l = dec.decoder()->options; l && !sdo; l = l->next)
+        if (strcmp(((const srd_decoder_option *)l->data)->id, id) == 0)
+            sdo = (const srd_decoder_option *)l->data;
+    if (!sdo)
+        return NULL;
+
+    GVariant *value = sdo->def;
+    const map<string, GVariant*>::const_iterator i = dec.options().find(id);
+    if (i != dec.options().end() && (*i).second)
+        value = (*i).second;
+
+    // srd_inst_new refuses a value of another type than the default
+    if (!g_variant_type_equal(g_variant_get_type(value),
+                              g_variant_get_type(sdo->def)))
+        return NULL;
+    return value;
+}
+
+bool NativeDecoder::option_int(const Decoder &dec, const char *id, int64_t &value)
+{
+    GVariant *const v = option(dec, id);
+    if (!v || !g_variant_is_of_type(v, G_VARIANT_TYPE_INT64))
+        return false;
+    value = g_variant_get_int64(v);
+    return true;
+}
+
+bool NativeDecoder::option_double(const Decoder &dec, const char *id, double &value)
+{
+    GVariant *const v = option(dec, id);
+    if (!v || !g_variant_is_of_type(v, G_VARIANT_TYPE_DOUBLE))
+        return false;
+    value = g_variant_get_double(v);
+    return true;
+}
+
+bool NativeDecoder::option_string(const Decoder &dec, const char *id, QString &value)
+{
+    GVariant *const v = option(dec, id);
+    if (!v || !g_variant_is_of_type(v, G_VARIANT_TYPE_STRING))
+        return false;
+    value = QString::fromUtf8(g_variant_get_string(v, NULL));
+    return true;
+}
+
+} // namespace decode
+} // namespace data
+} // namespace pv
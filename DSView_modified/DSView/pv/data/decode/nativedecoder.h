@@ -0,0 +1,219 @@
+/*
+ * This file is part of the DSView project.
+ * DSView is based on PulseView.
+ *
+ * Copyright (C) 2016 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef DSVIEW_PV_DATA_DECODE_NATIVEDECODER_H
+#define DSVIEW_PV_DATA_DECODE_NATIVEDECODER_H
+
+#include <stdint.h>
+
+#include <vector>
+
+#include <glib.h>
+
+#include <QString>
+
+struct srd_decoder;
+struct srd_decoder_inst;
+
+namespace pv {
+namespace data {
+
+class LogicSnapshot;
+
+namespace decode {
+
+class Annotation;
+class Decoder;
+
+/**
+ * C++ port of one of the bottom protocol decoders: the annotation-only
+ * 0:spi, 0:uart and 0:i2c, and 1:spi, 1:uart and 1:i2c, which also put
+ * the bits and the Python output for the decoders stacked on them.
+ *
+ * A native decoder takes the place of the Python instance at the bottom
+ * of a decoder stack: it is fed the same chunks by
+ * DecoderStack::decode_data and reports the same skip hints (cur_pos,
+ * logic_mask, exp_logic and edge_index), so the stack still jumps from
+ * edge to edge through LogicSnapshot::get_nxt_edge and the annotations
+ * come out exactly as the Python decoder would put them. The Python
+ * output goes through srd_inst_put_python to the Python decoders
+ * stacked on the instance set by set_instance().
+ */
+class NativeDecoder
+{
+protected:
+    // edges looked at for one boundary before giving up
+    static const unsigned int MaxBoundaryEdges = 1 << 16;
+
+public:
+    typedef void (*AnnotationCallback)(const srd_decoder *decc,
+                                       const Annotation &a, void *cb_data);
+
+protected:
+    NativeDecoder(const Decoder &dec);
+
+public:
+    virtual ~NativeDecoder();
+
+    /**
+     * Create the native port of a decoder, or NULL if there is none or
+     * the options are not supported, in which case the Python decoder
+     * has to run.
+     */
+    static NativeDecoder* create(const Decoder &dec, uint64_t samplerate);
+
+    const srd_decoder* decoder() const;
+    int num_channels() const;
+    const int* channel_map() const;
+
+    void set_callback(AnnotationCallback cb, void *cb_data);
+
+    /**
+     * Hand the Python output to the decoders stacked on di, the
+     * instance of the Python decoder this one stands in for, which is
+     * never fed any samples itself.
+     */
+    void set_instance(srd_decoder_inst *di);
+
+    /**
+     * Decode one chunk, the counterpart of srd_inst_decode.
+     */
+    void decode(uint8_t chunk_type, uint64_t start_samplenum,
+                uint64_t end_samplenum, const uint8_t *const *inbuf,
+                const uint8_t *inbuf_const);
+
+    // skip hints for the next chunk, as left in srd_decoder_inst
+    uint64_t cur_pos() const;
+    uint64_t logic_mask() const;
+    uint64_t exp_logic() const;
+    int edge_index() const;
+
+    /**
+     * Find a frame boundary after index and not after end: an edge at
+     * which a decoder started one sample before it goes on exactly like
+     * one which has been decoding all along and is synced() there.
+     */
+    virtual bool find_boundary(LogicSnapshot &snapshot, uint64_t &index,
+                               uint64_t end) const = 0;
+
+    /**
+     * True if the state, on arriving at a boundary, is the one a decoder
+     * started one sample before the boundary would have.
+     */
+    virtual bool synced() const = 0;
+
+protected:
+    // a bit as listed in the Python output, [value, ss, es]
+    struct Bit
+    {
+        uint64_t value;
+        uint64_t ss;
+        uint64_t es;
+    };
+
+protected:
+    /**
+     * Read the options, the counterpart of the start() method of the
+     * Python decoder. Returns false for anything the port does not
+     * cover, which leaves it to the Python decoder to decode or to
+     * report the error.
+     */
+    virtual bool start(const Decoder &dec, uint64_t samplerate) = 0;
+
+    virtual void decode_samples() = 0;
+
+    /**
+     * Step to the next sample of the chunk, the counterpart of the
+     * Python logic iterator.
+     */
+    bool next(uint64_t &samplenum, uint8_t *pins);
+
+    // logic.itercnt += count
+    void advance(double count);
+
+    void put(uint64_t ss, uint64_t es, int ann_class,
+             const std::vector<QString> &texts);
+
+    // one annotation of ann_class per bit, from the first one received
+    void put_bits(const std::vector<Bit> &bits, int ann_class);
+
+    // true if there are decoders to take the Python output
+    bool stacked() const;
+
+    /**
+     * Put Python output, the data being a floating reference as the
+     * g_variant_new functions return. Callers check stacked() first so
+     * nothing is built for a decoder on its own.
+     */
+    void put_python(uint64_t ss, uint64_t es, GVariant *data);
+
+    // the list of bits, newest_first as kept by insert(0, ...)
+    static GVariant* bits_variant(const std::vector<Bit> &bits,
+                                  bool newest_first);
+
+    /**
+     * Find an edge of channel sig to level, or to either level for -1,
+     * with no other edge in the min_gap samples before it.
+     */
+    static bool find_idle_edge(LogicSnapshot &snapshot, int sig, int level,
+                               uint64_t min_gap, uint64_t &index, uint64_t end);
+
+    static GVariant* option(const Decoder &dec, const char *id);
+    static bool option_int(const Decoder &dec, const char *id, int64_t &value);
+    static bool option_double(const Decoder &dec, const char *id, double &value);
+    static bool option_string(const Decoder &dec, const char *id, QString &value);
+
+private:
+    uint8_t logic_sample(int ch, uint64_t offset) const;
+
+protected:
+    // members of the Python logic object
+    float _itercnt;
+    uint64_t _logic_mask;
+    uint64_t _exp_logic;
+    int _edge_index;
+    uint64_t _cur_pos;
+
+private:
+    const srd_decoder *const _decoder;
+    std::vector<int> _channel_map;
+    std::vector<int> _ann_types;
+
+    uint64_t _start_samplenum;
+    uint64_t _samplenum;
+    const uint8_t *const *_inbuf;
+    const uint8_t *_inbuf_const;
+
+    uint64_t _di_cur_pos;
+    uint64_t _di_logic_mask;
+    uint64_t _di_exp_logic;
+    int _di_edge_index;
+
+    AnnotationCallback _cb;
+    void *_cb_data;
+    srd_decoder_inst *_di;
+};
+
+} // namespace decode
+} // namespace data
+} // namespace pv
+
+#endif // DSVIEW_PV_DATA_DECODE_NATIVEDECODER_H
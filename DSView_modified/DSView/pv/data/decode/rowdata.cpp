@@ -21,19 +21,49 @@
 
 #include <math.h>
 
+#include <algorithm>
+
+#include <QDataStream>
+
 #include "rowdata.h"
 
+using std::map;
 using std::max;
 using std::min;
+using std::multimap;
+using std::pair;
 using std::vector;
 
 namespace pv {
 namespace data {
 namespace decode {
 
+static bool is_hex_digit(const QChar &c)
+{
+    const QChar l = c.toLower();
+    return (l >= '0' && l <= '9') || (l >= 'a' && l <= 'f');
+}
+
+bool RowData::Kind::operator==(const Kind &other) const
+{
+    return format == other.format && type == other.type &&
+           texts == other.texts;
+}
+
+uint32_t RowData::Kind::hash() const
+{
+    uint32_t h = format * 31 + type;
+    for (vector<QString>::const_iterator i = texts.begin();
+        i != texts.end(); i++)
+        h = h * 31 + qHash(*i);
+    return h;
+}
+
 RowData::RowData() :
     _max_annotation(0),
-    _min_annotation(UINT64_MAX)
+    _min_annotation(UINT64_MAX),
+    _query_checked(0),
+    _sorted(true)
 {
 }
 
@@ -44,14 +74,29 @@ RowData::~RowData()
 
 void RowData::clear()
 {
-    _annotations.clear();
+    vector<uint64_t>().swap(_start_samples);
+    vector<uint64_t>().swap(_end_samples);
+    vector<uint32_t>().swap(_kinds);
+    vector<uint64_t>().swap(_block_max_end);
+    vector<Kind>().swap(_kind_table);
+    _kind_ids.clear();
+    vector< vector<uint64_t> >().swap(_kind_positions);
+    vector<uint32_t>().swap(_kind_texts);
+    _text_kinds.clear();
+    _gram_kinds.clear();
+    _sorted = true;
+
+    _query = QString();
+    vector<uint32_t>().swap(_query_kinds);
+    vector<bool>().swap(_query_mask);
+    _query_checked = 0;
 }
 
 uint64_t RowData::get_max_sample() const
 {
-	if (_annotations.empty())
+    if (_end_samples.empty())
 		return 0;
-	return _annotations.back().end_sample();
+    return _end_samples.back();
 }
 
 uint64_t RowData::get_max_annotation() const
@@ -67,58 +112,394 @@ uint64_t RowData::get_min_annotation() const
         return _min_annotation;
 }
 
-void RowData::get_annotation_subset(
-	vector<pv::data::decode::Annotation> &dest,
-	uint64_t start_sample, uint64_t end_sample) const
+Annotation RowData::annotation(uint64_t index) const
+{
+    const Kind &kind = _kind_table[_kinds[index]];
+    return Annotation(_start_samples[index], _end_samples[index],
+                      kind.format, kind.type, kind.texts);
+}
+
+void RowData::get_annotation_range(uint64_t start_sample, uint64_t end_sample,
+                                   const_iterator &first, const_iterator &last) const
 {
-	for (vector<Annotation>::const_iterator i = _annotations.begin();
-		i != _annotations.end(); i++)
-		if ((*i).end_sample() > start_sample &&
-			(*i).start_sample() <= end_sample)
-			dest.push_back(*i);
+    first = iter(0);
+    last = end();
+    if (_sorted) {
+        // nothing before the first block reaching into the range ends
+        // in it, nothing after the last start in the range starts in it
+        last = iter(std::upper_bound(_start_samples.begin(), _start_samples.end(),
+                                     end_sample) - _start_samples.begin());
+        first = iter(min(last.index(),
+                         (uint64_t)(std::upper_bound(_block_max_end.begin(),
+                                                     _block_max_end.end(),
+                                                     start_sample) -
+                                    _block_max_end.begin()) * IndexBlock));
+    }
 }
 
 uint64_t RowData::get_annotation_index(uint64_t start_sample) const
 {
+    if (_sorted)
+        return std::upper_bound(_start_samples.begin(), _start_samples.end(),
+                                start_sample) - _start_samples.begin();
+
     uint64_t index = 0;
-    for (vector<Annotation>::const_iterator i = _annotations.begin();
-        i != _annotations.end(); i++) {
-        if ((*i).start_sample() > start_sample)
+    for (vector<uint64_t>::const_iterator i = _start_samples.begin();
+        i != _start_samples.end(); i++) {
+        if ((*i) > start_sample)
             break;
         index++;
     }
     return index;
 }
 
+uint32_t RowData::kind_id(const Annotation &a)
+{
+    Kind kind;
+    kind.format = a.format();
+    kind.type = a.type();
+    kind.texts = a.annotations();
+
+    const uint32_t hash = kind.hash();
+    const uint32_t id = find_kind(kind, hash);
+    if (id != NoKind)
+        return id;
+
+    return add_kind(kind, hash);
+}
+
+uint32_t RowData::find_kind(const Kind &kind, uint32_t hash) const
+{
+    typedef multimap<uint32_t, uint32_t>::const_iterator iterator;
+    const pair<iterator, iterator> range = _kind_ids.equal_range(hash);
+    for (iterator i = range.first; i != range.second; i++)
+        if (_kind_table[(*i).second] == kind)
+            return (*i).second;
+    return NoKind;
+}
+
+uint32_t RowData::add_kind(const Kind &kind, uint32_t hash)
+{
+    const uint32_t id = _kind_table.size();
+    _kind_table.push_back(kind);
+    multimap<uint32_t, uint32_t>::iterator iter = _kind_ids.end();
+    try {
+        _kind_positions.push_back(vector<uint64_t>());
+        iter = _kind_ids.insert(std::make_pair(hash, id));
+        _kind_texts.push_back(id);
+        _kind_texts.back() = text_kind(id);
+    } catch (const std::bad_alloc&) {
+        // runs already indexed are weeded out by matching the text
+        if (iter != _kind_ids.end())
+            _kind_ids.erase(iter);
+        _kind_positions.resize(id);
+        _kind_texts.resize(id);
+        _kind_table.pop_back();
+        throw;
+    }
+    return id;
+}
+
+uint32_t RowData::text_kind(uint32_t id)
+{
+    const Kind &kind = _kind_table[id];
+    if (kind.texts.empty())
+        return id;
+
+    typedef multimap<uint32_t, uint32_t>::const_iterator iterator;
+    const uint32_t hash = qHash(kind.texts[0]);
+    const pair<iterator, iterator> range = _text_kinds.equal_range(hash);
+    for (iterator i = range.first; i != range.second; i++)
+        if (_kind_table[(*i).second].texts[0] == kind.texts[0])
+            return (*i).second;
+
+    // only a new text goes into the index
+    index_kind(id);
+    _text_kinds.insert(std::make_pair(hash, id));
+    return id;
+}
+
+uint64_t RowData::gram(const QString &folded, int pos)
+{
+    return ((uint64_t)folded[pos].unicode() << 32) |
+           ((uint64_t)folded[pos + 1].unicode() << 16) |
+           folded[pos + 2].unicode();
+}
+
+void RowData::index_kind(uint32_t id)
+{
+    const Kind &kind = _kind_table[id];
+    if (kind.texts.empty())
+        return;
+
+    const QString folded = kind.texts[0].toLower();
+    for (int pos = 0; pos + GramSize <= folded.size(); pos++) {
+        vector<uint32_t> &kinds = _gram_kinds[gram(folded, pos)];
+        if (kinds.empty() || kinds.back() != id)
+            kinds.push_back(id);
+    }
+}
+
 bool RowData::push_annotation(const Annotation &a)
 {
     try {
-      _annotations.push_back(a);
-      _max_annotation = max(_max_annotation, a.end_sample() - a.start_sample());
-      if (a.end_sample() != a.start_sample())
-          _min_annotation = min(_min_annotation, a.end_sample() - a.start_sample());
+        return push(a.start_sample(), a.end_sample(), kind_id(a));
+    } catch (const std::bad_alloc&) {
+        return false;
+    }
+}
+
+bool RowData::push(uint64_t start_sample, uint64_t end_sample, uint32_t kind)
+{
+    const size_t size = _start_samples.size();
+    try {
+      _start_samples.push_back(start_sample);
+      _end_samples.push_back(end_sample);
+      _kinds.push_back(kind);
+
+      const uint64_t pre_max_end = _block_max_end.empty() ? 0 : _block_max_end.back();
+      if (size % IndexBlock == 0)
+          _block_max_end.push_back(max(pre_max_end, end_sample));
+      else
+          _block_max_end.back() = max(pre_max_end, end_sample);
+      if (size != 0 && start_sample < _start_samples[size - 1])
+          _sorted = false;
+
+      _max_annotation = max(_max_annotation, end_sample - start_sample);
+      if (end_sample != start_sample)
+          _min_annotation = min(_min_annotation, end_sample - start_sample);
+      _kind_positions[kind].push_back(size);
       return true;
     } catch (const std::bad_alloc&) {
+      _start_samples.resize(size);
+      _end_samples.resize(size);
+      _kinds.resize(size);
+      _block_max_end.resize((size + IndexBlock - 1) / IndexBlock);
       return false;
     }
 }
 
 uint64_t RowData::get_annotation_size() const
 {
-    return _annotations.size();
+    return _start_samples.size();
 }
 
 bool RowData::get_annotation(Annotation &ann,
                              uint64_t index) const
 {
-    if (index < _annotations.size()) {
-        ann = _annotations[index];
+    if (index < _start_samples.size()) {
+        ann = annotation(index);
         return true;
     } else {
         return false;
     }
 }
 
+RowData::const_iterator RowData::iter(uint64_t index) const
+{
+    return const_iterator(this, min(index, (uint64_t)_start_samples.size()));
+}
+
+RowData::const_iterator RowData::end() const
+{
+    return const_iterator(this, _start_samples.size());
+}
+
+uint32_t RowData::get_kind_count() const
+{
+    return _kind_table.size();
+}
+
+const QString& RowData::get_kind_text(uint32_t kind) const
+{
+    static const QString empty;
+    const Kind &k = _kind_table[kind];
+    return k.texts.empty() ? empty : k.texts[0];
+}
+
+void RowData::save(QDataStream &out) const
+{
+    out << (quint32)_kind_table.size();
+    for (vector<Kind>::const_iterator i = _kind_table.begin();
+        i != _kind_table.end(); i++) {
+        out << (qint32)(*i).format << (qint32)(*i).type
+            << (quint32)(*i).texts.size();
+        for (vector<QString>::const_iterator t = (*i).texts.begin();
+            t != (*i).texts.end(); t++)
+            out << *t;
+    }
+
+    out << (quint64)_start_samples.size();
+    for (uint64_t i = 0; i < _start_samples.size(); i++)
+        out << (quint64)_start_samples[i] << (quint64)_end_samples[i]
+            << (quint32)_kinds[i];
+}
+
+bool RowData::load(QDataStream &in)
+{
+    try {
+        quint32 kinds;
+        in >> kinds;
+        for (quint32 k = 0; k < kinds && in.status() == QDataStream::Ok; k++) {
+            Kind kind;
+            qint32 format, type;
+            quint32 texts;
+            in >> format >> type >> texts;
+            kind.format = format;
+            kind.type = type;
+            for (quint32 t = 0; t < texts && in.status() == QDataStream::Ok; t++) {
+                QString text;
+                in >> text;
+                kind.texts.push_back(text);
+            }
+            const uint32_t hash = kind.hash();
+            if (find_kind(kind, hash) != NoKind)
+                return false;
+            add_kind(kind, hash);
+        }
+
+        quint64 count;
+        in >> count;
+        for (quint64 i = 0; i < count && in.status() == QDataStream::Ok; i++) {
+            quint64 start, end;
+            quint32 kind;
+            in >> start >> end >> kind;
+            if (kind >= _kind_table.size() || !push(start, end, kind))
+                return false;
+        }
+    } catch (const std::bad_alloc&) {
+        return false;
+    }
+    return in.status() == QDataStream::Ok;
+}
+
+bool RowData::match_text(const QString &text, const QString &pattern)
+{
+    if (!pattern.contains('?'))
+        return text.contains(pattern);
+
+    const int len = pattern.size();
+    for (int pos = 0; pos + len <= text.size(); pos++) {
+        int i = 0;
+        for (; i < len; i++) {
+            const QChar t = text[pos + i];
+            const QChar p = pattern[i];
+            if (p == '?') {
+                if (!is_hex_digit(t))
+                    break;
+            } else if (t != p) {
+                if (!is_hex_digit(p) || t.toLower() != p.toLower())
+                    break;
+            }
+        }
+        if (i == len)
+            return true;
+    }
+    return false;
+}
+
+void RowData::update_query(const QString &pattern) const
+{
+    if (pattern != _query || _query_checked > _kind_table.size()) {
+        _query = pattern;
+        _query_kinds.clear();
+        _query_mask.clear();
+        _query_checked = 0;
+    }
+    const uint32_t kinds = _kind_table.size();
+    if (_query_checked == kinds)
+        return;
+    _query_mask.resize(kinds, false);
+
+    // The longest run of the pattern without a wildcard gives the
+    // candidates, through the run of it shared by the fewest kinds
+    const QString folded = pattern.toLower();
+    int run_pos = 0;
+    int run_len = 0;
+    for (int i = 0, start = 0; i <= folded.size(); i++) {
+        if (i == folded.size() || folded[i] == '?') {
+            if (i - start > run_len) {
+                run_pos = start;
+                run_len = i - start;
+            }
+            start = i + 1;
+        }
+    }
+
+    const vector<uint32_t> *candidates = NULL;
+    for (int pos = run_pos; pos + GramSize <= run_pos + run_len; pos++) {
+        map< uint64_t, vector<uint32_t> >::const_iterator iter =
+            _gram_kinds.find(gram(folded, pos));
+        if (iter == _gram_kinds.end()) {
+            _query_checked = kinds;
+            return;
+        }
+        if (!candidates || (*iter).second.size() < candidates->size())
+            candidates = &(*iter).second;
+    }
+
+    // the texts first, then the kinds sharing them
+    if (candidates) {
+        for (vector<uint32_t>::const_iterator i = std::lower_bound(
+                candidates->begin(), candidates->end(), _query_checked);
+            i != candidates->end() && (*i) < kinds; i++)
+            if (match_text(_kind_table[*i].texts[0], pattern))
+                _query_mask[*i] = true;
+    } else {
+        for (uint32_t id = _query_checked; id < kinds; id++)
+            if (_kind_texts[id] == id && !_kind_table[id].texts.empty() &&
+                match_text(_kind_table[id].texts[0], pattern))
+                _query_mask[id] = true;
+    }
+    for (uint32_t id = _query_checked; id < kinds; id++) {
+        if (_kind_texts[id] != id)
+            _query_mask[id] = _query_mask[_kind_texts[id]];
+        if (_query_mask[id])
+            _query_kinds.push_back(id);
+    }
+    _query_checked = kinds;
+}
+
+uint64_t RowData::get_match_count(const QString &pattern) const
+{
+    update_query(pattern);
+
+    uint64_t count = 0;
+    for (vector<uint32_t>::const_iterator i = _query_kinds.begin();
+        i != _query_kinds.end(); i++)
+        count += _kind_positions[*i].size();
+    return count;
+}
+
+bool RowData::get_match(const QString &pattern, uint64_t from, bool nxt,
+                        uint64_t &index) const
+{
+    update_query(pattern);
+
+    // the nearest annotation of each matching kind
+    bool found = false;
+    for (vector<uint32_t>::const_iterator i = _query_kinds.begin();
+        i != _query_kinds.end(); i++) {
+        const vector<uint64_t> &positions = _kind_positions[*i];
+        if (nxt) {
+            const vector<uint64_t>::const_iterator p = std::lower_bound(
+                positions.begin(), positions.end(), from);
+            if (p != positions.end() && (!found || (*p) < index)) {
+                index = *p;
+                found = true;
+            }
+        } else {
+            const vector<uint64_t>::const_iterator p = std::upper_bound(
+                positions.begin(), positions.end(), from);
+            if (p != positions.begin() && (!found || *(p - 1) > index)) {
+                index = *(p - 1);
+                found = true;
+            }
+        }
+    }
+    return found;
+}
+
 } // decode
 } // data
 } // pv
@@ -22,16 +22,86 @@
 #ifndef DSVIEW_PV_DATA_DECODE_ROWDATA_H
 #define DSVIEW_PV_DATA_DECODE_ROWDATA_H
 
+#include <map>
 #include <vector>
 
+#include <QString>
+
 #include "annotation.h"
 
+class QDataStream;
+
 namespace pv {
 namespace data {
 namespace decode {
 
+/**
+ * The annotations of one row, stored by column. Annotations which only
+ * differ in their position share one entry of a kind table, and a
+ * running maximum of the end samples lets a time range be looked up by
+ * binary search as long as the annotations come in order of their start.
+ *
+ * For searching, the runs of three characters of each distinct text
+ * point back to the first kind showing it, so a text search only has to
+ * check the texts sharing a run with the pattern. Every kind lists the
+ * indexes of its annotations, so stepping to the next match is a binary
+ * search in the lists of the matching kinds.
+ */
 class RowData
 {
+private:
+    // annotations per entry of the end sample index
+    static const uint64_t IndexBlock = 64;
+    // characters in one run of the text index
+    static const int GramSize = 3;
+    // find_kind() of a kind not in the table
+    static const uint32_t NoKind = UINT32_MAX;
+
+    // what an annotation holds apart from its position
+    struct Kind
+    {
+        int format;
+        int type;
+        std::vector<QString> texts;
+
+        bool operator==(const Kind &other) const;
+        uint32_t hash() const;
+    };
+
+public:
+    /**
+     * Walks the annotations in place, without making Annotation objects.
+     * Valid until more annotations are pushed.
+     */
+    class const_iterator
+    {
+    public:
+        const_iterator() :
+            _row(NULL), _index(0) {}
+        const_iterator(const RowData *row, uint64_t index) :
+            _row(row), _index(index) {}
+
+        uint64_t index() const { return _index; }
+        uint64_t start_sample() const { return _row->_start_samples[_index]; }
+        uint64_t end_sample() const { return _row->_end_samples[_index]; }
+        uint32_t kind() const { return _row->_kinds[_index]; }
+        const QString& text() const { return _row->get_kind_text(kind()); }
+        int format() const { return _row->_kind_table[kind()].format; }
+        int type() const { return _row->_kind_table[kind()].type; }
+        const std::vector<QString>& texts() const {
+            return _row->_kind_table[kind()].texts;
+        }
+
+        const_iterator& operator++() { _index++; return *this; }
+        bool operator!=(const const_iterator &other) const {
+            return _index != other._index;
+        }
+
+    private:
+        const RowData *_row;
+        uint64_t _index;
+    };
+
 public:
 	RowData();
     ~RowData();
@@ -40,12 +110,12 @@ public:
 
     uint64_t get_max_annotation() const;
     uint64_t get_min_annotation() const;
-	/**
-	 * Extracts sorted annotations between two period into a vector.
-	 */
-	void get_annotation_subset(
-		std::vector<pv::data::decode::Annotation> &dest,
-		uint64_t start_sample, uint64_t end_sample) const;
+    /**
+     * The annotations which may overlap the period. Out of order rows
+     * give the whole row, so check the samples of each annotation.
+     */
+    void get_annotation_range(uint64_t start_sample, uint64_t end_sample,
+                              const_iterator &first, const_iterator &last) const;
 
     uint64_t get_annotation_index(uint64_t start_sample) const;
 
@@ -56,12 +126,82 @@ public:
     bool get_annotation(pv::data::decode::Annotation &ann,
                         uint64_t index) const;
 
+    // iterators from index on, or to the end
+    const_iterator iter(uint64_t index) const;
+    const_iterator end() const;
+
+    // the kinds of annotation, and the first text of each
+    uint32_t get_kind_count() const;
+    const QString& get_kind_text(uint32_t kind) const;
+
+    /**
+     * Count the annotations whose text contains the pattern. In a
+     * pattern with a '?', the '?' stands for any hex digit and hex
+     * digits match in either case.
+     */
+    uint64_t get_match_count(const QString &pattern) const;
+
+    /**
+     * Find the first annotation matching the pattern from index on,
+     * or the last one up to index if nxt is false.
+     */
+    bool get_match(const QString &pattern, uint64_t from, bool nxt,
+                   uint64_t &index) const;
+
+    // true if the text contains the pattern, '?' as above
+    static bool match_text(const QString &text, const QString &pattern);
+
     void clear();
 
+    /**
+     * Write the annotations with their kind table, and read them back
+     * into an empty row. load() returns false on a damaged stream.
+     */
+    void save(QDataStream &out) const;
+    bool load(QDataStream &in);
+
+private:
+    bool push(uint64_t start_sample, uint64_t end_sample, uint32_t kind);
+    uint32_t kind_id(const Annotation &a);
+    uint32_t find_kind(const Kind &kind, uint32_t hash) const;
+    uint32_t add_kind(const Kind &kind, uint32_t hash);
+    uint32_t text_kind(uint32_t id);
+    Annotation annotation(uint64_t index) const;
+
+    void index_kind(uint32_t id);
+    void update_query(const QString &pattern) const;
+    static uint64_t gram(const QString &folded, int pos);
+
 private:
     uint64_t _max_annotation;
     uint64_t _min_annotation;
-	std::vector<Annotation> _annotations;
+
+    std::vector<uint64_t> _start_samples;
+    std::vector<uint64_t> _end_samples;
+    std::vector<uint32_t> _kinds;
+
+    std::vector<Kind> _kind_table;
+    // entries of the kind table by the hash of their content
+    std::multimap<uint32_t, uint32_t> _kind_ids;
+    // indexes of the annotations of each kind, in order
+    std::vector< std::vector<uint64_t> > _kind_positions;
+    // the first kind with the same text as each kind
+    std::vector<uint32_t> _kind_texts;
+    // those first kinds by the hash of their text
+    std::multimap<uint32_t, uint32_t> _text_kinds;
+    // first kinds whose text contains a run, in order
+    std::map< uint64_t, std::vector<uint32_t> > _gram_kinds;
+
+    // kinds matching the last pattern, out of the first _query_checked
+    mutable QString _query;
+    mutable std::vector<uint32_t> _query_kinds;
+    mutable std::vector<bool> _query_mask;
+    mutable uint32_t _query_checked;
+
+    // maximum end sample of the annotations before each block end
+    std::vector<uint64_t> _block_max_end;
+    // start samples do not decrease
+    bool _sorted;
 };
 
 }
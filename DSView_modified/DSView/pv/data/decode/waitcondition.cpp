@@ -0,0 +1,232 @@
+/*
+ * This file is part of the DSView project.
+ * DSView is based on PulseView.
+ *
+ * Copyright (C) 2016 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <libsigrokdecode4DSL/libsigrokdecode.h>
+
+#include "waitcondition.h"
+#include "../logicsnapshot.h"
+
+namespace pv {
+namespace data {
+namespace decode {
+
+WaitCondition::WaitCondition()
+{
+}
+
+void WaitCondition::clear()
+{
+    // keeps the capacity, the next wait fills them again
+    _terms.clear();
+    _conds.clear();
+}
+
+void WaitCondition::add_term(uint64_t skip)
+{
+    Term term;
+    term.begin = _conds.size();
+    term.end = _conds.size();
+    term.edge = -1;
+    term.skip = skip;
+    _terms.push_back(term);
+}
+
+void WaitCondition::add_cond(int sig, CondType type)
+{
+    Term &term = _terms.back();
+    if (term.edge == -1 && type != High && type != Low && type != Stable)
+        term.edge = _conds.size();
+    Cond cond;
+    cond.sig = sig;
+    cond.type = type;
+    _conds.push_back(cond);
+    term.end = _conds.size();
+}
+
+void WaitCondition::set_hints(uint64_t logic_mask, uint64_t exp_logic,
+    int edge_index, const int *channel_map, int num_channels)
+{
+    clear();
+    if (edge_index == -1) {
+        for (int j = 0; j < num_channels; j++) {
+            if ((logic_mask & (1ULL << j)) && channel_map[j] != -1) {
+                add_term(0);
+                add_cond(channel_map[j], Edge);
+            }
+        }
+    } else {
+        add_term(0);
+        add_cond(edge_index, Edge);
+        for (int j = 0; j < num_channels; j++) {
+            if ((logic_mask & (1ULL << j)) && channel_map[j] != -1)
+                add_cond(channel_map[j], (exp_logic & (1ULL << j)) ? High : Low);
+        }
+    }
+}
+
+void WaitCondition::set_terms(const srd_wait_term *terms, int count,
+    const int *channel_map, int num_channels)
+{
+    clear();
+    for (int i = 0; i < count; i++) {
+        const srd_wait_term &t = terms[i];
+        add_term(t.skip);
+        for (int j = 0; j < num_channels; j++) {
+            const uint64_t bit = 1ULL << j;
+            const int sig = channel_map[j];
+            if (sig == -1)
+                continue;
+            if (t.rise & bit)
+                add_cond(sig, Rise);
+            if (t.fall & bit)
+                add_cond(sig, Fall);
+            if (t.edge & bit)
+                add_cond(sig, Edge);
+            if (t.high & bit)
+                add_cond(sig, High);
+            if (t.low & bit)
+                add_cond(sig, Low);
+            if (t.stable & bit)
+                add_cond(sig, Stable);
+        }
+    }
+}
+
+bool WaitCondition::holds(LogicSnapshot &snapshot, const Term &term,
+    uint64_t pos, uint64_t index) const
+{
+    if (term.skip != 0 && index != pos + term.skip)
+        return false;
+
+    for (unsigned int i = term.begin; i < term.end; i++) {
+        const Cond &cond = _conds[i];
+        const bool sample = snapshot.get_sample(index, cond.sig);
+        if (cond.type == High || cond.type == Low) {
+            if (sample != (cond.type == High))
+                return false;
+            continue;
+        }
+
+        // index is after pos, there is always a sample before it
+        const bool last_sample = snapshot.get_sample(index - 1, cond.sig);
+        switch (cond.type) {
+        case Rise:
+            if (last_sample || !sample)
+                return false;
+            break;
+        case Fall:
+            if (!last_sample || sample)
+                return false;
+            break;
+        case Edge:
+            if (last_sample == sample)
+                return false;
+            break;
+        default:
+            if (last_sample != sample)
+                return false;
+            break;
+        }
+    }
+    return true;
+}
+
+bool WaitCondition::first_match(LogicSnapshot &snapshot, const Term &term,
+    uint64_t pos, uint64_t end, uint64_t &index) const
+{
+    if (term.skip != 0) {
+        index = pos + term.skip;
+        return index <= end && holds(snapshot, term, pos, index);
+    }
+
+    index = pos + 1;
+    if (term.edge != -1) {
+        // only the edges of one of the signals can match
+        const int sig = _conds[term.edge].sig;
+        bool last_sample = snapshot.get_sample(pos, sig);
+        while (index <= end) {
+            if (!snapshot.get_nxt_edge(index, last_sample, end, 1, sig) ||
+                index > end)
+                return false;
+            if (holds(snapshot, term, pos, index))
+                return true;
+            last_sample = !last_sample;
+            index++;
+        }
+        return false;
+    }
+
+    // levels only: go on to the next edge of a signal not at its level
+    while (index <= end) {
+        unsigned int i = term.begin;
+        for (; i < term.end; i++) {
+            const Cond &cond = _conds[i];
+            const bool sample = snapshot.get_sample(index, cond.sig);
+            if (cond.type == Stable) {
+                if (sample != snapshot.get_sample(index - 1, cond.sig))
+                    break;
+            } else if (sample != (cond.type == High)) {
+                break;
+            }
+        }
+        if (i == term.end)
+            return true;
+
+        if (_conds[i].type == Stable) {
+            index++;
+        } else if (!snapshot.get_nxt_edge(index, _conds[i].type == Low, end,
+                                          1, _conds[i].sig)) {
+            return false;
+        }
+    }
+    return false;
+}
+
+bool WaitCondition::find(LogicSnapshot &snapshot, uint64_t pos, uint64_t end,
+    uint64_t &match, uint64_t &matched) const
+{
+    bool found = false;
+    uint64_t limit = end;
+    for (unsigned int t = 0; t < _terms.size(); t++) {
+        uint64_t index;
+        if (first_match(snapshot, _terms[t], pos, limit, index)) {
+            found = true;
+            match = index;
+            limit = index;
+            // nothing can come before the next sample
+            if (index == pos + 1)
+                break;
+        }
+    }
+    if (!found)
+        return false;
+
+    matched = 0;
+    for (unsigned int t = 0; t < _terms.size() && t < 64; t++) {
+        if (holds(snapshot, _terms[t], pos, match))
+            matched |= 1ULL << t;
+    }
+    return true;
+}
+
+} // namespace decode
+} // namespace data
+} // namespace pv
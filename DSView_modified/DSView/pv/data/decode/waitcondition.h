@@ -0,0 +1,122 @@
+/*
+ * This file is part of the DSView project.
+ * DSView is based on PulseView.
+ *
+ * Copyright (C) 2016 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef DSVIEW_PV_DATA_DECODE_WAITCONDITION_H
+#define DSVIEW_PV_DATA_DECODE_WAITCONDITION_H
+
+#include <stdint.h>
+
+#include <vector>
+
+struct srd_wait_term;
+
+namespace pv {
+namespace data {
+
+class LogicSnapshot;
+
+namespace decode {
+
+/**
+ * The sample a decoder waits for before its next chunk: any of a few
+ * terms, each a set of levels and edges of signals which have to hold
+ * together, as given to logic.wait() or by the older skip hints.
+ *
+ * Matches are looked for on the edge mipmaps of the snapshot, so the
+ * samples in between are never visited one by one: a term with an edge
+ * only looks at the edges of that signal, and one with levels only
+ * jumps to the next edge of whichever signal is not at its level yet.
+ */
+class WaitCondition
+{
+private:
+    enum CondType {
+        High,
+        Low,
+        Rise,
+        Fall,
+        Edge,
+        Stable
+    };
+
+    struct Cond
+    {
+        int sig;
+        CondType type;
+    };
+
+    struct Term
+    {
+        // the conds of the term in _conds
+        unsigned int begin;
+        unsigned int end;
+        // the first edge cond, or -1 if there is none
+        int edge;
+        uint64_t skip;
+    };
+
+public:
+    WaitCondition();
+
+    void clear();
+
+    /**
+     * The skip hints of srd_decoder_inst: any edge of the channels in
+     * logic_mask for an edge_index of -1, otherwise an edge of signal
+     * edge_index with the masked channels at exp_logic.
+     */
+    void set_hints(uint64_t logic_mask, uint64_t exp_logic, int edge_index,
+                   const int *channel_map, int num_channels);
+
+    /**
+     * The terms of a logic.wait(). Conditions on unused optional
+     * channels are left out.
+     */
+    void set_terms(const srd_wait_term *terms, int count,
+                   const int *channel_map, int num_channels);
+
+    /**
+     * Find the first sample after pos and not after end at which any of
+     * the terms holds, matched getting a bit set for each of them which
+     * does there.
+     */
+    bool find(LogicSnapshot &snapshot, uint64_t pos, uint64_t end,
+              uint64_t &match, uint64_t &matched) const;
+
+private:
+    void add_term(uint64_t skip);
+    void add_cond(int sig, CondType type);
+
+    bool holds(LogicSnapshot &snapshot, const Term &term,
+               uint64_t pos, uint64_t index) const;
+    bool first_match(LogicSnapshot &snapshot, const Term &term,
+                     uint64_t pos, uint64_t end, uint64_t &index) const;
+
+private:
+    std::vector<Term> _terms;
+    std::vector<Cond> _conds;
+};
+
+} // namespace decode
+} // namespace data
+} // namespace pv
+
+#endif // DSVIEW_PV_DATA_DECODE_WAITCONDITION_H
@@ -26,6 +26,7 @@
 #include <algorithm>
 
 #include <QDebug>
+#include <QDataStream>
 
 #include "decoderstack.h"
 
@@ -33,7 +34,10 @@
 #include <pv/data/logicsnapshot.h>
 #include <pv/data/decode/decoder.h>
 #include <pv/data/decode/annotation.h>
+#include <pv/data/decode/nativedecoder.h>
+#include <pv/data/decode/waitcondition.h>
 #include <pv/sigsession.h>
+#include <pv/device/devinst.h>
 #include <pv/view/logicsignal.h>
 
 using namespace boost;
@@ -50,26 +54,31 @@ const int64_t DecoderStack::DecodeChunkLength = 4 * 1024;
 //const int64_t DecoderStack::DecodeChunkLength = 1024 * 1024;
 const unsigned int DecoderStack::DecodeNotifyPeriod = 1024;
 
-boost::mutex DecoderStack::_global_decode_mutex;
-
 DecoderStack::DecoderStack(pv::SigSession &session,
 	const srd_decoder *const dec) :
-	_session(session),
+    DecoderStack(dec)
+{
+    _session = &session;
+	connect(_session, SIGNAL(frame_began()),
+		this, SLOT(on_new_frame()));
+	connect(_session, SIGNAL(data_received()),
+		this, SLOT(on_data_received()));
+	connect(_session, SIGNAL(frame_ended()),
+		this, SLOT(on_frame_ended()));
+}
+
+DecoderStack::DecoderStack(const srd_decoder *const dec) :
+    _session(NULL),
 	_sample_count(0),
 	_frame_complete(false),
+    _live(false),
     _samples_decoded(0),
     _decode_state(Stopped),
     _options_changed(false),
     _no_memory(false),
+    _restored(false),
     _mark_index(-1)
 {
-	connect(&_session, SIGNAL(frame_began()),
-		this, SLOT(on_new_frame()));
-	connect(&_session, SIGNAL(data_received()),
-		this, SLOT(on_data_received()));
-	connect(&_session, SIGNAL(frame_ended()),
-		this, SLOT(on_frame_ended()));
-
     _stack.push_back(boost::shared_ptr<decode::Decoder>(
 		new decode::Decoder(dec)));
 
@@ -183,18 +192,20 @@ int64_t DecoderStack::samples_decoded() const
 	return _samples_decoded;
 }
 
-void DecoderStack::get_annotation_subset(
-	std::vector<pv::data::decode::Annotation> &dest,
-	const Row &row, uint64_t start_sample,
-	uint64_t end_sample) const
+bool DecoderStack::get_annotation_range(const Row &row,
+    uint64_t start_sample, uint64_t end_sample,
+    decode::RowData::const_iterator &first,
+    decode::RowData::const_iterator &last) const
 {
     //lock_guard<mutex> lock(_output_mutex);
 
     std::map<const Row, decode::RowData>::const_iterator iter =
         _rows.find(row);
-    if (iter != _rows.end())
-		(*iter).second.get_annotation_subset(dest,
-			start_sample, end_sample);
+    if (iter == _rows.end())
+        return false;
+    (*iter).second.get_annotation_range(start_sample, end_sample,
+                                        first, last);
+    return true;
 }
 
 
@@ -334,6 +345,40 @@ bool DecoderStack::list_annotation(pv::data::decode::Annotation &ann,
     return false;
 }
 
+uint64_t DecoderStack::list_match_count(uint16_t row_index,
+                                        const QString &pattern) const
+{
+    boost::lock_guard<boost::recursive_mutex> lock(_output_mutex);
+    for (map<const Row, RowData>::const_iterator i = _rows.begin();
+        i != _rows.end(); i++) {
+        map<const Row, bool>::const_iterator iter = _rows_lshow.find((*i).first);
+        if (iter != _rows_lshow.end() && (*iter).second) {
+            if (row_index-- == 0) {
+                return (*i).second.get_match_count(pattern);
+            }
+        }
+    }
+
+    return 0;
+}
+
+bool DecoderStack::list_match(uint16_t row_index, const QString &pattern,
+                              uint64_t from, bool nxt, uint64_t &col_index) const
+{
+    boost::lock_guard<boost::recursive_mutex> lock(_output_mutex);
+    for (map<const Row, RowData>::const_iterator i = _rows.begin();
+        i != _rows.end(); i++) {
+        map<const Row, bool>::const_iterator iter = _rows_lshow.find((*i).first);
+        if (iter != _rows_lshow.end() && (*iter).second) {
+            if (row_index-- == 0) {
+                return (*i).second.get_match(pattern, from, nxt, col_index);
+            }
+        }
+    }
+
+    return false;
+}
+
 
 bool DecoderStack::list_row_title(int row, QString &title) const
 {
@@ -351,12 +396,36 @@ bool DecoderStack::list_row_title(int row, QString &title) const
     return 0;
 }
 
+bool DecoderStack::read_row(uint16_t row_index,
+    const boost::function<void (const RowData &)> &reader) const
+{
+    boost::lock_guard<boost::recursive_mutex> lock(_output_mutex);
+    for (map<const Row, RowData>::const_iterator i = _rows.begin();
+        i != _rows.end(); i++) {
+        map<const Row, bool>::const_iterator iter = _rows_lshow.find((*i).first);
+        if (iter != _rows_lshow.end() && (*iter).second) {
+            if (row_index-- == 0) {
+                reader((*i).second);
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
 QString DecoderStack::error_message()
 {
-    //lock_guard<mutex> lock(_output_mutex);
+    boost::lock_guard<boost::recursive_mutex> lock(_output_mutex);
 	return _error_message;
 }
 
+void DecoderStack::set_error_message(const QString &message)
+{
+    boost::lock_guard<boost::recursive_mutex> lock(_output_mutex);
+    _error_message = message;
+}
+
 void DecoderStack::clear()
 {
     init();
@@ -364,10 +433,15 @@ void DecoderStack::clear()
 
 void DecoderStack::init()
 {
-    _sample_count = 0;
-    _frame_complete = false;
+    stop_decode();
+    {
+        boost::lock_guard<boost::mutex> lock(_input_mutex);
+        _sample_count = 0;
+        _frame_complete = false;
+        _live = false;
+    }
     _samples_decoded = 0;
-    _error_message = QString();
+    set_error_message(QString());
     _no_memory = false;
     for (map<const Row, RowData>::iterator i = _rows.begin();
         i != _rows.end(); i++) {
@@ -390,31 +464,19 @@ void DecoderStack::stop_decode()
     }
 }
 
-void DecoderStack::begin_decode()
+void DecoderStack::begin_decode(bool live)
 {
     boost::shared_ptr<pv::view::LogicSignal> logic_signal;
     boost::shared_ptr<pv::data::Logic> data;
-
-    if (!_options_changed)
-        return;
-    _options_changed = false;
-    stop_decode();
-    init();
-
-	// Check that all decoders have the required channels
-    BOOST_FOREACH(const boost::shared_ptr<decode::Decoder> &dec, _stack)
-		if (!dec->have_required_probes()) {
-			_error_message = tr("One or more required channels "
-				"have not been specified");
-			return;
-		}
+    boost::shared_ptr<pv::data::LogicSnapshot> snapshot;
+    double samplerate = 0;
 
 	// We get the logic data of the first channel in the list.
 	// This works because we are currently assuming all
 	// LogicSignals have the same data/snapshot
     BOOST_FOREACH (const boost::shared_ptr<decode::Decoder> &dec, _stack) {
-        if (dec && !dec->channels().empty()) {
-            BOOST_FOREACH(boost::shared_ptr<view::Signal> sig, _session.get_signals()) {
+        if (_session && dec && !dec->channels().empty()) {
+            BOOST_FOREACH(boost::shared_ptr<view::Signal> sig, _session->get_signals()) {
                 if((sig->get_index() == (*dec->channels().begin()).second) &&
                    (logic_signal = dynamic_pointer_cast<view::LogicSignal>(sig)) &&
                    (data = logic_signal->logic_data()))
@@ -425,23 +487,70 @@ void DecoderStack::begin_decode()
         }
     }
 
-	if (!data)
-		return;
-
 	// Check we have a snapshot of data
-    const deque< boost::shared_ptr<pv::data::LogicSnapshot> > &snapshots =
-		data->get_snapshots();
-	if (snapshots.empty())
+    if (data && !data->get_snapshots().empty()) {
+        snapshot = data->get_snapshots().front();
+        samplerate = data->samplerate();
+    }
+
+    begin_decode(snapshot, samplerate, live);
+}
+
+void DecoderStack::begin_decode(const boost::shared_ptr<LogicSnapshot> &snapshot,
+                                double samplerate, bool live)
+{
+    if (!_options_changed)
+        return;
+    _options_changed = false;
+    stop_decode();
+    init();
+
+	// Check that all decoders have the required channels
+    BOOST_FOREACH(const boost::shared_ptr<decode::Decoder> &dec, _stack)
+		if (!dec->have_required_probes()) {
+			set_error_message(tr("One or more required channels "
+				"have not been specified"));
+			return;
+		}
+
+	if (!snapshot)
 		return;
-	_snapshot = snapshots.front();
+	_snapshot = snapshot;
     if (_snapshot->empty())
         return;
 
     // Get the samplerate
-	_samplerate = data->samplerate();
+	_samplerate = samplerate;
     if (_samplerate == 0.0)
         return;
 
+    // Annotations restored from the session file stand for the decode
+    if (_restored) {
+        _restored = false;
+        const uint64_t decode_start = _stack.back()->decode_start();
+        const uint64_t decode_end = _stack.back()->decode_end();
+        if (!live && _snapshot->get_sample_count() == _restored_samples &&
+            decode_start == _restored_start && decode_end == _restored_end) {
+            {
+                boost::lock_guard<boost::recursive_mutex> lock(_output_mutex);
+                _rows.swap(_restored_rows);
+                _sample_count = _restored_samples;
+                _samples_decoded = min(_restored_samples, decode_end + 1) - decode_start;
+            }
+            _restored_rows.clear();
+            decode_done();
+            return;
+        }
+        _restored_rows.clear();
+    }
+
+    {
+        boost::lock_guard<boost::mutex> lock(_input_mutex);
+        _live = live;
+        if (live)
+            _sample_count = _snapshot->get_indexed_sample_count();
+    }
+
     //_decode_thread = boost::thread(&DecoderStack::decode_proc, this);
     _decode_thread.reset(new boost::thread(&DecoderStack::decode_proc, this));
 }
@@ -460,140 +569,434 @@ uint64_t DecoderStack::get_max_sample_count() const
 
 void DecoderStack::decode_data(
     const uint64_t decode_start, const uint64_t decode_end,
-    srd_session *const session)
+    srd_session *const session, NativeDecoder *const native)
+{
+    DecodeCursor cursor = {decode_start, 0, decode_start, 0, false, true};
+    {
+        boost::lock_guard<boost::recursive_mutex> lock(_output_mutex);
+        _samples_decoded = 1;
+    }
+    if (decode_range(cursor, decode_end, decode_start, decode_end, true,
+                     session, native))
+        decode_done();
+}
+
+bool DecoderStack::decode_range(DecodeCursor &cursor, const uint64_t stop,
+    const uint64_t decode_start, const uint64_t decode_end, const bool last,
+    srd_session *const session, NativeDecoder *const native)
 {
     //uint8_t *chunk = NULL;
     uint64_t last_cnt = 0;
     uint64_t notify_cnt = (decode_end - decode_start + 1)/100;
     srd_decoder_inst *logic_di = NULL;
-    // find the first level decoder instant
-    for (GSList *d = session->di_list; d; d = d->next) {
-        srd_decoder_inst *di = (srd_decoder_inst *)d->data;
-        srd_decoder *decoder = di->decoder;
-        const bool have_probes = (decoder->channels || decoder->opt_channels) != 0;
-        if (have_probes) {
-            logic_di = di;
-            break;
+    int num_channels = 0;
+    const int *channel_map = NULL;
+    if (native) {
+        num_channels = native->num_channels();
+        channel_map = native->channel_map();
+    } else {
+        // find the first level decoder instant
+        for (GSList *d = session->di_list; d; d = d->next) {
+            srd_decoder_inst *di = (srd_decoder_inst *)d->data;
+            srd_decoder *decoder = di->decoder;
+            const bool have_probes = (decoder->channels || decoder->opt_channels) != 0;
+            if (have_probes) {
+                logic_di = di;
+                break;
+            }
         }
+        num_channels = logic_di->dec_num_channels;
+        channel_map = logic_di->dec_channelmap;
     }
 
+    WaitCondition condition;
     uint64_t entry_cnt = 0;
-    uint8_t chunk_type = 0;
-    uint64_t i = decode_start;
+    uint8_t chunk_type = cursor.chunk_type;
+    uint64_t i = cursor.pos;
     char *error = NULL;
     while(!boost::this_thread::interruption_requested() &&
-          i < decode_end && !_no_memory)
+          i < decode_end && i < stop && !_no_memory)
     {
         //lock_guard<mutex> decode_lock(_global_decode_mutex);
-        std::vector<const uint8_t *> chunk;
-        std::vector<uint8_t> chunk_const;
-        uint64_t chunk_end = decode_end;
-        for (int j =0 ; j < logic_di->dec_num_channels; j++) {
-            int sig_index = logic_di->dec_channelmap[j];
-            if (sig_index == -1) {
-                chunk.push_back(NULL);
-            } else {
-                if (_snapshot->has_data(sig_index)) {
-                    chunk.push_back(_snapshot->get_samples(i, chunk_end, sig_index));
-                    chunk_const.push_back(_snapshot->get_sample(i, sig_index));
+        if (!cursor.skip_pending) {
+            std::vector<const uint8_t *> chunk;
+            std::vector<uint8_t> chunk_const;
+            uint64_t chunk_end = decode_end;
+            for (int j =0 ; j < num_channels; j++) {
+                int sig_index = channel_map[j];
+                if (sig_index == -1) {
+                    chunk.push_back(NULL);
                 } else {
-                    _error_message = tr("At least one of selected channels are not enabled.");
-                    return;
+                    if (_snapshot->has_data(sig_index)) {
+                        chunk.push_back(_snapshot->get_samples(i, chunk_end, sig_index));
+                        chunk_const.push_back(_snapshot->get_sample(i, sig_index));
+                    } else {
+                        set_error_message(tr("At least one of selected channels are not enabled."));
+                        return false;
+                    }
+                }
+            }
+            // a live capture is still writing past decode_end
+            chunk_end = min(chunk_end, decode_end);
+            if (chunk_end - i > MaxChunkSize)
+                chunk_end = i + MaxChunkSize;
+
+            if (native) {
+                native->decode(chunk_type, i, chunk_end,
+                               chunk.data(), chunk_const.data());
+            } else {
+                if (srd_session_send(session, chunk_type, i, chunk_end,
+                                     chunk.data(), chunk_const.data(), &error) != SRD_OK) {
+                    set_error_message(QString::fromLocal8Bit(error));
+                    break;
                 }
             }
+            cursor.chunk_end = chunk_end;
+        }
+        cursor.skip_pending = false;
+
+        uint64_t logic_mask, exp_logic, cur_pos;
+        int edge_index;
+        if (native) {
+            logic_mask = native->logic_mask();
+            exp_logic = native->exp_logic();
+            edge_index = native->edge_index();
+            cur_pos = native->cur_pos();
+        } else {
+            logic_mask = logic_di->logic_mask;
+            exp_logic = logic_di->exp_logic;
+            edge_index = logic_di->edge_index;
+            cur_pos = logic_di->cur_pos;
         }
-        if (chunk_end - i > MaxChunkSize)
-            chunk_end = i + MaxChunkSize;
+        const bool wait = logic_mask != 0 ||
+            (logic_di && logic_di->wait_terms->len != 0);
 
-        if (srd_session_send(session, chunk_type, i, chunk_end,
-                             chunk.data(), chunk_const.data(), &error) != SRD_OK) {
-            _error_message = QString::fromLocal8Bit(error);
+        if (wait && cur_pos >= decode_end && !last) {
+            cursor.skip_pending = true;
             break;
         }
-
-        if (logic_di && logic_di->logic_mask != 0 && logic_di->cur_pos < decode_end) {
-            uint64_t cur_pos = logic_di->cur_pos;
-            uint64_t sample;
-            if (logic_di->edge_index == -1) {
-                std::vector<uint64_t> pos_vector;
-                cur_pos++;
-                for (int j =0 ; j < logic_di->dec_num_channels; j++) {
-                    int index = logic_di->dec_channelmap[j];
-                    if (index != -1 && (logic_di->logic_mask & (1 << j))) {
-                        bool last_sample = _snapshot->get_sample(cur_pos - 1, index);
-                        pos_vector.push_back(cur_pos);
-                        _snapshot->get_nxt_edge(pos_vector.back(), last_sample, decode_end, 1, index);
-                    }
-                }
-                cur_pos = *std::min_element(pos_vector.begin(), pos_vector.end());
-            } else {
-                bool last_sample = _snapshot->get_sample(cur_pos, logic_di->edge_index);
-                do {
-                    sample = 0;
-                    cur_pos++;
-                    if (!_snapshot->get_nxt_edge(cur_pos, last_sample, decode_end, 1, logic_di->edge_index))
-                        break;
-                    for (int j =0 ; j < logic_di->dec_num_channels; j++) {
-                        if (logic_di->logic_mask & (1 << j)) {
-                            int index = logic_di->dec_channelmap[j];
-                            bool index_sample = _snapshot->get_sample(cur_pos, index);
-                            sample +=  index_sample << j;
-                            if (index == logic_di->edge_index)
-                                last_sample = index_sample;
-                        }
-                    }
-                } while(sample != logic_di->exp_logic);
+        if (wait && cur_pos < decode_end) {
+            if (logic_di && logic_di->wait_terms->len != 0)
+                condition.set_terms((const srd_wait_term *)logic_di->wait_terms->data,
+                                    logic_di->wait_terms->len, channel_map, num_channels);
+            else
+                condition.set_hints(logic_mask, exp_logic, edge_index,
+                                    channel_map, num_channels);
+
+            uint64_t matched = 0;
+            const bool found = condition.find(*_snapshot, cur_pos, decode_end,
+                                              cur_pos, matched);
+
+            // the match may come with the data still to be indexed
+            if (!found && !last) {
+                cursor.skip_pending = true;
+                break;
             }
+            if (!found)
+                cur_pos = decode_end;
+            if (logic_di)
+                logic_di->wait_matched = matched;
 
             i = cur_pos;
             if (i >= decode_end)
                 i = decode_end;
             chunk_type = 0;
         } else {
-            i = chunk_end + 1;
+            i = cursor.chunk_end + 1;
             chunk_type = 1;
         }
 
-        {
+        if (i > cursor.counted) {
             boost::lock_guard<boost::recursive_mutex> lock(_output_mutex);
-            _samples_decoded = i - decode_start + 1;
+            _samples_decoded += i - cursor.counted;
+            cursor.counted = i;
         }
 
-        if ((i - last_cnt) > notify_cnt) {
+        if (cursor.notify && (i - last_cnt) > notify_cnt) {
             last_cnt = i;
             new_decode_data();
         }
         entry_cnt++;
     }
+    cursor.pos = i;
+    cursor.chunk_type = chunk_type;
     if (error)
         g_free(error);
+    return true;
+}
+
+struct DecoderStack::DecodeSegment
+{
+    DecodeCursor cursor;
+    uint64_t stop;
+    // where cursor.counted started from
+    uint64_t counted_from;
+    std::unique_ptr<NativeDecoder> native;
+    std::vector<Annotation> annotations;
+    bool no_memory;
+    bool done;
+};
+
+void DecoderStack::decode_segments(
+    const uint64_t decode_start, const uint64_t decode_end,
+    NativeDecoder *const native)
+{
+    for (int j = 0; j < native->num_channels(); j++) {
+        const int sig_index = native->channel_map()[j];
+        if (sig_index != -1 && !_snapshot->has_data(sig_index)) {
+            set_error_message(tr("At least one of selected channels are not enabled."));
+            return;
+        }
+    }
+
+    // Split at the first frame boundary after equally spaced points
+    const unsigned int threads = boost::thread::hardware_concurrency();
+    std::vector<uint64_t> bounds;
+    if (threads > 1 && decode_end > decode_start) {
+        const uint64_t total = decode_end - decode_start + 1;
+        const uint64_t count = min((uint64_t)threads * SegmentsPerThread,
+                                   total / MinSegmentSamples);
+        for (uint64_t k = 1; k < count; k++) {
+            uint64_t b = decode_start + k * (total / count);
+            const uint64_t limit = min(b + total / count, decode_end - 1);
+            if (!bounds.empty())
+                b = max(b, bounds.back());
+            if (b < limit && native->find_boundary(*_snapshot, b, limit))
+                bounds.push_back(b);
+        }
+    }
+    if (bounds.empty()) {
+        decode_data(decode_start, decode_end, NULL, native);
+        return;
+    }
+
+    // Segment k runs from one sample before its boundary to the next one
+    std::vector<DecodeSegment> segs(bounds.size() + 1);
+    for (size_t k = 0; k < segs.size(); k++) {
+        DecodeSegment &seg = segs[k];
+        const uint64_t start = (k == 0) ? decode_start : bounds[k - 1] - 1;
+        seg.counted_from = (k == 0) ? decode_start : bounds[k - 1];
+        seg.cursor.pos = start;
+        seg.cursor.chunk_type = 0;
+        seg.cursor.counted = seg.counted_from;
+        seg.cursor.chunk_end = 0;
+        seg.cursor.skip_pending = false;
+        seg.cursor.notify = false;
+        seg.stop = (k < bounds.size()) ? bounds[k] : decode_end;
+        seg.native.reset(NativeDecoder::create(*_stack.front(), (uint64_t)_samplerate));
+        assert(seg.native);
+        seg.native->set_callback(DecoderStack::segment_annotation_callback, &seg);
+        seg.no_memory = false;
+        seg.done = false;
+    }
+
+    {
+        boost::lock_guard<boost::recursive_mutex> lock(_output_mutex);
+        _samples_decoded = 1;
+    }
+
+    boost::mutex seg_mutex;
+    boost::condition_variable seg_cond;
+    size_t next_seg = 0;
+    boost::thread_group workers;
+    for (unsigned int t = 0; t < min((size_t)threads, segs.size()); t++) {
+        workers.create_thread([&]() {
+            for (;;) {
+                DecodeSegment *seg;
+                {
+                    boost::lock_guard<boost::mutex> lock(seg_mutex);
+                    if (next_seg == segs.size() ||
+                        boost::this_thread::interruption_requested())
+                        return;
+                    seg = &segs[next_seg++];
+                }
+                decode_range(seg->cursor, seg->stop, decode_start, decode_end,
+                             true, NULL, seg->native.get());
+                {
+                    boost::lock_guard<boost::mutex> lock(seg_mutex);
+                    seg->done = true;
+                }
+                seg_cond.notify_all();
+            }
+        });
+    }
+
+    // Stitch the annotations together in order
+    const srd_decoder *const decc = native->decoder();
+    try {
+        for (size_t k = 0; k < segs.size(); k++) {
+            DecodeSegment &seg = segs[k];
+            {
+                boost::unique_lock<boost::mutex> lock(seg_mutex);
+                while (!seg.done) {
+                    if (!seg_cond.timed_wait(lock,
+                            boost::posix_time::milliseconds(SegmentNotifyMs))) {
+                        // the workers report progress through _samples_decoded
+                        lock.unlock();
+                        new_decode_data();
+                        lock.lock();
+                    }
+                }
+            }
+
+            if (k > 0) {
+                DecodeSegment &pre = segs[k - 1];
+                const bool synced = pre.cursor.pos == pre.stop &&
+                                    pre.cursor.chunk_type == 0 &&
+                                    pre.native->synced();
+                if (!synced) {
+                    // go on with the decoder of the previous segment
+                    {
+                        boost::lock_guard<boost::recursive_mutex> lock(_output_mutex);
+                        _samples_decoded -= seg.cursor.counted - seg.counted_from;
+                    }
+                    seg.annotations.clear();
+                    seg.no_memory = false;
+                    seg.native = std::move(pre.native);
+                    seg.native->set_callback(DecoderStack::segment_annotation_callback, &seg);
+                    seg.cursor = pre.cursor;
+                    decode_range(seg.cursor, seg.stop, decode_start, decode_end,
+                                 true, NULL, seg.native.get());
+                }
+                pre.native.reset();
+            }
+
+            if (seg.no_memory)
+                _no_memory = true;
+            BOOST_FOREACH(const Annotation &a, seg.annotations) {
+                if (_no_memory)
+                    break;
+                push_annotation(decc, a);
+            }
+            std::vector<Annotation>().swap(seg.annotations);
+            new_decode_data();
+
+            if (boost::this_thread::interruption_requested() || _no_memory)
+                break;
+        }
+    } catch (const boost::thread_interrupted&) {
+    }
+
+    workers.interrupt_all();
+    workers.join_all();
     decode_done();
 }
 
-void DecoderStack::decode_proc()
+void DecoderStack::decode_live(const uint64_t decode_start,
+    srd_session *const session, NativeDecoder *const native)
 {
-    boost::lock_guard<boost::mutex> decode_lock(_global_decode_mutex);
+    DecodeCursor cursor = {decode_start, 0, decode_start, 0, false, true};
+    const uint64_t region_end = _stack.back()->decode_end();
+    uint64_t avail = 0;
+    bool completed = false;
+
+    {
+        boost::lock_guard<boost::recursive_mutex> lock(_output_mutex);
+        _samples_decoded = 1;
+    }
+
+    try {
+        for (;;) {
+            bool complete;
+            {
+                boost::unique_lock<boost::mutex> input_lock(_input_mutex);
+                while (!_frame_complete && _sample_count <= avail)
+                    _input_cond.wait(input_lock);
+                complete = _frame_complete;
+                avail = _sample_count;
+            }
+
+            // Decode up to the indexed samples; the ones after the region
+            // or the end of the frame finish the decode
+            uint64_t end;
+            bool last;
+            if (complete) {
+                const uint64_t count = _snapshot->get_sample_count();
+                if (count == 0)
+                    break;
+                end = min(region_end, count - 1);
+                last = true;
+            } else {
+                last = avail > region_end;
+                end = last ? region_end : avail - 1;
+            }
+            if (end < decode_start) {
+                if (last)
+                    break;
+                continue;
+            }
+
+            if (!decode_range(cursor, end, decode_start, end, last,
+                              session, native))
+                break;
+            if (boost::this_thread::interruption_requested() ||
+                !_error_message.isEmpty() || _no_memory)
+                break;
+            new_decode_data();
+            if (last) {
+                completed = true;
+                break;
+            }
+        }
+    } catch(boost::thread_interrupted&) {
+    }
+
+    {
+        boost::lock_guard<boost::mutex> input_lock(_input_mutex);
+        _live = false;
+    }
+    if (completed)
+        decode_done();
+}
 
+void DecoderStack::decode_proc()
+{
     optional<uint64_t> sample_count;
 	srd_session *session;
 	srd_decoder_inst *prev_di = NULL;
     uint64_t decode_start = 0;
     uint64_t decode_end = 0;
+    bool live;
 
 	assert(_snapshot);
 
-	// Create the session
-	srd_session_new(&session);
-	assert(session);
-
     _decode_state = Running;
 
     // Get the intial sample count
     {
-        //unique_lock<mutex> input_lock(_input_mutex);
-        sample_count = _sample_count = _snapshot->get_sample_count();
+        boost::lock_guard<boost::mutex> input_lock(_input_mutex);
+        live = _live;
+        if (!live)
+            sample_count = _sample_count = _snapshot->get_sample_count();
+    }
+
+    // The bottom decoder runs natively if it has a port. On its own it
+    // needs no Python session and decodes in segments; with decoders
+    // stacked on it, it puts its Python output to them in the session.
+    std::unique_ptr<NativeDecoder> native(
+        NativeDecoder::create(*_stack.front(), (uint64_t)_samplerate));
+    if (native && _stack.size() == 1) {
+        BOOST_FOREACH(const boost::shared_ptr<decode::Decoder> &dec, _stack) {
+            decode_start = dec->decode_start();
+            decode_end = min(dec->decode_end(), _sample_count-1);
+        }
+        native->set_callback(DecoderStack::native_annotation_callback, this);
+        if (live)
+            decode_live(decode_start, NULL, native.get());
+        else
+            decode_segments(decode_start, decode_end, native.get());
+        _decode_state = Stopped;
+        return;
     }
 
+    // libsigrokdecode takes the Python GIL in each call, so every stack
+    // decodes on its own thread: the Python code of the stacks takes turns
+    // while their sample fetching and condition scans run side by side
+
+	// Create the session
+	srd_session_new(&session);
+	assert(session);
+
     // Create the decoders
     BOOST_FOREACH(const boost::shared_ptr<decode::Decoder> &dec, _stack)
 	{
@@ -601,13 +1004,15 @@ void DecoderStack::decode_proc()
 
 		if (!di)
 		{
-			_error_message = tr("Failed to create decoder instance");
+			set_error_message(tr("Failed to create decoder instance"));
 			srd_session_destroy(session);
 			return;
 		}
 
 		if (prev_di)
 			srd_inst_stack (session, prev_di, di);
+		else if (native)
+			native->set_instance(di);
 
 		prev_di = di;
         decode_start = dec->decode_start();
@@ -620,12 +1025,16 @@ void DecoderStack::decode_proc()
 
 	srd_pd_output_callback_add(session, SRD_OUTPUT_ANN,
 		DecoderStack::annotation_callback, this);
+    if (native)
+        native->set_callback(DecoderStack::native_annotation_callback, this);
 
     char *error = NULL;
-    if (srd_session_start(session, &error) == SRD_OK)
-        decode_data(decode_start, decode_end, session);
+    if (srd_session_start(session, &error) != SRD_OK)
+        set_error_message(QString::fromLocal8Bit(error));
+    else if (live)
+        decode_live(decode_start, session, native.get());
     else
-        _error_message = QString::fromLocal8Bit(error);
+        decode_data(decode_start, decode_end, session, native.get());
 
 	// Destroy the session
     if (error) {
@@ -671,21 +1080,56 @@ void DecoderStack::annotation_callback(srd_proto_data *pdata, void *decoder)
 	const srd_decoder *const decc = pdata->pdo->di->decoder;
 	assert(decc);
 
-    map<const Row, decode::RowData>::iterator row_iter = d->_rows.end();
+    d->push_annotation(decc, a);
+}
+
+void DecoderStack::native_annotation_callback(const srd_decoder *decc,
+    const Annotation &a, void *decoder)
+{
+    assert(decc);
+    assert(decoder);
+
+    DecoderStack *const d = (DecoderStack*)decoder;
+    if (d->_no_memory)
+        return;
+
+    d->push_annotation(decc, a);
+}
+
+void DecoderStack::segment_annotation_callback(const srd_decoder *decc,
+    const Annotation &a, void *segment)
+{
+    (void)decc;
+    assert(segment);
+
+    DecodeSegment *const seg = (DecodeSegment*)segment;
+    if (seg->no_memory)
+        return;
+
+    try {
+        seg->annotations.push_back(a);
+    } catch (const std::bad_alloc&) {
+        seg->no_memory = true;
+    }
+}
+
+void DecoderStack::push_annotation(const srd_decoder *decc, const Annotation &a)
+{
+    map<const Row, decode::RowData>::iterator row_iter = _rows.end();
 	
 	// Try looking up the sub-row of this class
 	const map<pair<const srd_decoder*, int>, Row>::const_iterator r =
-		d->_class_rows.find(make_pair(decc, a.format()));
-	if (r != d->_class_rows.end())
-        row_iter = d->_rows.find((*r).second);
+		_class_rows.find(make_pair(decc, a.format()));
+	if (r != _class_rows.end())
+        row_iter = _rows.find((*r).second);
 	else
 	{
 		// Failing that, use the decoder as a key
-        row_iter = d->_rows.find(Row(decc));
+        row_iter = _rows.find(Row(decc));
 	}
 
-    assert(row_iter != d->_rows.end());
-    if (row_iter == d->_rows.end()) {
+    assert(row_iter != _rows.end());
+    if (row_iter == _rows.end()) {
         qDebug() << "Unexpected annotation: decoder = " << decc <<
             ", format = " << a.format();
         assert(0);
@@ -693,34 +1137,47 @@ void DecoderStack::annotation_callback(srd_proto_data *pdata, void *decoder)
     }
 
 	// Add the annotation
-    boost::lock_guard<boost::recursive_mutex> lock(d->_output_mutex);
+    boost::lock_guard<boost::recursive_mutex> lock(_output_mutex);
     if (!(*row_iter).second.push_annotation(a))
-        d->_no_memory = true;
+        _no_memory = true;
 }
 
 void DecoderStack::on_new_frame()
 {
-    //begin_decode();
+    // Stream captures are decoded while they are coming in
+    GVariant *gvar = _session->get_device()->get_config(NULL, NULL, SR_CONF_STREAM);
+    if (gvar == NULL)
+        return;
+    const bool stream = g_variant_get_boolean(gvar);
+    g_variant_unref(gvar);
+    if (!stream)
+        return;
+
+    _options_changed = true;
+    begin_decode(true);
 }
 
 void DecoderStack::on_data_received()
 {
-//	{
-//		unique_lock<mutex> lock(_input_mutex);
-//		if (_snapshot)
-//			_sample_count = _snapshot->get_sample_count();
-//	}
-//	_input_cond.notify_one();
+    {
+        boost::lock_guard<boost::mutex> lock(_input_mutex);
+        if (!_live || !_snapshot)
+            return;
+        _sample_count = _snapshot->get_indexed_sample_count();
+    }
+    _input_cond.notify_one();
 }
 
 void DecoderStack::on_frame_ended()
 {
-//	{
-//		unique_lock<mutex> lock(_input_mutex);
-//		if (_snapshot)
-//			_frame_complete = true;
-//	}
-//	_input_cond.notify_one();
+    {
+        boost::lock_guard<boost::mutex> lock(_input_mutex);
+        if (_live) {
+            _frame_complete = true;
+            _input_cond.notify_one();
+            return;
+        }
+    }
     _options_changed = true;
     begin_decode();
 }
@@ -746,6 +1203,11 @@ bool DecoderStack::options_changed() const
 void DecoderStack::set_options_changed(bool changed)
 {
     _options_changed = changed;
+    // the restored annotations are of the old options
+    if (changed && _restored) {
+        _restored = false;
+        _restored_rows.clear();
+    }
 }
 
 bool DecoderStack::out_of_memory() const
@@ -753,6 +1215,73 @@ bool DecoderStack::out_of_memory() const
     return _no_memory;
 }
 
+bool DecoderStack::save_result(QDataStream &out) const
+{
+    boost::lock_guard<boost::recursive_mutex> lock(_output_mutex);
+    if (_decode_state != Stopped || !_snapshot ||
+        !_error_message.isEmpty() || _no_memory)
+        return false;
+
+    // only a decode which got through the region
+    const uint64_t sample_count = _snapshot->get_sample_count();
+    const uint64_t decode_start = _stack.back()->decode_start();
+    const uint64_t decode_end = _stack.back()->decode_end();
+    const uint64_t real_end = min(sample_count, decode_end + 1);
+    if (real_end <= decode_start ||
+        _samples_decoded < (int64_t)(real_end - decode_start))
+        return false;
+
+    out << (quint64)sample_count << (quint64)decode_start
+        << (quint64)decode_end << (quint32)_rows.size();
+    for (map<const Row, RowData>::const_iterator i = _rows.begin();
+        i != _rows.end(); i++) {
+        const Row &row = (*i).first;
+        out << QString::fromUtf8(row.decoder()->id)
+            << (row.row() ? QString::fromUtf8(row.row()->id) : QString());
+        (*i).second.save(out);
+    }
+    return out.status() == QDataStream::Ok;
+}
+
+bool DecoderStack::restore_result(QDataStream &in)
+{
+    quint64 sample_count, decode_start, decode_end;
+    quint32 row_count;
+    in >> sample_count >> decode_start >> decode_end >> row_count;
+    if (in.status() != QDataStream::Ok || row_count != _rows.size())
+        return false;
+
+    // rows are matched by the ids of decoder and annotation row
+    std::map<const Row, RowData> rows;
+    for (quint32 k = 0; k < row_count; k++) {
+        QString decoder_id, row_id;
+        in >> decoder_id >> row_id;
+        map<const Row, RowData>::const_iterator i = _rows.begin();
+        for (; i != _rows.end(); i++) {
+            const Row &row = (*i).first;
+            if (decoder_id == QString::fromUtf8(row.decoder()->id) &&
+                row_id == (row.row() ? QString::fromUtf8(row.row()->id) : QString()))
+                break;
+        }
+        if (i == _rows.end() || rows.find((*i).first) != rows.end() ||
+            !rows[(*i).first].load(in))
+            return false;
+    }
+
+    _restored_rows.swap(rows);
+    _restored_samples = sample_count;
+    _restored_start = decode_start;
+    _restored_end = decode_end;
+    _restored = true;
+    return true;
+}
+
+bool DecoderStack::live() const
+{
+    boost::lock_guard<boost::mutex> lock(_input_mutex);
+    return _live;
+}
+
 void DecoderStack::set_mark_index(int64_t index)
 {
     _mark_index = index;
@@ -25,6 +25,7 @@
 
 #include <list>
 
+#include <boost/function.hpp>
 #include <boost/optional.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/thread.hpp>
@@ -36,6 +37,8 @@
 #include "../data/decode/rowdata.h"
 #include "../data/signaldata.h"
 
+class QDataStream;
+
 namespace DecoderStackTest {
 class TwoDecoderStack;
 }
@@ -55,6 +58,7 @@ class LogicSnapshot;
 namespace decode {
 class Annotation;
 class Decoder;
+class NativeDecoder;
 }
 
 class Logic;
@@ -69,6 +73,11 @@ private:
 	static const int64_t DecodeChunkLength;
 	static const unsigned int DecodeNotifyPeriod;
     static const uint64_t MaxChunkSize = 1024 * 16;
+    // native decoders split longer captures at frame boundaries
+    static const uint64_t MinSegmentSamples = 1024 * 1024 * 4;
+    static const unsigned int SegmentsPerThread = 4;
+    // how often decode_segments reports progress while waiting
+    static const int SegmentNotifyMs = 100;
 
 public:
     enum decode_state {
@@ -80,6 +89,12 @@ public:
 	DecoderStack(pv::SigSession &_session,
 		const srd_decoder *const decoder);
 
+    /**
+     * A stack which is not attached to a session. It only decodes the
+     * snapshots given to begin_decode(snapshot, samplerate).
+     */
+    DecoderStack(const srd_decoder *const decoder);
+
 	virtual ~DecoderStack();
 
     const std::list< boost::shared_ptr<decode::Decoder> >& stack() const;
@@ -89,13 +104,14 @@ public:
 
 	int64_t samples_decoded() const;
 
-	/**
-	 * Extracts sorted annotations between two period into a vector.
-	 */
-	void get_annotation_subset(
-		std::vector<pv::data::decode::Annotation> &dest,
-		const decode::Row &row, uint64_t start_sample,
-		uint64_t end_sample) const;
+    /**
+     * The annotations of a row which may overlap the period, see
+     * RowData::get_annotation_range. False if the row has none.
+     */
+    bool get_annotation_range(const decode::Row &row,
+        uint64_t start_sample, uint64_t end_sample,
+        decode::RowData::const_iterator &first,
+        decode::RowData::const_iterator &last) const;
 
     uint64_t get_annotation_index(
         const decode::Row &row, uint64_t start_sample) const;
@@ -117,9 +133,25 @@ public:
     bool list_annotation(decode::Annotation &ann,
                         uint16_t row_index, uint64_t col_index) const;
 
+    /**
+     * Search the text of the annotations of a listed row, see
+     * decode::RowData::get_match_count and get_match.
+     */
+    uint64_t list_match_count(uint16_t row_index, const QString &pattern) const;
+    bool list_match(uint16_t row_index, const QString &pattern,
+                    uint64_t from, bool nxt, uint64_t &col_index) const;
+
 
     bool list_row_title(int row, QString &title) const;
 
+    /**
+     * Run reader on the annotations of a listed row in place, under the
+     * output lock, so a batch can be read without copying it while the
+     * decode goes on. Returns false if there is no such row.
+     */
+    bool read_row(uint16_t row_index,
+        const boost::function<void (const decode::RowData &)> &reader) const;
+
 	QString error_message();
 
 	void clear();
@@ -127,7 +159,18 @@ public:
 
 	uint64_t get_max_sample_count() const;
 
-	void begin_decode();
+    /**
+     * Start decoding. A live decode follows the capture in progress,
+     * decoding each range as it gets indexed by the snapshot.
+     */
+    void begin_decode(bool live = false);
+
+    /**
+     * Start decoding snapshot, instead of the data the channels of the
+     * first decoder have in the session.
+     */
+    void begin_decode(const boost::shared_ptr<LogicSnapshot> &snapshot,
+                      double samplerate, bool live = false);
 
     void stop_decode();
 
@@ -141,17 +184,95 @@ public:
 
     bool out_of_memory() const;
 
+    // a decode is following the capture
+    bool live() const;
+
+    /**
+     * Write the annotations of a finished decode for a session file, or
+     * return false if there is no finished decode.
+     */
+    bool save_result(QDataStream &out) const;
+
+    /**
+     * Read back saved annotations. They are taken instead of decoding
+     * by the next decode if it is of the same samples and region, and
+     * dropped if the options are changed before.
+     */
+    bool restore_result(QDataStream &in);
+
     void set_mark_index(int64_t index);
     int64_t get_mark_index() const;
 
 private:
-    void decode_data(const uint64_t decode_start, const uint64_t decode_end, srd_session *const session);
+    // how far the decoding of a range has got
+    struct DecodeCursor
+    {
+        uint64_t pos;
+        uint8_t chunk_type;
+        // samples before this one have been added to _samples_decoded
+        uint64_t counted;
+        // the chunk decoded last, and whether the skip after it waits
+        // for more data
+        uint64_t chunk_end;
+        bool skip_pending;
+        // post new_decode_data() along the way, which the segment
+        // workers leave to the thread stitching their annotations
+        bool notify;
+    };
+
+    struct DecodeSegment;
+
+private:
+    void decode_data(const uint64_t decode_start, const uint64_t decode_end,
+                     srd_session *const session, decode::NativeDecoder *const native);
+
+    /**
+     * Decode from the cursor on until it reaches stop. The chunks and
+     * skips are the ones of decoding the whole of decode_start to
+     * decode_end, so the range after stop can be decoded later on by
+     * going on from the cursor. Unless last is set more data is going
+     * to follow decode_end, and a skip which would have to look beyond
+     * it is left pending in the cursor.
+     * @return false if the channels of the decoder have no data.
+     */
+    bool decode_range(DecodeCursor &cursor, const uint64_t stop,
+                      const uint64_t decode_start, const uint64_t decode_end,
+                      const bool last, srd_session *const session,
+                      decode::NativeDecoder *const native);
+
+    /**
+     * Decode with a native decoder on all cores. The capture is split at
+     * frame boundaries and each segment is decoded from the boundary on
+     * by a fresh decoder; when stitching the segments together in order,
+     * one whose predecessor did not arrive at the boundary in sync is
+     * decoded again by going on with the decoder of the predecessor.
+     */
+    void decode_segments(const uint64_t decode_start, const uint64_t decode_end,
+                         decode::NativeDecoder *const native);
+
+    /**
+     * Follow the capture: decode up to the indexed samples, wait for
+     * more and go on with the same decoder state until the frame ends.
+     */
+    void decode_live(const uint64_t decode_start, srd_session *const session,
+                     decode::NativeDecoder *const native);
 
 	void decode_proc();
 
+    // _error_message is read by the UI thread while decoding
+    void set_error_message(const QString &message);
+
 	static void annotation_callback(srd_proto_data *pdata,
 		void *decoder);
 
+    static void native_annotation_callback(const srd_decoder *decc,
+        const decode::Annotation &a, void *decoder);
+
+    static void segment_annotation_callback(const srd_decoder *decc,
+        const decode::Annotation &a, void *segment);
+
+    void push_annotation(const srd_decoder *decc, const decode::Annotation &a);
+
 private slots:
 	void on_new_frame();
 
@@ -164,24 +285,17 @@ signals:
     void decode_done();
 
 private:
-	pv::SigSession &_session;
-
-	/**
-	 * This mutex prevents more than one decode operation occuring
-	 * concurrently.
-	 * @todo A proper solution should be implemented to allow multiple
-	 * decode operations.
-	 */
-    static boost::mutex _global_decode_mutex;
+	pv::SigSession *_session;
 
 	std::list< boost::shared_ptr<decode::Decoder> > _stack;
 
 	boost::shared_ptr<pv::data::LogicSnapshot> _snapshot;
 
-    //mutable boost::mutex _input_mutex;
-    //mutable boost::condition_variable _input_cond;
+    mutable boost::mutex _input_mutex;
+    mutable boost::condition_variable _input_cond;
     uint64_t _sample_count;
 	bool _frame_complete;
+    bool _live;
 
     mutable boost::recursive_mutex _output_mutex;
     //mutable boost::mutex _output_mutex;
@@ -200,6 +314,13 @@ private:
     bool _options_changed;
     bool _no_memory;
 
+    // annotations restored from a session file
+    std::map<const decode::Row, decode::RowData> _restored_rows;
+    bool _restored;
+    uint64_t _restored_samples;
+    uint64_t _restored_start;
+    uint64_t _restored_end;
+
     int64_t _mark_index;
 
 	friend class DecoderStackTest::TwoDecoderStack;
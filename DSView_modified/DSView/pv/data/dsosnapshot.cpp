@@ -57,9 +57,23 @@ DsoSnapshot::DsoSnapshot() :
 
 DsoSnapshot::~DsoSnapshot()
 {
+    free_data();
     free_envelop();
 }
 
+void DsoSnapshot::free_data()
+{
+    // a buffer taken over from the driver is one of glib, so are ours
+    // it gets in exchange
+    if (_data) {
+        g_free(_data);
+        _data = NULL;
+        _capacity = 0;
+        _sample_count = 0;
+    }
+    Snapshot::free_data();
+}
+
 void DsoSnapshot::free_envelop()
 {
     for (unsigned int i = 0; i < _channel_num; i++) {
@@ -120,7 +134,7 @@ void DsoSnapshot::first_payload(const sr_datafeed_dso &dso, uint64_t total_sampl
     uint64_t size = _total_sample_count * _channel_num + sizeof(uint64_t);
     if (re_alloc || size != _capacity) {
         free_data();
-        _data = malloc(size);
+        _data = g_try_malloc(size);
         if (_data) {
             free_envelop();
             for (unsigned int i = 0; i < _channel_num; i++) {
@@ -174,7 +188,11 @@ void DsoSnapshot::append_data(void *data, uint64_t samples, bool instant)
         memcpy((uint8_t*)_data + _sample_count * _channel_num, data, samples*_channel_num);
         _sample_count = (_sample_count + samples) % (_total_sample_count + 1);
     } else {
-        memcpy((uint8_t*)_data, data, samples*_channel_num);
+        // a whole frame: take over the buffer of the driver if it hands
+        // it out, giving it ours to fill again
+        uint64_t size = _capacity;
+        if (!sr_session_swap_data(data, _capacity, &_data, &size))
+            memcpy((uint8_t*)_data, data, samples*_channel_num);
         _sample_count = samples;
     }
 
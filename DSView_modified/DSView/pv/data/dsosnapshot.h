@@ -102,6 +102,8 @@ public:
     uint64_t get_block_size(int block_index);
 
 private:
+    // the sample data is allocated by glib, see append_data
+    void free_data();
     void append_data(void *data, uint64_t samples, bool instant);
     void free_envelop();
 	void reallocate_envelope(Envelope &l);
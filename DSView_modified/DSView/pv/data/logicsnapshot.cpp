@@ -32,6 +32,7 @@
 #include <boost/foreach.hpp>
 
 #include "logicsnapshot.h"
+#include "blockpool.h"
 
 using namespace boost;
 using namespace std;
@@ -52,6 +53,8 @@ const uint64_t LogicSnapshot::LevelOffset[LogicSnapshot::ScaleLevel] = {
     (uint64_t)pow(Scale, 3) + (uint64_t)pow(Scale, 2) + (uint64_t)pow(Scale, 1),
 };
 
+BlockPool LogicSnapshot::_leaf_pool;
+
 LogicSnapshot::LogicSnapshot() :
     Snapshot(1, 0, 0),
     _block_num(0)
@@ -68,8 +71,7 @@ void LogicSnapshot::free_data()
     for(auto& iter:_ch_data) {
         for(auto& iter_rn:iter) {
             for (unsigned int k = 0; k < Scale; k++)
-                if (iter_rn.lbp[k] != NULL)
-                    free(iter_rn.lbp[k]);
+                _leaf_pool.release(iter_rn.lbp[k], LeafBlockSpace);
         }
         std::vector<struct RootNode> void_vector;
         iter.swap(void_vector);
@@ -98,10 +100,14 @@ void LogicSnapshot::clear()
     boost::lock_guard<boost::recursive_mutex> lock(_mutex);
     free_data();
     init();
+    // only called with no capture running, e.g. on device switch,
+    // so no capture is waiting for the cached leaves
+    _leaf_pool.trim(LeafBlockSpace, 0);
 }
 
 void LogicSnapshot::capture_ended()
 {
+    boost::lock_guard<boost::recursive_mutex> lock(_mutex);
     Snapshot::capture_ended();
 
     //assert(_ch_fraction == 0);
@@ -123,12 +129,12 @@ void LogicSnapshot::capture_ended()
 
             // calc root of current block
             if (*((uint64_t *)iter[index0].lbp[index1]) != 0)
-                iter[index0].value += 1ULL << index1;
+                iter[index0].value |= 1ULL << index1;
             if (*((uint64_t *)iter[index0].lbp[index1] + LeafBlockSpace / sizeof(uint64_t) - 1) != 0) {
-                iter[index0].tog += 1ULL << index1;
+                iter[index0].tog |= 1ULL << index1;
             } else {
                // trim leaf to free space
-               free(iter[index0].lbp[index1]);
+               _leaf_pool.release(iter[index0].lbp[index1], LeafBlockSpace);
                iter[index0].lbp[index1] = NULL;
             }
 
@@ -160,6 +166,10 @@ void LogicSnapshot::first_payload(const sr_datafeed_logic &logic, uint64_t total
         _total_sample_count = total_sample_count;
         _channel_num = channel_num;
         uint64_t rootnode_size = (_total_sample_count + RootNodeSamples - 1) / RootNodeSamples;
+        // keep no more cached leaves than the new capture can use,
+        // and later on no more than it has used
+        _leaf_pool.set_limit(LeafBlockSpace, _channel_num *
+                             ((_total_sample_count + LeafBlockSamples - 1) / LeafBlockSamples));
         for (const GSList *l = channels; l; l = l->next) {
             sr_channel *const probe = (sr_channel*)l->data;
             if (probe->type == SR_CHANNEL_LOGIC && probe->enabled) {
@@ -189,11 +199,13 @@ void LogicSnapshot::first_payload(const sr_datafeed_logic &logic, uint64_t total
     _sample_cnt.clear();
     _block_cnt.clear();
     _ring_sample_cnt.clear();
+    _indexed_words.clear();
     for (unsigned int i = 0; i < _channel_num; i++) {
         _last_sample.push_back(0);
         _sample_cnt.push_back(0);
         _block_cnt.push_back(0);
         _ring_sample_cnt.push_back(0);
+        _indexed_words.push_back(0);
     }
 
     append_payload(logic);
@@ -235,7 +247,7 @@ void LogicSnapshot::append_cross_payload(
         uint8_t index1 = _block_num % RootScale;
         for(auto& iter:_ch_data) {
             if (iter[index0].lbp[index1] == NULL)
-                iter[index0].lbp[index1] = malloc(LeafBlockSpace);
+                iter[index0].lbp[index1] = _leaf_pool.alloc(LeafBlockSpace);
             if (iter[index0].lbp[index1] == NULL) {
                 _memory_failed = true;
                 return;
@@ -318,12 +330,12 @@ void LogicSnapshot::append_cross_payload(
 
                     // calc root of current block
                     if (*((uint64_t *)iter[index0].lbp[index1]) != 0)
-                        iter[index0].value +=  1ULL<< index1;
+                        iter[index0].value |= 1ULL << index1;
                     if (*((uint64_t *)iter[index0].lbp[index1] + LeafBlockSpace / sizeof(uint64_t) - 1) != 0) {
-                        iter[index0].tog += 1ULL << index1;
+                        iter[index0].tog |= 1ULL << index1;
                     } else {
                         // trim leaf to free space
-                        free(iter[index0].lbp[index1]);
+                        _leaf_pool.release(iter[index0].lbp[index1], LeafBlockSpace);
                         iter[index0].lbp[index1] = NULL;
                     }
 
@@ -389,7 +401,7 @@ void LogicSnapshot::append_split_payload(
         uint8_t index0 = _block_cnt[order] / RootScale;
         uint8_t index1 = _block_cnt[order] % RootScale;
         if (_ch_data[order][index0].lbp[index1] == NULL)
-            _ch_data[order][index0].lbp[index1] = malloc(LeafBlockSpace);
+            _ch_data[order][index0].lbp[index1] = _leaf_pool.alloc(LeafBlockSpace);
         if (_ch_data[order][index0].lbp[index1] == NULL) {
             _memory_failed = true;
             return;
@@ -415,12 +427,12 @@ void LogicSnapshot::append_split_payload(
 
             // calc root of current block
             if (*((uint64_t *)_ch_data[order][index0].lbp[index1]) != 0)
-                _ch_data[order][index0].value +=  1ULL<< index1;
+                _ch_data[order][index0].value |= 1ULL << index1;
             if (*((uint64_t *)_ch_data[order][index0].lbp[index1] + LeafBlockSpace / sizeof(uint64_t) - 1) != 0) {
-                _ch_data[order][index0].tog += 1ULL << index1;
+                _ch_data[order][index0].tog |= 1ULL << index1;
             } else {
                 // trim leaf to free space
-                free(_ch_data[order][index0].lbp[index1]);
+                _leaf_pool.release(_ch_data[order][index0].lbp[index1], LeafBlockSpace);
                 _ch_data[order][index0].lbp[index1] = NULL;
             }
         } else {
@@ -436,33 +448,54 @@ void LogicSnapshot::append_split_payload(
 
 void LogicSnapshot::calc_mipmap(unsigned int order, uint8_t index0, uint8_t index1, uint64_t samples)
 {
-    uint8_t offset;
-    uint64_t *src_ptr;
-    uint64_t *dest_ptr;
-    unsigned int i;
-
-    // level 1
-    src_ptr = (uint64_t *)_ch_data[order][index0].lbp[index1];
-    dest_ptr = src_ptr + (LeafBlockSamples / Scale) - 1;
-    const uint64_t mask =  1ULL << (Scale - 1);
-    for(i = 0; i < samples / Scale; i++) {
-        offset = i % Scale;
-        if (offset == 0)
-            dest_ptr++;
-        *dest_ptr += ((_last_sample[order] ^ *src_ptr) != 0 ? 1ULL : 0ULL) << offset;
-        _last_sample[order] = *src_ptr & mask ? ~0ULL : 0ULL;
-        src_ptr++;
+    uint64_t *const lbp = (uint64_t *)_ch_data[order][index0].lbp[index1];
+    const uint64_t words = samples / Scale;
+    uint64_t begin = _indexed_words[order];
+    uint64_t end = words;
+
+    if (begin < end) {
+        // level 1
+        const uint64_t mask =  1ULL << (Scale - 1);
+        for (uint64_t i = begin; i < end; i++) {
+            lbp[LevelOffset[1] + i / Scale] |=
+                ((_last_sample[order] ^ lbp[i]) != 0 ? 1ULL : 0ULL) << (i % Scale);
+            _last_sample[order] = lbp[i] & mask ? ~0ULL : 0ULL;
+        }
+
+        // level 2/3, from the words of the level below just changed
+        for (unsigned int level = 1; level < ScaleLevel - 1; level++) {
+            begin /= Scale;
+            end = (end - 1) / Scale + 1;
+            for (uint64_t i = begin; i < end; i++)
+                if (lbp[LevelOffset[level] + i] != 0)
+                    lbp[LevelOffset[level + 1] + i / Scale] |= 1ULL << (i % Scale);
+        }
     }
 
-    // level 2/3
-    src_ptr = (uint64_t *)_ch_data[order][index0].lbp[index1] + (LeafBlockSamples / Scale);
-    dest_ptr = src_ptr + (LeafBlockSamples / Scale / Scale) - 1;
-    for(i = LeafBlockSamples / Scale; i < LeafBlockSpace / sizeof(uint64_t) - 1; i++) {
-        offset = i % Scale;
-        if (offset == 0)
-            dest_ptr++;
-        *dest_ptr += (*src_ptr != 0 ? 1ULL : 0ULL) << offset;
-        src_ptr++;
+    _indexed_words[order] = (words == LeafBlockSamples / Scale) ? 0 : words;
+}
+
+void LogicSnapshot::index_partial_leaf()
+{
+    int order = 0;
+    for(auto& iter:_ch_data) {
+        // split data counts the samples of each channel
+        const uint64_t samples = max(_ring_sample_count, _ring_sample_cnt[order]);
+        const uint64_t index0 = samples / RootNodeSamples;
+        const uint64_t index1 = (samples >> LeafBlockPower) % RootScale;
+        const uint64_t offset = samples & LeafMask;
+        if (offset >= Scale && iter[index0].lbp[index1] != NULL) {
+            calc_mipmap(order, index0, index1, offset);
+
+            // A leaf is only trimmed when it is full and has no edge, so
+            // until it has one the readers take its samples from the
+            // root value and never hold on to the leaf itself.
+            if (*((uint64_t *)iter[index0].lbp[index1]) != 0)
+                iter[index0].value |= 1ULL << index1;
+            if (*((uint64_t *)iter[index0].lbp[index1] + LeafBlockSpace / sizeof(uint64_t) - 1) != 0)
+                iter[index0].tog |= 1ULL << index1;
+        }
+        order++;
     }
 }
 
@@ -483,8 +516,9 @@ const uint8_t *LogicSnapshot::get_samples(uint64_t start_sample, uint64_t &end_s
                  ~(~0ULL << LeafBlockPower);
     end_sample = min(end_sample, get_sample_count() - 1);
 
+    // leaves without an edge are trimmed, or may still be
     if (order == -1 ||
-        _ch_data[order][root_index].lbp[root_pos] == NULL)
+        (_ch_data[order][root_index].tog & (1ULL << root_pos)) == 0)
         return NULL;
     else
         return (uint8_t *)_ch_data[order][root_index].lbp[root_pos] + block_offset;
@@ -514,6 +548,16 @@ bool LogicSnapshot::get_sample(uint64_t index, int sig_index)
     }
 }
 
+uint64_t LogicSnapshot::get_indexed_sample_count()
+{
+    boost::lock_guard<boost::recursive_mutex> lock(_mutex);
+    if (_last_ended)
+        return _sample_count;
+
+    index_partial_leaf();
+    return min(_ring_sample_count & ~(Scale - 1), _sample_count);
+}
+
 bool LogicSnapshot::get_display_edges(std::vector<std::pair<bool, bool> > &edges,
     std::vector<std::pair<uint16_t, bool> > &togs,
     uint64_t start, uint64_t end, uint16_t width, uint16_t max_togs,
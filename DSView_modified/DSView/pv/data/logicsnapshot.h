@@ -44,6 +44,8 @@ class LongPulses;
 namespace pv {
 namespace data {
 
+class BlockPool;
+
 class LogicSnapshot : public Snapshot
 {
 private:
@@ -92,6 +94,13 @@ public:
 
     bool get_sample(uint64_t index, int sig_index);
 
+    /**
+     * Samples which have their mipmap, which edge searches can see.
+     * While capturing, the leaf block being filled is indexed up to its
+     * last whole word on each call.
+     */
+    uint64_t get_indexed_sample_count();
+
     void capture_ended();
 
     bool get_display_edges(std::vector<std::pair<bool, bool>> &edges,
@@ -117,6 +126,7 @@ public:
 private:
     int get_ch_order(int sig_index);
     void calc_mipmap(unsigned int order, uint8_t index0, uint8_t index1, uint64_t samples);
+    void index_partial_leaf();
 
     void append_cross_payload(const sr_datafeed_logic &logic);
     void append_split_payload(const sr_datafeed_logic &logic);
@@ -190,6 +200,11 @@ private:
     std::vector<uint64_t> _block_cnt;
     std::vector<uint64_t> _ring_sample_cnt;
     std::vector<uint64_t> _last_sample;
+    // words of the current leaf of each channel which have their mipmap
+    std::vector<uint64_t> _indexed_words;
+
+    // leaf blocks released by one capture are reused by the next
+    static BlockPool _leaf_pool;
 
 	friend class LogicSnapshotTest::Pow2;
 	friend class LogicSnapshotTest::Basic;
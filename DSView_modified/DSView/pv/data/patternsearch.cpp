@@ -0,0 +1,333 @@
+/*
+ * This file is part of the DSView project.
+ * DSView is based on PulseView.
+ *
+ * Copyright (C) 2013 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "patternsearch.h"
+#include "logicsnapshot.h"
+
+#include <assert.h>
+
+#include <algorithm>
+#include <queue>
+
+using boost::shared_ptr;
+using std::greater;
+using std::map;
+using std::max;
+using std::min;
+using std::pair;
+using std::priority_queue;
+using std::vector;
+
+namespace pv {
+namespace data {
+
+PatternSearch::PatternSearch(shared_ptr<LogicSnapshot> snapshot,
+                             const map<uint16_t, QString> &pattern) :
+    _snapshot(snapshot),
+    _match_count(0),
+    _scanned(0),
+    _finished(false),
+    _cancelled(false),
+    _cursor(0)
+{
+    assert(_snapshot);
+
+    int start_match_pos = -1;
+    int end_match_pos = -1;
+    for (auto& iter:pattern) {
+        if (!_snapshot->has_data(iter.first))
+            continue;
+        int char_index = 0;
+        for (auto& iter_char:iter.second) {
+            if (iter_char != 'X') {
+                if (start_match_pos == -1 || char_index < start_match_pos)
+                    start_match_pos = char_index;
+                end_match_pos = max(end_match_pos, char_index);
+            }
+            char_index++;
+        }
+    }
+
+    if (start_match_pos == -1)
+        return;
+
+    _columns.resize(end_match_pos - start_match_pos + 1);
+    for (auto& iter:pattern) {
+        if (!_snapshot->has_data(iter.first))
+            continue;
+        bool used = false;
+        int level = -1;
+        for (int i = start_match_pos; i <= end_match_pos && i < iter.second.size(); i++) {
+            const char value = iter.second[i].toLatin1();
+            if (value == 'X')
+                continue;
+            Column col = {iter.first, value};
+            _columns[i - start_match_pos].push_back(col);
+            used = true;
+            if (level == -2) {
+                continue;
+            } else if (value == '0' || value == '1') {
+                const int exp = (value == '1');
+                level = (level == -1 || level == exp) ? exp : -2;
+            } else {
+                // an edge never happens inside a constant stretch
+                level = -2;
+            }
+        }
+        if (used) {
+            _channels.push_back(iter.first);
+            _static_level.push_back(level);
+        }
+    }
+}
+
+PatternSearch::~PatternSearch()
+{
+    cancel();
+}
+
+void PatternSearch::start()
+{
+    _thread = boost::thread(&PatternSearch::search_proc, this);
+}
+
+void PatternSearch::cancel()
+{
+    if (_thread.joinable()) {
+        _thread.interrupt();
+        _thread.join();
+    }
+
+    boost::lock_guard<boost::mutex> lock(_mutex);
+    if (!_finished) {
+        _cancelled = true;
+        _finished = true;
+        _cond.notify_all();
+    }
+}
+
+bool PatternSearch::finished() const
+{
+    boost::lock_guard<boost::mutex> lock(_mutex);
+    return _finished;
+}
+
+bool PatternSearch::cancelled() const
+{
+    boost::lock_guard<boost::mutex> lock(_mutex);
+    return _cancelled;
+}
+
+uint64_t PatternSearch::progress() const
+{
+    boost::lock_guard<boost::mutex> lock(_mutex);
+    return _scanned;
+}
+
+uint64_t PatternSearch::match_count() const
+{
+    boost::lock_guard<boost::mutex> lock(_mutex);
+    return _match_count;
+}
+
+size_t PatternSearch::find_range(uint64_t index) const
+{
+    // repeated next / previous steps stay at or next to the last range
+    for (size_t i = (_cursor > 0 ? _cursor - 1 : 0);
+         i < _matches.size() && i <= _cursor + 1; i++) {
+        if (_matches[i].second >= index &&
+            (i == 0 || _matches[i - 1].second < index))
+            return i;
+    }
+
+    size_t low = 0;
+    size_t high = _matches.size();
+    while (low < high) {
+        const size_t mid = (low + high) / 2;
+        if (_matches[mid].second < index)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return low;
+}
+
+bool PatternSearch::nxt_match(uint64_t index, uint64_t &match)
+{
+    boost::unique_lock<boost::mutex> lock(_mutex);
+    for (;;) {
+        const size_t i = find_range(index);
+        if (i < _matches.size()) {
+            _cursor = i;
+            match = max(_matches[i].first, index);
+            return true;
+        }
+        if (_finished)
+            return false;
+        _cond.wait(lock);
+    }
+}
+
+bool PatternSearch::pre_match(uint64_t index, uint64_t &match)
+{
+    boost::unique_lock<boost::mutex> lock(_mutex);
+    while (!_finished && _scanned <= index)
+        _cond.wait(lock);
+
+    if (_cancelled)
+        return false;
+
+    const size_t i = find_range(index);
+    if (i < _matches.size() && _matches[i].first <= index) {
+        _cursor = i;
+        match = index;
+        return true;
+    } else if (i > 0) {
+        _cursor = i - 1;
+        match = _matches[i - 1].second;
+        return true;
+    }
+    return false;
+}
+
+void PatternSearch::search_proc()
+{
+    typedef pair<uint64_t, unsigned int> EdgeItem;
+
+    const uint64_t sample_count = _snapshot->get_sample_count();
+    const uint64_t cols = _columns.size();
+
+    if (sample_count == 0) {
+        set_scanned(0, true);
+        return;
+    }
+    if (cols == 0) {
+        // nothing to compare, every sample matches
+        add_match(0, sample_count - 1);
+        set_scanned(sample_count, true);
+        return;
+    }
+
+    // merge the transitions of all pattern channels
+    const uint64_t end = sample_count - 1;
+    vector<bool> level;
+    priority_queue<EdgeItem, vector<EdgeItem>, greater<EdgeItem> > edges;
+    for (unsigned int k = 0; k < _channels.size(); k++) {
+        level.push_back(_snapshot->get_sample(0, _channels[k]));
+        uint64_t index = 1;
+        if (_snapshot->get_nxt_edge(index, level[k], end, 1, _channels[k]))
+            edges.push(EdgeItem(index, k));
+    }
+
+    uint64_t seg_start = 0;
+    uint64_t checked = 0;
+    uint64_t seg_num = 0;
+    while (!boost::this_thread::interruption_requested()) {
+        const uint64_t seg_end = edges.empty() ? sample_count : edges.top().first;
+
+        // windows reaching back to the transition at seg_start
+        const uint64_t dirty_end = min(seg_start + cols - 1, end);
+        for (uint64_t pos = max(max(seg_start, cols - 1), checked); pos <= dirty_end; pos++)
+            if (match_at(pos))
+                add_match(pos, pos);
+
+        // windows inside [seg_start, seg_end) see constant levels only
+        if (seg_start + cols < seg_end) {
+            bool matched = true;
+            for (unsigned int k = 0; matched && k < _channels.size(); k++) {
+                const int exp = _static_level[k];
+                matched = (exp == -1 || exp == (int)level[k]);
+            }
+            if (matched)
+                add_match(seg_start + cols, seg_end - 1);
+        }
+        checked = max(dirty_end + 1, seg_end);
+
+        if (edges.empty())
+            break;
+        if ((++seg_num % ReportSegments) == 0)
+            set_scanned(min(checked, sample_count), false);
+
+        seg_start = seg_end;
+        while (!edges.empty() && edges.top().first == seg_start) {
+            const unsigned int k = edges.top().second;
+            edges.pop();
+            level[k] = !level[k];
+            uint64_t index = seg_start + 1;
+            if (_snapshot->get_nxt_edge(index, level[k], end, 1, _channels[k]))
+                edges.push(EdgeItem(index, k));
+        }
+    }
+
+    if (boost::this_thread::interruption_requested())
+        set_scanned(min(checked, sample_count), true);
+    else
+        set_scanned(sample_count, true);
+}
+
+bool PatternSearch::match_at(uint64_t pos)
+{
+    const uint64_t first = pos + 1 - _columns.size();
+    for (uint64_t i = 0; i < _columns.size(); i++) {
+        const uint64_t index = first + i;
+        for (auto& col:_columns[i]) {
+            const bool sample = _snapshot->get_sample(index, col.ch_index);
+            if (col.value == '0' || col.value == '1') {
+                if (sample != (col.value == '1'))
+                    return false;
+                continue;
+            }
+
+            if (index == 0 ||
+                _snapshot->get_sample(index - 1, col.ch_index) == sample)
+                return false;
+            if ((col.value == 'R' && !sample) ||
+                (col.value == 'F' && sample))
+                return false;
+        }
+    }
+    return true;
+}
+
+void PatternSearch::add_match(uint64_t first, uint64_t last)
+{
+    boost::lock_guard<boost::mutex> lock(_mutex);
+    if (!_matches.empty() && _matches.back().second + 1 == first)
+        _matches.back().second = last;
+    else
+        _matches.push_back(MatchRange(first, last));
+    _match_count += last - first + 1;
+    _cond.notify_all();
+}
+
+void PatternSearch::set_scanned(uint64_t pos, bool finished)
+{
+    boost::lock_guard<boost::mutex> lock(_mutex);
+    _scanned = pos;
+    if (finished && !_finished) {
+        _cancelled = boost::this_thread::interruption_requested();
+        _finished = true;
+    }
+    _cond.notify_all();
+}
+
+} // namespace data
+} // namespace pv
@@ -0,0 +1,117 @@
+/*
+ * This file is part of the DSView project.
+ * DSView is based on PulseView.
+ *
+ * Copyright (C) 2013 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+
+#ifndef DSVIEW_PV_DATA_PATTERNSEARCH_H
+#define DSVIEW_PV_DATA_PATTERNSEARCH_H
+
+#include <stdint.h>
+
+#include <map>
+#include <utility>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+
+#include <QString>
+
+namespace pv {
+namespace data {
+
+class LogicSnapshot;
+
+/**
+ * Finds every match of a search pattern in a logic snapshot on a
+ * background thread.
+ *
+ * Only samples close to a transition of one of the pattern channels
+ * are compared one by one; the constant stretches in between are
+ * skipped through the snapshot mipmaps and matched as a whole.
+ * Matches are reported by the sample of the last pattern column, as
+ * LogicSnapshot::pattern_search does, and kept as sorted ranges.
+ */
+class PatternSearch
+{
+public:
+    typedef std::pair<uint64_t, uint64_t> MatchRange;
+
+private:
+    // transitions merged between two progress reports
+    static const uint64_t ReportSegments = 1024;
+
+    struct Column
+    {
+        uint16_t ch_index;
+        char value;
+    };
+
+public:
+    PatternSearch(boost::shared_ptr<LogicSnapshot> snapshot,
+                  const std::map<uint16_t, QString> &pattern);
+    ~PatternSearch();
+
+    void start();
+    void cancel();
+
+    bool finished() const;
+    bool cancelled() const;
+    uint64_t progress() const;
+    uint64_t match_count() const;
+
+    /**
+     * Find the first match at or after / the last match at or before
+     * index, blocking until the scan has got far enough to answer.
+     */
+    bool nxt_match(uint64_t index, uint64_t &match);
+    bool pre_match(uint64_t index, uint64_t &match);
+
+private:
+    void search_proc();
+    bool match_at(uint64_t pos);
+    void add_match(uint64_t first, uint64_t last);
+    void set_scanned(uint64_t pos, bool finished);
+    size_t find_range(uint64_t index) const;
+
+private:
+    boost::shared_ptr<LogicSnapshot> _snapshot;
+    std::vector<uint16_t> _channels;
+    // pattern columns between the first and the last non-'X' one
+    std::vector<std::vector<Column> > _columns;
+    // level each of _channels must keep for a match inside a constant
+    // stretch: 0, 1, -1 for don't care, or -2 if no such match exists
+    std::vector<int> _static_level;
+
+    boost::thread _thread;
+    mutable boost::mutex _mutex;
+    boost::condition_variable _cond;
+    std::vector<MatchRange> _matches;
+    uint64_t _match_count;
+    uint64_t _scanned;
+    bool _finished;
+    bool _cancelled;
+    size_t _cursor;
+};
+
+} // namespace data
+} // namespace pv
+
+#endif // DSVIEW_PV_DATA_PATTERNSEARCH_H
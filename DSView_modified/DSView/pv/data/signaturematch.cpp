@@ -0,0 +1,290 @@
+/*
+ * This file is part of the DSView project.
+ * DSView is based on PulseView.
+ *
+ * Copyright (C) 2013 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "signaturematch.h"
+#include "dsosnapshot.h"
+
+#include <assert.h>
+#include <math.h>
+
+#include <algorithm>
+
+#include <QFile>
+#include <QTextStream>
+
+using std::max;
+using std::min;
+using std::vector;
+
+namespace pv {
+namespace data {
+
+// Kept free of anything but the multiply-add, and in blocks of a fixed
+// length, so that the compiler turns it into widening SIMD multiplies
+// at the default optimization level too.
+static inline int32_t dot(const uint8_t *x, const int8_t *r, int n)
+{
+    const int Block = 16;
+    int32_t acc = 0;
+    int i = 0;
+    for (; i + Block <= n; i += Block) {
+        int32_t part = 0;
+        for (int j = 0; j < Block; j++)
+            part += x[i + j] * r[i + j];
+        acc += part;
+    }
+    for (; i < n; i++)
+        acc += x[i] * r[i];
+    return acc;
+}
+
+SignatureMatch::SignatureMatch() :
+    _threshold(0.8),
+    _search_start(0),
+    _search_end(0),
+    _decimation(4)
+{
+    _ref.sum = 0;
+    _ref.norm = 0;
+    _coarse_ref.sum = 0;
+    _coarse_ref.norm = 0;
+}
+
+bool SignatureMatch::load(const QString &file_name)
+{
+    _samples.clear();
+    _ref.samples.clear();
+    _coarse_ref.samples.clear();
+
+    QFile file(file_name);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+        return false;
+
+    QTextStream in(&file);
+    while (!in.atEnd() && _samples.size() < (size_t)MaxLength) {
+        const QString line = in.readLine();
+        bool ok;
+        const double value = line.section(',', 0, 0).trimmed().toDouble(&ok);
+        if (ok)
+            _samples.push_back(value);
+    }
+
+    if (_samples.size() < 2)
+        _samples.clear();
+    _ref.set(_samples);
+    update_coarse();
+    return enabled();
+}
+
+bool SignatureMatch::enabled() const
+{
+    return !_ref.samples.empty() && _ref.norm > 0;
+}
+
+int SignatureMatch::length() const
+{
+    return _ref.samples.size();
+}
+
+void SignatureMatch::set_threshold(double threshold)
+{
+    _threshold = threshold;
+}
+
+void SignatureMatch::set_search_range(uint64_t start, uint64_t end)
+{
+    assert(end == 0 || start <= end);
+    _search_start = start;
+    _search_end = end;
+}
+
+void SignatureMatch::set_decimation(int decimation)
+{
+    _decimation = max(decimation, 1);
+    update_coarse();
+}
+
+uint64_t SignatureMatch::needed_samples() const
+{
+    if (_search_end == 0)
+        return 0;
+    return _search_end + _ref.samples.size();
+}
+
+void SignatureMatch::update_coarse()
+{
+    _coarse_ref.samples.clear();
+    if (_decimation == 1 || _samples.size() < (size_t)_decimation * 2)
+        return;
+
+    vector<double> coarse(_samples.size() / _decimation, 0);
+    for (size_t i = 0; i < coarse.size(); i++) {
+        for (int j = 0; j < _decimation; j++)
+            coarse[i] += _samples[i * _decimation + j];
+        coarse[i] /= _decimation;
+    }
+    _coarse_ref.set(coarse);
+}
+
+void SignatureMatch::Reference::set(const vector<double> &ref)
+{
+    samples.clear();
+    sum = 0;
+    norm = 0;
+    if (ref.empty())
+        return;
+
+    // Remove the mean and use the full int8 range, the scale is
+    // cancelled out by the normalization anyway. The ADC counts down,
+    // the export has the volts go up as the raw samples go down, so
+    // the sign is turned for the correlation with the raw samples.
+    double mean = 0;
+    for (size_t i = 0; i < ref.size(); i++)
+        mean += ref[i];
+    mean /= ref.size();
+    double peak = 0;
+    for (size_t i = 0; i < ref.size(); i++)
+        peak = max(peak, fabs(ref[i] - mean));
+    if (peak == 0)
+        return;
+
+    int64_t sum_sq = 0;
+    samples.resize(ref.size());
+    for (size_t i = 0; i < ref.size(); i++) {
+        samples[i] = (int8_t)lround((mean - ref[i]) * 127 / peak);
+        sum += samples[i];
+        sum_sq += samples[i] * samples[i];
+    }
+    norm = sqrt(sum_sq - (double)sum * sum / samples.size());
+}
+
+void SignatureMatch::Window::set(const uint8_t *x, uint64_t n)
+{
+    sum.resize(n + 1);
+    sum_sq.resize(n + 1);
+    sum[0] = 0;
+    sum_sq[0] = 0;
+    for (uint64_t i = 0; i < n; i++) {
+        sum[i + 1] = sum[i] + x[i];
+        sum_sq[i + 1] = sum_sq[i] + x[i] * x[i];
+    }
+}
+
+void SignatureMatch::decimate(const uint8_t *src, uint64_t n, int factor,
+                              vector<uint8_t> &dst)
+{
+    dst.resize(n / factor);
+    for (uint64_t i = 0; i < dst.size(); i++) {
+        unsigned int acc = 0;
+        for (int j = 0; j < factor; j++)
+            acc += src[i * factor + j];
+        dst[i] = acc / factor;
+    }
+}
+
+double SignatureMatch::score(const uint8_t *x, uint64_t pos,
+                             const Reference &ref, const Window &win)
+{
+    const int n = ref.samples.size();
+    const double sx = win.sum[pos + n] - win.sum[pos];
+    const double var = (win.sum_sq[pos + n] - win.sum_sq[pos]) - sx * sx / n;
+    if (var <= 0)
+        return 0;
+
+    const double cov = dot(x + pos, ref.samples.data(), n) - sx * ref.sum / n;
+    return cov / (sqrt(var) * ref.norm);
+}
+
+uint64_t SignatureMatch::best_match(const uint8_t *x, uint64_t first, uint64_t last,
+                                    const Reference &ref, const Window &win,
+                                    double &best)
+{
+    uint64_t best_pos = first;
+    best = -1;
+    for (uint64_t pos = first; pos <= last; pos++) {
+        const double s = score(x, pos, ref, win);
+        if (s > best) {
+            best = s;
+            best_pos = pos;
+        }
+    }
+    return best_pos;
+}
+
+SignatureMatch::Result SignatureMatch::match(const DsoSnapshot &snapshot,
+                                             uint16_t index) const
+{
+    Result result;
+    result.checked = false;
+    result.qualified = false;
+    result.offset = 0;
+    result.score = 0;
+
+    if (!enabled())
+        return result;
+    result.checked = true;
+
+    const uint64_t m = _ref.samples.size();
+    const uint64_t count = snapshot.get_sample_count();
+    if (count < _search_start + m)
+        return result;
+    uint64_t last = count - m;
+    if (_search_end != 0)
+        last = min(last, _search_end);
+
+    // Gather the channel out of the interleaved frame once, the
+    // kernels then only see contiguous samples.
+    const uint64_t n = last - _search_start + m;
+    const uint8_t *src = snapshot.get_samples(_search_start,
+                                              _search_start + n - 1, index);
+    const unsigned int stride = snapshot.get_channel_num();
+    vector<uint8_t> buf(n);
+    for (uint64_t i = 0; i < n; i++)
+        buf[i] = src[i * stride];
+
+    Window win;
+    win.set(buf.data(), n);
+
+    uint64_t first_pos = 0;
+    uint64_t last_pos = n - m;
+    const uint64_t cm = _coarse_ref.samples.size();
+    if (cm != 0 && n / _decimation >= cm) {
+        vector<uint8_t> coarse;
+        decimate(buf.data(), n, _decimation, coarse);
+        Window coarse_win;
+        coarse_win.set(coarse.data(), coarse.size());
+        double coarse_score;
+        const uint64_t pos = best_match(coarse.data(), 0, coarse.size() - cm,
+                                        _coarse_ref, coarse_win, coarse_score);
+        first_pos = pos * _decimation > (uint64_t)_decimation ?
+                    pos * _decimation - _decimation : 0;
+        last_pos = min(last_pos, pos * _decimation + _decimation);
+    }
+
+    const uint64_t pos = best_match(buf.data(), first_pos, last_pos,
+                                    _ref, win, result.score);
+    result.offset = _search_start + pos;
+    result.qualified = result.score >= _threshold;
+    return result;
+}
+
+} // namespace data
+} // namespace pv
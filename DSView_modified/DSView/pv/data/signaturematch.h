@@ -0,0 +1,129 @@
+/*
+ * This file is part of the DSView project.
+ * DSView is based on PulseView.
+ *
+ * Copyright (C) 2013 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+
+#ifndef DSVIEW_PV_DATA_SIGNATUREMATCH_H
+#define DSVIEW_PV_DATA_SIGNATUREMATCH_H
+
+#include <stdint.h>
+
+#include <vector>
+
+#include <QString>
+
+namespace pv {
+namespace data {
+
+class DsoSnapshot;
+
+/**
+ * Qualifies a DSO capture by looking for a reference waveform segment
+ * in one of its channels.
+ *
+ * Candidate positions are scored by normalized cross-correlation, so a
+ * reference exported in volts matches the raw samples whatever the
+ * vdiv and offset of the capture. The reference is kept zero-mean and
+ * quantized to 8 bits, which leaves a plain integer dot product per
+ * position; the window sums come from prefix sums. The search range is
+ * first scanned on decimated data and only the best coarse candidate
+ * is refined at full rate.
+ */
+class SignatureMatch
+{
+public:
+    struct Result
+    {
+        bool checked;
+        bool qualified;
+        // first sample of the best match in the capture
+        uint64_t offset;
+        double score;
+    };
+
+    // longest reference whose dot products still fit in 32 bits
+    static const int MaxLength = 65536;
+
+public:
+    SignatureMatch();
+
+    /**
+     * Load the reference from a text file, the first column of each
+     * numeric line being one sample. Header lines, like the ones of
+     * the CSV export, are skipped.
+     */
+    bool load(const QString &file_name);
+
+    bool enabled() const;
+    int length() const;
+
+    void set_threshold(double threshold);
+    void set_search_range(uint64_t start, uint64_t end);
+    void set_decimation(int decimation);
+
+    /**
+     * Samples a capture needs before match() sees the whole search
+     * range, or 0 if the range runs up to the end of the capture.
+     */
+    uint64_t needed_samples() const;
+
+    Result match(const DsoSnapshot &snapshot, uint16_t index) const;
+
+private:
+    struct Reference
+    {
+        std::vector<int8_t> samples;
+        int64_t sum;
+        double norm;
+
+        void set(const std::vector<double> &ref);
+    };
+
+    struct Window
+    {
+        std::vector<int64_t> sum;
+        std::vector<int64_t> sum_sq;
+
+        void set(const uint8_t *x, uint64_t n);
+    };
+
+    void update_coarse();
+    static void decimate(const uint8_t *src, uint64_t n, int factor,
+                         std::vector<uint8_t> &dst);
+    static uint64_t best_match(const uint8_t *x, uint64_t first, uint64_t last,
+                               const Reference &ref, const Window &win,
+                               double &best);
+    static double score(const uint8_t *x, uint64_t pos,
+                        const Reference &ref, const Window &win);
+
+private:
+    std::vector<double> _samples;
+    Reference _ref;
+    Reference _coarse_ref;
+    double _threshold;
+    uint64_t _search_start;
+    uint64_t _search_end;
+    int _decimation;
+};
+
+} // namespace data
+} // namespace pv
+
+#endif // DSVIEW_PV_DATA_SIGNATUREMATCH_H
@@ -39,6 +39,11 @@ File::File(QString path) :
 {
 }
 
+const QString& File::path() const
+{
+    return _path;
+}
+
 QString File::format_device_title() const
 {
     QFileInfo fi(_path);
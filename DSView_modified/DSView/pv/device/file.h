@@ -42,6 +42,8 @@ public:
 
     QJsonArray get_decoders();
 
+    const QString& path() const;
+
 public:
     QString format_device_title() const;
 
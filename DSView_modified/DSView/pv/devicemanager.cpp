@@ -80,11 +80,13 @@ std::list<boost::shared_ptr<device::DevInst> > DeviceManager::driver_scan(
 	assert(driver);
 
 	// Remove any device instances from this driver from the device
-	// list. They will not be valid after the scan.
+	// list, and the groups of the sync driver using them. They will
+	// not be valid after the scan.
     list< shared_ptr<device::DevInst> >::iterator i = _devices.begin();
 	while (i != _devices.end()) {
         if ((*i)->dev_inst() &&
-            (*i)->dev_inst()->driver == driver) {
+            ((*i)->dev_inst()->driver == driver ||
+             sr_sync_group_uses((*i)->dev_inst(), driver))) {
             (*i)->release();
 			i = _devices.erase(i);
         } else {
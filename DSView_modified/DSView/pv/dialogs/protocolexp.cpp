@@ -21,6 +21,8 @@
 
 #include "protocolexp.h"
 
+#include <string.h>
+
 #include <boost/foreach.hpp>
 
 #include <QFormLayout>
@@ -31,11 +33,13 @@
 #include <QProgressDialog>
 #include <QFuture>
 #include <QtConcurrent/QtConcurrent>
+#include <QtEndian>
 
 #include "../sigsession.h"
 #include "../data/decoderstack.h"
 #include "../data/decode/row.h"
 #include "../data/decode/annotation.h"
+#include "../data/decode/rowdata.h"
 #include "../view/decodetrace.h"
 #include "../data/decodermodel.h"
 
@@ -55,6 +59,7 @@ ProtocolExp::ProtocolExp(QWidget *parent, SigSession &session) :
     _format_combobox = new QComboBox(this);
     _format_combobox->addItem(tr("Comma-Separated Values (*.csv)"));
     _format_combobox->addItem(tr("Text files (*.txt)"));
+    _format_combobox->addItem(tr("Binary columns (*.bin)"));
 
     _flayout = new QFormLayout();
     _flayout->setVerticalSpacing(5);
@@ -132,63 +137,36 @@ void ProtocolExp::accept()
             QDir CurrentDir;
             settings.setValue(DIR_KEY, CurrentDir.absoluteFilePath(file_name));
 
+            // the selection is read here, the widgets belong to this thread
+            QString title;
+            int index = 0;
+            for (std::list<QRadioButton *>::const_iterator i = _row_sel_list.begin();
+                i != _row_sel_list.end(); i++) {
+                if ((*i)->isChecked()) {
+                    title = (*i)->property("title").toString();
+                    index = (*i)->property("index").toULongLong();
+                    break;
+                }
+            }
+            pv::data::DecoderModel* decoder_model = _session.get_decoder_model();
+            const boost::shared_ptr<pv::data::DecoderStack> decoder_stack = decoder_model->getDecoderStack();
+            if (!decoder_stack)
+                return;
+
+            const bool binary = (ext == "bin");
             QFile file(file_name);
-            file.open(QIODevice::WriteOnly | QIODevice::Text);
-            QTextStream out(&file);
-            out.setCodec("UTF-8");
-            out.setGenerateByteOrderMark(true);
+            if (!file.open(binary ? QIODevice::WriteOnly :
+                                    QIODevice::WriteOnly | QIODevice::Text))
+                return;
 
+            _export_cancel = false;
+            bool done = false;
             QFuture<void> future;
             future = QtConcurrent::run([&]{
-                _export_cancel = false;
-                QString title;
-                int index = 0;
-                for (std::list<QRadioButton *>::const_iterator i = _row_sel_list.begin();
-                    i != _row_sel_list.end(); i++) {
-                    if ((*i)->isChecked()) {
-                        title = (*i)->property("title").toString();
-                        index = (*i)->property("index").toULongLong();
-                        break;
-                    }
-                }
-                out << QString("%1,%2,%3\n")
-                       .arg("ID")
-                       .arg("Time[s]")
-                       .arg(title);
-
-                pv::data::DecoderModel* decoder_model = _session.get_decoder_model();
-                const boost::shared_ptr<pv::data::DecoderStack>& decoder_stack = decoder_model->getDecoderStack();
-                int row_index = 0;
-                Row row;
-                const std::map<const Row, bool> rows_lshow = decoder_stack->get_rows_lshow();
-                for (std::map<const Row, bool>::const_iterator i = rows_lshow.begin();
-                    i != rows_lshow.end(); i++) {
-                    if ((*i).second) {
-                        if (index == row_index) {
-                            row = (*i).first;
-                            break;
-                        }
-                        row_index++;
-                    }
-                }
-
-                uint64_t exported = 0;
-                double time_pre_samples = 1.0 / decoder_stack->samplerate();
-                vector<Annotation> annotations;
-                decoder_stack->get_annotation_subset(annotations, row,
-                    0, decoder_stack->sample_count()-1);
-                if (!annotations.empty()) {
-                    BOOST_FOREACH(const Annotation &a, annotations) {
-                        out << QString("%1,%2,%3\n")
-                               .arg(QString::number(exported))
-                               .arg(QString::number(a.start_sample()*time_pre_samples))
-                               .arg(a.annotations().at(0));
-                        exported++;
-                        emit  export_progress(exported*100/annotations.size());
-                        if (_export_cancel)
-                            break;
-                    }
-                }
+                if (binary)
+                    done = export_binary(file, decoder_stack, index);
+                else
+                    done = export_text(file, decoder_stack, index, title);
             });
             Qt::WindowFlags flags = Qt::CustomizeWindowHint;
             QProgressDialog dlg(tr("Export Protocol List Result... It can take a while."),
@@ -205,11 +183,142 @@ void ProtocolExp::accept()
             dlg.exec();
 
             future.waitForFinished();
-            file.close();
+            // leave no partial export behind
+            if (done)
+                file.close();
+            else
+                file.remove();
         }
     }
 }
 
+void ProtocolExp::update_progress(uint64_t done, uint64_t total, int &percent)
+{
+    const int cur = total ? done * 100 / total : 100;
+    if (cur != percent) {
+        percent = cur;
+        emit export_progress(percent);
+    }
+}
+
+bool ProtocolExp::export_text(QFile &file,
+    const boost::shared_ptr<data::DecoderStack> &decoder_stack,
+    int row_index, const QString &title)
+{
+    using namespace pv::data::decode;
+
+    QTextStream out(&file);
+    out.setCodec("UTF-8");
+    out.setGenerateByteOrderMark(true);
+    out << QString("%1,%2,%3\n")
+           .arg("ID")
+           .arg("Time[s]")
+           .arg(title);
+
+    uint64_t total = 0;
+    decoder_stack->read_row(row_index, [&](const RowData &row) {
+        total = row.get_annotation_size();
+    });
+
+    const double time_pre_samples = 1.0 / decoder_stack->samplerate();
+    uint64_t exported = 0;
+    int percent = -1;
+    while (exported < total && !_export_cancel) {
+        const uint64_t batch_end = min(exported + ExportBatch, total);
+        if (!decoder_stack->read_row(row_index, [&](const RowData &row) {
+                const RowData::const_iterator end = row.iter(batch_end);
+                for (RowData::const_iterator i = row.iter(exported); i != end; ++i)
+                    out << i.index() << ','
+                        << QString::number(i.start_sample()*time_pre_samples) << ','
+                        << i.text() << '\n';
+            }))
+            return false;
+        exported = batch_end;
+        update_progress(exported, total, percent);
+    }
+    out.flush();
+    return !_export_cancel && out.status() == QTextStream::Ok;
+}
+
+bool ProtocolExp::export_binary(QFile &file,
+    const boost::shared_ptr<data::DecoderStack> &decoder_stack,
+    int row_index)
+{
+    using namespace pv::data::decode;
+
+    // the annotations and kinds there are now, later ones are left out
+    uint64_t total = 0;
+    uint32_t strings = 0;
+    decoder_stack->read_row(row_index, [&](const RowData &row) {
+        total = row.get_annotation_size();
+        strings = row.get_kind_count();
+    });
+
+    QByteArray header("DSVPROT1", 8);
+    quint64 value = qToLittleEndian<quint64>(total);
+    header.append((const char *)&value, sizeof(value));
+    value = qToLittleEndian<quint64>(strings);
+    header.append((const char *)&value, sizeof(value));
+    double samplerate = decoder_stack->samplerate();
+    memcpy(&value, &samplerate, sizeof(value));
+    value = qToLittleEndian<quint64>(value);
+    header.append((const char *)&value, sizeof(value));
+    file.write(header);
+
+    // one column after the other, three passes over the annotations
+    const uint64_t work = total * 3 + strings;
+    uint64_t done = 0;
+    int percent = -1;
+    std::vector<char> buf;
+    for (int col = 0; col < 3 && !_export_cancel; col++) {
+        uint64_t exported = 0;
+        while (exported < total && !_export_cancel) {
+            const uint64_t batch_end = min(exported + ExportBatch, total);
+            buf.clear();
+            if (!decoder_stack->read_row(row_index, [&](const RowData &row) {
+                    const RowData::const_iterator end = row.iter(batch_end);
+                    for (RowData::const_iterator i = row.iter(exported); i != end; ++i) {
+                        if (col == 2) {
+                            const quint32 v = qToLittleEndian<quint32>(i.kind());
+                            buf.insert(buf.end(), (const char *)&v, (const char *)&v + sizeof(v));
+                        } else {
+                            const quint64 v = qToLittleEndian<quint64>(
+                                col == 0 ? i.start_sample() : i.end_sample());
+                            buf.insert(buf.end(), (const char *)&v, (const char *)&v + sizeof(v));
+                        }
+                    }
+                }))
+                return false;
+            file.write(buf.data(), buf.size());
+            done += batch_end - exported;
+            exported = batch_end;
+            update_progress(done, work, percent);
+        }
+    }
+    if ((total * sizeof(quint32)) % 8)
+        file.write(QByteArray(4, 0));
+
+    // the string table, offsets first
+    std::vector<QByteArray> texts;
+    decoder_stack->read_row(row_index, [&](const RowData &row) {
+        for (uint32_t k = 0; k < strings; k++)
+            texts.push_back(row.get_kind_text(k).toUtf8());
+    });
+    quint64 offset = 0;
+    buf.clear();
+    for (uint32_t k = 0; k <= strings; k++) {
+        const quint64 v = qToLittleEndian<quint64>(offset);
+        buf.insert(buf.end(), (const char *)&v, (const char *)&v + sizeof(v));
+        if (k < strings)
+            offset += texts[k].size();
+    }
+    file.write(buf.data(), buf.size());
+    for (uint32_t k = 0; k < strings && !_export_cancel; k++)
+        file.write(texts[k]);
+    update_progress(work, work, percent);
+    return !_export_cancel && file.error() == QFile::NoError;
+}
+
 void ProtocolExp::reject()
 {
     using namespace Qt;
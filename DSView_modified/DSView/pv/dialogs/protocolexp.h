@@ -29,6 +29,7 @@
 #include <QLabel>
 #include <QRadioButton>
 #include <QComboBox>
+#include <QFile>
 
 #include <boost/shared_ptr.hpp>
 
@@ -42,6 +43,7 @@ namespace pv {
 class SigSession;
 
 namespace data {
+class DecoderStack;
 namespace decode {
 class Row;
 }
@@ -53,6 +55,10 @@ class ProtocolExp : public DSDialog
 {
     Q_OBJECT
 
+private:
+    // annotations read at a time under the decoder output lock
+    static const uint64_t ExportBatch = 1 << 16;
+
 public:
     ProtocolExp(QWidget *parent, SigSession &session);
 
@@ -66,6 +72,31 @@ signals:
 private slots:
     void cancel_export();
 
+private:
+    // the export functions return false if cancelled or cut short
+    bool export_text(QFile &file,
+                     const boost::shared_ptr<data::DecoderStack> &decoder_stack,
+                     int row_index, const QString &title);
+
+    /**
+     * Binary export, little-endian and aligned to 8 bytes so that the
+     * columns can be mapped straight into arrays:
+     *   char[8]    magic "DSVPROT1"
+     *   u64        annotation count n
+     *   u64        string count m
+     *   f64        samplerate
+     *   u64[n]     start samples
+     *   u64[n]     end samples
+     *   u32[n]     string table row of each annotation, padded to 8 bytes
+     *   u64[m+1]   string offsets into the string data
+     *   UTF-8 string data
+     */
+    bool export_binary(QFile &file,
+                       const boost::shared_ptr<data::DecoderStack> &decoder_stack,
+                       int row_index);
+
+    void update_progress(uint64_t done, uint64_t total, int &percent);
+
 private:
     SigSession &_session;
 
@@ -40,9 +40,6 @@
 #include <QScrollBar>
 #include <QLineEdit>
 #include <QRegExp>
-#include <QFuture>
-#include <QProgressDialog>
-#include <QtConcurrent/QtConcurrent>
 #include <QSizePolicy>
 
 #include <boost/foreach.hpp>
@@ -56,8 +53,8 @@ ProtocolDock::ProtocolDock(QWidget *parent, view::View &view, SigSession &sessio
     QScrollArea(parent),
     _session(session),
     _view(view),
+    _search_column(0),
     _cur_search_index(-1),
-    _search_edited(false),
     _searching(false),
     _add_silent(false)
 {
@@ -481,7 +478,6 @@ void ProtocolDock::set_model()
     pv::dialogs::ProtocolList *protocollist_dlg = new pv::dialogs::ProtocolList(this, _session);
     protocollist_dlg->exec();
     resize_table_view(_session.get_decoder_model());
-    _model_proxy.setSourceModel(_session.get_decoder_model());
     search_done();
 
     // clear mark_index of all DecoderStacks
@@ -513,7 +509,6 @@ void ProtocolDock::update_model()
         if (index >= decode_sigs.size())
             decoder_model->setDecoderStack(decode_sigs.at(0)->decoder());
     }
-    _model_proxy.setSourceModel(decoder_model);
     search_done();
     resize_table_view(decoder_model);
 }
@@ -552,42 +547,11 @@ void ProtocolDock::item_clicked(const QModelIndex &index)
         }
     }
     _table_view->resizeRowToContents(index.row());
-    if (index.column() != _model_proxy.filterKeyColumn()) {
-        _model_proxy.setFilterKeyColumn(index.column());
-        _model_proxy.setSourceModel(decoder_model);
+    if (index.column() != _search_column) {
+        _search_column = index.column();
         search_done();
     }
-    QModelIndex filterIndex = _model_proxy.mapFromSource(index);
-    if (filterIndex.isValid()) {
-        _cur_search_index = filterIndex.row();
-    } else {
-        if (_model_proxy.rowCount() == 0) {
-            _cur_search_index = -1;
-        } else {
-            uint64_t up = 0;
-            uint64_t dn = _model_proxy.rowCount() - 1;
-            do {
-                uint64_t md = (up + dn)/2;
-                QModelIndex curIndex = _model_proxy.mapToSource(_model_proxy.index(md,_model_proxy.filterKeyColumn()));
-                if (index.row() == curIndex.row()) {
-                    _cur_search_index = md;
-                    break;
-                } else if (md == up) {
-                    if (curIndex.row() < index.row() && up < dn) {
-                        QModelIndex nxtIndex = _model_proxy.mapToSource(_model_proxy.index(md+1,_model_proxy.filterKeyColumn()));
-                        if (nxtIndex.row() < index.row())
-                            md++;
-                    }
-                    _cur_search_index = md + ((curIndex.row() < index.row()) ? 0.5 : -0.5);
-                    break;
-                } else if (curIndex.row() < index.row()) {
-                    up = md;
-                } else if (curIndex.row() > index.row()) {
-                    dn = md;
-                }
-            }while(1);
-        }
-    }
+    _cur_search_index = index.row();
 }
 
 void ProtocolDock::column_resize(int index, int old_size, int new_size)
@@ -620,7 +584,7 @@ void ProtocolDock::nav_table_view()
     if (decoder_stack) {
         uint64_t offset = _view.offset() * (decoder_stack->samplerate() * _view.scale());
         std::map<const pv::data::decode::Row, bool> rows = decoder_stack->get_rows_lshow();
-        int column = _model_proxy.filterKeyColumn();
+        int column = _search_column;
         for (std::map<const pv::data::decode::Row, bool>::const_iterator i = rows.begin();
             i != rows.end(); i++) {
             if ((*i).second && column-- == 0) {
@@ -628,7 +592,7 @@ void ProtocolDock::nav_table_view()
                 break;
             }
         }
-        QModelIndex index = _model_proxy.mapToSource(_model_proxy.index(row_index, _model_proxy.filterKeyColumn()));
+        QModelIndex index = decoder_model->index(row_index, _search_column);
         if(index.isValid()){
             _table_view->scrollTo(index);
             _table_view->setCurrentIndex(index);
@@ -639,9 +603,9 @@ void ProtocolDock::nav_table_view()
                 _session.get_decode_signals());
             BOOST_FOREACH(boost::shared_ptr<pv::view::DecodeTrace> d, decode_sigs) {
                 d->decoder()->set_mark_index(-1);
+                d->update_paint();
             }
             decoder_stack->set_mark_index((ann.start_sample()+ann.end_sample())/2);
-            _view.set_all_update(true);
             _view.update();
         }
     }
@@ -649,105 +613,58 @@ void ProtocolDock::nav_table_view()
 
 void ProtocolDock::search_pre()
 {
-    search_update();
-    // now the proxy only contains rows that match the name
-    // let's take the pre one and map it to the original model
-    if (_model_proxy.rowCount() == 0) {
-        _table_view->scrollToTop();
-        _table_view->clearSelection();
-        _matchs_label->setText(QString::number(0));
-        _cur_search_index = -1;
-        return;
-    }
-    int i = 0;
-    uint64_t rowCount = _model_proxy.rowCount();
-    QModelIndex matchingIndex;
-    pv::data::DecoderModel *decoder_model = _session.get_decoder_model();
-    boost::shared_ptr<pv::data::DecoderStack> decoder_stack = decoder_model->getDecoderStack();
-    do {
-        _cur_search_index--;
-        if (_cur_search_index <= -1 || _cur_search_index >= _model_proxy.rowCount())
-            _cur_search_index = _model_proxy.rowCount() - 1;
-
-        matchingIndex = _model_proxy.mapToSource(_model_proxy.index(ceil(_cur_search_index),_model_proxy.filterKeyColumn()));
-        if (!decoder_stack || !matchingIndex.isValid())
-            break;
-        i = 1;
-        uint64_t row = matchingIndex.row() + 1;
-        uint64_t col = matchingIndex.column();
-        pv::data::decode::Annotation ann;
-        bool ann_valid;
-        while(i < _str_list.size()) {
-            QString nxt = _str_list.at(i);
-            do {
-                ann_valid = decoder_stack->list_annotation(ann, col, row);
-                row++;
-            }while(ann_valid && (ann.type() < 100 || ann.type() > 999));
-            QString source = ann.annotations().at(0);
-            if (ann_valid && source.contains(nxt))
-                i++;
-            else
-                break;
-        }
-    }while(i < _str_list.size() && --rowCount);
-
-    if(i >= _str_list.size() && matchingIndex.isValid()){
-        _table_view->scrollTo(matchingIndex);
-        _table_view->setCurrentIndex(matchingIndex);
-        _table_view->clicked(matchingIndex);
-    } else {
-        _table_view->scrollToTop();
-        _table_view->clearSelection();
-        _matchs_label->setText(QString::number(0));
-        _cur_search_index = -1;
-    }
+    search_step(false);
 }
 
 void ProtocolDock::search_nxt()
 {
-    search_update();
-    // now the proxy only contains rows that match the name
-    // let's take the pre one and map it to the original model
-    if (_model_proxy.rowCount() == 0) {
-        _table_view->scrollToTop();
-        _table_view->clearSelection();
-        _matchs_label->setText(QString::number(0));
-        _cur_search_index = -1;
-        return;
-    }
-    int i = 0;
-    uint64_t rowCount = _model_proxy.rowCount();
-    QModelIndex matchingIndex;
+    search_step(true);
+}
+
+void ProtocolDock::search_step(bool nxt)
+{
     pv::data::DecoderModel *decoder_model = _session.get_decoder_model();
     boost::shared_ptr<pv::data::DecoderStack> decoder_stack = decoder_model->getDecoderStack();
-    do {
-        _cur_search_index++;
-        if (_cur_search_index < 0 || _cur_search_index >= _model_proxy.rowCount())
-            _cur_search_index = 0;
+    QModelIndex matchingIndex;
+    uint64_t index = 0;
+    if (decoder_stack) {
+        // the row index finds the matches of the first part, the parts
+        // after it have to follow in the next data annotations
+        const QString &first = _str_list.first();
+        uint64_t count = decoder_stack->list_match_count(_search_column, first);
+        uint64_t from = nxt ? _cur_search_index + 1 :
+                        (_cur_search_index <= 0) ? UINT64_MAX : _cur_search_index - 1;
+        while (count-- > 0) {
+            if (!decoder_stack->list_match(_search_column, first, from, nxt, index) &&
+                !decoder_stack->list_match(_search_column, first,
+                                           nxt ? 0 : UINT64_MAX, nxt, index))
+                break;
 
-        matchingIndex = _model_proxy.mapToSource(_model_proxy.index(floor(_cur_search_index),_model_proxy.filterKeyColumn()));
-        if (!decoder_stack || !matchingIndex.isValid())
-            break;
-        i = 1;
-        uint64_t row = matchingIndex.row() + 1;
-        uint64_t col = matchingIndex.column();
-        pv::data::decode::Annotation ann;
-        bool ann_valid;
-        while(i < _str_list.size()) {
-            QString nxt = _str_list.at(i);
-            do {
-                ann_valid = decoder_stack->list_annotation(ann, col, row);
-                row++;
-            }while(ann_valid && (ann.type() < 100 || ann.type() > 999));
-            QString source = ann.annotations().at(0);
-            if (ann_valid && source.contains(nxt))
-                i++;
-            else
+            int i = 1;
+            uint64_t row = index + 1;
+            pv::data::decode::Annotation ann;
+            bool ann_valid;
+            while(i < _str_list.size()) {
+                do {
+                    ann_valid = decoder_stack->list_annotation(ann, _search_column, row);
+                    row++;
+                }while(ann_valid && (ann.type() < 100 || ann.type() > 999));
+                if (ann_valid && pv::data::decode::RowData::match_text(
+                        ann.annotations().at(0), _str_list.at(i)))
+                    i++;
+                else
+                    break;
+            }
+            if (i >= _str_list.size()) {
+                matchingIndex = decoder_model->index(index, _search_column);
                 break;
+            }
+            from = nxt ? index + 1 : (index == 0) ? UINT64_MAX : index - 1;
         }
-    }while(i < _str_list.size() && --rowCount);
+    }
 
-    if(i >= _str_list.size() && matchingIndex.isValid()){
+    if(matchingIndex.isValid()){
+        _cur_search_index = index;
         _table_view->scrollTo(matchingIndex);
         _table_view->setCurrentIndex(matchingIndex);
         _table_view->clicked(matchingIndex);
@@ -764,54 +681,22 @@ void ProtocolDock::search_done()
     QString str = _search_edit->text().trimmed();
     QRegExp rx("(-)");
     _str_list = str.split(rx);
-    _model_proxy.setFilterFixedString(_str_list.first());
+
+    pv::data::DecoderModel *decoder_model = _session.get_decoder_model();
+    boost::shared_ptr<pv::data::DecoderStack> decoder_stack = decoder_model->getDecoderStack();
     if (_str_list.size() > 1)
         _matchs_label->setText("...");
+    else if (decoder_stack)
+        _matchs_label->setText(QString::number(
+            decoder_stack->list_match_count(_search_column, _str_list.first())));
     else
-        _matchs_label->setText(QString::number(_model_proxy.rowCount()));
+        _matchs_label->setText(QString::number(0));
 }
 
 void ProtocolDock::search_changed()
 {
-    _search_edited = true;
-    _matchs_label->setText("...");
-}
-
-void ProtocolDock::search_update()
-{
-    if (!_search_edited)
-        return;
-
-    pv::data::DecoderModel *decoder_model = _session.get_decoder_model();
-    boost::shared_ptr<pv::data::DecoderStack> decoder_stack = decoder_model->getDecoderStack();
-    if (!decoder_stack)
-        return;
-
-    if (decoder_stack->list_annotation_size(_model_proxy.filterKeyColumn()) > ProgressRows) {
-        QFuture<void> future;
-        future = QtConcurrent::run([&]{
-            search_done();
-        });
-        Qt::WindowFlags flags = Qt::CustomizeWindowHint;
-        QProgressDialog dlg(tr("Searching..."),
-                            tr("Cancel"),0,0,this,flags);
-        dlg.setWindowModality(Qt::WindowModal);
-        dlg.setWindowFlags(Qt::Dialog | Qt::FramelessWindowHint | Qt::WindowSystemMenuHint |
-                           Qt::WindowMinimizeButtonHint | Qt::WindowMaximizeButtonHint);
-        dlg.setCancelButton(NULL);
-
-        QFutureWatcher<void> watcher;
-        watcher.setFuture(future);
-        connect(&watcher,SIGNAL(finished()),&dlg,SLOT(cancel()));
-
-        dlg.exec();
-    } else {
-        search_done();
-    }
-    _search_edited = false;
-    //search_done();
+    search_done();
 }
 
-
 } // namespace dock
 } // namespace pv
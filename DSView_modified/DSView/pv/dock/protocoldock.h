@@ -35,7 +35,6 @@
 #include <QScrollArea>
 #include <QSplitter>
 #include <QTableView>
-#include <QSortFilterProxyModel>
 
 #include <vector>
 #include <boost/thread.hpp>
@@ -60,9 +59,6 @@ class ProtocolDock : public QScrollArea
 {
     Q_OBJECT
 
-public:
-    static const uint64_t ProgressRows = 100000;
-
 public:
     ProtocolDock(QWidget *parent, view::View &view, SigSession &session);
     ~ProtocolDock();
@@ -93,17 +89,17 @@ private slots:
     void search_nxt();
     void search_done();
     void search_changed();
-    void search_update();
 
 private:
     static int decoder_name_cmp(const void *a, const void *b);
     void resize_table_view(data::DecoderModel *decoder_model);
+    void search_step(bool nxt);
 
 private:
     SigSession &_session;
     view::View &_view;
-    QSortFilterProxyModel _model_proxy;
-    double _cur_search_index;
+    int _search_column;
+    int64_t _cur_search_index;
     QStringList _str_list;
 
     QSplitter *_split_widget;
@@ -133,7 +129,6 @@ private:
     QPushButton *_dn_nav_button;
 
     mutable boost::mutex _search_mutex;
-    bool _search_edited;
     bool _searching;
 
     bool _add_silent;
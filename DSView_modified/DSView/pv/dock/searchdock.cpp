@@ -28,6 +28,7 @@
 #include "../dialogs/search.h"
 #include "../data/snapshot.h"
 #include "../data/logicsnapshot.h"
+#include "../data/patternsearch.h"
 #include "../device/devinst.h"
 #include "../dialogs/dsmessagebox.h"
 
@@ -58,6 +59,8 @@ SearchDock::SearchDock(QWidget *parent, View &view, SigSession &session) :
         this, SLOT(on_previous()));
     connect(&_nxt_button, SIGNAL(clicked()),
         this, SLOT(on_next()));
+    connect(&_session, SIGNAL(capture_state_changed(int)),
+        this, SLOT(on_capture_state_changed(int)));
 
     _pre_button.setIcon(QIcon::fromTheme("searchDock",
         QIcon(":/icons/pre.png")));
@@ -126,7 +129,6 @@ void SearchDock::on_previous()
         return;
     }
 
-    const int64_t end = logic_snapshot->get_sample_count() - 1;
     last_pos = _view.get_search_pos();
     last_hit = _view.get_search_hit();
     if (last_pos == 0) {
@@ -138,10 +140,14 @@ void SearchDock::on_previous()
         msg.exec();
         return;
     } else {
+        if (!_search)
+            start_search(logic_snapshot);
+        const boost::shared_ptr<data::PatternSearch> search = _search;
+        uint64_t match;
         QFuture<void> future;
         future = QtConcurrent::run([&]{
             last_pos -= last_hit;
-            ret = logic_snapshot->pattern_search(0, end, false, last_pos, _pattern);
+            ret = search->pre_match(last_pos, match);
         });
         Qt::WindowFlags flags = Qt::CustomizeWindowHint;
         QProgressDialog dlg(tr("Search Previous..."),
@@ -149,14 +155,19 @@ void SearchDock::on_previous()
         dlg.setWindowModality(Qt::WindowModal);
         dlg.setWindowFlags(Qt::Dialog | Qt::FramelessWindowHint | Qt::WindowSystemMenuHint |
                            Qt::WindowMinimizeButtonHint | Qt::WindowMaximizeButtonHint);
-        dlg.setCancelButton(NULL);
+        connect(&dlg, SIGNAL(canceled()), this, SLOT(on_search_canceled()));
 
         QFutureWatcher<void> watcher;
         connect(&watcher,SIGNAL(finished()),&dlg,SLOT(cancel()));
         watcher.setFuture(future);
         dlg.exec();
+        future.waitForFinished();
 
-        if (!ret) {
+        if (search->cancelled()) {
+            if (_search == search)
+                _search.reset();
+            return;
+        } else if (!ret) {
             dialogs::DSMessageBox msg(this);
             msg.mBox()->setText(tr("Search"));
             msg.mBox()->setInformativeText(tr("Pattern not found!"));
@@ -165,7 +176,7 @@ void SearchDock::on_previous()
             msg.exec();
             return;
         } else {
-            _view.set_search_pos(last_pos, true);
+            _view.set_search_pos(match, true);
         }
     }
 }
@@ -199,9 +210,13 @@ void SearchDock::on_next()
         msg.exec();
         return;
     } else {
+        if (!_search)
+            start_search(logic_snapshot);
+        const boost::shared_ptr<data::PatternSearch> search = _search;
+        uint64_t match;
         QFuture<void> future;
         future = QtConcurrent::run([&]{
-            ret = logic_snapshot->pattern_search(0, end, true, last_pos, _pattern);
+            ret = search->nxt_match(last_pos, match);
         });
         Qt::WindowFlags flags = Qt::CustomizeWindowHint;
         QProgressDialog dlg(tr("Search Next..."),
@@ -209,14 +224,19 @@ void SearchDock::on_next()
         dlg.setWindowModality(Qt::WindowModal);
         dlg.setWindowFlags(Qt::Dialog | Qt::FramelessWindowHint | Qt::WindowSystemMenuHint |
                            Qt::WindowMinimizeButtonHint | Qt::WindowMaximizeButtonHint);
-        dlg.setCancelButton(NULL);
+        connect(&dlg, SIGNAL(canceled()), this, SLOT(on_search_canceled()));
 
         QFutureWatcher<void> watcher;
         connect(&watcher,SIGNAL(finished()),&dlg,SLOT(cancel()));
         watcher.setFuture(future);
         dlg.exec();
+        future.waitForFinished();
 
-        if (!ret) {
+        if (search->cancelled()) {
+            if (_search == search)
+                _search.reset();
+            return;
+        } else if (!ret) {
             dialogs::DSMessageBox msg(this);
             msg.mBox()->setText(tr("Search"));
             msg.mBox()->setInformativeText(tr("Pattern not found!"));
@@ -225,7 +245,7 @@ void SearchDock::on_next()
             msg.exec();
             return;
         } else {
-            _view.set_search_pos(last_pos, true);
+            _view.set_search_pos(match, true);
         }
     }
 }
@@ -250,9 +270,37 @@ void SearchDock::on_set()
         if (new_pattern != _pattern) {
             _view.set_search_pos(_view.get_search_pos(), false);
             _pattern = new_pattern;
+            _search.reset();
+
+            // index the whole capture while the user moves on
+            const boost::shared_ptr<data::LogicSnapshot> logic_snapshot =
+                boost::dynamic_pointer_cast<data::LogicSnapshot>(
+                    _session.get_snapshot(SR_CHANNEL_LOGIC));
+            if (logic_snapshot && !logic_snapshot->empty() &&
+                _session.get_capture_state() == SigSession::Stopped)
+                start_search(logic_snapshot);
         }
     }
 }
 
+void SearchDock::start_search(boost::shared_ptr<data::LogicSnapshot> logic_snapshot)
+{
+    _search.reset(new data::PatternSearch(logic_snapshot, _pattern));
+    _search->start();
+}
+
+void SearchDock::on_capture_state_changed(int state)
+{
+    (void)state;
+    // matches of the previous capture are stale
+    _search.reset();
+}
+
+void SearchDock::on_search_canceled()
+{
+    if (_search)
+        _search->cancel();
+}
+
 } // namespace dock
 } // namespace pv
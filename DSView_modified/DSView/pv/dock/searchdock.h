@@ -42,6 +42,8 @@
 
 #include <vector>
 
+#include <boost/shared_ptr.hpp>
+
 #include "../widgets/fakelineedit.h"
 
 namespace pv {
@@ -52,6 +54,11 @@ namespace view {
     class View;
 }
 
+namespace data {
+    class LogicSnapshot;
+    class PatternSearch;
+}
+
 namespace widgets {
     class FakeLineEdit;
 }
@@ -73,10 +80,18 @@ public slots:
     void on_next();
     void on_set();
 
+private slots:
+    void on_capture_state_changed(int state);
+    void on_search_canceled();
+
+private:
+    void start_search(boost::shared_ptr<data::LogicSnapshot> logic_snapshot);
+
 private:
     SigSession &_session;
     view::View &_view;
     std::map<uint16_t, QString> _pattern;
+    boost::shared_ptr<data::PatternSearch> _search;
 
     QPushButton _pre_button;
     QPushButton _nxt_button;
@@ -109,6 +109,7 @@ DeviceOptions::DeviceOptions(struct sr_dev_inst *sdi) :
         case SR_CONF_CLOCK_TYPE:
         case SR_CONF_CLOCK_EDGE:
         case SR_CONF_INSTANT:
+        case SR_CONF_REARM:
             bind_bool(name, key);
             break;
 
@@ -119,6 +120,14 @@ DeviceOptions::DeviceOptions(struct sr_dev_inst *sdi) :
         case SR_CONF_PROBE_VDIV:
             bind_enum(name, key, gvar_list, print_vdiv);
             break;
+
+        case SR_CONF_TRACE_INDEX:
+            bind_trace(name, key, gvar_list);
+            break;
+
+        case SR_CONF_TRACE_MEAN:
+            bind_bool(name, key);
+            break;
         default:
             gvar_list = NULL;
 		}
@@ -183,6 +192,17 @@ void DeviceOptions::bind_int(const QString &name, int key, QString suffix,
 			bind(config_setter, _sdi, key, _1))));
 }
 
+void DeviceOptions::bind_trace(const QString &name, int key,
+    GVariant *const gvar_list)
+{
+    uint64_t first = 0, last = 0;
+
+    // the list is the range of the trace index
+    if (gvar_list)
+        g_variant_get(gvar_list, "(tt)", &first, &last);
+    bind_int(name, key, "", pair<int64_t, int64_t>(first, last));
+}
+
 void DeviceOptions::bind_double(const QString &name, int key, QString suffix,
     optional< std::pair<double, double> > range,
     int decimals, boost::optional<double> step)
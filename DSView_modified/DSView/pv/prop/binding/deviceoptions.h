@@ -54,6 +54,7 @@ private:
 		boost::function<QString (GVariant*)> printer = print_gvariant);
 	void bind_int(const QString &name, int key, QString suffix,
 		boost::optional< std::pair<int64_t, int64_t> > range);
+    void bind_trace(const QString &name, int key, GVariant *const gvar_list);
 
     void bind_double(const QString &name, int key, QString suffix,
         boost::optional<std::pair<double, double> > range,
@@ -42,6 +42,7 @@
 #include "data/decode/decoder.h"
 #include "data/decodermodel.h"
 #include "data/mathstack.h"
+#include "cpa.h"
 
 #include "view/analogsignal.h"
 #include "view/dsosignal.h"
@@ -123,6 +124,15 @@ SigSession::SigSession(DeviceManager &device_manager) :
     _group_data.reset(new data::Group());
     _group_cnt = 0;
 
+    // CPA capture qualifier, see cpa.h
+    _signature_result.checked = false;
+    _signature.set_threshold(CPA_SIGNATURE_THRESHOLD);
+    _signature.set_search_range(CPA_SIGNATURE_SEARCH_START, CPA_SIGNATURE_SEARCH_END);
+    _signature.set_decimation(CPA_SIGNATURE_DECIMATION);
+    if (_signature.load(CPA_SIGNATURE_FILE))
+        qDebug("Signature of %d samples loaded from %s",
+               _signature.length(), CPA_SIGNATURE_FILE);
+
     connect(&_view_timer, SIGNAL(timeout()), this, SLOT(check_update()));
 }
 
@@ -318,6 +328,12 @@ void SigSession::capture_init()
         _view_timer.stop();
     _noData_cnt = 0;
     data_unlock();
+    {
+        boost::lock_guard<boost::mutex> lock(_signature_mutex);
+        _signature_result.checked = false;
+        _trace_texts.clear();
+        _next_trace_texts.clear();
+    }
 
     // container init
     container_init();
@@ -432,8 +448,12 @@ void SigSession::stop_capture()
     for (vector< boost::shared_ptr<view::DecodeTrace> >::iterator i =
         _decode_traces.begin();
         i != _decode_traces.end();
-        i++)
+        i++) {
+        // a live decode finishes with the end of the capture
+        if (get_capture_state() == Running && (*i)->decoder()->live())
+            continue;
         (*i)->decoder()->stop_decode();
+    }
 #endif
     if (get_capture_state() != Running)
 		return;
@@ -468,6 +488,27 @@ bool SigSession::get_capture_status(bool &triggered, int &progress)
     return false;
 }
 
+bool SigSession::get_transfer_stats(transfer_stats &stats) const
+{
+    GVariant *gvar = _dev_inst->get_config(NULL, NULL, SR_CONF_TRANSFER_STATS);
+    if (gvar == NULL)
+        return false;
+
+    guint32 in_flight, max_in_flight, transfer_size;
+    guint64 overflows, max_gap, max_feed_time;
+    g_variant_get(gvar, "(uuuttt)", &in_flight, &max_in_flight,
+                  &transfer_size, &overflows, &max_gap, &max_feed_time);
+    g_variant_unref(gvar);
+
+    stats.in_flight = in_flight;
+    stats.max_in_flight = max_in_flight;
+    stats.transfer_size = transfer_size;
+    stats.overflows = overflows;
+    stats.max_gap = max_gap;
+    stats.max_feed_time = max_feed_time;
+    return true;
+}
+
 vector< boost::shared_ptr<view::Signal> > SigSession::get_signals()
 {
     //boost::lock_guard<boost::mutex> lock(_signals_mutex);
@@ -889,6 +930,15 @@ void SigSession::feed_in_meta(const sr_dev_inst *sdi,
 			/// @todo handle samplerate changes
 			/// samplerate = (uint64_t *)src->value;
 			break;
+		case SR_CONF_TRACE_TEXTS: {
+            // they belong to the frame whose first payload comes next
+            gsize size;
+            const void *const texts =
+                g_variant_get_fixed_array(src->data, &size, 1);
+            boost::lock_guard<boost::mutex> lock(_signature_mutex);
+            _next_trace_texts = QByteArray((const char *)texts, size);
+			break;
+		}
 		default:
 			// Unknown metadata is not an error.
 			break;
@@ -944,6 +994,10 @@ void SigSession::feed_in_logic(const sr_datafeed_logic &logic)
 
     if (_cur_logic_snapshot->last_ended()) {
         _cur_logic_snapshot->first_payload(logic, _dev_inst->get_sample_limit(), _dev_inst->dev_inst()->channels);
+#ifdef ENABLE_DECODE
+        BOOST_FOREACH(const boost::shared_ptr<view::DecodeTrace> d, _decode_traces)
+            d->frame_began();
+#endif
         // @todo Putting this here means that only listeners querying
         // for logic will be notified. Currently the only user of
         // frame_began is DecoderStack, but in future we need to signal
@@ -992,6 +1046,10 @@ void SigSession::feed_in_dso(const sr_datafeed_dso &dso)
 
         // first payload
         _cur_dso_snapshot->first_payload(dso, _dev_inst->get_sample_limit(), sig_enable, _instant);
+        boost::lock_guard<boost::mutex> lock(_signature_mutex);
+        _signature_result.checked = false;
+        _trace_texts = _next_trace_texts;
+        _next_trace_texts.clear();
     } else {
         // Append to the existing data snapshot
         _cur_dso_snapshot->append_payload(dso);
@@ -1010,6 +1068,19 @@ void SigSession::feed_in_dso(const sr_datafeed_dso &dso)
             m->get_math_stack()->calc_fft();
     }
 
+    // a sync group in LOGIC mode sends a frame along with the logic data,
+    // the capture goes by the logic data then
+    if (_dev_inst->dev_inst()->mode != DSO) {
+        _data_updated = true;
+        return;
+    }
+
+    // qualify the frame as soon as the whole search range is in
+    if (_signature.enabled() && !_signature_result.checked &&
+        _signature.needed_samples() != 0 &&
+        _cur_dso_snapshot->get_sample_count() >= _signature.needed_samples())
+        check_signature();
+
     _trigger_flag = dso.trig_flag;
    
 
@@ -1021,6 +1092,26 @@ void SigSession::feed_in_dso(const sr_datafeed_dso &dso)
     _data_updated = true;
 }
 
+void SigSession::check_signature()
+{
+    const data::SignatureMatch::Result result =
+        _signature.match(*_cur_dso_snapshot, CPA_SIGNATURE_CHANNEL);
+    boost::lock_guard<boost::mutex> lock(_signature_mutex);
+    _signature_result = result;
+}
+
+data::SignatureMatch::Result SigSession::get_signature_result() const
+{
+    boost::lock_guard<boost::mutex> lock(_signature_mutex);
+    return _signature_result;
+}
+
+QByteArray SigSession::get_trace_texts() const
+{
+    boost::lock_guard<boost::mutex> lock(_signature_mutex);
+    return _trace_texts;
+}
+
 void SigSession::feed_in_analog(const sr_datafeed_analog &analog)
 {
     //boost::lock_guard<boost::mutex> lock(_data_mutex);
@@ -1122,6 +1213,9 @@ void SigSession::data_feed_in(const struct sr_dev_inst *sdi,
                     _cur_group_snapshot.reset();
                 }
             }
+            if (_dev_inst->dev_inst()->mode == DSO && _signature.enabled() &&
+                !_signature_result.checked && !_cur_dso_snapshot->empty())
+                check_signature();
             _cur_logic_snapshot->capture_ended();
             _cur_dso_snapshot->capture_ended();
             _cur_analog_snapshot->capture_ended();
@@ -1135,6 +1229,15 @@ void SigSession::data_feed_in(const struct sr_dev_inst *sdi,
             _error = Pkt_data_err;
             session_error();
         }
+
+        transfer_stats stats;
+        if (get_transfer_stats(stats) && stats.max_in_flight != 0)
+            qDebug("Transfers: up to %u in flight of %u bytes, %llu overflows, "
+                   "longest gap %llu us, longest feed %llu us",
+                   stats.max_in_flight, stats.transfer_size,
+                   (unsigned long long)stats.overflows,
+                   (unsigned long long)stats.max_gap,
+                   (unsigned long long)stats.max_feed_time);
         frame_ended();
 		break;
 	}
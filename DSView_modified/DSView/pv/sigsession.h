@@ -37,6 +37,7 @@
 #include <stdint.h>
 
 #include <QObject>
+#include <QByteArray>
 #include <QString>
 #include <QLine>
 #include <QVector>
@@ -49,6 +50,8 @@
 #include <libsigrok4DSL/libsigrok.h>
 #include <libusb.h>
 
+#include "data/signaturematch.h"
+
 struct srd_decoder;
 struct srd_channel;
 
@@ -121,6 +124,18 @@ public:
         Data_overflow
     };
 
+    // transfer counters of the last capture, see SR_CONF_TRANSFER_STATS
+    struct transfer_stats {
+        uint32_t in_flight;
+        uint32_t max_in_flight;
+        uint32_t transfer_size;
+        uint64_t overflows;
+        // the longest gap between two completions, in us
+        uint64_t max_gap;
+        // the longest a packet took to be taken in, in us
+        uint64_t max_feed_time;
+    };
+
 public:
 	SigSession(DeviceManager &device_manager);
 
@@ -156,6 +171,9 @@ public:
 		boost::function<void (const QString)> error_handler);
     void capture_init();
     bool get_capture_status(bool &triggered, int &progress);
+    bool get_transfer_stats(transfer_stats &stats) const;
+    data::SignatureMatch::Result get_signature_result() const;
+    QByteArray get_trace_texts() const;
     void container_init();
 
     std::set< boost::shared_ptr<data::SignalData> > get_data() const;
@@ -255,6 +273,7 @@ private:
     void feed_in_trigger(const ds_trigger_pos &trigger_pos);
 	void feed_in_logic(const sr_datafeed_logic &logic);
     void feed_in_dso(const sr_datafeed_dso &dso);
+    void check_signature();
 	void feed_in_analog(const sr_datafeed_analog &analog);
 	void data_feed_in(const struct sr_dev_inst *sdi,
 		const struct sr_datafeed_packet *packet);
@@ -315,6 +334,13 @@ private:
 
     QDateTime _trigger_time;
     uint64_t _trigger_pos;
+
+    data::SignatureMatch _signature;
+    mutable boost::mutex _signature_mutex;
+    data::SignatureMatch::Result _signature_result;
+    // SR_CONF_TRACE_TEXTS of the current frame, and of the next one
+    QByteArray _trace_texts;
+    QByteArray _next_trace_texts;
     bool _trigger_flag;
     bool _hw_replied;
 
@@ -39,11 +39,19 @@
 #include <pv/view/dsosignal.h>
 #include <pv/view/decodetrace.h>
 #include <pv/device/devinst.h>
+#include <pv/device/file.h>
 #include <pv/dock/protocoldock.h>
 
 #include <boost/foreach.hpp>
 
 #include <QFileDialog>
+#include <QApplication>
+#include <QCryptographicHash>
+#include <QDataStream>
+
+#include <zip.h>
+
+#include <queue>
 
 using boost::dynamic_pointer_cast;
 using boost::mutex;
@@ -51,9 +59,11 @@ using boost::shared_ptr;
 using boost::thread;
 using boost::lock_guard;
 using std::deque;
+using std::greater;
 using std::make_pair;
 using std::min;
 using std::pair;
+using std::priority_queue;
 using std::set;
 using std::string;
 using std::vector;
@@ -229,6 +239,10 @@ void StoreSession::save_proc(shared_ptr<data::Snapshot> snapshot)
                 }
             }
         }
+    #ifdef ENABLE_DECODE
+        if (!boost::this_thread::interruption_requested())
+            save_decoded();
+    #endif
     } else {
         int ch_type = -1;
         BOOST_FOREACH(const boost::shared_ptr<view::Signal> s, _session.get_signals()) {
@@ -854,7 +868,9 @@ void StoreSession::export_proc(shared_ptr<data::Snapshot> snapshot)
     }
     g_slist_free(meta.config);
 
-    if (channel_type == SR_CHANNEL_LOGIC) {
+    if (channel_type == SR_CHANNEL_LOGIC && edge_export_supported()) {
+        export_logic_edges(logic_snapshot, output, out);
+    } else if (channel_type == SR_CHANNEL_LOGIC) {
         _unit_count = logic_snapshot->get_sample_count();
         int blk_num = logic_snapshot->get_block_num();
         bool sample;
@@ -984,6 +1000,97 @@ void StoreSession::export_proc(shared_ptr<data::Snapshot> snapshot)
 	snapshot->set_exporting_status(true);
 }
 
+bool StoreSession::edge_export_supported() const
+{
+    // output modules which only print changed samples
+    return strcmp(_outModule->id, "csv") == 0 ||
+           strcmp(_outModule->id, "vcd") == 0;
+}
+
+void StoreSession::export_logic_edges(shared_ptr<data::LogicSnapshot> logic_snapshot,
+                                      const struct sr_output &output, QTextStream &out)
+{
+    typedef pair<uint64_t, unsigned int> EdgeItem;
+
+    vector<int> ch_index;
+    BOOST_FOREACH(const boost::shared_ptr<view::Signal> s, _session.get_signals()) {
+        if (s->get_type() == SR_CHANNEL_LOGIC &&
+            logic_snapshot->has_data(s->get_index()))
+            ch_index.push_back(s->get_index());
+    }
+
+    const uint64_t sample_count = logic_snapshot->get_sample_count();
+    _unit_count = sample_count;
+    if (ch_index.empty() || sample_count == 0)
+        return;
+
+    const uint64_t end = sample_count - 1;
+    const uint16_t unitsize = ceil(ch_index.size() / 8.0);
+    const unsigned int usize = 8192;
+
+    // current level of each channel, packed as the SR_DF_LOGIC export does,
+    // and a min-heap holding the next transition of each channel
+    vector<uint8_t> cur(unitsize, 0);
+    priority_queue<EdgeItem, vector<EdgeItem>, greater<EdgeItem> > edges;
+    for (unsigned int k = 0; k < ch_index.size(); k++) {
+        const bool level = logic_snapshot->get_sample(0, ch_index[k]);
+        if (level)
+            cur[k/8] |= 1 << k%8;
+        uint64_t index = 1;
+        if (logic_snapshot->get_nxt_edge(index, level, end, 1, ch_index[k]))
+            edges.push(EdgeItem(index, k));
+    }
+
+    vector<uint64_t> index_buf;
+    vector<uint8_t> data_buf;
+    index_buf.reserve(usize);
+    data_buf.reserve(usize * unitsize);
+    index_buf.push_back(0);
+    data_buf.insert(data_buf.end(), cur.begin(), cur.end());
+
+    GString *data_out;
+    struct sr_datafeed_packet p;
+    struct sr_datafeed_logic_edge ep;
+    p.type = SR_DF_LOGIC_EDGE;
+    p.status = SR_PKT_OK;
+    p.payload = &ep;
+    ep.unitsize = unitsize;
+
+    for (;;) {
+        while (!edges.empty() && index_buf.size() < usize) {
+            const uint64_t index = edges.top().first;
+            // channels toggling on the same sample share one entry
+            while (!edges.empty() && edges.top().first == index) {
+                const unsigned int k = edges.top().second;
+                edges.pop();
+                cur[k/8] ^= 1 << k%8;
+                uint64_t nxt_index = index + 1;
+                if (logic_snapshot->get_nxt_edge(nxt_index, (cur[k/8] >> k%8) & 1,
+                                                 end, 1, ch_index[k]))
+                    edges.push(EdgeItem(nxt_index, k));
+            }
+            index_buf.push_back(index);
+            data_buf.insert(data_buf.end(), cur.begin(), cur.end());
+        }
+
+        ep.num_edges = index_buf.size();
+        ep.index = index_buf.data();
+        ep.data = data_buf.data();
+        _outModule->receive(&output, &p, &data_out);
+        if(data_out){
+            out << QString::fromUtf8((char*) data_out->str);
+            g_string_free(data_out,TRUE);
+        }
+
+        _units_stored = edges.empty() ? sample_count : index_buf.back();
+        progress_updated();
+        index_buf.clear();
+        data_buf.clear();
+        if (edges.empty() || boost::this_thread::interruption_requested())
+            break;
+    }
+}
+
 #ifdef ENABLE_DECODE
 QString StoreSession::decoders_gen()
 {
@@ -1006,8 +1113,8 @@ QString StoreSession::decoders_gen()
         outStream.setCodec("UTF-8");
         outStream.setGenerateByteOrderMark(true);
 
-        QJsonArray dec_array = json_decoders();
-        QJsonDocument sessionDoc(dec_array);
+        _dec_array = json_decoders();
+        QJsonDocument sessionDoc(_dec_array);
         outStream << QString::fromUtf8(sessionDoc.toJson());
         sessionFile.close();
 
@@ -1107,12 +1214,133 @@ QJsonArray StoreSession::json_decoders()
     return dec_array;
 }
 
+QByteArray StoreSession::decoded_key(const QJsonObject &dec_obj, struct zip *archive)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(QJsonDocument(dec_obj).toJson(QJsonDocument::Compact));
+    hash.addData(srd_package_version_string_get());
+    hash.addData(QApplication::applicationVersion().toUtf8());
+
+    // the decoders of the stack, down to the scripts they run
+    QStringList ids(dec_obj["id"].toString());
+    foreach (const QJsonValue &value, dec_obj["stacked decoders"].toArray())
+        ids.push_back(value.toObject()["id"].toString());
+    foreach (const QString &id, ids) {
+        const srd_decoder *const d = srd_decoder_get_by_id(id.toUtf8().data());
+        const QByteArray digest = d ? data::decode::Decoder::digest(d) : QByteArray();
+        if (digest.isEmpty())
+            return QByteArray();
+        hash.addData(digest);
+    }
+
+    // The channel data is known by the CRCs the archive keeps anyway
+    set<int> channels;
+    foreach (const QJsonValue &value, dec_obj["channel"].toArray()) {
+        QJsonObject ch_obj = value.toObject();
+        for (QJsonObject::const_iterator i = ch_obj.begin(); i != ch_obj.end(); i++)
+            if ((*i).toInt() >= 0)
+                channels.insert((*i).toInt());
+    }
+    if (channels.empty())
+        return QByteArray();
+
+    BOOST_FOREACH(int ch, channels) {
+        for (int n = 0; ; n++) {
+            const QString name = QString("L-%1/%2").arg(ch).arg(n);
+            struct zip_stat zs;
+            if (zip_stat(archive, name.toLocal8Bit().data(), 0, &zs) == -1) {
+                if (n == 0)
+                    return QByteArray();
+                break;
+            }
+            if (!(zs.valid & ZIP_STAT_CRC))
+                return QByteArray();
+            const quint64 size = zs.size;
+            const quint32 crc = zs.crc;
+            hash.addData(name.toUtf8());
+            hash.addData((const char *)&size, sizeof(size));
+            hash.addData((const char *)&crc, sizeof(crc));
+        }
+    }
+    return hash.result();
+}
+
+void StoreSession::save_decoded()
+{
+    int ret;
+    struct zip *archive = zip_open(_file_name.toLocal8Bit().data(), 0, &ret);
+    if (!archive)
+        return;
+
+    // the buffers have to live until the archive is closed
+    vector<QByteArray> results;
+    int index = 0;
+    BOOST_FOREACH(boost::shared_ptr<view::DecodeTrace> t, _session.get_decode_signals()) {
+        if (index >= _dec_array.size())
+            break;
+        const QByteArray key = decoded_key(_dec_array[index].toObject(), archive);
+        QByteArray result;
+        QDataStream out(&result, QIODevice::WriteOnly);
+        out.setVersion(QDataStream::Qt_5_0);
+        out << (quint32)Decoded_Version << key;
+        if (!key.isEmpty() && t->decoder()->save_result(out)) {
+            results.push_back(result);
+            const QString name = QString("decoded-%1").arg(index);
+            struct zip_source *src = zip_source_buffer(archive,
+                results.back().constData(), results.back().size(), 0);
+            if (src && zip_file_add(archive, name.toLocal8Bit().data(),
+                                    src, ZIP_FL_OVERWRITE) == -1)
+                zip_source_free(src);
+        }
+        index++;
+    }
+
+    if (zip_close(archive) == -1)
+        qDebug("Warning: Couldn't save the decoder results!");
+}
+
+void StoreSession::restore_decoded(const boost::shared_ptr<data::DecoderStack> &stack,
+                                   const QJsonObject &dec_obj, int index)
+{
+    shared_ptr<device::File> file;
+    if (!(file = dynamic_pointer_cast<device::File>(_session.get_device())))
+        return;
+
+    int ret;
+    struct zip *archive = zip_open(file->path().toLocal8Bit().data(), 0, &ret);
+    if (!archive)
+        return;
+
+    const QString name = QString("decoded-%1").arg(index);
+    struct zip_stat zs;
+    struct zip_file *zf;
+    if (zip_stat(archive, name.toLocal8Bit().data(), 0, &zs) != -1 &&
+        (zf = zip_fopen_index(archive, zs.index, 0)) != NULL) {
+        QByteArray result(zs.size, Qt::Uninitialized);
+        const bool read = (zip_fread(zf, result.data(), zs.size) == (zip_int64_t)zs.size);
+        zip_fclose(zf);
+
+        if (read) {
+            QDataStream in(result);
+            in.setVersion(QDataStream::Qt_5_0);
+            quint32 version;
+            QByteArray key;
+            in >> version >> key;
+            if (version == Decoded_Version && !key.isEmpty() &&
+                key == decoded_key(dec_obj, archive))
+                stack->restore_result(in);
+        }
+    }
+    zip_close(archive);
+}
+
 void StoreSession::load_decoders(dock::ProtocolDock *widget, QJsonArray dec_array)
 {
     if (_session.get_device()->dev_inst()->mode != LOGIC ||
         dec_array.empty())
         return;
 
+    int dec_index = 0;
     foreach (const QJsonValue &dec_value, dec_array) {
         QJsonObject dec_obj = dec_value.toObject();
         const vector< boost::shared_ptr<view::DecodeTrace> > pre_dsigs(
@@ -1253,7 +1481,10 @@ void StoreSession::load_decoders(dock::ProtocolDock *widget, QJsonArray dec_arra
                     }
                 }
             }
+
+            restore_decoded(stack, dec_obj, dec_index);
         }
+        dec_index++;
     }
 
 }
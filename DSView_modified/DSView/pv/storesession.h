@@ -29,16 +29,23 @@
 #include <boost/thread.hpp>
 
 #include <QObject>
+#include <QJsonArray>
+#include <QJsonObject>
 
 #include <libsigrok4DSL/libsigrok.h>
 #include <libsigrokdecode4DSL/libsigrokdecode.h>
 
+class QTextStream;
+struct zip;
+
 namespace pv {
 
 class SigSession;
 
 namespace data {
 class Snapshot;
+class LogicSnapshot;
+class DecoderStack;
 }
 
 namespace dock {
@@ -51,6 +58,8 @@ class StoreSession : public QObject
 
 private:
     const static int File_Version = 2;
+    // format of the saved decoder results
+    const static int Decoded_Version = 1;
 
 public:
     StoreSession(SigSession &session);
@@ -77,9 +86,24 @@ private:
     QString meta_gen(boost::shared_ptr<data::Snapshot> snapshot);
     void export_proc(boost::shared_ptr<pv::data::Snapshot> snapshot);
     void export_proc_cpa(boost::shared_ptr<pv::data::Snapshot> snapshot);
+    bool edge_export_supported() const;
+    void export_logic_edges(boost::shared_ptr<pv::data::LogicSnapshot> logic_snapshot,
+                            const struct sr_output &output, QTextStream &out);
 
     #ifdef ENABLE_DECODE
     QString decoders_gen();
+
+    /**
+     * Decoder results are saved as "decoded-<n>" next to the decoders
+     * file, keyed by the config of decoder stack n, the decoder versions,
+     * the scripts of its decoders and the CRCs of the stored blocks of
+     * the channels it decodes.
+     * Stacks loaded with a matching key take them instead of decoding.
+     */
+    static QByteArray decoded_key(const QJsonObject &dec_obj, struct zip *archive);
+    void save_decoded();
+    void restore_decoded(const boost::shared_ptr<data::DecoderStack> &stack,
+                         const QJsonObject &dec_obj, int index);
     #endif
 
 public:
@@ -109,6 +133,9 @@ private:
 	uint64_t _unit_count;
     bool _has_error;
 	QString _error;
+
+    // the decoders file of the session being saved
+    QJsonArray _dec_array;
 };
 
 } // pv
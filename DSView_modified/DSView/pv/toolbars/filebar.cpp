@@ -127,7 +127,7 @@ void FileBar::on_actionOpen_triggered()
     // Show the dialog
     const QString file_name = QFileDialog::getOpenFileName(
         this, tr("Open File"), settings.value(DIR_KEY).toString(), tr(
-            "DSView Data (*.dsl)"));
+            "DSView Data (*.dsl);;Trace Set (*.dstrace)"));
     if (!file_name.isEmpty()) {
         QDir CurrentDir;
         settings.setValue(DIR_KEY, CurrentDir.absoluteFilePath(file_name));
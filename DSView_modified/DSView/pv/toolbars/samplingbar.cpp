@@ -33,6 +33,9 @@
 #include <QLabel>
 #include <QAbstractItemView>
 #include <QApplication>
+#include <QFile>
+#include <QFileInfo>
+#include <QTextStream>
 
 #include "samplingbar.h"
 
@@ -45,6 +48,7 @@
 #include "../dialogs/interval.h"
 #include "../view/viewport.h"
 #include "../view/trace.h"
+#include "../cpa.h"
 
 #include <fstream>      // std::fstream
 
@@ -244,6 +248,14 @@ void SamplingBar::on_configure()
         update_sample_rate_selector();
 
         GVariant* gvar;
+        // a trace set reads the trace it was set to on the next start
+        gvar = dev_inst->get_config(NULL, NULL, SR_CONF_TRACE_INDEX);
+        if (gvar != NULL) {
+            g_variant_unref(gvar);
+            on_run_stop();
+            return;
+        }
+
         if (dev_inst->dev_inst()->mode == DSO) {
             gvar = dev_inst->get_config(NULL, NULL, SR_CONF_ZERO);
             if (gvar != NULL) {
@@ -967,6 +979,33 @@ void SamplingBar::capturing_thread_proc(QString _file_name)
 		usleep(50);
 	}
 
+	// Captures the signature doesn't qualify never reach the export,
+	// the match offset of the others is logged for the trace alignment.
+	const data::SignatureMatch::Result sig = _session.get_signature_result();
+	if (sig.checked) {
+		if (!sig.qualified) {
+			fprintf(stdout, "no signature match (%.3f), capture dropped\n", sig.score);
+			done = true;
+			return;
+		}
+		QFile log(CPA_SIGNATURE_LOG);
+		if (log.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text)) {
+			QTextStream out(&log);
+			out << QFileInfo(_file_name).completeBaseName() << ","
+			    << sig.offset << "," << sig.score << "\n";
+		}
+	}
+
+	const QByteArray texts = _session.get_trace_texts();
+	if (texts.size() == 32) {
+		QFile log(CPA_TEXTS_LOG);
+		if (log.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text)) {
+			QTextStream out(&log);
+			out << QFileInfo(_file_name).completeBaseName() << ","
+			    << texts.left(16).toHex() << "," << texts.mid(16).toHex() << "\n";
+		}
+	}
+
  	StoreSession ss(_session);
 
     ss.export_cpa_start(_file_name);
@@ -304,15 +304,16 @@ void DecodeTrace::paint_mid(QPainter &p, int left, int right)
                         if ((max_annWidth > 100) ||
                             (max_annWidth > 10 && min_annWidth > 1) ||
                             (max_annWidth == 0 && samples_per_pixel < 10)) {
-                            vector<Annotation> annotations;
-                            _decoder_stack->get_annotation_subset(annotations, row,
-                                start_sample, end_sample);
-                            if (!annotations.empty()) {
-                                BOOST_FOREACH(const Annotation &a, annotations)
-                                    draw_annotation(a, p, get_text_colour(),
-                                        annotation_height, left, right,
-                                        samples_per_pixel, pixels_offset, y,
-                                        0, min_annWidth);
+                            RowData::const_iterator first, last;
+                            if (_decoder_stack->get_annotation_range(row,
+                                    start_sample, end_sample, first, last)) {
+                                for (RowData::const_iterator a = first; a != last; ++a)
+                                    if (a.end_sample() > start_sample &&
+                                        a.start_sample() <= end_sample)
+                                        draw_annotation(a, p, get_text_colour(),
+                                            annotation_height, left, right,
+                                            samples_per_pixel, pixels_offset, y,
+                                            0, min_annWidth);
                             }
                         } else {
                             draw_nodetail(p, annotation_height, left, right, y, 0);
@@ -480,7 +481,7 @@ void DecodeTrace::populate_popup_form(QWidget *parent, QFormLayout *form)
     form->addRow(confirm_button_box);
 }
 
-void DecodeTrace::draw_annotation(const pv::data::decode::Annotation &a,
+void DecodeTrace::draw_annotation(const pv::data::decode::RowData::const_iterator &a,
     QPainter &p, QColor text_color, int h, int left, int right,
     double samples_per_pixel, double pixels_offset, int y,
     size_t base_colour, double min_annWidth) const
@@ -566,11 +567,11 @@ void DecodeTrace::draw_nodetail(QPainter &p,
     p.drawText(nodetail_rect, Qt::AlignCenter | Qt::AlignVCenter, info);
 }
 
-void DecodeTrace::draw_instant(const pv::data::decode::Annotation &a, QPainter &p,
+void DecodeTrace::draw_instant(const pv::data::decode::RowData::const_iterator &a, QPainter &p,
     QColor fill, QColor outline, QColor text_color, int h, double x, int y, double min_annWidth) const
 {
-	const QString text = a.annotations().empty() ?
-		QString() : a.annotations().back();
+	const QString text = a.texts().empty() ?
+		QString() : a.texts().back();
 //	const double w = min((double)p.boundingRect(QRectF(), 0, text).width(),
 //		0.0) + h;
     const double w = min(min_annWidth, (double)h);
@@ -587,13 +588,13 @@ void DecodeTrace::draw_instant(const pv::data::decode::Annotation &a, QPainter &
 	p.drawText(rect, Qt::AlignCenter | Qt::AlignVCenter, text);
 }
 
-void DecodeTrace::draw_range(const pv::data::decode::Annotation &a, QPainter &p,
+void DecodeTrace::draw_range(const pv::data::decode::RowData::const_iterator &a, QPainter &p,
 	QColor fill, QColor outline, QColor text_color, int h, double start,
 	double end, int y) const
 {
 	const double top = y + .5 - h / 2;
 	const double bottom = y + .5 + h / 2;
-	const vector<QString> annotations = a.annotations();
+	const vector<QString> &annotations = a.texts();
 
     p.setPen(outline);
     p.setBrush(fill);
@@ -993,7 +994,17 @@ void DecodeTrace::on_region_set(int index)
     }
 }
 
+void DecodeTrace::frame_began()
+{
+    fit_decode_region();
+}
+
 void DecodeTrace::frame_ended()
+{
+    fit_decode_region();
+}
+
+void DecodeTrace::fit_decode_region()
 {
     const uint64_t last_samples = _session.cur_samplelimits() - 1;
     if (_decode_start > last_samples) {
@@ -33,6 +33,7 @@
 #include <boost/shared_ptr.hpp>
 
 #include <pv/prop/binding/decoderoptions.h>
+#include "../data/decode/rowdata.h"
 #include "../dialogs/dsdialog.h"
 
 struct srd_channel;
@@ -48,7 +49,6 @@ namespace data {
 class DecoderStack;
 
 namespace decode {
-class Annotation;
 class Decoder;
 class Row;
 }
@@ -141,6 +141,7 @@ public:
     /**
      * decode region
      **/
+    void frame_began();
     void frame_ended();
 
     int get_progress() const;
@@ -153,7 +154,7 @@ private:
 
 	void populate_popup_form(QWidget *parent, QFormLayout *form);
 
-	void draw_annotation(const pv::data::decode::Annotation &a, QPainter &p,
+	void draw_annotation(const pv::data::decode::RowData::const_iterator &a, QPainter &p,
 		QColor text_colour, int text_height, int left, int right,
 		double samples_per_pixel, double pixels_offset, int y,
         size_t base_colour, double min_annWidth) const;
@@ -161,11 +162,11 @@ private:
         int text_height, int left, int right, int y,
         size_t base_colour) const;
 
-	void draw_instant(const pv::data::decode::Annotation &a, QPainter &p,
+	void draw_instant(const pv::data::decode::RowData::const_iterator &a, QPainter &p,
 		QColor fill, QColor outline, QColor text_color, int h, double x,
         int y, double min_annWidth) const;
 
-	void draw_range(const pv::data::decode::Annotation &a, QPainter &p,
+	void draw_range(const pv::data::decode::RowData::const_iterator &a, QPainter &p,
 		QColor fill, QColor outline, QColor text_color, int h, double start,
 		double end, int y) const;
 
@@ -188,6 +189,9 @@ private:
 
 	void commit_probes();
 
+    // clip the decode region to the samples of the capture
+    void fit_decode_region();
+
 signals:
     void decoded_progress(int progress);
 
@@ -526,7 +526,7 @@ uint64_t DsoSignal::get_factor()
 void DsoSignal::set_ms_show(bool show)
 {
     _probe->ms_show = show;
-    _view->set_update(_viewport, true);
+    update_paint();
 }
 
 bool DsoSignal::get_ms_show() const
@@ -1244,18 +1244,18 @@ bool DsoSignal::measure(const QPointF &p)
 {
     if (_ms_gear_rect.contains(QPoint(p.x(), p.y()))) {
         _ms_gear_hover = true;
-        _view->set_update(_viewport, true);
+        update_paint();
         return false;
     } else if (_ms_gear_hover) {
-        _view->set_update(_viewport, true);
+        update_paint();
         _ms_gear_hover = false;
     }
     if (_ms_show_rect.contains(QPoint(p.x(), p.y()))) {
         _ms_show_hover = true;
-        _view->set_update(_viewport, true);
+        update_paint();
         return false;
     } else if (_ms_show_hover){
-        _view->set_update(_viewport, true);
+        update_paint();
         _ms_show_hover = false;
     }
 
@@ -218,7 +218,7 @@ void Header::mouseReleaseEvent(QMouseEvent *event)
         if (action == Trace::COLOR && _colorFlag) {
             _context_trace = mTrace;
             changeColor(event);
-            _view.set_all_update(true);
+            _view.viewport_update();
         } else if (action == Trace::NAME && _nameFlag) {
             _context_trace = mTrace;
             changeName(event);
@@ -146,7 +146,7 @@ void MathTrace::zoom(double steps, int offset)
     _offset = pre_offset - _scale*offset/width;
     _offset = max(min(_offset, 1-_scale), 0.0);
 
-    _view->set_update(_viewport, true);
+    update_paint();
     _view->update();
 }
 
@@ -156,7 +156,7 @@ void MathTrace::set_offset(double delta)
     _offset = _offset + (delta*_scale / width);
     _offset = max(min(_offset, 1-_scale), 0.0);
 
-    _view->set_update(_viewport, true);
+    update_paint();
     _view->update();
 }
 
@@ -169,7 +169,7 @@ void MathTrace::set_scale(double scale)
 {
     _scale = max(min(scale, 1.0), 100.0/_math_stack->get_sample_num());
 
-    _view->set_update(_viewport, true);
+    update_paint();
     _view->update();
 }
 
@@ -83,7 +83,8 @@ Trace::Trace(QString name, uint16_t index, int type) :
     _type(type),
     _sec_index(0),
     _totalHeight(30),
-    _typeWidth(SquareNum)
+    _typeWidth(SquareNum),
+    _paint_generation(0)
 {
     _index_list.push_back(index);
 }
@@ -96,7 +97,8 @@ Trace::Trace(QString name, std::list<int> index_list, int type, int sec_index) :
     _index_list(index_list),
     _sec_index(sec_index),
     _totalHeight(30),
-    _typeWidth(SquareNum)
+    _typeWidth(SquareNum),
+    _paint_generation(0)
 {
 }
 
@@ -111,6 +113,7 @@ Trace::Trace(const Trace &t) :
     _old_v_offset(t._old_v_offset),
     _totalHeight(t._totalHeight),
     _typeWidth(t._typeWidth),
+    _paint_generation(t._paint_generation),
     _text_size(t._text_size)
 {
 }
@@ -141,6 +144,7 @@ QColor Trace::get_colour() const
 void Trace::set_colour(QColor colour)
 {
 	_colour = colour;
+    update_paint();
 }
 
 int Trace::get_v_offset() const
@@ -186,6 +190,16 @@ void Trace::set_sec_index(int sec_index)
     _sec_index = sec_index;
 }
 
+uint64_t Trace::get_paint_generation() const
+{
+    return _paint_generation;
+}
+
+void Trace::update_paint()
+{
+    _paint_generation++;
+}
+
 int Trace::get_old_v_offset() const
 {
     return _old_v_offset;
@@ -162,6 +162,17 @@ public:
 
     virtual int get_zero_vpos() const;
 
+    /**
+     * Gets the paint generation, it moves on whenever what paint_mid
+     * draws of this trace changes.
+     */
+    uint64_t get_paint_generation() const;
+
+    /**
+     * Moves the paint generation on, so the viewport repaints the trace.
+     */
+    void update_paint();
+
 	/**
 	 * Returns true if the trace is visible and enabled.
 	 */
@@ -306,6 +317,7 @@ protected:
     int _old_v_offset;
     int _totalHeight;
     int _typeWidth;
+    uint64_t _paint_generation;
 
     QSizeF _text_size;
 };
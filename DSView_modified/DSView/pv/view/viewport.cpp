@@ -26,6 +26,7 @@
 #include "signal.h"
 #include "dsosignal.h"
 #include "logicsignal.h"
+#include "groupsignal.h"
 #include "mathtrace.h"
 #include "../device/devinst.h"
 #include "../data/logic.h"
@@ -37,6 +38,7 @@
 
 #include <QMouseEvent>
 #include <QStyleOption>
+#include <QtConcurrent/QtConcurrent>
 
 
 #include <math.h>
@@ -91,9 +93,6 @@ Viewport::Viewport(View &parent, View_type type) :
     _drag_strength = 0;
     _drag_timer.setSingleShot(true);
 
-    _pixmap = new QPixmap(size());
-    _pixmap->fill(Qt::transparent);
-
     connect(&trigger_timer, SIGNAL(timeout()),
             this, SLOT(on_trigger_timer()));
     connect(&_drag_timer, SIGNAL(timeout()),
@@ -178,10 +177,6 @@ void Viewport::paintEvent(QPaintEvent *event)
             t->paint_fore(p, 0, _view.get_view_width());
     }
 
-    //p.setRenderHint(QPainter::Antialiasing, false);
-    if (_view.get_signalHeight() != _curSignalHeight)
-            _curSignalHeight = _view.get_signalHeight();
-
 	p.end();
 }
 
@@ -190,32 +185,56 @@ void Viewport::paintSignals(QPainter &p)
 //    if (_view.session().get_data_lock())
 //        return;
     const vector< boost::shared_ptr<Trace> > traces(_view.get_traces(_type));
-    if (_view.scale() != _curScale ||
-        _view.offset() != _curOffset ||
-        _view.get_signalHeight() != _curSignalHeight ||
-        _need_update) {
-        _curScale = _view.scale();
-        _curOffset = _view.offset();
-        _curSignalHeight = _view.get_signalHeight();
-
-        //pixmap = QPixmap(size());
-        //pixmap.fill(Qt::transparent);
-        if (_pixmap->size() == size()) {
-            _pixmap->fill(Qt::transparent);
-            QPainter dbp(_pixmap);
-            dbp.initFrom(this);
-            //p.setRenderHint(QPainter::Antialiasing, false);
-            BOOST_FOREACH(const boost::shared_ptr<Trace> t, traces)
-            {
-                assert(t);
-                if (t->enabled())
-                    t->paint_mid(dbp, 0, t->get_view_rect().right());
-            }
-            _need_update = false;
+    if (_need_update) {
+        BOOST_FOREACH(const boost::shared_ptr<Trace> t, traces)
+            t->update_paint();
+        _need_update = false;
+    }
+
+    // Every trace keeps its paint_mid in a tile of its own. The tiles
+    // whose key changed are repainted on the thread pool, the others
+    // are only drawn again.
+    TileKey key;
+    key.scale = _view.scale();
+    key.offset = _view.offset();
+    key.signal_height = _view.get_signalHeight();
+
+    std::map<Trace*, Tile> tiles;
+    vector<Tile*> stale;
+    BOOST_FOREACH(const boost::shared_ptr<Trace> t, traces)
+    {
+        assert(t);
+        const QRect row = tile_rect(t);
+        const QRect rect = row & this->rect();
+        if (!t->enabled() || rect.isEmpty())
+            continue;
+        Tile &tile = tiles[t.get()];
+        std::map<Trace*, Tile>::const_iterator i = _tiles.find(t.get());
+        if (i != _tiles.end())
+            tile = (*i).second;
+        tile.trace = t;
+        tile.rect = rect;
+        key.generation = t->get_paint_generation();
+        key.size = rect.size();
+        key.clip = rect.topLeft() - row.topLeft();
+        if (tile.image.isNull() || !(tile.key == key)) {
+            tile.key = key;
+            stale.push_back(&tile);
         }
     }
-    if (_pixmap->size() == size())
-        p.drawPixmap(0, 0, *_pixmap);
+    _tiles.swap(tiles);
+
+    const QFont tile_font = font();
+    QtConcurrent::blockingMap(stale, [&tile_font](Tile *tile) {
+        paint_tile(tile, tile_font);
+    });
+
+    BOOST_FOREACH(const boost::shared_ptr<Trace> t, traces)
+    {
+        std::map<Trace*, Tile>::const_iterator i = _tiles.find(t.get());
+        if (i != _tiles.end())
+            p.drawImage((*i).second.rect.topLeft(), (*i).second.image);
+    }
 
     // plot cursors
     const double samples_per_pixel = _view.session().cur_samplerate() * _view.scale();
@@ -294,6 +313,40 @@ void Viewport::paintSignals(QPainter &p)
 
 
 
+bool Viewport::TileKey::operator==(const TileKey &other) const
+{
+    return generation == other.generation &&
+           scale == other.scale &&
+           offset == other.offset &&
+           signal_height == other.signal_height &&
+           size == other.size &&
+           clip == other.clip;
+}
+
+QRect Viewport::tile_rect(const boost::shared_ptr<Trace> &t) const
+{
+    // Logic, group and decode traces keep to their own row, the
+    // others paint over the whole view.
+    if (dynamic_pointer_cast<LogicSignal>(t) ||
+        dynamic_pointer_cast<GroupSignal>(t) ||
+        dynamic_pointer_cast<DecodeTrace>(t)) {
+        const int top = t->get_y() - t->get_totalHeight() / 2 - 1;
+        return QRect(0, top, width(), t->get_totalHeight() + 2);
+    }
+    return rect();
+}
+
+void Viewport::paint_tile(Tile *tile, const QFont &font)
+{
+    tile->image = QImage(tile->rect.size(), QImage::Format_ARGB32_Premultiplied);
+    tile->image.fill(Qt::transparent);
+
+    QPainter p(&tile->image);
+    p.setFont(font);
+    p.translate(-tile->rect.topLeft());
+    tile->trace->paint_mid(p, 0, tile->trace->get_view_rect().right());
+}
+
 void Viewport::paintProgress(QPainter &p)
 {
     using pv::view::Signal;
@@ -935,13 +988,6 @@ void Viewport::leaveEvent(QEvent *)
     clear_measure();
 }
 
-void Viewport::resizeEvent(QResizeEvent*)
-{
-    if (_pixmap)
-        delete _pixmap;
-    _pixmap = new QPixmap(size());
-}
-
 void Viewport::set_receive_len(quint64 length)
 {
     if (length == 0) {
@@ -26,9 +26,13 @@
 
 #include <stdint.h>
 
+#include <map>
+#include <vector>
+
 #include <boost/shared_ptr.hpp>
 #include <boost/weak_ptr.hpp>
 
+#include <QImage>
 #include <QTime>
 #include <QTimer>
 #include <QWidget>
@@ -44,6 +48,7 @@ namespace pv {
 namespace view {
 
 class Signal;
+class Trace;
 class View;
 
 class Viewport : public QWidget
@@ -116,9 +121,10 @@ private:
     void mouseDoubleClickEvent(QMouseEvent *event);
 	void wheelEvent(QWheelEvent *event);
     void leaveEvent(QEvent *);
-    void resizeEvent(QResizeEvent *e);
 
     void paintSignals(QPainter& p);
+    // the area paint_mid of a trace covers, not clipped to the viewport
+    QRect tile_rect(const boost::shared_ptr<Trace> &t) const;
     void paintProgress(QPainter& p);
     void paintMeasure(QPainter &p);
 
@@ -137,22 +143,48 @@ signals:
     void measure_updated();
     void prgRate(int progress);
 
+private:
+    /**
+     * What the paint_mid of a trace depends on. The paint generation
+     * of the trace moves on with its own changes, set_need_update
+     * moves on those of all traces in the viewport. A row cut off at
+     * the edge of the viewport is keyed on the part shown.
+     */
+    struct TileKey
+    {
+        uint64_t generation;
+        double scale;
+        int64_t offset;
+        int signal_height;
+        QSize size;
+        // top left of the part shown, relative to the row
+        QPoint clip;
+
+        bool operator==(const TileKey &other) const;
+    };
+
+    // paint_mid of one trace, in coordinates relative to rect
+    struct Tile
+    {
+        boost::shared_ptr<Trace> trace;
+        QRect rect;
+        TileKey key;
+        QImage image;
+    };
+
+    static void paint_tile(Tile *tile, const QFont &font);
+
 private:
 	View &_view;
     View_type _type;
     bool _need_update;
 
-    QPixmap *_pixmap;
+    std::map<Trace*, Tile> _tiles;
 
     uint64_t _sample_received;
     QPoint _mouse_point;
 	QPoint _mouse_down_point;
     int64_t _mouse_down_offset;
-    double _curScale;
-    int64_t _curOffset;
-    int _curSignalHeight;
-
-    //QPixmap pixmap;
 
     bool _measure_en;
     ActionType _action_type;
@@ -0,0 +1,305 @@
+/*
+ * This file is part of the DSView project.
+ * DSView is based on PulseView.
+ *
+ * Copyright (C) 2013 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+/*
+ * Times DecoderStack on synthetic captures, the whole way the
+ * application decodes them: native or Python decoders, segments on all
+ * cores, chunking, skips and the annotation rows. Usage:
+ *
+ *   DSView-bench [-n samples] [-w bit width] [-s decoders dir]
+ *
+ * The library side is timed by "make bench" of libsigrokdecode4DSL.
+ */
+
+#include <libsigrokdecode4DSL/libsigrokdecode.h>
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <getopt.h>
+
+#include <map>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+
+#include <pv/data/decoderstack.h>
+#include <pv/data/logicsnapshot.h>
+#include <pv/data/decode/decoder.h>
+
+#include "../data/logicwave.h"
+
+using boost::shared_ptr;
+using pv::data::DecoderStack;
+using pv::data::LogicSnapshot;
+using std::map;
+
+// defined by main.cpp in the application
+char DS_RES_PATH[256];
+
+namespace {
+
+const uint64_t SampleRate = 100000000;
+
+uint64_t bench_samples = 16 * 1024 * 1024;
+uint64_t bench_bit = 8;
+
+// the same data on every run
+uint8_t next_byte()
+{
+    static uint32_t seed = 1;
+    seed = seed * 1103515245 + 12345;
+    return seed >> 16;
+}
+
+// Each wave is frames of random data with the bus idle about as long
+// again in between, the decoders skip along the idle parts.
+void uart_wave(LogicWave &wave)
+{
+    wave.set(0, 1);
+    wave.hold(bench_bit * 16);
+    while (wave.samples() < bench_samples) {
+        for (int n = 0; n < 16; n++) {
+            const uint8_t byte = next_byte();
+            wave.set(0, 0);
+            wave.hold(bench_bit);
+            for (int i = 0; i < 8; i++) {
+                wave.set(0, (byte >> i) & 1);
+                wave.hold(bench_bit);
+            }
+            wave.set(0, 1);
+            wave.hold(bench_bit);
+        }
+        wave.hold(bench_bit * 160);
+    }
+}
+
+// mode 0, msb first, CS# active low: clk, miso, mosi, cs
+void spi_wave(LogicWave &wave)
+{
+    const uint64_t half = (bench_bit + 1) / 2;
+    wave.set(3, 1);
+    wave.hold(half * 8);
+    while (wave.samples() < bench_samples) {
+        wave.set(3, 0);
+        wave.hold(half * 2);
+        for (int n = 0; n < 16; n++) {
+            const uint8_t miso = next_byte();
+            const uint8_t mosi = next_byte();
+            for (int i = 7; i >= 0; i--) {
+                wave.set(1, (miso >> i) & 1);
+                wave.set(2, (mosi >> i) & 1);
+                wave.hold(half);
+                wave.set(0, 1);
+                wave.hold(half);
+                wave.set(0, 0);
+            }
+        }
+        wave.hold(half * 2);
+        wave.set(3, 1);
+        wave.hold(half * 16 * 16);
+    }
+}
+
+// scl, sda: writes of a few bytes to 0x50
+void i2c_wave(LogicWave &wave)
+{
+    const uint64_t half = (bench_bit + 1) / 2;
+    wave.set(0, 1);
+    wave.set(1, 1);
+    wave.hold(half * 8);
+    while (wave.samples() < bench_samples) {
+        wave.set(1, 0);
+        wave.hold(half);
+        wave.set(0, 0);
+        for (int n = 0; n < 8; n++) {
+            const uint8_t byte = n ? next_byte() : 0x50 << 1;
+            for (int i = 8; i >= 0; i--) {
+                wave.set(1, i ? (byte >> (i - 1)) & 1 : 0);
+                wave.hold(half);
+                wave.set(0, 1);
+                wave.hold(half);
+                wave.set(0, 0);
+            }
+        }
+        wave.set(1, 0);
+        wave.hold(half);
+        wave.set(0, 1);
+        wave.hold(half);
+        wave.set(1, 1);
+        wave.hold(half * 8 * 18);
+    }
+}
+
+struct BenchCase
+{
+    const char *id;
+    int channels;
+    void (*generate)(LogicWave &wave);
+    // the wave is at a baud rate of a bit every bench_bit samples
+    bool baudrate;
+};
+
+const BenchCase Cases[] = {
+    {"0:uart", 1, uart_wave, true},
+    {"1:uart", 1, uart_wave, true},
+    {"0:spi", 4, spi_wave, false},
+    {"1:spi", 4, spi_wave, false},
+    {"0:i2c", 2, i2c_wave, false},
+    {"1:i2c", 2, i2c_wave, false},
+};
+
+class DecodeWait
+{
+public:
+    DecodeWait() :
+        _done(false)
+    {
+    }
+
+    void done()
+    {
+        boost::lock_guard<boost::mutex> lock(_mutex);
+        _done = true;
+        _cond.notify_one();
+    }
+
+    // false if the stack gave up with an error instead
+    bool wait(DecoderStack &stack)
+    {
+        boost::unique_lock<boost::mutex> lock(_mutex);
+        while (!_done) {
+            _cond.timed_wait(lock, boost::posix_time::milliseconds(100));
+            if (!_done && (!stack.error_message().isEmpty() ||
+                           stack.out_of_memory()))
+                return false;
+        }
+        return true;
+    }
+
+private:
+    boost::mutex _mutex;
+    boost::condition_variable _cond;
+    bool _done;
+};
+
+bool run(const BenchCase &c)
+{
+    const srd_decoder *const decc = srd_decoder_get_by_id(c.id);
+    if (!decc) {
+        printf("%-8s not found\n", c.id);
+        return true;
+    }
+
+    LogicWave wave(c.channels);
+    c.generate(wave);
+    shared_ptr<LogicSnapshot> snapshot(new LogicSnapshot());
+    wave.fill(*snapshot);
+
+    // all channels of the decoder mapped in order
+    DecoderStack stack(decc);
+    const shared_ptr<pv::data::decode::Decoder> &dec = stack.stack().front();
+    map<const srd_channel*, int> probes;
+    int ch = 0;
+    for (const GSList *l = decc->channels; l; l = l->next)
+        probes[(const srd_channel*)l->data] = ch++;
+    for (const GSList *l = decc->opt_channels; l && ch < c.channels; l = l->next)
+        probes[(const srd_channel*)l->data] = ch++;
+    dec->set_probes(probes);
+    if (c.baudrate)
+        dec->set_option("baudrate", g_variant_new_int64(SampleRate / bench_bit));
+    dec->set_decode_region(0, UINT64_MAX);
+    dec->commit();
+
+    DecodeWait wait;
+    QObject::connect(&stack, &DecoderStack::decode_done,
+                     [&]() { wait.done(); });
+
+    QElapsedTimer timer;
+    timer.start();
+    stack.set_options_changed(true);
+    stack.begin_decode(snapshot, SampleRate);
+    if (!wait.wait(stack)) {
+        printf("%-8s failed: %s\n", c.id,
+               stack.error_message().toLocal8Bit().data());
+        return false;
+    }
+    const double secs = timer.nsecsElapsed() / 1e9;
+
+    uint64_t annotations = 0;
+    for (int row = 0; row < stack.list_rows_size(); row++)
+        annotations += stack.list_annotation_size(row);
+
+    const uint64_t samples = snapshot->get_sample_count();
+    printf("%-8s %12" PRIu64 " samples %8.3f s %10.2f Msamples/s "
+           "%10" PRIu64 " annotations %10.2f kann/s\n",
+           c.id, samples, secs, samples / secs / 1e6,
+           annotations, annotations / secs / 1e3);
+    return true;
+}
+
+} // anonymous namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    const char *decoders_dir = NULL;
+
+    int c;
+    while ((c = getopt(argc, argv, "n:w:s:")) != -1) {
+        switch (c) {
+        case 'n':
+            bench_samples = strtoull(optarg, NULL, 0);
+            break;
+        case 'w':
+            bench_bit = strtoull(optarg, NULL, 0);
+            break;
+        case 's':
+            decoders_dir = optarg;
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-n samples] [-w bit width] "
+                    "[-s decoders dir]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (bench_bit < 4) {
+        fprintf(stderr, "The bit width is at least 4 samples.\n");
+        return 1;
+    }
+
+    if (srd_init(decoders_dir) != SRD_OK) {
+        fprintf(stderr, "libsigrokdecode init failed.\n");
+        return 1;
+    }
+    srd_decoder_load_all();
+
+    bool ok = true;
+    for (size_t i = 0; i < sizeof(Cases) / sizeof(Cases[0]); i++)
+        ok = run(Cases[i]) && ok;
+
+    srd_exit();
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,88 @@
+/*
+ * This file is part of the DSView project.
+ * DSView is based on PulseView.
+ *
+ * Copyright (C) 2013 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <libsigrokdecode4DSL/libsigrokdecode.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <QDir>
+#include <QFile>
+#include <QTemporaryDir>
+
+#include <pv/data/decode/decoder.h>
+
+using pv::data::decode::Decoder;
+
+namespace {
+
+void write_file(const QString &path, const QByteArray &data)
+{
+    QFile file(path);
+    BOOST_REQUIRE(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+    BOOST_REQUIRE_EQUAL(file.write(data), data.size());
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(DecoderTest)
+
+// Saved decoder results are only taken while the digest of each decoder
+// of the stack is the one they were saved with, StoreSession decodes
+// the stack again as soon as it differs.
+BOOST_AUTO_TEST_CASE(DigestFollowsScripts)
+{
+    QTemporaryDir tmp;
+    BOOST_REQUIRE(tmp.isValid());
+    const QDir dir(tmp.path());
+    write_file(dir.filePath("__init__.py"), "from .pd import Decoder\n");
+    write_file(dir.filePath("pd.py"), "class Decoder:\n    id = 'test'\n");
+
+    const QByteArray key = Decoder::digest("test", tmp.path());
+    BOOST_REQUIRE(!key.isEmpty());
+    BOOST_CHECK(Decoder::digest("test", tmp.path()) == key);
+    BOOST_CHECK(Decoder::digest("other", tmp.path()) != key);
+
+    // an edit of the script
+    write_file(dir.filePath("pd.py"), "class Decoder:\n    id = 'test'\n\n");
+    const QByteArray edited = Decoder::digest("test", tmp.path());
+    BOOST_CHECK(edited != key);
+
+    // a new file next to it
+    write_file(dir.filePath("lists.py"), "");
+    BOOST_CHECK(Decoder::digest("test", tmp.path()) != edited);
+
+    BOOST_CHECK(Decoder::digest("test", dir.filePath("missing")).isEmpty());
+}
+
+BOOST_AUTO_TEST_CASE(DigestOfLoadedDecoders)
+{
+    const srd_decoder *const uart = srd_decoder_get_by_id("0:uart");
+    const srd_decoder *const spi = srd_decoder_get_by_id("0:spi");
+    BOOST_REQUIRE(uart);
+    BOOST_REQUIRE(spi);
+
+    const QByteArray uart_key = Decoder::digest(uart);
+    BOOST_CHECK(!uart_key.isEmpty());
+    BOOST_CHECK(Decoder::digest(uart) == uart_key);
+    BOOST_CHECK(Decoder::digest(spi) != uart_key);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,581 @@
+/*
+ * This file is part of the DSView project.
+ * DSView is based on PulseView.
+ *
+ * Copyright (C) 2013 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <libsigrokdecode4DSL/libsigrokdecode.h>
+
+#include <stdint.h>
+
+#include <boost/test/unit_test.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <pv/data/logicsnapshot.h>
+#include <pv/data/decode/annotation.h>
+#include <pv/data/decode/decoder.h>
+#include <pv/data/decode/nativedecoder.h>
+#include <pv/data/decode/waitcondition.h>
+
+#include "../logicwave.h"
+
+using pv::data::LogicSnapshot;
+using pv::data::decode::Annotation;
+using pv::data::decode::Decoder;
+using pv::data::decode::NativeDecoder;
+using pv::data::decode::WaitCondition;
+using std::map;
+using std::vector;
+
+namespace {
+
+const uint64_t SampleRate = 1000000;
+
+// an annotation with the decoder which put it
+typedef std::pair<const srd_decoder*, Annotation> Put;
+
+/**
+ * Feeds the bottom decoder of a stack the way DecoderStack::decode_range
+ * does: a chunk from the current position, then a jump to the sample
+ * its skip hints or logic.wait() terms ask for.
+ */
+class DecodeRun
+{
+public:
+    DecodeRun(LogicSnapshot &snapshot) :
+        _snapshot(snapshot),
+        _session(NULL)
+    {
+    }
+
+    virtual ~DecodeRun()
+    {
+        if (_session)
+            srd_session_destroy(_session);
+    }
+
+    void run(int num_channels, const int *channel_map)
+    {
+        const uint64_t end = _snapshot.get_sample_count() - 1;
+        WaitCondition condition;
+        uint8_t chunk_type = 0;
+        uint64_t i = 0;
+        while (i < end) {
+            vector<const uint8_t *> chunk;
+            vector<uint8_t> chunk_const;
+            uint64_t chunk_end = end;
+            for (int j = 0; j < num_channels; j++) {
+                if (channel_map[j] == -1) {
+                    chunk.push_back(NULL);
+                } else {
+                    chunk.push_back(_snapshot.get_samples(i, chunk_end, channel_map[j]));
+                    chunk_const.push_back(_snapshot.get_sample(i, channel_map[j]));
+                }
+            }
+            send(chunk_type, i, chunk_end, chunk.data(), chunk_const.data());
+
+            uint64_t cur_pos;
+            if (wait(condition, cur_pos) && cur_pos < end) {
+                uint64_t matched = 0;
+                if (!condition.find(_snapshot, cur_pos, end, cur_pos, matched))
+                    cur_pos = end;
+                set_matched(matched);
+                i = cur_pos;
+                chunk_type = 0;
+            } else {
+                i = chunk_end + 1;
+                chunk_type = 1;
+            }
+        }
+    }
+
+protected:
+    /**
+     * Start a session of the stack, the bottom decoder first, the way
+     * DecoderStack::decode_proc does, and return the bottom instance.
+     */
+    srd_decoder_inst* start_session(const vector<const Decoder*> &stack)
+    {
+        srd_session_new(&_session);
+        srd_decoder_inst *bottom = NULL;
+        srd_decoder_inst *prev_di = NULL;
+        for (size_t k = 0; k < stack.size(); k++) {
+            srd_decoder_inst *const di = stack[k]->create_decoder_inst(_session);
+            BOOST_REQUIRE(di);
+            if (prev_di)
+                srd_inst_stack(_session, prev_di, di);
+            else
+                bottom = di;
+            prev_di = di;
+        }
+        srd_session_metadata_set(_session, SRD_CONF_SAMPLERATE,
+                                 g_variant_new_uint64(SampleRate));
+        srd_pd_output_callback_add(_session, SRD_OUTPUT_ANN,
+                                   annotation_callback, &annotations);
+
+        char *error = NULL;
+        BOOST_REQUIRE(srd_session_start(_session, &error) == SRD_OK);
+        return bottom;
+    }
+
+    virtual void send(uint8_t chunk_type, uint64_t start, uint64_t end,
+                      const uint8_t **inbuf, const uint8_t *inbuf_const) = 0;
+    virtual bool wait(WaitCondition &condition, uint64_t &cur_pos) = 0;
+    virtual void set_matched(uint64_t matched)
+    {
+        (void)matched;
+    }
+
+private:
+    static void annotation_callback(srd_proto_data *pdata, void *cb_data)
+    {
+        ((vector<Put> *)cb_data)->push_back(
+            Put(pdata->pdo->di->decoder, Annotation(pdata)));
+    }
+
+public:
+    vector<Put> annotations;
+
+protected:
+    LogicSnapshot &_snapshot;
+    srd_session *_session;
+};
+
+class NativeRun : public DecodeRun
+{
+public:
+    NativeRun(LogicSnapshot &snapshot, NativeDecoder &native,
+              const vector<const Decoder*> &stack) :
+        DecodeRun(snapshot),
+        _native(native)
+    {
+        _native.set_callback(annotation_callback, &annotations);
+        // the Python instance of the bottom decoder only passes its
+        // output on to the ones stacked on it
+        if (stack.size() > 1)
+            _native.set_instance(start_session(stack));
+        run(_native.num_channels(), _native.channel_map());
+    }
+
+private:
+    void send(uint8_t chunk_type, uint64_t start, uint64_t end,
+              const uint8_t **inbuf, const uint8_t *inbuf_const)
+    {
+        _native.decode(chunk_type, start, end, inbuf, inbuf_const);
+    }
+
+    bool wait(WaitCondition &condition, uint64_t &cur_pos)
+    {
+        if (_native.logic_mask() == 0)
+            return false;
+        condition.set_hints(_native.logic_mask(), _native.exp_logic(),
+                            _native.edge_index(), _native.channel_map(),
+                            _native.num_channels());
+        cur_pos = _native.cur_pos();
+        return true;
+    }
+
+    static void annotation_callback(const srd_decoder *decc,
+                                    const Annotation &a, void *cb_data)
+    {
+        ((vector<Put> *)cb_data)->push_back(Put(decc, a));
+    }
+
+private:
+    NativeDecoder &_native;
+};
+
+class PythonRun : public DecodeRun
+{
+public:
+    PythonRun(LogicSnapshot &snapshot, const vector<const Decoder*> &stack) :
+        DecodeRun(snapshot)
+    {
+        _di = start_session(stack);
+        run(_di->dec_num_channels, _di->dec_channelmap);
+    }
+
+private:
+    void send(uint8_t chunk_type, uint64_t start, uint64_t end,
+              const uint8_t **inbuf, const uint8_t *inbuf_const)
+    {
+        char *error = NULL;
+        BOOST_REQUIRE(srd_session_send(_session, chunk_type, start, end,
+                                       inbuf, inbuf_const, &error) == SRD_OK);
+    }
+
+    bool wait(WaitCondition &condition, uint64_t &cur_pos)
+    {
+        if (_di->wait_terms->len != 0)
+            condition.set_terms((const srd_wait_term *)_di->wait_terms->data,
+                                _di->wait_terms->len, _di->dec_channelmap,
+                                _di->dec_num_channels);
+        else if (_di->logic_mask != 0)
+            condition.set_hints(_di->logic_mask, _di->exp_logic, _di->edge_index,
+                                _di->dec_channelmap, _di->dec_num_channels);
+        else
+            return false;
+        cur_pos = _di->cur_pos;
+        return true;
+    }
+
+    void set_matched(uint64_t matched)
+    {
+        _di->wait_matched = matched;
+    }
+
+private:
+    srd_decoder_inst *_di;
+};
+
+// the Python interpreter is started once for the whole run
+struct DecoderFixture
+{
+    DecoderFixture()
+    {
+        BOOST_REQUIRE(srd_init(DECODERS_DIR) == SRD_OK);
+        srd_decoder_load_all();
+    }
+
+    ~DecoderFixture()
+    {
+        srd_exit();
+    }
+};
+
+// map all channels of the decoder in order and decode the whole wave
+void configure(Decoder &dec, const LogicWave &wave,
+               const map<const char*, GVariant*> &options =
+                     map<const char*, GVariant*>())
+{
+    const srd_decoder *const decc = dec.decoder();
+    map<const srd_channel*, int> probes;
+    int ch = 0;
+    for (const GSList *l = decc->channels; l; l = l->next)
+        probes[(const srd_channel*)l->data] = ch++;
+    for (const GSList *l = decc->opt_channels; l; l = l->next)
+        probes[(const srd_channel*)l->data] = ch++;
+    BOOST_REQUIRE_EQUAL(ch, wave.channels());
+    dec.set_probes(probes);
+    for (map<const char*, GVariant*>::const_iterator i = options.begin();
+         i != options.end(); i++)
+        dec.set_option((*i).first, (*i).second);
+    dec.set_decode_region(0, UINT64_MAX);
+    dec.commit();
+}
+
+void check_same(const vector<Put> &n, const vector<Put> &p)
+{
+    BOOST_REQUIRE_EQUAL(n.size(), p.size());
+    for (size_t i = 0; i < n.size(); i++) {
+        BOOST_CHECK(n[i].first == p[i].first);
+        BOOST_CHECK_EQUAL(n[i].second.start_sample(), p[i].second.start_sample());
+        BOOST_CHECK_EQUAL(n[i].second.end_sample(), p[i].second.end_sample());
+        BOOST_CHECK_EQUAL(n[i].second.format(), p[i].second.format());
+        BOOST_CHECK_EQUAL(n[i].second.type(), p[i].second.type());
+        BOOST_CHECK(n[i].second.annotations() == p[i].second.annotations());
+    }
+}
+
+/**
+ * Decode the wave with the native port and with the Python decoder,
+ * all channels mapped in order, and check the annotations match. With
+ * a stacked_id the decoder of that id is stacked on the bottom one, fed
+ * by the Python output of either, and its annotations are checked too.
+ */
+void check_parity(const char *id, const LogicWave &wave,
+                  const map<const char*, GVariant*> &options =
+                        map<const char*, GVariant*>(),
+                  const char *stacked_id = NULL)
+{
+    const srd_decoder *const decc = srd_decoder_get_by_id(id);
+    BOOST_REQUIRE(decc);
+
+    Decoder dec(decc);
+    configure(dec, wave, options);
+
+    vector<const Decoder*> stack(1, &dec);
+    std::unique_ptr<Decoder> stacked;
+    if (stacked_id) {
+        const srd_decoder *const stacked_decc = srd_decoder_get_by_id(stacked_id);
+        BOOST_REQUIRE(stacked_decc);
+        stacked.reset(new Decoder(stacked_decc));
+        stacked->set_decode_region(0, UINT64_MAX);
+        stacked->commit();
+        stack.push_back(stacked.get());
+    }
+
+    LogicSnapshot snapshot;
+    wave.fill(snapshot);
+
+    NativeDecoder *const native = NativeDecoder::create(dec, SampleRate);
+    BOOST_REQUIRE(native);
+    const NativeRun native_run(snapshot, *native, stack);
+    delete native;
+    const PythonRun python_run(snapshot, stack);
+
+    const vector<Put> &n = native_run.annotations;
+    const vector<Put> &p = python_run.annotations;
+    BOOST_CHECK(!p.empty());
+    if (stacked_id)
+        BOOST_CHECK(std::find_if(p.begin(), p.end(), [&](const Put &put) {
+            return put.first == stacked->decoder(); }) != p.end());
+    check_same(n, p);
+}
+
+void uart_byte(LogicWave &wave, uint8_t byte, uint64_t bit)
+{
+    wave.set(0, 0);
+    wave.hold(bit);
+    for (int i = 0; i < 8; i++) {
+        wave.set(0, (byte >> i) & 1);
+        wave.hold(bit);
+    }
+    wave.set(0, 1);
+    wave.hold(bit * 3);
+}
+
+// mode 0, msb first, CS# active low: clk, miso, mosi, cs
+void spi_transfer(LogicWave &wave, const vector<uint8_t> &miso,
+                  const vector<uint8_t> &mosi, uint64_t half)
+{
+    wave.set(3, 0);
+    wave.hold(half * 2);
+    for (size_t n = 0; n < miso.size(); n++) {
+        for (int i = 7; i >= 0; i--) {
+            wave.set(1, (miso[n] >> i) & 1);
+            wave.set(2, (mosi[n] >> i) & 1);
+            wave.hold(half);
+            wave.set(0, 1);
+            wave.hold(half);
+            wave.set(0, 0);
+        }
+    }
+    wave.hold(half * 2);
+    wave.set(3, 1);
+    wave.hold(half * 8);
+}
+
+// scl, sda; a byte followed by the ack bit
+void i2c_byte(LogicWave &wave, uint8_t byte, bool ack, uint64_t half)
+{
+    for (int i = 8; i >= 0; i--) {
+        wave.set(1, (i == 0) ? !ack : ((byte >> (i - 1)) & 1));
+        wave.hold(half);
+        wave.set(0, 1);
+        wave.hold(half);
+        wave.set(0, 0);
+    }
+}
+
+void i2c_start(LogicWave &wave, uint64_t half)
+{
+    wave.set(1, 1);
+    wave.hold(half);
+    wave.set(0, 1);
+    wave.hold(half);
+    wave.set(1, 0);
+    wave.hold(half);
+    wave.set(0, 0);
+}
+
+void i2c_stop(LogicWave &wave, uint64_t half)
+{
+    wave.set(1, 0);
+    wave.hold(half);
+    wave.set(0, 1);
+    wave.hold(half);
+    wave.set(1, 1);
+    wave.hold(half * 4);
+}
+
+} // anonymous namespace
+
+BOOST_GLOBAL_FIXTURE(DecoderFixture);
+
+BOOST_AUTO_TEST_SUITE(NativeDecoderTest)
+
+BOOST_AUTO_TEST_CASE(Uart)
+{
+    // 9600 baud at 1 MHz, a bit is 104.17 samples
+    const uint64_t bit = SampleRate / 9600;
+    const char text[] = "Hello, DSView!\r\n\x01\xff";
+
+    LogicWave wave(1);
+    wave.set(0, 1);
+    wave.hold(1000);
+    for (const char *c = text; *c; c++)
+        uart_byte(wave, *c, bit);
+    // a frame running on without idle time
+    for (int i = 0; i < 4; i++) {
+        wave.set(0, 0);
+        wave.hold(bit);
+        wave.set(0, 1);
+        wave.hold(bit * 9);
+    }
+    // a break, with a low stop bit
+    wave.set(0, 0);
+    wave.hold(bit * 12);
+    wave.set(0, 1);
+    wave.hold(1000);
+
+    check_parity("0:uart", wave);
+    check_parity("1:uart", wave);
+
+    map<const char*, GVariant*> options;
+    options["format"] = g_variant_new_string("hex");
+    options["parity_type"] = g_variant_new_string("even");
+    check_parity("0:uart", wave, options);
+    check_parity("1:uart", wave, options);
+}
+
+BOOST_AUTO_TEST_CASE(Spi)
+{
+    LogicWave wave(4);
+    wave.set(3, 1);
+    wave.hold(100);
+    for (int n = 0; n < 8; n++) {
+        vector<uint8_t> miso, mosi;
+        for (int i = 0; i <= n; i++) {
+            miso.push_back(0xa5 ^ (i * 17 + n));
+            mosi.push_back(0x3c + i * 29 + n);
+        }
+        spi_transfer(wave, miso, mosi, 5 + n);
+    }
+
+    check_parity("0:spi", wave);
+    check_parity("1:spi", wave);
+
+    map<const char*, GVariant*> options;
+    options["wordsize"] = g_variant_new_int64(4);
+    check_parity("0:spi", wave, options);
+    check_parity("1:spi", wave, options);
+}
+
+BOOST_AUTO_TEST_CASE(StackedSpiFlash)
+{
+    LogicWave wave(4);
+    wave.set(3, 1);
+    wave.hold(100);
+
+    // WREN, RDID and a READ of four bytes from 0x001000
+    const uint8_t wren[] = {0x06};
+    const uint8_t rdid_mosi[] = {0x9f, 0x00, 0x00, 0x00};
+    const uint8_t rdid_miso[] = {0xff, 0xc2, 0x20, 0x16};
+    const uint8_t read_mosi[] = {0x03, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00};
+    const uint8_t read_miso[] = {0xff, 0xff, 0xff, 0xff, 0xde, 0xad, 0xbe, 0xef};
+    spi_transfer(wave, vector<uint8_t>(1, 0xff),
+                 vector<uint8_t>(wren, wren + 1), 5);
+    spi_transfer(wave, vector<uint8_t>(rdid_miso, rdid_miso + 4),
+                 vector<uint8_t>(rdid_mosi, rdid_mosi + 4), 5);
+    spi_transfer(wave, vector<uint8_t>(read_miso, read_miso + 8),
+                 vector<uint8_t>(read_mosi, read_mosi + 8), 5);
+
+    check_parity("1:spi", wave, map<const char*, GVariant*>(), "spiflash");
+}
+
+BOOST_AUTO_TEST_CASE(I2c)
+{
+    const uint64_t half = 5;
+
+    LogicWave wave(2);
+    wave.set(0, 1);
+    wave.set(1, 1);
+    wave.hold(100);
+
+    // write two bytes to 0x50, then read one back with a repeated start
+    i2c_start(wave, half);
+    i2c_byte(wave, 0x50 << 1, true, half);
+    i2c_byte(wave, 0x12, true, half);
+    i2c_byte(wave, 0x34, true, half);
+    i2c_start(wave, half);
+    i2c_byte(wave, (0x50 << 1) | 1, true, half);
+    i2c_byte(wave, 0xa7, false, half);
+    i2c_stop(wave, half);
+
+    // a transfer nobody acknowledges
+    i2c_start(wave, half);
+    i2c_byte(wave, 0x21 << 1, false, half);
+    i2c_stop(wave, half);
+    wave.hold(100);
+
+    check_parity("0:i2c", wave);
+    check_parity("1:i2c", wave);
+
+    map<const char*, GVariant*> options;
+    options["address_format"] = g_variant_new_string("unshifted");
+    check_parity("0:i2c", wave, options);
+    check_parity("1:i2c", wave, options);
+}
+
+// Python stacks on threads of their own, as DecoderStack runs them
+BOOST_AUTO_TEST_CASE(ConcurrentPythonStacks)
+{
+    const uint64_t bit = SampleRate / 9600;
+    LogicWave uart_wave(1);
+    uart_wave.set(0, 1);
+    uart_wave.hold(1000);
+    for (int i = 0; i < 64; i++)
+        uart_byte(uart_wave, 'A' + i % 26, bit);
+    uart_wave.hold(1000);
+
+    LogicWave spi_wave(4);
+    spi_wave.set(3, 1);
+    spi_wave.hold(100);
+    for (int n = 0; n < 64; n++)
+        spi_transfer(spi_wave, vector<uint8_t>(4, n),
+                     vector<uint8_t>(4, 0xff - n), 5);
+
+    const srd_decoder *const uart_decc = srd_decoder_get_by_id("1:uart");
+    const srd_decoder *const spi_decc = srd_decoder_get_by_id("1:spi");
+    BOOST_REQUIRE(uart_decc && spi_decc);
+    Decoder uart_dec(uart_decc), spi_dec(spi_decc);
+    configure(uart_dec, uart_wave);
+    configure(spi_dec, spi_wave);
+    const vector<const Decoder*> uart_stack(1, &uart_dec);
+    const vector<const Decoder*> spi_stack(1, &spi_dec);
+
+    LogicSnapshot uart_snapshot, spi_snapshot;
+    uart_wave.fill(uart_snapshot);
+    spi_wave.fill(spi_snapshot);
+
+    const PythonRun uart_serial(uart_snapshot, uart_stack);
+    const PythonRun spi_serial(spi_snapshot, spi_stack);
+
+    std::unique_ptr<PythonRun> uart_run, spi_run;
+    boost::thread uart_thread([&]() {
+        uart_run.reset(new PythonRun(uart_snapshot, uart_stack)); });
+    boost::thread spi_thread([&]() {
+        spi_run.reset(new PythonRun(spi_snapshot, spi_stack)); });
+    uart_thread.join();
+    spi_thread.join();
+
+    BOOST_REQUIRE(uart_run && spi_run);
+    BOOST_CHECK(!uart_serial.annotations.empty());
+    BOOST_CHECK(!spi_serial.annotations.empty());
+    check_same(uart_serial.annotations, uart_run->annotations);
+    check_same(spi_serial.annotations, spi_run->annotations);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,103 @@
+/*
+ * This file is part of the DSView project.
+ * DSView is based on PulseView.
+ *
+ * Copyright (C) 2013 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <stdint.h>
+
+#include <algorithm>
+
+#include <boost/test/unit_test.hpp>
+
+#include <pv/data/logicsnapshot.h>
+
+#include "logicwave.h"
+
+using pv::data::LogicSnapshot;
+using std::min;
+
+namespace {
+
+// LogicSnapshot::LeafBlockSamples
+const uint64_t LeafSamples = 1 << 24;
+const uint64_t Period = 1000;
+
+bool clock_level(uint64_t index)
+{
+    return (index / Period) % 2 != 0;
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(LogicSnapshotTest)
+
+// A live decode has to see the leaf block which is still being filled
+BOOST_AUTO_TEST_CASE(LiveIndex)
+{
+    const uint64_t Payload = 1024 * 1024 - 64 * 7;
+
+    // a clock on channel 0, channel 1 high all along
+    LogicWave wave(2);
+    wave.set(1, true);
+    for (uint64_t i = 0; i < LeafSamples * 3 / 2; i += Period) {
+        wave.set(0, clock_level(i));
+        wave.hold(Period);
+    }
+    const uint64_t samples = (wave.samples() + 63) & ~63ULL;
+
+    LogicSnapshot snapshot;
+    for (uint64_t fed = Payload; ; fed += Payload) {
+        wave.feed(snapshot, fed);
+        const uint64_t indexed = snapshot.get_indexed_sample_count();
+        BOOST_REQUIRE_EQUAL(indexed, snapshot.get_sample_count());
+
+        // past the wave the padding holds the last levels
+        const uint64_t last = min(indexed, wave.samples()) - 1;
+        BOOST_CHECK_EQUAL(snapshot.get_sample(last, 0), clock_level(last));
+        BOOST_CHECK(snapshot.get_sample(last, 1));
+
+        // the last edge before the end of the data
+        uint64_t index = last - last % Period - 1;
+        BOOST_REQUIRE(snapshot.get_nxt_edge(index, clock_level(index),
+                                            last, 1, 0));
+        BOOST_CHECK_EQUAL(index, last - last % Period);
+
+        // none of it while the constant leaf may still be trimmed,
+        // channel 1 only rises at the start of the first one
+        if (last >= LeafSamples) {
+            uint64_t end = last;
+            BOOST_CHECK(snapshot.get_samples(last, end, 1) == NULL);
+        }
+        index = last - Payload + 1;
+        BOOST_CHECK(!snapshot.get_nxt_edge(index, true, last, 1, 1));
+
+        if (indexed >= samples)
+            break;
+    }
+
+    snapshot.capture_ended();
+    BOOST_CHECK_EQUAL(snapshot.get_indexed_sample_count(), samples);
+    uint64_t index = LeafSamples - 1;
+    BOOST_REQUIRE(snapshot.get_nxt_edge(index, clock_level(index),
+                                        samples - 1, 1, 0));
+    BOOST_CHECK_EQUAL(index, (LeafSamples / Period + 1) * Period);
+    BOOST_CHECK(snapshot.get_sample(samples - 1, 1));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
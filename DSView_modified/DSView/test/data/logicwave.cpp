@@ -0,0 +1,112 @@
+/*
+ * This file is part of the DSView project.
+ * DSView is based on PulseView.
+ *
+ * Copyright (C) 2013 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "logicwave.h"
+
+#include <assert.h>
+
+#include <algorithm>
+
+#include <pv/data/logicsnapshot.h>
+
+using pv::data::LogicSnapshot;
+using std::min;
+using std::vector;
+
+LogicWave::LogicWave(int channels) :
+    _channels(channels),
+    _levels(0)
+{
+    assert(channels > 0 && channels <= 8);
+}
+
+int LogicWave::channels() const
+{
+    return _channels;
+}
+
+uint64_t LogicWave::samples() const
+{
+    return _samples.size();
+}
+
+void LogicWave::set(int ch, bool level)
+{
+    assert(ch < _channels);
+    if (level)
+        _levels |= 1 << ch;
+    else
+        _levels &= ~(1 << ch);
+}
+
+void LogicWave::hold(uint64_t samples)
+{
+    _samples.insert(_samples.end(), samples, _levels);
+}
+
+void LogicWave::fill(LogicSnapshot &snapshot) const
+{
+    snapshot.init();
+    feed(snapshot, _samples.size());
+    snapshot.capture_ended();
+}
+
+void LogicWave::feed(LogicSnapshot &snapshot, uint64_t end) const
+{
+    const uint64_t total = (_samples.size() + 63) & ~63ULL;
+    const uint64_t start = snapshot.get_sample_count();
+    end = min((end + 63) & ~(uint64_t)63, total);
+    assert(start % 64 == 0 && start < end);
+
+    // one 64 bit word per channel for each 64 samples
+    vector<uint64_t> data((end - start) / 64 * _channels, 0);
+    for (uint64_t i = start; i < end; i++) {
+        const uint8_t levels = (i < _samples.size()) ? _samples[i] : _levels;
+        for (int ch = 0; ch < _channels; ch++)
+            if (levels & (1 << ch))
+                data[(i - start) / 64 * _channels + ch] |= 1ULL << (i % 64);
+    }
+
+    sr_datafeed_logic logic = sr_datafeed_logic();
+    logic.format = LA_CROSS_DATA;
+    logic.unitsize = 1;
+    logic.length = data.size() * sizeof(uint64_t);
+    logic.data = data.data();
+
+    if (start != 0) {
+        snapshot.append_payload(logic);
+        return;
+    }
+
+    vector<sr_channel> probes(_channels);
+    GSList *channels = NULL;
+    for (int ch = 0; ch < _channels; ch++) {
+        probes[ch] = sr_channel();
+        probes[ch].index = ch;
+        probes[ch].type = SR_CHANNEL_LOGIC;
+        probes[ch].enabled = TRUE;
+        channels = g_slist_append(channels, &probes[ch]);
+    }
+
+    snapshot.init();
+    snapshot.first_payload(logic, total, channels);
+    g_slist_free(channels);
+}
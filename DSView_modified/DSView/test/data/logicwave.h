@@ -0,0 +1,70 @@
+/*
+ * This file is part of the DSView project.
+ * DSView is based on PulseView.
+ *
+ * Copyright (C) 2013 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef DSVIEW_TEST_DATA_LOGICWAVE_H
+#define DSVIEW_TEST_DATA_LOGICWAVE_H
+
+#include <stdint.h>
+
+#include <vector>
+
+namespace pv {
+namespace data {
+class LogicSnapshot;
+}
+}
+
+/**
+ * Levels of a few logic channels over time, to be loaded into a
+ * LogicSnapshot the way a capture fills it.
+ */
+class LogicWave
+{
+public:
+    LogicWave(int channels);
+
+    int channels() const;
+    uint64_t samples() const;
+
+    void set(int ch, bool level);
+    // keep the current levels for a number of samples
+    void hold(uint64_t samples);
+
+    /**
+     * Fill the snapshot with the wave as one LA_CROSS_DATA payload,
+     * padded with the last levels up to a multiple of 64 samples.
+     */
+    void fill(pv::data::LogicSnapshot &snapshot) const;
+
+    /**
+     * Append the wave up to end to a running capture, padded the same
+     * way, or start the capture if the snapshot is empty.
+     */
+    void feed(pv::data::LogicSnapshot &snapshot, uint64_t end) const;
+
+private:
+    const int _channels;
+    uint8_t _levels;
+    // one byte of channel levels per sample
+    std::vector<uint8_t> _samples;
+};
+
+#endif // DSVIEW_TEST_DATA_LOGICWAVE_H
@@ -0,0 +1,177 @@
+/*
+ * This file is part of the DSView project.
+ * DSView is based on PulseView.
+ *
+ * Copyright (C) 2013 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <map>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+#include <QTemporaryFile>
+
+#include <libsigrok4DSL/libsigrok.h>
+
+#include <pv/data/dsosnapshot.h>
+#include <pv/data/signaturematch.h>
+
+using pv::data::DsoSnapshot;
+using pv::data::SignatureMatch;
+using std::vector;
+
+namespace {
+
+const int ChannelNum = 2;
+const uint64_t Samples = 20000;
+const uint64_t RefStart = 12345;
+const uint64_t RefLength = 2000;
+
+// a bounded random walk on channel 0, so the shape outlives the
+// decimation of the coarse search; channel 1 flat
+vector<uint8_t> make_frame()
+{
+    vector<uint8_t> frame(Samples * ChannelNum);
+    uint32_t seed = 1;
+    int v = 0;
+    for (uint64_t i = 0; i < Samples; i++) {
+        seed = seed * 1103515245 + 12345;
+        v += (int)((seed >> 16) % 21) - 10;
+        v = std::min(std::max(v, -100), 100);
+        frame[i * ChannelNum] = 128 + v;
+        frame[i * ChannelNum + 1] = 128;
+    }
+    return frame;
+}
+
+const sr_output_module *csv_module()
+{
+    for (const sr_output_module **m = sr_output_list(); *m; m++)
+        if (!strcmp((*m)->id, "csv"))
+            return *m;
+    return NULL;
+}
+
+// The samples RefStart to RefStart + RefLength of the frame, as the
+// CPA export writes them.
+bool export_csv(const vector<uint8_t> &frame, QFile &file)
+{
+    const sr_output_module *const module = csv_module();
+    if (!module)
+        return false;
+
+    sr_channel channels[ChannelNum];
+    char names[ChannelNum][2] = {"0", "1"};
+    GSList *list = NULL;
+    memset(channels, 0, sizeof(channels));
+    for (int i = 0; i < ChannelNum; i++) {
+        channels[i].index = i;
+        channels[i].type = SR_CHANNEL_DSO;
+        channels[i].enabled = TRUE;
+        channels[i].name = names[i];
+        channels[i].vdiv = 1000;
+        channels[i].vfactor = 1;
+        channels[i].vpos = 0.5;
+        list = g_slist_append(list, &channels[i]);
+    }
+    sr_dev_inst sdi;
+    memset(&sdi, 0, sizeof(sdi));
+    sdi.mode = DSO;
+    sdi.channels = list;
+
+    GHashTable *params = g_hash_table_new(g_str_hash, g_str_equal);
+    g_hash_table_insert(params, (char*)"type",
+                        g_variant_ref_sink(g_variant_new_int16(SR_CHANNEL_DSO)));
+    sr_output output;
+    memset(&output, 0, sizeof(output));
+    output.module = module;
+    output.sdi = &sdi;
+    bool ok = module->init(&output, params) == SR_OK;
+
+    if (ok) {
+        sr_datafeed_dso dso;
+        memset(&dso, 0, sizeof(dso));
+        dso.num_samples = RefLength;
+        dso.data = (void*)&frame[RefStart * ChannelNum];
+        sr_datafeed_packet p;
+        p.type = SR_DF_DSO;
+        p.status = SR_PKT_OK;
+        p.payload = &dso;
+        GString *out = NULL;
+        ok = module->receive(&output, &p, &out) == SR_OK && out;
+        if (out) {
+            ok = ok && file.write(out->str, out->len) == (qint64)out->len;
+            g_string_free(out, TRUE);
+        }
+    }
+
+    if (module->cleanup)
+        module->cleanup(&output);
+    g_variant_unref((GVariant*)g_hash_table_lookup(params, "type"));
+    g_hash_table_destroy(params);
+    g_slist_free(list);
+    return ok && file.flush();
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(SignatureMatchTest)
+
+// A trimmed export of the capture is found where it was cut from
+BOOST_AUTO_TEST_CASE(ExportedReference)
+{
+    vector<uint8_t> frame = make_frame();
+
+    DsoSnapshot snapshot;
+    std::map<int, bool> ch_enable;
+    for (int i = 0; i < ChannelNum; i++)
+        ch_enable[i] = true;
+    sr_datafeed_dso dso;
+    memset(&dso, 0, sizeof(dso));
+    dso.num_samples = Samples;
+    dso.data = frame.data();
+    snapshot.first_payload(dso, Samples, ch_enable, true);
+    BOOST_REQUIRE_EQUAL(snapshot.get_sample_count(), Samples);
+
+    QTemporaryFile file;
+    BOOST_REQUIRE(file.open());
+    BOOST_REQUIRE(export_csv(frame, file));
+
+    SignatureMatch signature;
+    signature.set_threshold(0.8);
+    signature.set_decimation(4);
+    BOOST_REQUIRE(signature.load(file.fileName()));
+    BOOST_REQUIRE_EQUAL(signature.length(), (int)RefLength);
+
+    const SignatureMatch::Result result = signature.match(snapshot, 0);
+    BOOST_CHECK(result.checked);
+    BOOST_CHECK(result.qualified);
+    BOOST_CHECK_EQUAL(result.offset, RefStart);
+    BOOST_CHECK_GT(result.score, 0.99);
+
+    // the flat channel has nothing to correlate with
+    const SignatureMatch::Result flat = signature.match(snapshot, 1);
+    BOOST_CHECK(flat.checked);
+    BOOST_CHECK(!flat.qualified);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
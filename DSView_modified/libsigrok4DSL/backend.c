@@ -394,6 +394,8 @@ SR_API int sr_exit(struct sr_context *ctx)
 
 #ifdef HAVE_LIBUSB_1_0
 	libusb_exit(ctx->libusb_ctx);
+	g_slist_free_full(ctx->usb_sources, g_free);
+	g_free(ctx->usb_dispatcher);
 #endif
 
 	g_free(ctx);
@@ -38,6 +38,7 @@ static const char *opmodes[] = {
 
 static const int32_t hwoptions[] = {
     SR_CONF_OPERATION_MODE,
+    SR_CONF_REARM,
 };
 
 static const int32_t sessions_dso[] = {
@@ -49,6 +50,7 @@ static const int32_t sessions_dso[] = {
     SR_CONF_HORIZ_TRIGGERPOS,
     SR_CONF_TRIGGER_HOLDOFF,
     SR_CONF_TRIGGER_MARGIN,
+    SR_CONF_REARM,
 };
 
 static const int32_t sessions_daq[] = {
@@ -126,6 +128,20 @@ static struct DSL_context *DSCope_dev_new(const struct DSL_profile *prof)
     devc->trigger_margin = 8;
     devc->trigger_channel = 0;
     devc->rle_mode = FALSE;
+    devc->feed_thread = NULL;
+    devc->record = NULL;
+    devc->replay = NULL;
+    devc->rearm = FALSE;
+    devc->spare_size = 0;
+    devc->spare_trigger = NULL;
+    devc->spare_transfers = NULL;
+    devc->spare_bufs = NULL;
+    devc->armed = FALSE;
+    devc->armed_setting = NULL;
+    devc->arm_kept = FALSE;
+    devc->hpos_cmd = 0;
+    devc->buffer_time = DSL_BUFFER_TIME;
+    devc->total_time = DSL_TOTAL_BUFFER_TIME;
 
     dsl_adjust_samplerate(devc);
 	return devc;
@@ -412,6 +428,10 @@ static int dso_init(const struct sr_dev_inst *sdi)
 {
     int ret;
     GSList *l;
+    struct DSL_context *devc = sdi->priv;
+
+    /* everything is written again, the next capture arms the FPGA too */
+    devc->armed = FALSE;
 
     for(l = sdi->channels; l; l = l->next) {
         struct sr_channel *probe = (struct sr_channel *)l->data;
@@ -437,7 +457,8 @@ static int dso_init(const struct sr_dev_inst *sdi)
         sr_err("Set Sample Rate command failed!");
         return ret;
     }
-    ret = dsl_wr_dso(sdi, dso_cmd_gen(sdi, NULL, SR_CONF_HORIZ_TRIGGERPOS));
+    devc->hpos_cmd = dso_cmd_gen(sdi, NULL, SR_CONF_HORIZ_TRIGGERPOS);
+    ret = dsl_wr_dso(sdi, devc->hpos_cmd);
     if (ret != SR_OK) {
         sr_err("Set Horiz Trigger Position command failed!");
         return ret;
@@ -738,12 +759,15 @@ static int config_set(int id, GVariant *data, struct sr_dev_inst *sdi,
              * because the samplelimits may changed
              */
             devc->trigger_hpos = devc->trigger_hrate * dsl_en_ch_num(sdi) * devc->limit_samples / 200.0;
-            if ((ret = dsl_wr_dso(sdi, dso_cmd_gen(sdi, NULL, SR_CONF_HORIZ_TRIGGERPOS))) == SR_OK)
+            devc->hpos_cmd = dso_cmd_gen(sdi, NULL, SR_CONF_HORIZ_TRIGGERPOS);
+            if ((ret = dsl_wr_dso(sdi, devc->hpos_cmd)) == SR_OK) {
                 sr_dbg("%s: setting DSO Horiz Trigger Position to %d",
                     __func__, devc->trigger_hpos);
-            else
+            } else {
                 sr_dbg("%s: setting DSO Horiz Trigger Position to %d failed",
                     __func__, devc->trigger_hpos);
+                devc->hpos_cmd = 0;
+            }
         } else {
             devc->trigger_hpos = g_variant_get_byte(data) * devc->limit_samples / 100.0;
         }
@@ -774,6 +798,9 @@ static int config_set(int id, GVariant *data, struct sr_dev_inst *sdi,
         if(sdi->mode == DSO) {
             ret = dsl_wr_dso(sdi, dso_cmd_gen(sdi, 0, SR_CONF_SAMPLERATE));
         }
+    } else if (id == SR_CONF_REARM) {
+        devc->rearm = g_variant_get_boolean(data);
+        sr_dbg("%s: setting Rapid Re-arm to %d", __func__, devc->rearm);
     } else if (id == SR_CONF_INSTANT) {
         devc->instant = g_variant_get_boolean(data);
         if (sdi->mode == DSO && dsl_en_ch_num(sdi) != 0) {
@@ -1324,16 +1351,6 @@ static int cleanup(void)
 	return ret;
 }
 
-static void remove_sources(struct DSL_context *devc)
-{
-    int i;
-    sr_info("%s: remove fds from polling", __func__);
-    /* Remove fds from polling. */
-    for (i = 0; devc->usbfd[i] != -1; i++)
-        sr_source_remove(devc->usbfd[i]);
-    g_free(devc->usbfd);
-}
-
 static int receive_data(int fd, int revents, const struct sr_dev_inst *sdi)
 {
     int completed = 0;
@@ -1355,7 +1372,8 @@ static int receive_data(int fd, int revents, const struct sr_dev_inst *sdi)
     }
 
     if (devc->status == DSL_FINISH) {
-        remove_sources(devc);
+        sr_info("%s: remove fds from polling", __func__);
+        usb_source_remove(drvc->sr_ctx, sdi);
     }
 
     devc->trf_completed = 0;
@@ -1369,10 +1387,9 @@ static int dev_acquisition_start(struct sr_dev_inst *sdi, void *cb_data)
     struct DSL_context *devc;
     struct sr_usb_dev_inst *usb;
     struct drv_context *drvc;
-    const struct libusb_pollfd **lupfd;
-	unsigned int i;
     int ret;
     struct ctl_wr_cmd wr_cmd;
+    uint64_t hpos_cmd;
 
     if (sdi->status != SR_ST_ACTIVE)
         return SR_ERR_DEV_CLOSED;
@@ -1431,12 +1448,19 @@ static int dev_acquisition_start(struct sr_dev_inst *sdi, void *cb_data)
      */
     if (sdi->mode == DSO) {
         devc->trigger_hpos =  devc->trigger_hrate * dsl_en_ch_num(sdi) * devc->limit_samples / 200.0;
-        if ((ret = dsl_wr_dso(sdi, dso_cmd_gen(sdi, NULL, SR_CONF_HORIZ_TRIGGERPOS))) == SR_OK)
+        hpos_cmd = dso_cmd_gen(sdi, NULL, SR_CONF_HORIZ_TRIGGERPOS);
+        /* only left out if the FPGA kept its setting from the last capture */
+        if (devc->arm_kept && hpos_cmd == devc->hpos_cmd) {
+            sr_dbg("%s: DSO Horiz Trigger Position unchanged", __func__);
+        } else if ((ret = dsl_wr_dso(sdi, hpos_cmd)) == SR_OK) {
             sr_dbg("%s: setting DSO Horiz Trigger Position to %d",
                 __func__, devc->trigger_hpos);
-        else
+            devc->hpos_cmd = hpos_cmd;
+        } else {
             sr_dbg("%s: setting DSO Horiz Trigger Position to %d failed",
                 __func__, devc->trigger_hpos);
+            devc->hpos_cmd = 0;
+        }
     }
 
     /* setup and submit usb transfer */
@@ -1447,17 +1471,9 @@ static int dev_acquisition_start(struct sr_dev_inst *sdi, void *cb_data)
     }
 
     /* setup callback function for data transfer */
-    lupfd = libusb_get_pollfds(drvc->sr_ctx->libusb_ctx);
-    for (i = 0; lupfd[i]; i++);
-    if (!(devc->usbfd = g_try_malloc(sizeof(struct libusb_pollfd) * (i + 1))))
-    	return SR_ERR;
-    for (i = 0; lupfd[i]; i++) {
-        sr_source_add(lupfd[i]->fd, lupfd[i]->events,
-                  dsl_get_timeout(devc), receive_data, sdi);
-        devc->usbfd[i] = lupfd[i]->fd;
-    }
-    devc->usbfd[i] = -1;
-    free(lupfd);
+    if ((ret = usb_source_add(drvc->sr_ctx, dsl_get_timeout(devc),
+                              receive_data, sdi)) != SR_OK)
+        return ret;
 
     wr_cmd.header.dest = DSL_CTL_START;
     wr_cmd.header.size = 0;
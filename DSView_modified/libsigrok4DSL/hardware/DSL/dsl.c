@@ -28,8 +28,13 @@
 
 extern struct ds_trigger *trigger;
 
-static const unsigned int single_buffer_time = 20;
-static const unsigned int total_buffer_time = 100;
+/* Limits of the stream transfer times, see DSL_BUFFER_TIME. */
+static const unsigned int max_single_buffer_time = 100;
+static const unsigned int max_total_buffer_time = 1000;
+/* Data the feed thread may fall behind by, and how long to wait for it. */
+static const unsigned int feed_buffer_time = 500;
+static const unsigned int max_feed_buffer_time = 2000;
+static const guint64 feed_wait_time = 2000;
 static const unsigned int instant_buffer_size = 1024 * 1024;
 static uint16_t test_init = 1;
 
@@ -626,11 +631,15 @@ SR_PRIV int dsl_fpga_arm(const struct sr_dev_inst *sdi)
     struct ctl_wr_cmd wr_cmd;
     struct ctl_rd_cmd rd_cmd;
     uint8_t rd_cmd_data;
+    const gint64 start = g_get_monotonic_time();
 
     devc = sdi->priv;
     usb = sdi->conn;
     hdl = usb->devhdl;
+    devc->arm_kept = FALSE;
 
+    /* cleared, so settings can be compared for a rapid re-arm */
+    memset(&setting, 0, sizeof(struct DSL_setting));
     setting.sync = 0xf5a5f5a5;
     setting.mode_header = 0x0001;
     setting.divider_header = 0x0102;
@@ -842,6 +851,29 @@ SR_PRIV int dsl_fpga_arm(const struct sr_dev_inst *sdi)
         }
     }
 
+    /*
+     * The same setting is only left as it is if the device still reports
+     * the GPIF armed after the acquisition was stopped, as the full arm
+     * checks at its end. Otherwise it is armed again all the same.
+     */
+    if (devc->rearm && devc->armed &&
+        memcmp(&setting, devc->armed_setting, sizeof(struct DSL_setting)) == 0) {
+        rd_cmd.header.dest = DSL_CTL_HW_STATUS;
+        rd_cmd.header.size = 1;
+        rd_cmd_data = 0;
+        rd_cmd.data = &rd_cmd_data;
+        if (command_ctl_rd(hdl, rd_cmd) == SR_OK &&
+            (rd_cmd_data & bmGPIF_DONE)) {
+            sr_info("%s: FPGA setting unchanged and kept, not armed again "
+                    "(%" PRId64 " us).", __func__, g_get_monotonic_time() - start);
+            devc->arm_kept = TRUE;
+            return SR_OK;
+        }
+        sr_info("%s: FPGA setting unchanged, but not kept by the device.",
+                __func__);
+    }
+    devc->armed = FALSE;
+
     // set GPIF to be wordwide
     wr_cmd.header.dest = DSL_CTL_WORDWIDE;
     wr_cmd.header.size = 1;
@@ -895,7 +927,12 @@ SR_PRIV int dsl_fpga_arm(const struct sr_dev_inst *sdi)
     if ((ret = command_ctl_rd(hdl, rd_cmd)) != SR_OK)
         return SR_ERR;
     if (rd_cmd_data & bmGPIF_DONE) {
-        sr_info("Arm FPGA done");
+        sr_info("Arm FPGA done (%" PRId64 " us)", g_get_monotonic_time() - start);
+        if (devc->rearm && (devc->armed_setting ||
+            (devc->armed_setting = g_try_malloc(sizeof(struct DSL_setting))))) {
+            *devc->armed_setting = setting;
+            devc->armed = TRUE;
+        }
         return SR_OK;
     } else {
         return SR_ERR;
@@ -1107,6 +1144,22 @@ SR_PRIV int dsl_config_get(int id, GVariant **data, const struct sr_dev_inst *sd
             return SR_ERR;
         *data = g_variant_new_boolean(devc->instant);
         break;
+    case SR_CONF_REARM:
+        if (!sdi)
+            return SR_ERR;
+        *data = g_variant_new_boolean(devc->rearm);
+        break;
+    case SR_CONF_TRANSFER_STATS:
+        if (!sdi)
+            return SR_ERR;
+        *data = g_variant_new("(uuuttt)",
+                              (guint32)max(devc->submitted_transfers, 0),
+                              (guint32)devc->stats_max_in_flight,
+                              (guint32)devc->feed_buf_size,
+                              (guint64)devc->stats_overflows,
+                              (guint64)devc->stats_max_gap,
+                              (guint64)g_atomic_int_get(&devc->stats_feed_time));
+        break;
     case SR_CONF_PROBE_VDIV:
         if (!ch)
             return SR_ERR;
@@ -1363,6 +1416,7 @@ SR_PRIV int dsl_dev_open(struct sr_dev_driver *di, struct sr_dev_inst *sdi, gboo
         }
         ret = dsl_fpga_config(usb->devhdl, fpga_bit);
         g_free(fpga_bit);
+        devc->armed = FALSE;
         if (ret != SR_OK) {
             sr_err("%s: Configure FPGA failed!", __func__);
             return SR_ERR;
@@ -1381,6 +1435,8 @@ SR_PRIV int dsl_dev_close(struct sr_dev_inst *sdi)
     if (usb->devhdl == NULL)
         return SR_ERR;
 
+    dsl_rearm_clear(sdi->priv);
+
     sr_info("%s: Closing device %d on %d.%d interface %d.",
         sdi->driver->name, sdi->index, usb->bus, usb->address, USB_INTERFACE);
     libusb_release_interface(usb->devhdl, USB_INTERFACE);
@@ -1426,16 +1482,14 @@ SR_PRIV int dsl_dev_status_get(const struct sr_dev_inst *sdi, struct sr_status *
 
     if (sdi) {
         struct DSL_context *devc;
-        struct sr_usb_dev_inst *usb;
 
         devc = sdi->priv;
-        usb = sdi->conn;
         if (prg && (devc->status == DSL_START)) {
             rd_cmd.header.dest = DSL_CTL_I2C_STATUS;
             rd_cmd.header.offset = begin;
             rd_cmd.header.size = end - begin + 1;
             rd_cmd.data = (unsigned char*)status;
-            ret = command_ctl_rd(usb->devhdl, rd_cmd);
+            ret = dsl_acq_ctl_rd(sdi, rd_cmd);
         } else if (devc->mstatus_valid) {
             *status = devc->mstatus;
             ret = SR_OK;
@@ -1466,10 +1520,10 @@ static size_t get_buffer_size(struct DSL_context *devc)
     size_t s;
 
     /*
-     * The buffer should be large enough to hold 10ms of data and
-     * a multiple of 512.
+     * The buffer should be large enough to hold buffer_time ms of data
+     * and a multiple of 512.
      */
-    s = single_buffer_time * to_bytes_per_ms(devc);
+    s = devc->buffer_time * to_bytes_per_ms(devc);
     //s = to_bytes_per_ms(devc->cur_samplerate);
     return (s + 511) & ~511;
 }
@@ -1477,8 +1531,8 @@ static size_t get_buffer_size(struct DSL_context *devc)
 static unsigned int get_number_of_transfers(struct DSL_context *devc)
 {
     unsigned int n;
-    /* Total buffer size should be able to hold about 100ms of data. */
-    n = ceil(total_buffer_time * 1.0f * to_bytes_per_ms(devc) / get_buffer_size(devc));
+    /* Total buffer size should be able to hold about total_time ms of data. */
+    n = ceil(devc->total_time * 1.0f * to_bytes_per_ms(devc) / get_buffer_size(devc));
 
     if (n > NUM_SIMUL_TRANSFERS)
         return NUM_SIMUL_TRANSFERS;
@@ -1500,6 +1554,324 @@ SR_PRIV unsigned int dsl_get_timeout(struct DSL_context *devc)
         return 1000;
 }
 
+/* A packet queued for the feed thread. */
+struct dsl_feed {
+    struct sr_datafeed_packet packet;
+    union {
+        struct sr_datafeed_logic logic;
+        struct sr_datafeed_dso dso;
+        struct sr_datafeed_analog analog;
+        struct ds_trigger_pos trigger_pos;
+    } payload;
+    /* the transfer buffer holding the data, handed over with it */
+    void *buf;
+};
+
+static void feed_release(struct DSL_context *devc, void *buf, uint64_t size)
+{
+    void *new_buf;
+
+    if (!buf) {
+        /* taken over without one in exchange */
+        g_atomic_int_add(&devc->feed_bufs, -1);
+        return;
+    }
+
+    if (size < devc->feed_buf_size) {
+        if (!(new_buf = g_try_realloc(buf, devc->feed_buf_size))) {
+            g_free(buf);
+            g_atomic_int_add(&devc->feed_bufs, -1);
+            return;
+        }
+        buf = new_buf;
+    }
+
+    g_async_queue_push(devc->feed_pool, buf);
+}
+
+static gpointer feed_thread_proc(gpointer data)
+{
+    struct DSL_context *devc = data;
+    struct dsl_feed *feed;
+    gboolean end;
+    uint64_t size;
+    gint64 start, time;
+
+    do {
+        feed = g_async_queue_pop(devc->feed_queue);
+        end = (feed->packet.type == SR_DF_END);
+        start = g_get_monotonic_time();
+        if (feed->buf) {
+            size = devc->feed_buf_size;
+            sr_session_send_buffer(devc->cb_data, &feed->packet,
+                                   &feed->buf, &size);
+            feed_release(devc, feed->buf, size);
+        } else {
+            sr_session_send(devc->cb_data, &feed->packet);
+        }
+        g_free(feed);
+
+        time = min(g_get_monotonic_time() - start, G_MAXINT);
+        if (time > g_atomic_int_get(&devc->stats_feed_time))
+            g_atomic_int_set(&devc->stats_feed_time, time);
+    } while (!end);
+
+    return NULL;
+}
+
+static int feed_start(struct DSL_context *devc, size_t buf_size)
+{
+    unsigned int bufs;
+
+    bufs = feed_buffer_time * to_bytes_per_ms(devc) / buf_size;
+    devc->feed_buf_size = buf_size;
+    devc->feed_bufs = 0;
+    devc->feed_max_bufs = max(bufs, 2);
+    devc->feed_queue = g_async_queue_new();
+    devc->feed_pool = g_async_queue_new_full(g_free);
+
+    /* the spares kept by a rapid re-arm are of buf_size */
+    while (devc->spare_bufs) {
+        if (devc->feed_bufs < devc->feed_max_bufs) {
+            g_async_queue_push(devc->feed_pool, devc->spare_bufs->data);
+            devc->feed_bufs++;
+        } else {
+            g_free(devc->spare_bufs->data);
+        }
+        devc->spare_bufs = g_slist_delete_link(devc->spare_bufs, devc->spare_bufs);
+    }
+
+    devc->feed_thread = g_thread_try_new("dsl-feed", feed_thread_proc,
+                                         devc, NULL);
+    if (!devc->feed_thread) {
+        sr_err("%s: Failed to start the feed thread.", __func__);
+        g_async_queue_unref(devc->feed_queue);
+        g_async_queue_unref(devc->feed_pool);
+        return SR_ERR;
+    }
+
+    return SR_OK;
+}
+
+/*
+ * Queue a packet for the feed thread, copying its payload. buf is the
+ * buffer its data is in, if it is handed over with it.
+ */
+static void feed_packet(struct DSL_context *devc,
+                        const struct sr_datafeed_packet *packet, void *buf)
+{
+    struct dsl_feed *feed;
+
+    if (!devc->feed_thread) {
+        sr_session_send(devc->cb_data, packet);
+        return;
+    }
+
+    feed = g_malloc(sizeof(struct dsl_feed));
+    feed->packet = *packet;
+    feed->buf = buf;
+    if (packet->payload) {
+        switch (packet->type) {
+        case SR_DF_LOGIC:
+            feed->payload.logic = *(const struct sr_datafeed_logic *)packet->payload;
+            break;
+        case SR_DF_DSO:
+            feed->payload.dso = *(const struct sr_datafeed_dso *)packet->payload;
+            break;
+        case SR_DF_ANALOG:
+            feed->payload.analog = *(const struct sr_datafeed_analog *)packet->payload;
+            break;
+        case SR_DF_TRIGGER:
+            feed->payload.trigger_pos = *(const struct ds_trigger_pos *)packet->payload;
+            break;
+        }
+        feed->packet.payload = &feed->payload;
+    }
+    g_async_queue_push(devc->feed_queue, feed);
+}
+
+/*
+ * Queue the data of a transfer, which gets a spare buffer instead so
+ * it can be resubmitted right away. Once there are as many spare
+ * buffers as may be, wait for the feed thread to give one back.
+ */
+static int feed_transfer(struct DSL_context *devc,
+                         struct libusb_transfer *transfer,
+                         const struct sr_datafeed_packet *packet)
+{
+    void *buf;
+
+    if (!devc->feed_thread) {
+        sr_session_send(devc->cb_data, packet);
+        return SR_OK;
+    }
+
+    buf = g_async_queue_try_pop(devc->feed_pool);
+    if (!buf && g_atomic_int_get(&devc->feed_bufs) < devc->feed_max_bufs &&
+        (buf = g_try_malloc(devc->feed_buf_size)))
+        g_atomic_int_inc(&devc->feed_bufs);
+    if (!buf) {
+        /* held up downstream, let it fall behind further next time */
+        if (devc->feed_max_bufs * devc->feed_buf_size <
+            max_feed_buffer_time * to_bytes_per_ms(devc))
+            devc->feed_max_bufs++;
+        buf = g_async_queue_timeout_pop(devc->feed_pool, feed_wait_time * 1000);
+    }
+    if (!buf) {
+        sr_err("%s: No buffer to resubmit the transfer with.", __func__);
+        return SR_ERR;
+    }
+
+    feed_packet(devc, packet, transfer->buffer);
+    transfer->buffer = buf;
+
+    return SR_OK;
+}
+
+static void feed_stop(struct DSL_context *devc)
+{
+    void *buf;
+
+    if (!devc->feed_thread)
+        return;
+
+    g_thread_join(devc->feed_thread);
+    devc->feed_thread = NULL;
+    if (devc->rearm) {
+        while ((buf = g_async_queue_try_pop(devc->feed_pool)))
+            devc->spare_bufs = g_slist_prepend(devc->spare_bufs, buf);
+    }
+    g_async_queue_unref(devc->feed_queue);
+    g_async_queue_unref(devc->feed_pool);
+}
+
+/*
+ * The transfers are recorded by the session thread, the status reads
+ * by whichever thread polls the status.
+ */
+static GMutex record_mutex;
+
+static void record_start(struct DSL_context *devc, size_t buf_size,
+                         unsigned int num_transfers)
+{
+    const struct sr_dev_inst *sdi = devc->cb_data;
+    struct dsl_record_header header;
+    const char *path;
+    FILE *record;
+    GSList *l;
+
+    if (devc->replay || !(path = getenv("DSL_RECORD")) || !*path)
+        return;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, DSL_RECORD_MAGIC, sizeof(header.magic));
+    header.vid = devc->profile->vid;
+    header.pid = devc->profile->pid;
+    header.mode = sdi->mode;
+    header.ch_mode = devc->ch_mode;
+    for (l = sdi->channels; l; l = l->next) {
+        const struct sr_channel *probe = l->data;
+        if (probe->enabled && probe->index < 64)
+            header.ch_enable |= 1ULL << probe->index;
+    }
+    header.samplerate = devc->cur_samplerate;
+    header.limit_samples = devc->limit_samples;
+    header.actual_samples = devc->actual_samples;
+    header.actual_bytes = devc->actual_bytes;
+    header.buf_size = buf_size;
+    header.num_transfers = num_transfers;
+    header.unit_pitch = devc->unit_pitch;
+    header.stream = devc->stream;
+    header.instant = devc->instant;
+
+    if (!(record = fopen(path, "wb"))) {
+        sr_err("%s: Failed to open %s: %s.", __func__, path, strerror(errno));
+        return;
+    }
+    if (fwrite(&header, sizeof(header), 1, record) != 1) {
+        sr_err("%s: Failed to write %s.", __func__, path);
+        fclose(record);
+        return;
+    }
+    g_mutex_lock(&record_mutex);
+    devc->record = record;
+    devc->record_start = g_get_monotonic_time();
+    g_mutex_unlock(&record_mutex);
+    sr_info("%s: Recording the transfers to %s.", __func__, path);
+}
+
+static void record_write(struct DSL_context *devc, uint32_t type,
+                         int32_t status, const void *head, uint32_t head_len,
+                         const void *data, uint32_t length)
+{
+    struct dsl_record_transfer rec;
+
+    g_mutex_lock(&record_mutex);
+    if (devc->record) {
+        rec.time = g_get_monotonic_time() - devc->record_start;
+        rec.length = head_len + length;
+        rec.status = status;
+        rec.type = type;
+        rec.reserved = 0;
+        if (fwrite(&rec, sizeof(rec), 1, devc->record) != 1 ||
+            fwrite(head, 1, head_len, devc->record) != head_len ||
+            fwrite(data, 1, length, devc->record) != length) {
+            sr_err("%s: Failed to write the recording, stopped it.", __func__);
+            fclose(devc->record);
+            devc->record = NULL;
+        }
+    }
+    g_mutex_unlock(&record_mutex);
+}
+
+static void record_transfer(struct DSL_context *devc,
+                            const struct libusb_transfer *transfer,
+                            uint32_t type)
+{
+    record_write(devc, type, transfer->status, NULL, 0,
+                 transfer->buffer, max(transfer->actual_length, 0));
+}
+
+static void record_stop(struct DSL_context *devc)
+{
+    g_mutex_lock(&record_mutex);
+    if (devc->record) {
+        fclose(devc->record);
+        devc->record = NULL;
+    }
+    g_mutex_unlock(&record_mutex);
+}
+
+/*
+ * A control read while acquiring, recorded with the transfers, or
+ * answered from the recording when replaying one.
+ */
+SR_PRIV int dsl_acq_ctl_rd(const struct sr_dev_inst *sdi, struct ctl_rd_cmd cmd)
+{
+    struct DSL_context *devc = sdi->priv;
+    struct sr_usb_dev_inst *usb = sdi->conn;
+    int ret;
+
+    if (devc->replay)
+        return dsl_replay_ctl_rd(devc, cmd);
+
+    ret = command_ctl_rd(usb->devhdl, cmd);
+    record_write(devc, DSL_RECORD_CTL_RD, ret,
+                 &cmd.header, sizeof(cmd.header),
+                 cmd.data, ret == SR_OK ? cmd.header.size : 0);
+
+    return ret;
+}
+
+static int submit_transfer(struct DSL_context *devc,
+                           struct libusb_transfer *transfer)
+{
+    if (devc->replay)
+        return dsl_replay_submit(devc, transfer);
+
+    return libusb_submit_transfer(transfer);
+}
+
 static void finish_acquisition(struct DSL_context *devc)
 {
     struct sr_datafeed_packet packet;
@@ -1508,7 +1880,10 @@ static void finish_acquisition(struct DSL_context *devc)
     /* Terminate session. */
     packet.type = SR_DF_END;
     packet.status = SR_PKT_OK;
-    sr_session_send(devc->cb_data, &packet);
+    packet.payload = NULL;
+    feed_packet(devc, &packet, NULL);
+    feed_stop(devc);
+    record_stop(devc);
 
     if (devc->num_transfers != 0) {
         devc->num_transfers = 0;
@@ -1518,6 +1893,61 @@ static void finish_acquisition(struct DSL_context *devc)
     devc->status = DSL_FINISH;
 }
 
+/*
+ * Keep a transfer with its buffer for the next capture, which is of
+ * the same size if it uses them. The trigger transfer is the first.
+ */
+static gboolean spare_transfer(struct DSL_context *devc,
+                               struct libusb_transfer *transfer)
+{
+    if (!devc->rearm || !transfer->buffer)
+        return FALSE;
+
+    if (devc->num_transfers != 0 && transfer == devc->transfers[0]) {
+        if (devc->spare_trigger)
+            return FALSE;
+        devc->spare_trigger = transfer;
+    } else {
+        if ((size_t)transfer->length != devc->spare_size)
+            return FALSE;
+        devc->spare_transfers = g_slist_prepend(devc->spare_transfers, transfer);
+    }
+
+    return TRUE;
+}
+
+static void clear_spares(struct DSL_context *devc)
+{
+    struct libusb_transfer *transfer;
+    GSList *l;
+
+    if (devc->spare_trigger) {
+        g_free(devc->spare_trigger->buffer);
+        libusb_free_transfer(devc->spare_trigger);
+        devc->spare_trigger = NULL;
+    }
+    for (l = devc->spare_transfers; l; l = l->next) {
+        transfer = l->data;
+        g_free(transfer->buffer);
+        libusb_free_transfer(transfer);
+    }
+    g_slist_free(devc->spare_transfers);
+    devc->spare_transfers = NULL;
+    g_slist_free_full(devc->spare_bufs, g_free);
+    devc->spare_bufs = NULL;
+    devc->spare_size = 0;
+}
+
+SR_PRIV void dsl_rearm_clear(struct DSL_context *devc)
+{
+    clear_spares(devc);
+    g_free(devc->armed_setting);
+    devc->armed_setting = NULL;
+    devc->armed = FALSE;
+    devc->arm_kept = FALSE;
+    devc->hpos_cmd = 0;
+}
+
 static void free_transfer(struct libusb_transfer *transfer)
 {
     struct DSL_context *devc;
@@ -1525,9 +1955,11 @@ static void free_transfer(struct libusb_transfer *transfer)
 
     devc = transfer->user_data;
 
-    g_free(transfer->buffer);
-    transfer->buffer = NULL;
-    libusb_free_transfer(transfer);
+    if (!spare_transfer(devc, transfer)) {
+        g_free(transfer->buffer);
+        transfer->buffer = NULL;
+        libusb_free_transfer(transfer);
+    }
 
     for (i = 0; i < devc->num_transfers; i++) {
         if (devc->transfers[i] == transfer) {
@@ -1545,7 +1977,7 @@ static void resubmit_transfer(struct libusb_transfer *transfer)
 {
     int ret;
 
-    if ((ret = libusb_submit_transfer(transfer)) == LIBUSB_SUCCESS)
+    if ((ret = submit_transfer(transfer->user_data, transfer)) == LIBUSB_SUCCESS)
         return;
 
     free_transfer(transfer);
@@ -1554,6 +1986,72 @@ static void resubmit_transfer(struct libusb_transfer *transfer)
     sr_err("%s: %s", __func__, libusb_error_name(ret));
 }
 
+static void receive_transfer(struct libusb_transfer *transfer);
+
+/* Submit one more stream transfer, while there is room for it. */
+static void add_transfer(struct DSL_context *devc)
+{
+    const struct sr_dev_inst *sdi = devc->cb_data;
+    struct sr_usb_dev_inst *usb = sdi->conn;
+    struct libusb_transfer *transfer;
+    unsigned char *buf;
+    int ret;
+
+    if (devc->num_transfers > NUM_SIMUL_TRANSFERS)
+        return;
+
+    if (!(buf = g_try_malloc(devc->feed_buf_size)))
+        return;
+    transfer = libusb_alloc_transfer(0);
+    libusb_fill_bulk_transfer(transfer, usb->devhdl,
+            6 | LIBUSB_ENDPOINT_IN, buf, devc->feed_buf_size,
+            (libusb_transfer_cb_fn)receive_transfer, devc, 0);
+    if ((ret = submit_transfer(devc, transfer)) != 0) {
+        sr_warn("%s: Failed to submit one more transfer: %s.",
+                __func__, libusb_error_name(ret));
+        libusb_free_transfer(transfer);
+        g_free(buf);
+        return;
+    }
+    devc->transfers[devc->num_transfers++] = transfer;
+    devc->submitted_transfers++;
+    devc->stats_max_in_flight = max(devc->stats_max_in_flight,
+                                    devc->submitted_transfers);
+    sr_info("%s: %d transfers in flight.", __func__, devc->submitted_transfers);
+}
+
+/*
+ * Adapt the stream transfers to how soon the host gets round to them.
+ * A gap between two completions of more than half the data in flight
+ * gets another transfer submitted, and more for the next capture.
+ * Taking over a tenth of its time to handle a transfer makes those of
+ * the next capture longer.
+ */
+static void tune_transfers(struct DSL_context *devc, gint64 start)
+{
+    gint64 gap, in_flight;
+
+    if (devc->last_completion) {
+        gap = start - devc->last_completion;
+        devc->stats_max_gap = max(devc->stats_max_gap, gap);
+        in_flight = (gint64)(devc->submitted_transfers - (devc->transfers[0] != NULL)) *
+                    devc->buffer_time * 1000;
+        if (gap * 2 > in_flight) {
+            add_transfer(devc);
+            devc->total_time = min(devc->total_time + devc->buffer_time,
+                                   max_total_buffer_time);
+        }
+    }
+    devc->last_completion = start;
+
+    if ((g_get_monotonic_time() - start) * 10 > devc->buffer_time * 1000 &&
+        get_buffer_size(devc) == devc->feed_buf_size &&
+        devc->buffer_time < max_single_buffer_time) {
+        devc->buffer_time = min(devc->buffer_time * 2, max_single_buffer_time);
+        devc->total_time = max(devc->total_time, 2 * devc->buffer_time);
+    }
+}
+
 static void receive_transfer(struct libusb_transfer *transfer)
 {
     struct sr_datafeed_packet packet;
@@ -1565,6 +2063,9 @@ static void receive_transfer(struct libusb_transfer *transfer)
     uint8_t *cur_buf = transfer->buffer;
     struct DSL_context *devc = transfer->user_data;
     struct sr_dev_inst *sdi = devc->cb_data;
+    const gint64 start = g_get_monotonic_time();
+
+    record_transfer(devc, transfer, DSL_RECORD_DATA);
 
     if (devc->status == DSL_START)
         devc->status = DSL_DATA;
@@ -1665,12 +2166,14 @@ static void receive_transfer(struct libusb_transfer *transfer)
 
             /* send data to session bus */
             if (!devc->overflow) {
-                if (packet.status == SR_PKT_OK)
-                    sr_session_send(sdi, &packet);
+                if (packet.status == SR_PKT_OK &&
+                    feed_transfer(devc, transfer, &packet) != SR_OK)
+                    devc->status = DSL_ERROR;
             } else {
                 packet.type = SR_DF_OVERFLOW;
                 packet.payload = NULL;
-                sr_session_send(sdi, &packet);
+                feed_packet(devc, &packet, NULL);
+                devc->stats_overflows++;
             }
         }
 
@@ -1687,6 +2190,9 @@ static void receive_transfer(struct libusb_transfer *transfer)
         }
     }
 
+    if (devc->stream && devc->status == DSL_DATA)
+        tune_transfers(devc, start);
+
     if (devc->status == DSL_DATA)
         resubmit_transfer(transfer);
     else
@@ -1707,6 +2213,7 @@ static void receive_trigger_pos(struct libusb_transfer *transfer)
     devc = transfer->user_data;
     sdi = devc->cb_data;
     trigger_pos = (struct ds_trigger_pos *)transfer->buffer;
+    record_transfer(devc, transfer, DSL_RECORD_TRIGGER);
     if (devc->status != DSL_ABORT)
         devc->status = DSL_ERROR;
     if (!devc->abort && transfer->status == LIBUSB_TRANSFER_COMPLETED &&
@@ -1727,7 +2234,7 @@ static void receive_trigger_pos(struct libusb_transfer *transfer)
 
                 packet.type = SR_DF_TRIGGER;
                 packet.payload = trigger_pos;
-                sr_session_send(sdi, &packet);
+                feed_packet(devc, &packet, NULL);
 
                 devc->status = DSL_DATA;
             }
@@ -1737,7 +2244,7 @@ static void receive_trigger_pos(struct libusb_transfer *transfer)
         packet.type = SR_DF_TRIGGER;
         packet.payload = trigger_pos;
         packet.status = SR_PKT_DATA_ERROR;
-        sr_session_send(sdi, &packet);
+        feed_packet(devc, &packet, NULL);
     }
 
     free_transfer(transfer);
@@ -1769,25 +2276,48 @@ SR_PRIV int dsl_start_transfers(const struct sr_dev_inst *sdi)
     size = (sdi->mode == DSO) ? dso_buffer_size :
            (devc->stream) ? get_buffer_size(devc) : instant_buffer_size;
 
+    if (!devc->rearm || size != devc->spare_size)
+        clear_spares(devc);
+    devc->spare_size = size;
+
+    devc->stats_max_in_flight = 0;
+    devc->stats_overflows = 0;
+    devc->stats_max_gap = 0;
+    devc->stats_feed_time = 0;
+    devc->last_completion = 0;
+
     /* trigger packet transfer */
-    if (!(trigger_pos = g_try_malloc0(sizeof(struct ds_trigger_pos)))) {
-        sr_err("%s: USB trigger_pos buffer malloc failed.", __func__);
-        return SR_ERR_MALLOC;
+    if (devc->spare_trigger) {
+        transfer = devc->spare_trigger;
+        devc->spare_trigger = NULL;
+        trigger_pos = (struct ds_trigger_pos *)transfer->buffer;
+        memset(trigger_pos, 0, sizeof(struct ds_trigger_pos));
+    } else {
+        if (!(trigger_pos = g_try_malloc0(sizeof(struct ds_trigger_pos)))) {
+            sr_err("%s: USB trigger_pos buffer malloc failed.", __func__);
+            return SR_ERR_MALLOC;
+        }
+        transfer = libusb_alloc_transfer(0);
     }
-    devc->transfers = g_try_malloc0(sizeof(*devc->transfers) * (num_transfers + 1));
+    /* stream transfers may be added, see add_transfer() */
+    devc->transfers = g_try_malloc0(sizeof(*devc->transfers) *
+                                    ((devc->stream ? NUM_SIMUL_TRANSFERS : num_transfers) + 1));
     if (!devc->transfers) {
         sr_err("%s: USB transfer malloc failed.", __func__);
+        libusb_free_transfer(transfer);
+        g_free(trigger_pos);
         return SR_ERR_MALLOC;
     }
-    transfer = libusb_alloc_transfer(0);
     libusb_fill_bulk_transfer(transfer, usb->devhdl,
             6 | LIBUSB_ENDPOINT_IN, (unsigned char *)trigger_pos, sizeof(struct ds_trigger_pos),
             (libusb_transfer_cb_fn)receive_trigger_pos, devc, 0);
-    if ((ret = libusb_submit_transfer(transfer)) != 0) {
+    record_start(devc, size, num_transfers);
+    if ((ret = submit_transfer(devc, transfer)) != 0) {
         sr_err("%s: Failed to submit trigger_pos transfer: %s.",
                __func__, libusb_error_name(ret));
         libusb_free_transfer(transfer);
         g_free(trigger_pos);
+        record_stop(devc);
         devc->status = DSL_ERROR;
         return SR_ERR;
     } else {
@@ -1796,17 +2326,31 @@ SR_PRIV int dsl_start_transfers(const struct sr_dev_inst *sdi)
         devc->submitted_transfers++;
     }
 
+    /* with a transfer submitted, finish_acquisition() stops it again */
+    if ((ret = feed_start(devc, size)) != SR_OK) {
+        devc->status = DSL_ERROR;
+        devc->abort = TRUE;
+        return ret;
+    }
+
     /* data packet transfer */
     for (i = 1; i <= num_transfers; i++) {
-        if (!(buf = g_try_malloc(size))) {
-            sr_err("%s: USB transfer buffer malloc failed.", __func__);
-            return SR_ERR_MALLOC;
+        if (devc->spare_transfers) {
+            transfer = devc->spare_transfers->data;
+            buf = transfer->buffer;
+            devc->spare_transfers = g_slist_delete_link(devc->spare_transfers,
+                                                        devc->spare_transfers);
+        } else {
+            if (!(buf = g_try_malloc(size))) {
+                sr_err("%s: USB transfer buffer malloc failed.", __func__);
+                return SR_ERR_MALLOC;
+            }
+            transfer = libusb_alloc_transfer(0);
         }
-        transfer = libusb_alloc_transfer(0);
         libusb_fill_bulk_transfer(transfer, usb->devhdl,
                 6 | LIBUSB_ENDPOINT_IN, buf, size,
                 (libusb_transfer_cb_fn)receive_transfer, devc, 0);
-        if ((ret = libusb_submit_transfer(transfer)) != 0) {
+        if ((ret = submit_transfer(devc, transfer)) != 0) {
             sr_err("%s: Failed to submit transfer: %s.",
                    __func__, libusb_error_name(ret));
             libusb_free_transfer(transfer);
@@ -1819,6 +2363,7 @@ SR_PRIV int dsl_start_transfers(const struct sr_dev_inst *sdi)
         devc->submitted_transfers++;
         devc->num_transfers++;
     }
+    devc->stats_max_in_flight = devc->submitted_transfers;
 
     return SR_OK;
 }
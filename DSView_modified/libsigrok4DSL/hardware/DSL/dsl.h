@@ -53,6 +53,9 @@
 #define USB_CONFIGURATION	1
 #define NUM_TRIGGER_STAGES	16
 #define NUM_SIMUL_TRANSFERS	64
+/* ms of data in a stream transfer, and in all of them, to start with */
+#define DSL_BUFFER_TIME	20
+#define DSL_TOTAL_BUFFER_TIME	100
 
 #define DSL_REQUIRED_VERSION_MAJOR	2
 #define DSL_REQUIRED_VERSION_MINOR	0
@@ -510,6 +513,55 @@ enum {
     DSL_ABORT = 8,
 };
 
+/*
+ * A recording of the transfers of an acquisition, made if DSL_RECORD
+ * names a file and replayed by the DSL replay driver: the header, then
+ * each completed transfer, with its data, in host byte order. The
+ * control reads made while acquiring are recorded in between, their
+ * data is the struct ctl_header of the read and then what was read.
+ */
+#define DSL_RECORD_MAGIC "DSLREC1"
+
+enum {
+    DSL_RECORD_DATA = 0,
+    DSL_RECORD_TRIGGER = 1,
+    DSL_RECORD_CTL_RD = 2,
+};
+
+struct dsl_record_header {
+    char magic[8];
+    uint16_t vid;
+    uint16_t pid;
+    uint16_t mode;
+    uint16_t ch_mode;
+    uint64_t ch_enable;
+    uint64_t samplerate;
+    uint64_t limit_samples;
+    uint64_t actual_samples;
+    uint64_t actual_bytes;
+    uint32_t buf_size;
+    uint32_t num_transfers;
+    uint16_t unit_pitch;
+    uint8_t stream;
+    uint8_t instant;
+    uint32_t reserved;
+};
+
+struct dsl_record_transfer {
+    /* us since the acquisition started */
+    uint64_t time;
+    uint32_t length;
+    /* the libusb status, or the result of a control read */
+    int32_t status;
+    /* DSL_RECORD_DATA, _TRIGGER or _CTL_RD */
+    uint32_t type;
+    uint32_t reserved;
+};
+
+struct dsl_replay;
+struct ctl_rd_cmd;
+struct DSL_setting;
+
 struct DSL_context {
     const struct DSL_profile *profile;
 	/*
@@ -572,7 +624,54 @@ struct DSL_context {
 	void *cb_data;
 	unsigned int num_transfers;
 	struct libusb_transfer **transfers;
-	int *usbfd;
+
+	/*
+	 * Packets are sent from a feed thread, the transfers get a spare
+	 * buffer from the pool and are resubmitted meanwhile.
+	 */
+	GThread *feed_thread;
+	GAsyncQueue *feed_queue;
+	GAsyncQueue *feed_pool;
+	size_t feed_buf_size;
+	/* spare buffers there are, and may be */
+	gint feed_bufs;
+	gint feed_max_bufs;
+
+	/* the transfers recorded to, or replayed instead of the device */
+	FILE *record;
+	gint64 record_start;
+	struct dsl_replay *replay;
+
+	/*
+	 * Rapid re-arm: the transfers, their buffers and the spare buffers
+	 * of the last capture are kept for the next one of the same size,
+	 * and the FPGA is only armed again if its setting changed or the
+	 * device no longer has it, see dsl_fpga_arm().
+	 */
+	gboolean rearm;
+	size_t spare_size;
+	struct libusb_transfer *spare_trigger;
+	GSList *spare_transfers;
+	GSList *spare_bufs;
+	gboolean armed;
+	struct DSL_setting *armed_setting;
+	/* the last dsl_fpga_arm() found the setting kept and left it */
+	gboolean arm_kept;
+	/* the DSO trigger position last written, 0 if not known */
+	uint64_t hpos_cmd;
+
+	/*
+	 * Stream transfers hold buffer_time ms of data each, total_time ms
+	 * together. Both adapt to the host, see tune_transfers().
+	 */
+	unsigned int buffer_time;
+	unsigned int total_time;
+	gint64 last_completion;
+	/* counters of the capture, see SR_CONF_TRANSFER_STATS */
+	int stats_max_in_flight;
+	uint64_t stats_overflows;
+	gint64 stats_max_gap;
+	gint stats_feed_time;
 
     int pipe_fds[2];
     GIOChannel *channel;
@@ -694,5 +793,12 @@ SR_PRIV int dsl_dev_status_get(const struct sr_dev_inst *sdi, struct sr_status *
 
 SR_PRIV unsigned int dsl_get_timeout(struct DSL_context *devc);
 SR_PRIV int dsl_start_transfers(const struct sr_dev_inst *sdi);
+SR_PRIV void dsl_rearm_clear(struct DSL_context *devc);
+SR_PRIV int dsl_acq_ctl_rd(const struct sr_dev_inst *sdi, struct ctl_rd_cmd cmd);
+
+/* dsreplay.c */
+SR_PRIV int dsl_replay_submit(struct DSL_context *devc,
+                              struct libusb_transfer *transfer);
+SR_PRIV int dsl_replay_ctl_rd(struct DSL_context *devc, struct ctl_rd_cmd cmd);
 
 #endif
@@ -156,6 +156,20 @@ static struct DSL_context *DSLogic_dev_new(const struct DSL_profile *prof)
     devc->clock_type = FALSE;
     devc->clock_edge = FALSE;
     devc->rle_mode = FALSE;
+    devc->feed_thread = NULL;
+    devc->record = NULL;
+    devc->replay = NULL;
+    devc->rearm = FALSE;
+    devc->spare_size = 0;
+    devc->spare_trigger = NULL;
+    devc->spare_transfers = NULL;
+    devc->spare_bufs = NULL;
+    devc->armed = FALSE;
+    devc->armed_setting = NULL;
+    devc->arm_kept = FALSE;
+    devc->hpos_cmd = 0;
+    devc->buffer_time = DSL_BUFFER_TIME;
+    devc->total_time = DSL_TOTAL_BUFFER_TIME;
     devc->instant = FALSE;
     devc->op_mode = OP_STREAM;
     devc->test_mode = SR_TEST_NONE;
@@ -914,6 +928,7 @@ static int config_set(int id, GVariant *data, struct sr_dev_inst *sdi,
                 }
                 ret = dsl_fpga_config(usb->devhdl, fpga_bit);
                 g_free(fpga_bit);
+                devc->armed = FALSE;
                 if (ret != SR_OK) {
                     sr_err("Configure FPGA failed!");
                 }
@@ -1098,23 +1113,12 @@ static int cleanup(void)
 	return ret;
 }
 
-static void remove_sources(struct DSL_context *devc)
-{
-    int i;
-    sr_info("%s: remove fds from polling", __func__);
-    /* Remove fds from polling. */
-    for (i = 0; devc->usbfd[i] != -1; i++)
-        sr_source_remove(devc->usbfd[i]);
-    g_free(devc->usbfd);
-}
-
 static int receive_data(int fd, int revents, const struct sr_dev_inst *sdi)
 {
     int completed = 0;
     struct timeval tv;
     struct drv_context *drvc;
     struct DSL_context *devc;
-    struct sr_usb_dev_inst *usb;
     struct ctl_rd_cmd rd_cmd;
     uint8_t hw_info;
     int ret;
@@ -1124,7 +1128,6 @@ static int receive_data(int fd, int revents, const struct sr_dev_inst *sdi)
 
     drvc = di->priv;
     devc = sdi->priv;
-    usb = sdi->conn;
 
     tv.tv_sec = tv.tv_usec = 0;
     libusb_handle_events_timeout_completed(drvc->sr_ctx->libusb_ctx, &tv, &completed);
@@ -1135,7 +1138,7 @@ static int receive_data(int fd, int revents, const struct sr_dev_inst *sdi)
         rd_cmd.header.size = 1;
         hw_info = 0;
         rd_cmd.data = &hw_info;
-        if ((ret = command_ctl_rd(usb->devhdl, rd_cmd)) != SR_OK)
+        if ((ret = dsl_acq_ctl_rd(sdi, rd_cmd)) != SR_OK)
             sr_err("Failed to get hardware infos.");
         else
             devc->overflow = (hw_info & bmSYS_OVERFLOW) != 0;
@@ -1143,7 +1146,8 @@ static int receive_data(int fd, int revents, const struct sr_dev_inst *sdi)
 
     if (devc->status == DSL_FINISH) {
         /* Remove polling */
-        remove_sources(devc);
+        sr_info("%s: remove fds from polling", __func__);
+        usb_source_remove(drvc->sr_ctx, sdi);
     }
 
     devc->trf_completed = 0;
@@ -1157,8 +1161,6 @@ static int dev_acquisition_start(struct sr_dev_inst *sdi, void *cb_data)
     struct DSL_context *devc;
     struct sr_usb_dev_inst *usb;
     struct drv_context *drvc;
-    const struct libusb_pollfd **lupfd;
-	unsigned int i;
     int ret;
     struct ctl_wr_cmd wr_cmd;
 
@@ -1229,17 +1231,9 @@ static int dev_acquisition_start(struct sr_dev_inst *sdi, void *cb_data)
     }
 
     /* setup callback function for data transfer */
-    lupfd = libusb_get_pollfds(drvc->sr_ctx->libusb_ctx);
-    for (i = 0; lupfd[i]; i++);
-    if (!(devc->usbfd = g_try_malloc(sizeof(struct libusb_pollfd) * (i + 1))))
-    	return SR_ERR;
-    for (i = 0; lupfd[i]; i++) {
-        sr_source_add(lupfd[i]->fd, lupfd[i]->events,
-                  dsl_get_timeout(devc), receive_data, sdi);
-        devc->usbfd[i] = lupfd[i]->fd;
-    }
-    devc->usbfd[i] = -1;
-    free(lupfd);
+    if ((ret = usb_source_add(drvc->sr_ctx, dsl_get_timeout(devc),
+                              receive_data, sdi)) != SR_OK)
+        return ret;
 
     wr_cmd.header.dest = DSL_CTL_START;
     wr_cmd.header.size = 0;
@@ -0,0 +1,594 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2017 DreamSourceLab <dreamsourcelab@dreamsourcelab.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "libsigrok.h"
+#include "libsigrok-internal.h"
+
+#include "dsl.h"
+#include "command.h"
+
+/*
+ * Replays the transfers recorded by setting DSL_RECORD, see dsl.h, as
+ * a device of the recorded model. The transfers are submitted and
+ * completed the same as those of the device, so everything from
+ * receive_transfer() on runs as in the recorded acquisition. The
+ * control reads are answered with what the device last answered by
+ * then in the recording.
+ *
+ * DSL_REPLAY names the recording, DSL_REPLAY_SPEED is how much faster
+ * than recorded the transfers complete, as fast as possible if unset
+ * or 0.
+ */
+
+struct replay_ctl_rd {
+    int32_t status;
+    uint8_t data[];
+};
+
+struct dsl_replay {
+    char *path;
+    FILE *file;
+    struct dsl_record_header header;
+    /* submitted and not completed */
+    GQueue pending;
+    double speed;
+    gint64 start;
+    /* the next record, read ahead while waiting for its time */
+    struct dsl_record_transfer next;
+    gboolean has_next;
+    /* the control reads replayed so far, by ctl_rd_key() */
+    GHashTable *ctl_rd;
+    GMutex ctl_mutex;
+};
+
+SR_PRIV struct sr_dev_driver DSReplay_driver_info;
+static struct sr_dev_driver *di = &DSReplay_driver_info;
+
+SR_PRIV int dsl_replay_submit(struct DSL_context *devc,
+                              struct libusb_transfer *transfer)
+{
+    g_queue_push_tail(&devc->replay->pending, transfer);
+    return LIBUSB_SUCCESS;
+}
+
+static gpointer ctl_rd_key(const struct ctl_header *header)
+{
+    return GUINT_TO_POINTER(((guint)header->dest << 24) |
+                            ((guint)header->offset << 8) | header->size);
+}
+
+/*
+ * Called by whichever thread polls the status, while the session
+ * thread goes on replaying.
+ */
+SR_PRIV int dsl_replay_ctl_rd(struct DSL_context *devc, struct ctl_rd_cmd cmd)
+{
+    struct dsl_replay *replay = devc->replay;
+    const struct replay_ctl_rd *rd;
+    int ret;
+
+    g_mutex_lock(&replay->ctl_mutex);
+    rd = g_hash_table_lookup(replay->ctl_rd, ctl_rd_key(&cmd.header));
+    if (!rd) {
+        ret = SR_ERR;
+    } else {
+        ret = rd->status;
+        if (ret == SR_OK)
+            memcpy(cmd.data, rd->data, cmd.header.size);
+    }
+    g_mutex_unlock(&replay->ctl_mutex);
+
+    return ret;
+}
+
+static int read_header(FILE *file, struct dsl_record_header *header)
+{
+    if (fread(header, sizeof(*header), 1, file) != 1 ||
+        memcmp(header->magic, DSL_RECORD_MAGIC, sizeof(header->magic)))
+        return SR_ERR;
+    if (header->ch_mode >= ARRAY_SIZE(channel_modes) ||
+        channel_modes[header->ch_mode].mode != header->mode)
+        return SR_ERR;
+
+    return SR_OK;
+}
+
+static const struct DSL_profile *find_profile(uint16_t vid, uint16_t pid)
+{
+    int i;
+
+    for (i = 0; supported_DSCope[i].vid; i++)
+        if (supported_DSCope[i].vid == vid && supported_DSCope[i].pid == pid)
+            return &supported_DSCope[i];
+    for (i = 0; supported_DSLogic[i].vid; i++)
+        if (supported_DSLogic[i].vid == vid && supported_DSLogic[i].pid == pid)
+            return &supported_DSLogic[i];
+
+    return NULL;
+}
+
+static void enable_probes(struct sr_dev_inst *sdi, uint64_t ch_enable)
+{
+    GSList *l;
+
+    for (l = sdi->channels; l; l = l->next) {
+        struct sr_channel *probe = (struct sr_channel *)l->data;
+        probe->enabled = (probe->index < 64) && (ch_enable >> probe->index) & 1;
+    }
+}
+
+static void clear_private(void *priv)
+{
+    struct DSL_context *devc = priv;
+    struct dsl_replay *replay = devc->replay;
+
+    if (!replay)
+        return;
+
+    if (replay->file)
+        fclose(replay->file);
+    g_hash_table_destroy(replay->ctl_rd);
+    g_mutex_clear(&replay->ctl_mutex);
+    g_free(replay->path);
+    g_free(replay);
+    devc->replay = NULL;
+}
+
+static int dev_clear(void)
+{
+    return std_dev_clear(di, clear_private);
+}
+
+static int init(struct sr_context *sr_ctx)
+{
+    return std_hw_init(sr_ctx, di, LOG_PREFIX);
+}
+
+static GSList *scan(GSList *options)
+{
+    struct drv_context *drvc;
+    struct DSL_context *devc;
+    struct sr_dev_inst *sdi;
+    struct dsl_record_header header;
+    const struct DSL_profile *prof;
+    const char *path;
+    FILE *file;
+    int ret;
+
+    (void)options;
+
+    drvc = di->priv;
+
+    if (!(path = getenv("DSL_REPLAY")) || !*path)
+        return NULL;
+
+    if (!(file = fopen(path, "rb"))) {
+        sr_err("%s: Failed to open %s: %s.", __func__, path, strerror(errno));
+        return NULL;
+    }
+    ret = read_header(file, &header);
+    fclose(file);
+    if (ret != SR_OK) {
+        sr_err("%s: %s is not a DSL recording.", __func__, path);
+        return NULL;
+    }
+    if (!(prof = find_profile(header.vid, header.pid))) {
+        sr_err("%s: %s is of an unknown device %04x:%04x.", __func__,
+               path, header.vid, header.pid);
+        return NULL;
+    }
+
+    if (!(devc = g_try_malloc0(sizeof(struct DSL_context)))) {
+        sr_err("Device context malloc failed.");
+        return NULL;
+    }
+    if (!(devc->replay = g_try_malloc0(sizeof(struct dsl_replay)))) {
+        sr_err("Replay context malloc failed.");
+        g_free(devc);
+        return NULL;
+    }
+    devc->replay->path = g_strdup(path);
+    devc->replay->header = header;
+    g_queue_init(&devc->replay->pending);
+    devc->replay->ctl_rd = g_hash_table_new_full(g_direct_hash,
+                                                 g_direct_equal, NULL, g_free);
+    g_mutex_init(&devc->replay->ctl_mutex);
+
+    devc->profile = prof;
+    devc->ch_mode = header.ch_mode;
+    devc->cur_samplerate = header.samplerate;
+    devc->limit_samples = header.limit_samples;
+    devc->stream = header.stream;
+    devc->instant = header.instant;
+    devc->unit_pitch = header.unit_pitch;
+    devc->th_level = SR_TH_3V3;
+    devc->filter = SR_FILTER_NONE;
+    devc->timebase = 10000;
+    devc->trigger_margin = 8;
+    devc->buffer_time = DSL_BUFFER_TIME;
+    devc->total_time = DSL_TOTAL_BUFFER_TIME;
+    dsl_adjust_samplerate(devc);
+    devc->cur_samplerate = header.samplerate;
+
+    sdi = sr_dev_inst_new(header.mode, g_slist_length(drvc->instances),
+                          SR_ST_INACTIVE, prof->vendor, prof->model, "Replay");
+    if (!sdi) {
+        clear_private(devc);
+        g_free(devc);
+        return NULL;
+    }
+    sdi->priv = devc;
+    sdi->driver = di;
+    sdi->inst_type = SR_INST_USB;
+    sdi->conn = sr_usb_dev_inst_new(0, 0, NULL);
+    drvc->instances = g_slist_append(drvc->instances, sdi);
+
+    if (dsl_setup_probes(sdi, channel_modes[devc->ch_mode].num) != SR_OK)
+        return NULL;
+    enable_probes(sdi, header.ch_enable);
+
+    sr_info("%s: Replaying %s as a %s %s.", __func__, path,
+            prof->vendor, prof->model);
+
+    return g_slist_append(NULL, sdi);
+}
+
+static GSList *dev_list(void)
+{
+    return ((struct drv_context *)(di->priv))->instances;
+}
+
+static const GSList *dev_mode_list(const struct sr_dev_inst *sdi)
+{
+    return dsl_mode_list(sdi);
+}
+
+static int config_get(int id, GVariant **data, const struct sr_dev_inst *sdi,
+                      const struct sr_channel *ch,
+                      const struct sr_channel_group *cg)
+{
+    return dsl_config_get(id, data, sdi, ch, cg);
+}
+
+static int config_set(int id, GVariant *data, struct sr_dev_inst *sdi,
+                      struct sr_channel *ch,
+                      struct sr_channel_group *cg)
+{
+    struct DSL_context *devc = sdi->priv;
+
+    (void)ch;
+    (void)cg;
+
+    /* Keeping the transfers between replays, see dsl_start_transfers(). */
+    if (id == SR_CONF_REARM) {
+        devc->rearm = g_variant_get_boolean(data);
+        return SR_OK;
+    }
+
+    /* The recorded settings are the only ones there is data for. */
+    return SR_ERR_NA;
+}
+
+static int config_list(int key, GVariant **data, const struct sr_dev_inst *sdi,
+                       const struct sr_channel_group *cg)
+{
+    return dsl_config_list(key, data, sdi, cg);
+}
+
+static int dev_open(struct sr_dev_inst *sdi)
+{
+    struct DSL_context *devc = sdi->priv;
+    struct dsl_replay *replay = devc->replay;
+
+    if (sdi->status == SR_ST_ACTIVE)
+        return SR_ERR;
+
+    if (!(replay->file = fopen(replay->path, "rb"))) {
+        sr_err("%s: Failed to open %s: %s.", __func__,
+               replay->path, strerror(errno));
+        return SR_ERR;
+    }
+    sdi->status = SR_ST_ACTIVE;
+
+    return SR_OK;
+}
+
+static int dev_close(struct sr_dev_inst *sdi)
+{
+    struct DSL_context *devc = sdi->priv;
+    struct dsl_replay *replay = devc->replay;
+
+    dsl_rearm_clear(devc);
+    if (replay->file) {
+        fclose(replay->file);
+        replay->file = NULL;
+    }
+    sdi->status = SR_ST_INACTIVE;
+
+    return SR_OK;
+}
+
+static int cleanup(void)
+{
+    int ret;
+    struct drv_context *drvc;
+
+    if (!(drvc = di->priv))
+        return SR_OK;
+
+    ret = dev_clear();
+
+    g_free(drvc);
+    di->priv = NULL;
+
+    return ret;
+}
+
+static gboolean replay_read_next(struct dsl_replay *replay)
+{
+    if (!replay->has_next)
+        replay->has_next = fread(&replay->next, sizeof(replay->next),
+                                 1, replay->file) == 1;
+
+    return replay->has_next;
+}
+
+/*
+ * Keep the answer of a recorded control read for the reads made from
+ * now on, as the driver of the device would have made them.
+ */
+static gboolean replay_ctl_rd(struct DSL_context *devc, uint32_t length,
+                              int32_t status)
+{
+    struct dsl_replay *replay = devc->replay;
+    struct ctl_header header;
+    struct replay_ctl_rd *rd;
+
+    if (length < sizeof(header) ||
+        fread(&header, sizeof(header), 1, replay->file) != 1)
+        return FALSE;
+    length -= sizeof(header);
+    if (status == SR_OK && length != header.size)
+        return FALSE;
+
+    rd = g_malloc0(sizeof(*rd) + header.size);
+    rd->status = status;
+    if (fread(rd->data, 1, length, replay->file) != length) {
+        g_free(rd);
+        return FALSE;
+    }
+
+    /* As dslogic.c reads it in stream mode. */
+    if (header.dest == DSL_CTL_HW_STATUS && header.size == 1 &&
+        status == SR_OK)
+        devc->overflow = (rd->data[0] & bmSYS_OVERFLOW) != 0;
+
+    g_mutex_lock(&replay->ctl_mutex);
+    g_hash_table_replace(replay->ctl_rd, ctl_rd_key(&header), rd);
+    g_mutex_unlock(&replay->ctl_mutex);
+
+    return TRUE;
+}
+
+static struct libusb_transfer *replay_find_transfer(struct DSL_context *devc,
+                                                    gboolean trigger)
+{
+    GList *l;
+
+    for (l = devc->replay->pending.head; l; l = l->next) {
+        if ((l->data == devc->transfers[0]) == trigger)
+            return l->data;
+    }
+
+    return NULL;
+}
+
+/*
+ * Complete the submitted transfer the next record is for, or return
+ * FALSE if the recording has ended. Until the record is due the
+ * session is left to block, with this source deferred to then.
+ */
+static gboolean replay_transfer(struct DSL_context *devc)
+{
+    struct dsl_replay *replay = devc->replay;
+    struct libusb_transfer *transfer;
+    uint32_t length;
+    gint64 due;
+
+    if (!replay_read_next(replay))
+        return FALSE;
+
+    if (replay->speed > 0) {
+        due = replay->start + replay->next.time / replay->speed;
+        if (due > g_get_monotonic_time()) {
+            sr_session_source_defer(-1, due);
+            return TRUE;
+        }
+    }
+    replay->has_next = FALSE;
+
+    if (replay->next.type == DSL_RECORD_CTL_RD)
+        return replay_ctl_rd(devc, replay->next.length, replay->next.status);
+
+    length = 0;
+    transfer = replay_find_transfer(devc,
+                                    replay->next.type == DSL_RECORD_TRIGGER);
+    if (transfer) {
+        length = min(replay->next.length, (uint32_t)transfer->length);
+        if (fread(transfer->buffer, 1, length, replay->file) != length)
+            return FALSE;
+    } else {
+        sr_warn("%s: No transfer submitted for a recorded one, skipped it.",
+                __func__);
+    }
+    if (fseek(replay->file, replay->next.length - length, SEEK_CUR) != 0)
+        return FALSE;
+    if (!transfer)
+        return TRUE;
+
+    g_queue_remove(&replay->pending, transfer);
+    transfer->actual_length = length;
+    transfer->status = replay->next.status;
+    transfer->callback(transfer);
+
+    return TRUE;
+}
+
+static void replay_flush(struct DSL_context *devc)
+{
+    struct libusb_transfer *transfer;
+
+    while ((transfer = g_queue_pop_head(&devc->replay->pending))) {
+        transfer->actual_length = 0;
+        transfer->status = LIBUSB_TRANSFER_COMPLETED;
+        transfer->callback(transfer);
+    }
+}
+
+static int receive_data(int fd, int revents, const struct sr_dev_inst *sdi)
+{
+    struct DSL_context *devc;
+
+    (void)fd;
+
+    devc = sdi->priv;
+
+    /* The session is stopping. */
+    if (revents == -1)
+        devc->abort = TRUE;
+
+    if (!devc->abort &&
+        (devc->status == DSL_START || devc->status == DSL_DATA)) {
+        if (!replay_transfer(devc)) {
+            sr_info("%s: End of the recording.", __func__);
+            devc->abort = TRUE;
+        }
+    }
+
+    /*
+     * The transfers still submitted when the device would have stopped
+     * sending complete empty, which frees them.
+     */
+    if (devc->abort ||
+        (devc->status != DSL_START && devc->status != DSL_DATA))
+        replay_flush(devc);
+
+    if (devc->status == DSL_FINISH) {
+        sr_info("%s: remove fds from polling", __func__);
+        sr_source_remove(-1);
+    }
+
+    return TRUE;
+}
+
+static int dev_acquisition_start(struct sr_dev_inst *sdi, void *cb_data)
+{
+    struct DSL_context *devc;
+    struct dsl_replay *replay;
+    const char *speed;
+    int ret;
+
+    (void)cb_data;
+
+    if (sdi->status != SR_ST_ACTIVE)
+        return SR_ERR_DEV_CLOSED;
+
+    devc = sdi->priv;
+    replay = devc->replay;
+
+    devc->cb_data = sdi;
+    devc->num_samples = 0;
+    devc->num_bytes = 0;
+    devc->empty_transfer_count = 0;
+    devc->status = DSL_INIT;
+    devc->num_transfers = 0;
+    devc->submitted_transfers = 0;
+    devc->abort = FALSE;
+    devc->mstatus_valid = FALSE;
+    devc->overflow = FALSE;
+
+    /* Sized as recorded, whatever the channels have been set to since. */
+    enable_probes(sdi, replay->header.ch_enable);
+    devc->actual_samples = replay->header.actual_samples;
+    devc->actual_bytes = replay->header.actual_bytes;
+
+    if (fseek(replay->file, sizeof(struct dsl_record_header), SEEK_SET) != 0)
+        return SR_ERR;
+    g_queue_clear(&replay->pending);
+    replay->has_next = FALSE;
+    g_mutex_lock(&replay->ctl_mutex);
+    g_hash_table_remove_all(replay->ctl_rd);
+    g_mutex_unlock(&replay->ctl_mutex);
+    speed = getenv("DSL_REPLAY_SPEED");
+    replay->speed = speed ? g_ascii_strtod(speed, NULL) : 0;
+    replay->start = g_get_monotonic_time();
+
+    if ((ret = dsl_start_transfers(sdi)) != SR_OK) {
+        sr_err("%s: Could not submit the replayed transfers.", __func__);
+        return ret;
+    }
+
+    /* Always ready, the recording is read as the loop goes round. */
+    if ((ret = sr_source_add(-1, 0, 0, receive_data, sdi)) != SR_OK)
+        return ret;
+
+    devc->status = DSL_START;
+
+    std_session_send_df_header(sdi, LOG_PREFIX);
+
+    return SR_OK;
+}
+
+static int dev_acquisition_stop(const struct sr_dev_inst *sdi, void *cb_data)
+{
+    struct DSL_context *devc = sdi->priv;
+
+    (void)cb_data;
+
+    devc->abort = TRUE;
+
+    return SR_OK;
+}
+
+static int dev_status_get(const struct sr_dev_inst *sdi, struct sr_status *status, gboolean prg, int begin, int end)
+{
+    /* Read from the recording, see dsl_replay_ctl_rd(). */
+    return dsl_dev_status_get(sdi, status, prg, begin, end);
+}
+
+SR_PRIV struct sr_dev_driver DSReplay_driver_info = {
+    .name = "DSReplay",
+    .longname = "DSReplay (replays a recording of a DSLogic or DSCope)",
+    .api_version = 1,
+    .init = init,
+    .cleanup = cleanup,
+    .scan = scan,
+    .dev_list = dev_list,
+    .dev_mode_list = dev_mode_list,
+    .dev_clear = dev_clear,
+    .config_get = config_get,
+    .config_set = config_set,
+    .config_list = config_list,
+    .dev_open = dev_open,
+    .dev_close = dev_close,
+    .dev_status_get = dev_status_get,
+    .dev_acquisition_start = dev_acquisition_start,
+    .dev_acquisition_stop = dev_acquisition_stop,
+    .priv = NULL,
+};
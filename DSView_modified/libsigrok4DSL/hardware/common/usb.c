@@ -243,3 +243,214 @@ SR_PRIV int sr_usb_open(libusb_context *usb_ctx, struct sr_usb_dev_inst *usb)
 
     return ret;
 }
+
+/* A callback registered with usb_source_add(). */
+struct usb_source {
+    int timeout;
+    sr_receive_data_callback_t cb;
+    const struct sr_dev_inst *sdi;
+};
+
+/*
+ * The callback of the session sources of the libusb descriptors, sdi is
+ * the dispatcher of the context. There is one libusb context, so with
+ * several devices acquiring every one of them gets called on an event of
+ * any of the descriptors. A callback may remove its own registration.
+ */
+static int usb_source_dispatch(int fd, int revents,
+        const struct sr_dev_inst *sdi)
+{
+    struct sr_context *ctx = sdi->priv;
+    struct usb_source *us;
+    GSList *l, *next;
+
+    for (l = ctx->usb_sources; l; l = next) {
+        next = l->next;
+        us = l->data;
+        us->cb(fd, revents, us->sdi);
+    }
+
+    return TRUE;
+}
+
+/* The shortest timeout of the registrations, 0 if none of them has one. */
+static int usb_source_timeout(struct sr_context *ctx)
+{
+    struct usb_source *us;
+    GSList *l;
+    int timeout;
+
+    timeout = 0;
+    for (l = ctx->usb_sources; l; l = l->next) {
+        us = l->data;
+        if (us->timeout > 0 && (timeout == 0 || us->timeout < timeout))
+            timeout = us->timeout;
+    }
+
+    return timeout;
+}
+
+static void usb_pollfd_added(int fd, short events, void *user_data)
+{
+    struct sr_context *ctx = user_data;
+
+    sr_dbg("Polling new libusb descriptor %d.", fd);
+    sr_session_source_add(fd, events, ctx->usb_source_timeout,
+                          usb_source_dispatch, ctx->usb_dispatcher);
+}
+
+static void usb_pollfd_removed(int fd, void *user_data)
+{
+    (void)user_data;
+
+    sr_dbg("No longer polling libusb descriptor %d.", fd);
+    sr_session_source_remove(fd);
+}
+
+static void usb_pollfds_remove(struct sr_context *ctx)
+{
+    const struct libusb_pollfd **lupfd;
+    int i;
+
+    libusb_set_pollfd_notifiers(ctx->libusb_ctx, NULL, NULL, NULL);
+    ctx->usb_source_present = FALSE;
+
+    if (!(lupfd = libusb_get_pollfds(ctx->libusb_ctx))) {
+        sr_err("Failed to get the libusb descriptors.");
+        return;
+    }
+    for (i = 0; lupfd[i]; i++)
+        sr_session_source_remove(lupfd[i]->fd);
+    free(lupfd);
+}
+
+static int usb_pollfds_add(struct sr_context *ctx, int timeout)
+{
+    const struct libusb_pollfd **lupfd;
+    int i, ret;
+
+    if (!(lupfd = libusb_get_pollfds(ctx->libusb_ctx))) {
+        sr_err("Failed to get the libusb descriptors.");
+        return SR_ERR;
+    }
+
+    ret = SR_OK;
+    for (i = 0; lupfd[i]; i++) {
+        if ((ret = sr_session_source_add(lupfd[i]->fd, lupfd[i]->events,
+                timeout, usb_source_dispatch,
+                ctx->usb_dispatcher)) != SR_OK)
+            break;
+    }
+    if (ret != SR_OK) {
+        while (i-- > 0)
+            sr_session_source_remove(lupfd[i]->fd);
+        free(lupfd);
+        return ret;
+    }
+    free(lupfd);
+
+    ctx->usb_source_timeout = timeout;
+    ctx->usb_source_present = TRUE;
+    libusb_set_pollfd_notifiers(ctx->libusb_ctx, usb_pollfd_added,
+                                usb_pollfd_removed, ctx);
+
+    return SR_OK;
+}
+
+/**
+ * Add session sources for the descriptors of libusb, so the session
+ * sleeps in g_poll() until a transfer completes or times out instead of
+ * waking up to poll libusb. Descriptors libusb adds or removes later on
+ * are added or removed along with them.
+ *
+ * Each device acquiring registers its callback, the descriptors are
+ * polled once for all of them, with the shortest of their timeouts.
+ *
+ * @param ctx The context whose libusb context to follow.
+ * @param timeout Max time to wait before cb is called, ignored if 0.
+ * @param cb Callback handling the libusb events.
+ * @param sdi Passed to cb, and identifies the registration.
+ *
+ * @return SR_OK upon success, SR_ERR upon errors.
+ */
+SR_PRIV int usb_source_add(struct sr_context *ctx, int timeout,
+        sr_receive_data_callback_t cb, const struct sr_dev_inst *sdi)
+{
+    struct usb_source *us;
+    GSList *l;
+    int ret;
+
+    for (l = ctx->usb_sources; l; l = l->next) {
+        us = l->data;
+        if (us->sdi == sdi) {
+            sr_err("A USB event source is already present.");
+            return SR_ERR;
+        }
+    }
+
+    if (!ctx->usb_dispatcher) {
+        ctx->usb_dispatcher = g_malloc0(sizeof(struct sr_dev_inst));
+        ctx->usb_dispatcher->priv = ctx;
+    }
+
+    us = g_malloc0(sizeof(struct usb_source));
+    us->timeout = timeout;
+    us->cb = cb;
+    us->sdi = sdi;
+    ctx->usb_sources = g_slist_append(ctx->usb_sources, us);
+
+    timeout = usb_source_timeout(ctx);
+    if (ctx->usb_source_present) {
+        if (timeout == ctx->usb_source_timeout)
+            return SR_OK;
+        usb_pollfds_remove(ctx);
+    }
+
+    if ((ret = usb_pollfds_add(ctx, timeout)) != SR_OK) {
+        ctx->usb_sources = g_slist_remove(ctx->usb_sources, us);
+        g_free(us);
+    }
+
+    return ret;
+}
+
+/**
+ * Remove the registration of a device added by usb_source_add(), and
+ * the session sources along with the last one.
+ *
+ * @param ctx The context passed to usb_source_add().
+ * @param sdi The device instance passed to usb_source_add().
+ *
+ * @return SR_OK upon success, SR_ERR upon errors.
+ */
+SR_PRIV int usb_source_remove(struct sr_context *ctx,
+        const struct sr_dev_inst *sdi)
+{
+    struct usb_source *us;
+    GSList *l;
+    int timeout;
+
+    for (l = ctx->usb_sources; l; l = l->next) {
+        us = l->data;
+        if (us->sdi == sdi)
+            break;
+    }
+    if (!l)
+        return SR_OK;
+
+    ctx->usb_sources = g_slist_delete_link(ctx->usb_sources, l);
+    g_free(us);
+
+    if (!ctx->usb_source_present)
+        return SR_OK;
+
+    timeout = usb_source_timeout(ctx);
+    if (ctx->usb_sources && timeout == ctx->usb_source_timeout)
+        return SR_OK;
+
+    usb_pollfds_remove(ctx);
+    if (ctx->usb_sources)
+        return usb_pollfds_add(ctx, timeout);
+
+    return SR_OK;
+}
@@ -70,6 +70,9 @@ static struct sr_dev_driver *di = &demo_driver_info;
 extern struct ds_trigger *trigger;
 
 static int hw_dev_acquisition_stop(const struct sr_dev_inst *sdi, void *cb_data);
+static void rng_seed(struct demo_context *devc, int index);
+static void aes_setup(struct demo_context *devc);
+static void logic_setup(struct demo_context *devc);
 
 static int clear_instances(void)
 {
@@ -140,48 +143,64 @@ static int setup_probes(struct sr_dev_inst *sdi, int num_probes)
     return SR_OK;
 }
 
+/*
+ * DEMO_DEVICES in the environment sets the number of devices scanned,
+ * to have several of them acquire together, see sync_driver.c.
+ */
 static GSList *hw_scan(GSList *options)
 {
 	struct sr_dev_inst *sdi;
 	struct drv_context *drvc;
     struct demo_context *devc;
 	GSList *devices;
+    const char *s;
+    int i, num_devices;
 
 	(void)options;
 	drvc = di->priv;
 	devices = NULL;
 
-    if (!(devc = g_try_malloc(sizeof(struct demo_context)))) {
-        sr_err("Device context malloc failed.");
-        return NULL;
-    }
-    devc->profile = &supported_Demo[0];
-    devc->ch_mode = devc->profile->dev_caps.default_channelmode;
-    devc->cur_samplerate = channel_modes[devc->ch_mode].default_samplerate;
-    devc->limit_samples = channel_modes[devc->ch_mode].default_samplelimit;
-    devc->limit_samples_show = devc->limit_samples;
-    devc->limit_msec = 0;
-    devc->sample_generator = devc->profile->dev_caps.default_pattern;
-    devc->timebase = devc->profile->dev_caps.default_timebase;
-    devc->max_height = 0;
-    adjust_samplerate(devc);
-
-    sdi = sr_dev_inst_new(channel_modes[devc->ch_mode].mode, 0, SR_ST_INITIALIZING,
-                          devc->profile->vendor,
-                          devc->profile->model,
-                          devc->profile->model_version);
-	if (!sdi) {
-        g_free(devc);
-        sr_err("Device instance creation failed.");
-		return NULL;
-	}
-    sdi->priv = devc;
-	sdi->driver = di;
+    num_devices = 1;
+    if ((s = getenv("DEMO_DEVICES")) && *s)
+        num_devices = MAX(1, atoi(s));
 
-	devices = g_slist_append(devices, sdi);
-	drvc->instances = g_slist_append(drvc->instances, sdi);
+    for (i = 0; i < num_devices; i++) {
+        if (!(devc = g_try_malloc(sizeof(struct demo_context)))) {
+            sr_err("Device context malloc failed.");
+            break;
+        }
+        devc->profile = &supported_Demo[0];
+        devc->ch_mode = devc->profile->dev_caps.default_channelmode;
+        devc->cur_samplerate = channel_modes[devc->ch_mode].default_samplerate;
+        devc->limit_samples = channel_modes[devc->ch_mode].default_samplelimit;
+        devc->limit_samples_show = devc->limit_samples;
+        devc->limit_msec = 0;
+        devc->sample_generator = devc->profile->dev_caps.default_pattern;
+        devc->timebase = devc->profile->dev_caps.default_timebase;
+        devc->max_height = 0;
+        adjust_samplerate(devc);
+        rng_seed(devc, i);
+        aes_setup(devc);
+        logic_setup(devc);
+
+        sdi = sr_dev_inst_new(channel_modes[devc->ch_mode].mode, i,
+                              SR_ST_INITIALIZING,
+                              devc->profile->vendor,
+                              devc->profile->model,
+                              devc->profile->model_version);
+        if (!sdi) {
+            g_free(devc);
+            sr_err("Device instance creation failed.");
+            break;
+        }
+        sdi->priv = devc;
+        sdi->driver = di;
+
+        devices = g_slist_append(devices, sdi);
+        drvc->instances = g_slist_append(drvc->instances, sdi);
 
-    setup_probes(sdi, channel_modes[devc->ch_mode].num);
+        setup_probes(sdi, channel_modes[devc->ch_mode].num);
+    }
 
 	return devices;
 }
@@ -310,7 +329,10 @@ static int config_get(int id, GVariant **data, const struct sr_dev_inst *sdi,
         *data = g_variant_new_boolean(devc->instant);
         break;
     case SR_CONF_PATTERN_MODE:
-        *data = g_variant_new_string(pattern_strings[devc->sample_generator]);
+        if (sdi->mode == LOGIC)
+            *data = g_variant_new_string(logic_pattern_strings[devc->logic_generator]);
+        else
+            *data = g_variant_new_string(pattern_strings[devc->sample_generator]);
 		break;
     case SR_CONF_MAX_HEIGHT:
         *data = g_variant_new_string(maxHeights[devc->max_height]);
@@ -449,7 +471,16 @@ static int config_set(int id, GVariant *data, struct sr_dev_inst *sdi,
     }else if (id == SR_CONF_PATTERN_MODE) {
         stropt = g_variant_get_string(data, NULL);
         ret = SR_OK;
-        if (!strcmp(stropt, pattern_strings[PATTERN_SINE])) {
+        if (sdi->mode == LOGIC) {
+            for (i = 0; i < ARRAY_SIZE(logic_pattern_strings); i++) {
+                if (!strcmp(stropt, logic_pattern_strings[i])) {
+                    devc->logic_generator = i;
+                    break;
+                }
+            }
+            if (i == ARRAY_SIZE(logic_pattern_strings))
+                ret = SR_ERR;
+        } else if (!strcmp(stropt, pattern_strings[PATTERN_SINE])) {
             devc->sample_generator = PATTERN_SINE;
         } else if (!strcmp(stropt, pattern_strings[PATTERN_SQUARE])) {
             devc->sample_generator = PATTERN_SQUARE;
@@ -459,11 +490,13 @@ static int config_set(int id, GVariant *data, struct sr_dev_inst *sdi,
             devc->sample_generator = PATTERN_SAWTOOTH;
         } else if (!strcmp(stropt, pattern_strings[PATTERN_RANDOM])) {
             devc->sample_generator = PATTERN_RANDOM;
+        } else if (!strcmp(stropt, pattern_strings[PATTERN_AES])) {
+            devc->sample_generator = PATTERN_AES;
 		} else {
             ret = SR_ERR;
 		}
         sr_dbg("%s: setting pattern to %d",
-			__func__, devc->sample_generator);
+			__func__, (sdi->mode == LOGIC) ? devc->logic_generator : devc->sample_generator);
     } else if (id == SR_CONF_MAX_HEIGHT) {
         stropt = g_variant_get_string(data, NULL);
         ret = SR_OK;
@@ -583,7 +616,12 @@ static int config_list(int key, GVariant **data, const struct sr_dev_inst *sdi,
 		*data = g_variant_builder_end(&gvb);
 		break;
     case SR_CONF_PATTERN_MODE:
-		*data = g_variant_new_strv(pattern_strings, ARRAY_SIZE(pattern_strings));
+        if (sdi->mode == LOGIC)
+            *data = g_variant_new_strv(logic_pattern_strings, ARRAY_SIZE(logic_pattern_strings));
+        else if (sdi->mode == DSO)
+            *data = g_variant_new_strv(pattern_strings, ARRAY_SIZE(pattern_strings));
+        else
+            *data = g_variant_new_strv(pattern_strings, PATTERN_AES);
 		break;
     case SR_CONF_MAX_HEIGHT:
         *data = g_variant_new_strv(maxHeights, ARRAY_SIZE(maxHeights));
@@ -622,6 +660,410 @@ static int config_list(int key, GVariant **data, const struct sr_dev_inst *sdi,
     return SR_OK;
 }
 
+/* With a channel off, both report the range of the one left */
+static void merge_status(const struct sr_dev_inst *sdi,
+                         struct demo_context *devc)
+{
+    GSList *l;
+    struct sr_channel *probe;
+
+    for (l = sdi->channels; l; l = l->next) {
+        probe = (struct sr_channel *)l->data;
+        if (!probe->enabled) {
+            devc->mstatus.ch1_max = MAX(devc->mstatus.ch0_max, devc->mstatus.ch1_max);
+            devc->mstatus.ch1_min = MIN(devc->mstatus.ch0_min, devc->mstatus.ch1_min);
+            devc->mstatus.ch0_max = MAX(devc->mstatus.ch0_max, devc->mstatus.ch1_max);
+            devc->mstatus.ch0_min = MIN(devc->mstatus.ch0_min, devc->mstatus.ch1_min);
+            break;
+        }
+    }
+}
+
+static uint64_t splitmix(uint64_t *x)
+{
+    uint64_t z = (*x += 0x9e3779b97f4a7c15ULL);
+
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+/*
+ * n random words, n a multiple of RNG_LANES. Each lane is a
+ * xorshift128+ of its own, so the inner loop vectorizes.
+ */
+static void rng_fill(struct demo_context *devc, uint64_t *out,
+                         unsigned int n)
+{
+    uint64_t s0[RNG_LANES], s1[RNG_LANES];
+    uint64_t x, y;
+    unsigned int i, j;
+
+    memcpy(s0, devc->rng[0], sizeof(s0));
+    memcpy(s1, devc->rng[1], sizeof(s1));
+    for (i = 0; i < n; i += RNG_LANES) {
+        for (j = 0; j < RNG_LANES; j++) {
+            x = s0[j];
+            y = s1[j];
+            s0[j] = y;
+            x ^= x << 23;
+            s1[j] = x ^ y ^ (x >> 17) ^ (y >> 26);
+            out[i + j] = s1[j] + y;
+        }
+    }
+    memcpy(devc->rng[0], s0, sizeof(s0));
+    memcpy(devc->rng[1], s1, sizeof(s1));
+}
+
+static double env_double(const char *name, double def)
+{
+    const char *s = getenv(name);
+
+    return (s && *s) ? g_ascii_strtod(s, NULL) : def;
+}
+
+/* DEMO_SEED makes the random patterns repeat from run to run */
+static void rng_seed(struct demo_context *devc, int index)
+{
+    const char *s;
+    uint64_t seed;
+    unsigned int i;
+
+    if ((s = getenv("DEMO_SEED")) && *s)
+        seed = g_ascii_strtoull(s, NULL, 0);
+    else
+        seed = g_get_real_time() ^ ((uint64_t)g_get_monotonic_time() << 32);
+    /* each device its own sequence, also with DEMO_SEED */
+    seed += index;
+    for (i = 0; i < RNG_LANES; i++) {
+        devc->rng[0][i] = splitmix(&seed);
+        devc->rng[1][i] = splitmix(&seed);
+    }
+}
+
+/*
+ * PATTERN_AES: channel 0 is the power trace of an 8-bit target running
+ * AES-128 in software, channel 1 the GPIO it raises around the
+ * encryption. Every frame is the encryption of a new random plaintext.
+ *
+ * The target is set up from the environment when the device is scanned:
+ *   DEMO_AES_KEY     the key, 32 hex digits (the FIPS-197 example key)
+ *   DEMO_AES_LEAK    the leaking intermediates, "hw<r>" for the Hamming
+ *                    weight of the SubBytes output of round r and
+ *                    "hd<r>" for the Hamming distance of the state
+ *                    update of round r ("hw1,hd10")
+ *   DEMO_AES_GAIN    leakage per bit in mV (10)
+ *   DEMO_AES_NOISE   standard deviation of the Gaussian noise in mV (10)
+ *   DEMO_AES_JITTER  largest shift of the encryption against the GPIO,
+ *                    in samples (2)
+ *   DEMO_AES_DRIFT   amplitude of the DC drift in mV (20)
+ *   DEMO_AES_UNPACED if set, frames are sent as fast as the session
+ *                    takes them rather than at the samplerate
+ *
+ * The plaintext and ciphertext of each trace go ahead of its first
+ * samples as SR_CONF_TRACE_TEXTS in an SR_DF_META packet.
+ */
+#define AES_NOISE_BLOCK        256
+/* Activity of the byte operations which do not leak, in bits */
+#define AES_BASE_BITS          4
+/* GPIO level in mV */
+#define AES_GPIO_LEVEL         3300
+/* Traces per period of the DC drift */
+#define AES_DRIFT_PERIOD       1000
+/* How long an unpaced poll keeps sending, in us */
+#define AES_UNPACED_TIME       20000
+
+static const uint8_t aes_sbox[256] = {
+    0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76,
+    0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0, 0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0,
+    0xb7, 0xfd, 0x93, 0x26, 0x36, 0x3f, 0xf7, 0xcc, 0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
+    0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a, 0x07, 0x12, 0x80, 0xe2, 0xeb, 0x27, 0xb2, 0x75,
+    0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0, 0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84,
+    0x53, 0xd1, 0x00, 0xed, 0x20, 0xfc, 0xb1, 0x5b, 0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
+    0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85, 0x45, 0xf9, 0x02, 0x7f, 0x50, 0x3c, 0x9f, 0xa8,
+    0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5, 0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2,
+    0xcd, 0x0c, 0x13, 0xec, 0x5f, 0x97, 0x44, 0x17, 0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
+    0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88, 0x46, 0xee, 0xb8, 0x14, 0xde, 0x5e, 0x0b, 0xdb,
+    0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c, 0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79,
+    0xe7, 0xc8, 0x37, 0x6d, 0x8d, 0xd5, 0x4e, 0xa9, 0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
+    0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6, 0xe8, 0xdd, 0x74, 0x1f, 0x4b, 0xbd, 0x8b, 0x8a,
+    0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e, 0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e,
+    0xe1, 0xf8, 0x98, 0x11, 0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
+    0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f, 0xb0, 0x54, 0xbb, 0x16,
+};
+
+static uint8_t aes_xtime(uint8_t x)
+{
+    return (x << 1) ^ ((x >> 7) * 0x1b);
+}
+
+static void aes_expand_key(const uint8_t *key, uint8_t *rk)
+{
+    static const uint8_t rcon[10] = {
+        0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1b, 0x36,
+    };
+    uint8_t t[4], tmp;
+    int i, j;
+
+    memcpy(rk, key, 16);
+    for (i = 4; i < 44; i++) {
+        memcpy(t, rk + 4 * (i - 1), 4);
+        if (i % 4 == 0) {
+            tmp = t[0];
+            t[0] = aes_sbox[t[1]] ^ rcon[i / 4 - 1];
+            t[1] = aes_sbox[t[2]];
+            t[2] = aes_sbox[t[3]];
+            t[3] = aes_sbox[tmp];
+        }
+        for (j = 0; j < 4; j++)
+            rk[4 * i + j] = rk[4 * (i - 4) + j] ^ t[j];
+    }
+}
+
+/* The state, column major, after the first AddRoundKey and each round */
+static void aes_encrypt(const uint8_t *rk, const uint8_t *in,
+                        uint8_t state[11][16])
+{
+    uint8_t t[16], a, b, c, d, e;
+    int r, i;
+
+    for (i = 0; i < 16; i++)
+        state[0][i] = in[i] ^ rk[i];
+    for (r = 1; r <= 10; r++) {
+        /* SubBytes and ShiftRows */
+        for (i = 0; i < 16; i++)
+            t[i] = aes_sbox[state[r - 1][(i + 4 * (i % 4)) % 16]];
+        if (r < 10) {
+            for (i = 0; i < 16; i += 4) {
+                a = t[i];
+                b = t[i + 1];
+                c = t[i + 2];
+                d = t[i + 3];
+                e = a ^ b ^ c ^ d;
+                t[i] ^= e ^ aes_xtime(a ^ b);
+                t[i + 1] ^= e ^ aes_xtime(b ^ c);
+                t[i + 2] ^= e ^ aes_xtime(c ^ d);
+                t[i + 3] ^= e ^ aes_xtime(d ^ a);
+            }
+        }
+        for (i = 0; i < 16; i++)
+            state[r][i] = t[i] ^ rk[16 * r + i];
+    }
+}
+
+static int aes_hw(uint8_t x)
+{
+    x = x - ((x >> 1) & 0x55);
+    x = (x & 0x33) + ((x >> 2) & 0x33);
+    return (x + (x >> 4)) & 0x0f;
+}
+
+/*
+ * A standard normal value from one random word: the sum of its four
+ * 16 bit halves, which is close enough to Gaussian for noise.
+ */
+static double aes_gauss(uint64_t r)
+{
+    const double sum = (double)(r & 0xffff) + ((r >> 16) & 0xffff) +
+                       ((r >> 32) & 0xffff) + (r >> 48);
+
+    return (sum - 2 * 65535.0) / (65536.0 / sqrt(3.0));
+}
+
+static void aes_setup(struct demo_context *devc)
+{
+    static const uint8_t default_key[16] = {
+        0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6,
+        0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c,
+    };
+    uint8_t key[16];
+    const char *s;
+    char **tokens, *end;
+    unsigned int i, r;
+
+    memcpy(key, default_key, 16);
+    if ((s = getenv("DEMO_AES_KEY")) && *s) {
+        for (i = 0; i < 16 && g_ascii_isxdigit(s[2 * i]) &&
+                    g_ascii_isxdigit(s[2 * i + 1]); i++)
+            key[i] = (g_ascii_xdigit_value(s[2 * i]) << 4) |
+                     g_ascii_xdigit_value(s[2 * i + 1]);
+        if (i != 16 || s[32] != '\0') {
+            sr_err("DEMO_AES_KEY needs 32 hex digits, using the default key.");
+            memcpy(key, default_key, 16);
+        }
+    }
+    aes_expand_key(key, devc->aes_rk);
+
+    devc->aes_leak_hw = 1 << 1;
+    devc->aes_leak_hd = 1 << 10;
+    if ((s = getenv("DEMO_AES_LEAK"))) {
+        devc->aes_leak_hw = 0;
+        devc->aes_leak_hd = 0;
+        tokens = g_strsplit(s, ",", 0);
+        for (i = 0; tokens[i]; i++) {
+            g_strstrip(tokens[i]);
+            r = strtoul(tokens[i] + MIN(strlen(tokens[i]), 2), &end, 10);
+            if (*end != '\0' || r < 1 || r > 10)
+                sr_err("Ignoring leak '%s' in DEMO_AES_LEAK.", tokens[i]);
+            else if (!strncmp(tokens[i], "hw", 2))
+                devc->aes_leak_hw |= 1 << r;
+            else if (!strncmp(tokens[i], "hd", 2))
+                devc->aes_leak_hd |= 1 << r;
+            else
+                sr_err("Ignoring leak '%s' in DEMO_AES_LEAK.", tokens[i]);
+        }
+        g_strfreev(tokens);
+    }
+
+    devc->aes_gain = env_double("DEMO_AES_GAIN", 10);
+    devc->aes_noise = env_double("DEMO_AES_NOISE", 10);
+    devc->aes_drift = env_double("DEMO_AES_DRIFT", 20);
+    devc->aes_jitter = MAX(env_double("DEMO_AES_JITTER", 2), 0);
+
+    devc->aes_traces = 0;
+    devc->aes_trace = NULL;
+    devc->aes_unpaced = getenv("DEMO_AES_UNPACED") != NULL;
+}
+
+/*
+ * Encrypt a new plaintext and lay out the noise free trace: ten rounds
+ * between the first and last tenth of the frame, each with 16 byte
+ * slots for SubBytes and 16 for the state update. Every slot draws a
+ * decaying pulse, as large as its leakage where it leaks.
+ */
+static void aes_new_trace(struct demo_context *devc)
+{
+    uint8_t state[11][16];
+    uint64_t rnd[RNG_LANES];
+    const uint64_t len = devc->limit_samples;
+    float *const trace = devc->aes_trace;
+    uint64_t slot, pos, k;
+    int64_t start;
+    double drift, amp;
+    int r, i, op;
+
+    rng_fill(devc, rnd, RNG_LANES);
+    memcpy(devc->aes_pt, rnd, 16);
+    aes_encrypt(devc->aes_rk, devc->aes_pt, state);
+    memcpy(devc->aes_ct, state[10], 16);
+
+    drift = devc->aes_drift *
+            sin(2 * G_PI * devc->aes_traces / AES_DRIFT_PERIOD);
+    for (k = 0; k < len; k++)
+        trace[k] = drift;
+
+    start = len / 10;
+    if (devc->aes_jitter)
+        start += (int64_t)(rnd[2] % (2 * devc->aes_jitter + 1)) -
+                 devc->aes_jitter;
+    start = MAX(start, 0);
+    slot = MAX(len * 8 / 10 / 10 / 32, 1);
+
+    for (r = 1; r <= 10; r++) {
+        for (op = 0; op < 2; op++) {
+            for (i = 0; i < 16; i++) {
+                if (op == 0 && (devc->aes_leak_hw & (1 << r)))
+                    amp = aes_hw(aes_sbox[state[r - 1][i]]);
+                else if (op == 1 && (devc->aes_leak_hd & (1 << r)))
+                    amp = aes_hw(state[r - 1][i] ^ state[r][i]);
+                else
+                    amp = AES_BASE_BITS;
+                amp *= devc->aes_gain;
+                pos = start + (((r - 1) * 2 + op) * 16 + i) * slot;
+                for (k = 0; k < slot && pos + k < len; k++)
+                    trace[pos + k] += amp * (slot - k) / slot;
+            }
+        }
+    }
+
+    sr_spew("AES trace %" PRIu64 ": ciphertext %02x%02x%02x%02x...",
+            devc->aes_traces, devc->aes_ct[0], devc->aes_ct[1],
+            devc->aes_ct[2], devc->aes_ct[3]);
+    devc->aes_traces++;
+}
+
+/* Tell the session the texts of the trace whose samples follow */
+static void aes_send_texts(const struct sr_dev_inst *sdi,
+                           struct demo_context *devc)
+{
+    struct sr_datafeed_packet packet;
+    struct sr_datafeed_meta meta;
+    struct sr_config *src;
+    uint8_t texts[32];
+
+    memcpy(texts, devc->aes_pt, 16);
+    memcpy(texts + 16, devc->aes_ct, 16);
+    src = sr_config_new(SR_CONF_TRACE_TEXTS,
+            g_variant_new_fixed_array(G_VARIANT_TYPE_BYTE, texts, 32, 1));
+    meta.config = g_slist_append(NULL, src);
+    packet.type = SR_DF_META;
+    packet.status = SR_PKT_OK;
+    packet.payload = &meta;
+    sr_session_send(sdi, &packet);
+    g_slist_free(meta.config);
+    sr_config_free(src);
+}
+
+static void aes_samples_generator(uint16_t *buf, uint64_t size,
+                                  const struct sr_dev_inst *sdi,
+                                  struct demo_context *devc)
+{
+    uint64_t rnd[AES_NOISE_BLOCK];
+    /* instant captures send each packet from the start of the buffer */
+    const uint64_t pos = devc->instant ? devc->samples_counter :
+                                         devc->pre_index;
+    const uint64_t end = pos + size;
+    const uint64_t len = devc->limit_samples;
+    uint16_t *const out = buf + devc->pre_index;
+    GSList *l;
+    struct sr_channel *probe;
+    uint64_t i, j, n;
+    double scale, offset, v;
+    int sample;
+
+    if (pos == 0) {
+        aes_new_trace(devc);
+        aes_send_texts(sdi, devc);
+    }
+
+    for (l = sdi->channels; l; l = l->next) {
+        probe = (struct sr_channel *)l->data;
+        /* The ADC counts down, 255 counts over ten divisions */
+        scale = 255 / (10.0 * probe->vdiv);
+        offset = ceil((0.5 - (probe->vpos/probe->vdiv/10.0)) * 255);
+        for (i = pos; i < end; i += n) {
+            n = MIN(AES_NOISE_BLOCK, end - i);
+            if (probe->index == 0)
+                rng_fill(devc, rnd, (n + RNG_LANES - 1) &
+                                        ~(uint64_t)(RNG_LANES - 1));
+            for (j = 0; j < n; j++) {
+                if (probe->index == 0)
+                    v = devc->aes_trace[i + j] +
+                        devc->aes_noise * aes_gauss(rnd[j]);
+                else
+                    v = (i + j >= len / 10 && i + j < len * 9 / 10) ?
+                        AES_GPIO_LEVEL : 0;
+                if (probe->coupling == SR_AC_COUPLING)
+                    v -= (probe->index == 0) ?
+                         AES_BASE_BITS * devc->aes_gain : AES_GPIO_LEVEL * 0.8;
+                else if (probe->coupling != SR_DC_COUPLING)
+                    v = 0;
+                sample = offset - v * scale;
+                sample = MIN(MAX(sample, 0), 255);
+                *(out + i - pos + j) += sample << (probe->index * 8);
+
+                if (probe->index == 0) {
+                    devc->mstatus.ch0_max = MAX(devc->mstatus.ch0_max, sample);
+                    devc->mstatus.ch0_min = MIN(devc->mstatus.ch0_min, sample);
+                } else {
+                    devc->mstatus.ch1_max = MAX(devc->mstatus.ch1_max, sample);
+                    devc->mstatus.ch1_min = MIN(devc->mstatus.ch1_min, sample);
+                }
+            }
+        }
+    }
+}
+
 static void samples_generator(uint16_t *buf, uint64_t size,
                               const struct sr_dev_inst *sdi,
                               struct demo_context *devc)
@@ -634,8 +1076,6 @@ static void samples_generator(uint16_t *buf, uint64_t size,
     double span = 1;
     const uint64_t len = ARRAY_SIZE(sinx) - 1;
     const int *pre_buf;
-    uint16_t tmp_u16 = 0;
-    unsigned int ch_num = en_ch_num(sdi) ? en_ch_num(sdi) : 1;
     uint64_t index = 0;
 
     switch (devc->sample_generator) {
@@ -663,22 +1103,6 @@ static void samples_generator(uint16_t *buf, uint64_t size,
         size != devc->limit_samples) {
         for (i = 0; i < devc->limit_samples; i++)
             *(buf + i) = *(buf + ((i + size)%devc->limit_samples));
-    } else if (sdi->mode == LOGIC) {
-        for (i = 0; i < size; i++) {
-            //index = (i/10/g_slist_length(sdi->channels)+start_rand)%len;
-            //*(buf + i) = (uint16_t)(((const_dc+pre_buf[index]) << 8) + (const_dc+pre_buf[index]));
-            tmp_u16 = 0;
-            if (i < ch_num*4)
-                *(buf + i) = tmp_u16;
-            else if (i % 4 == 0) {
-                start_rand = rand() % (ch_num * 4);
-                if (start_rand == (i/4 % ch_num))
-                    tmp_u16 = 0xffff;
-                *(buf + i) = tmp_u16 ? ~*(buf + i - ch_num*4) : *(buf + i - ch_num*4);
-            } else {
-                *(buf + i) = *(buf + i - 1);
-            }
-        }
 //    } else if (sdi->mode == ANALOG) {
 //        for (i = 0; i < size; i++) {
 //            *(buf + i) = 0x8080;
@@ -714,6 +1138,13 @@ static void samples_generator(uint16_t *buf, uint64_t size,
         else if (sdi->mode == ANALOG)
             memset(buf, 0, size*sizeof(uint16_t));
 
+        if (sdi->mode == DSO && devc->sample_generator == PATTERN_AES &&
+            devc->aes_trace) {
+            aes_samples_generator(buf, size, sdi, devc);
+            merge_status(sdi, devc);
+            return;
+        }
+
         for (l = sdi->channels; l; l = l->next) {
             if (sdi->mode == DSO)
                 start_rand = (devc->pre_index == 0) ? rand()%len : 0;
@@ -755,38 +1186,122 @@ static void samples_generator(uint16_t *buf, uint64_t size,
             }
         }
 
-        for (l = sdi->channels; l; l = l->next) {
-            probe = (struct sr_channel *)l->data;
-            if (!probe->enabled) {
-                devc->mstatus.ch1_max = MAX(devc->mstatus.ch0_max, devc->mstatus.ch1_max);
-                devc->mstatus.ch1_min = MIN(devc->mstatus.ch0_min, devc->mstatus.ch1_min);
-                devc->mstatus.ch0_max = MAX(devc->mstatus.ch0_max, devc->mstatus.ch1_max);
-                devc->mstatus.ch0_min = MIN(devc->mstatus.ch0_min, devc->mstatus.ch1_min);
-                break;
-            }
-        }
+        merge_status(sdi, devc);
     }
 }
 
-/* Callback handling data */
-static int receive_data(int fd, int revents, const struct sr_dev_inst *sdi)
+/* Generate and send up to samples_to_send samples */
+static void send_samples(const struct sr_dev_inst *sdi,
+                         struct demo_context *devc, uint64_t samples_to_send)
 {
-    struct demo_context *devc = sdi->priv;
     struct sr_datafeed_packet packet;
-    struct sr_datafeed_logic logic;
     struct sr_datafeed_dso dso;
     struct sr_datafeed_analog analog;
-    double samples_elaspsed;
-    uint64_t samples_to_send = 0, sending_now;
-	int64_t time, elapsed;
+    uint64_t sending_now;
     static uint16_t last_sample = 0;
     uint16_t cur_sample;
     uint64_t i;
 
+    packet.status = SR_PKT_OK;
+    sending_now = MIN(samples_to_send, (sdi->mode == DSO ) ? DSO_BUFSIZE : BUFSIZE);
+    if (sdi->mode == ANALOG)
+        samples_generator(devc->buf, sending_now*2, sdi, devc);
+    else
+        samples_generator(devc->buf, sending_now, sdi, devc);
+
+    if (devc->trigger_stage != 0) {
+        for (i = 0; i < sending_now; i++) {
+            if (devc->trigger_edge == 0) {
+                if ((*(devc->buf + i) | devc->trigger_mask) ==
+                        (devc->trigger_value | devc->trigger_mask)) {
+                    devc->trigger_stage = 0;
+                    break;
+                }
+            } else {
+                cur_sample = *(devc->buf + i);
+                if (((last_sample & devc->trigger_edge) ==
+                     (~devc->trigger_value & devc->trigger_edge)) &&
+                    ((cur_sample | devc->trigger_mask) ==
+                     (devc->trigger_value | devc->trigger_mask)) &&
+                    ((cur_sample & devc->trigger_edge) ==
+                     (devc->trigger_value & devc->trigger_edge))) {
+                    devc->trigger_stage = 0;
+                    break;
+                }
+                last_sample = cur_sample;
+            }
+        }
+        if (devc->trigger_stage == 0) {
+            struct ds_trigger_pos demo_trigger_pos;
+            demo_trigger_pos.real_pos = i;
+            packet.type = SR_DF_TRIGGER;
+            packet.payload = &demo_trigger_pos;
+            sr_session_send(sdi, &packet);
+        }
+    }
+
+    devc->samples_counter += sending_now;
+    if (sdi->mode == DSO && !devc->instant &&
+        devc->samples_counter > devc->limit_samples)
+        devc->samples_counter = devc->limit_samples;
+
+    if (devc->trigger_stage == 0){
+        //samples_to_send -= sending_now;
+        if (sdi->mode == DSO) {
+            packet.type = SR_DF_DSO;
+            packet.payload = &dso;
+            dso.probes = sdi->channels;
+            if (devc->instant)
+                dso.num_samples = sending_now;
+            else
+                dso.num_samples = devc->samples_counter;
+            if (en_ch_num(sdi) == 1)
+                dso.num_samples *= 2;
+            dso.mq = SR_MQ_VOLTAGE;
+            dso.unit = SR_UNIT_VOLT;
+            dso.mqflags = SR_MQFLAG_AC;
+            dso.data = devc->buf;
+        }else {
+            packet.type = SR_DF_ANALOG;
+            packet.payload = &analog;
+            analog.probes = sdi->channels;
+            analog.num_samples = sending_now;
+            analog.unit_bits = channel_modes[devc->ch_mode].unit_bits;;
+            analog.mq = SR_MQ_VOLTAGE;
+            analog.unit = SR_UNIT_VOLT;
+            analog.mqflags = SR_MQFLAG_AC;
+            analog.data = devc->buf;
+        }
+
+        if (sdi->mode == DSO && !devc->instant) {
+            devc->pre_index += sending_now;
+            if (devc->pre_index >= devc->limit_samples)
+                devc->pre_index = 0;
+        } else if (sdi->mode == ANALOG) {
+            devc->pre_index =(devc->pre_index + sending_now) % devc->limit_samples;
+        }
+
+        sr_session_send(sdi, &packet);
+
+        devc->mstatus.trig_hit = (devc->trigger_stage == 0);
+        devc->mstatus.captured_cnt0 = devc->samples_counter;
+        devc->mstatus.captured_cnt1 = devc->samples_counter >> 8;
+        devc->mstatus.captured_cnt2 = devc->samples_counter >> 16;
+        devc->mstatus.captured_cnt3 = devc->samples_counter >> 32;
+    }
+}
+
+/* Callback handling data */
+static int receive_data(int fd, int revents, const struct sr_dev_inst *sdi)
+{
+    struct demo_context *devc = sdi->priv;
+    double samples_elaspsed;
+    uint64_t samples_to_send = 0;
+	int64_t time, elapsed, deadline;
+
 	(void)fd;
 	(void)revents;
 
-    packet.status = SR_PKT_OK;
 	/* How many "virtual" samples should we have collected by now? */
 	time = g_get_monotonic_time();
 	elapsed = time - devc->starttime;
@@ -818,106 +1333,381 @@ static int receive_data(int fd, int revents, const struct sr_dev_inst *sdi)
         }
     }
 
-    if (samples_to_send > 0 && !devc->stop) {
-        sending_now = MIN(samples_to_send, (sdi->mode == DSO ) ? DSO_BUFSIZE : BUFSIZE);
-        if (sdi->mode == ANALOG)
-            samples_generator(devc->buf, sending_now*2, sdi, devc);
+    if (devc->aes_unpaced && devc->aes_trace && devc->limit_samples) {
+        /* whole frames, until the poll has taken long enough */
+        deadline = time + AES_UNPACED_TIME;
+        while (!devc->stop) {
+            samples_to_send = devc->limit_samples - (devc->instant ?
+                              devc->samples_counter : devc->pre_index);
+            if (samples_to_send == 0)
+                break;
+            send_samples(sdi, devc, samples_to_send);
+            if (g_get_monotonic_time() >= deadline)
+                break;
+        }
+    } else if (samples_to_send > 0 && !devc->stop) {
+        send_samples(sdi, devc, samples_to_send);
+    }
+
+    if (devc->instant && devc->limit_samples &&
+        devc->samples_counter >= devc->limit_samples) {
+        sr_info("Requested number of samples reached.");
+        hw_dev_acquisition_stop(sdi, NULL);
+        return TRUE;
+    }
+
+    return TRUE;
+}
+
+/*
+ * LOGIC: the enabled channels, in order, replay a ring of
+ * LOGIC_RING_SAMPLES samples built when the acquisition starts.
+ * Packets point straight into the ring, so nothing is generated while
+ * sending.
+ *
+ *   Random  each channel toggles at random, DEMO_LOGIC_DENSITY being
+ *           the chance of a toggle per sample (1/64)
+ *   PRBS    PRBS-31, each channel at another phase of it
+ *   SPI     buses of CS#, CLK, MOSI and MISO, mode 0
+ *   UART    each channel an 8N1 line
+ *   I2C     buses of SCL and SDA
+ *
+ * DEMO_LOGIC_WIDTH is the number of samples per bit, or per half clock
+ * period, of the protocols (8). With DEMO_LOGIC_UNPACED set the ring
+ * is sent as fast as the session takes it rather than at the
+ * samplerate, and the throughput is logged at the end.
+ */
+#define LOGIC_RING_SAMPLES     (1 << 21)
+/* Samples per packet */
+#define LOGIC_CHUNK_SAMPLES    (1 << 18)
+/* How long an unpaced poll keeps sending, in us */
+#define LOGIC_UNPACED_TIME     20000
+/* Phase step between the PRBS channels, in samples */
+#define LOGIC_PRBS_PHASE       1021
+
+struct logic_ring {
+    uint64_t *words;
+    unsigned int ch_num;
+    uint64_t samples;
+};
+
+static void logic_setup(struct demo_context *devc)
+{
+    devc->logic_generator = LOGIC_RANDOM;
+    devc->logic_density = env_double("DEMO_LOGIC_DENSITY", 1 / 64.0);
+    devc->logic_density = MIN(MAX(devc->logic_density, 0), 1);
+    devc->logic_width = MAX(env_double("DEMO_LOGIC_WIDTH", 8), 1);
+    devc->logic_unpaced = getenv("DEMO_LOGIC_UNPACED") != NULL;
+    devc->logic_ring = NULL;
+    devc->logic_ring_samples = 0;
+    devc->logic_pos = 0;
+    devc->logic_bytes = 0;
+    devc->logic_start = 0;
+}
+
+/* Set samples [pos, pos + n) of channel ch to level */
+static void logic_put(const struct logic_ring *ring, unsigned int ch,
+                      uint64_t pos, uint64_t n, int level)
+{
+    const uint64_t end = MIN(pos + n, ring->samples);
+    uint64_t *word, mask;
+    unsigned int bit, cnt;
+
+    if (ch >= ring->ch_num)
+        return;
+    while (pos < end) {
+        bit = pos % 64;
+        cnt = MIN(64 - bit, end - pos);
+        mask = (cnt == 64) ? ~0ULL : ((1ULL << cnt) - 1) << bit;
+        word = ring->words + pos / 64 * ring->ch_num + ch;
+        if (level)
+            *word |= mask;
         else
-            samples_generator(devc->buf, sending_now, sdi, devc);
-
-        if (devc->trigger_stage != 0) {
-            for (i = 0; i < sending_now; i++) {
-                if (devc->trigger_edge == 0) {
-                    if ((*(devc->buf + i) | devc->trigger_mask) ==
-                            (devc->trigger_value | devc->trigger_mask)) {
-                        devc->trigger_stage = 0;
-                        break;
-                    }
-                } else {
-                    cur_sample = *(devc->buf + i);
-                    if (((last_sample & devc->trigger_edge) ==
-                         (~devc->trigger_value & devc->trigger_edge)) &&
-                        ((cur_sample | devc->trigger_mask) ==
-                         (devc->trigger_value | devc->trigger_mask)) &&
-                        ((cur_sample & devc->trigger_edge) ==
-                         (devc->trigger_value & devc->trigger_edge))) {
-                        devc->trigger_stage = 0;
-                        break;
-                    }
-                    last_sample = cur_sample;
+            *word &= ~mask;
+        pos += cnt;
+    }
+}
+
+static void logic_gen_random(struct demo_context *devc,
+                             const struct logic_ring *ring)
+{
+    uint64_t rnd[256], toggles, x, carry, w;
+    const uint64_t *r;
+    const uint64_t threshold = devc->logic_density * 65536;
+    unsigned int ch, k;
+
+    for (ch = 0; ch < ring->ch_num; ch++) {
+        carry = 0;
+        for (w = 0; w < ring->samples / 64; w++) {
+            /* a toggle where a 16 bit random value is below threshold */
+            if (w % (ARRAY_SIZE(rnd) / 16) == 0)
+                rng_fill(devc, rnd, ARRAY_SIZE(rnd));
+            r = rnd + w % (ARRAY_SIZE(rnd) / 16) * 16;
+            toggles = 0;
+            for (k = 0; k < 64; k++)
+                toggles |= (uint64_t)(((r[k / 4] >> (k % 4 * 16)) & 0xffff) <
+                                      threshold) << k;
+            /* the level is the running parity of the toggles */
+            x = toggles;
+            x ^= x << 1;
+            x ^= x << 2;
+            x ^= x << 4;
+            x ^= x << 8;
+            x ^= x << 16;
+            x ^= x << 32;
+            x ^= carry;
+            carry = (x >> 63) ? ~0ULL : 0;
+            ring->words[w * ring->ch_num + ch] = x;
+        }
+    }
+}
+
+static int logic_gen_prbs(const struct logic_ring *ring)
+{
+    const uint64_t words = ring->samples / 64;
+    uint64_t *seq, x, w, q, r;
+    uint32_t state = 0x7fffffff, bit;
+    unsigned int ch, k;
+
+    if (!(seq = g_try_malloc(words * sizeof(uint64_t))))
+        return SR_ERR_MALLOC;
+
+    /* x^31 + x^28 + 1, the sample order is the bit order */
+    for (w = 0; w < words; w++) {
+        x = 0;
+        for (k = 0; k < 64; k++) {
+            bit = ((state >> 30) ^ (state >> 27)) & 1;
+            state = ((state << 1) | bit) & 0x7fffffff;
+            x |= (uint64_t)bit << k;
+        }
+        seq[w] = x;
+    }
+
+    for (ch = 0; ch < ring->ch_num; ch++) {
+        q = (uint64_t)ch * LOGIC_PRBS_PHASE % ring->samples / 64;
+        r = (uint64_t)ch * LOGIC_PRBS_PHASE % 64;
+        for (w = 0; w < words; w++) {
+            x = seq[(w + q) % words] >> r;
+            if (r)
+                x |= seq[(w + q + 1) % words] << (64 - r);
+            ring->words[w * ring->ch_num + ch] = x;
+        }
+    }
+
+    g_free(seq);
+    return SR_OK;
+}
+
+static void logic_gen_spi(struct demo_context *devc,
+                          const struct logic_ring *ring)
+{
+    const uint64_t h = devc->logic_width;
+    /* CS# lead, 16 bytes at most and CS# trail */
+    const uint64_t frame_max = 2 * h + 16 * 16 * h + 2 * h;
+    uint64_t rnd[2 * RNG_LANES], pos, gap;
+    unsigned int base, bytes, i, b, mosi, miso;
+
+    for (base = 0; base < ring->ch_num; base += 4) {
+        logic_put(ring, base, 0, ring->samples, 1);
+        pos = 0;
+        for (;;) {
+            rng_fill(devc, rnd, 2 * RNG_LANES);
+            gap = 4 * h + rnd[0] % (16 * h);
+            if (pos + gap + frame_max > ring->samples)
+                break;
+            pos += gap;
+            bytes = 1 + rnd[1] % 16;
+            logic_put(ring, base, pos, 2 * h + bytes * 16 * h + 2 * h, 0);
+            pos += 2 * h;
+            for (i = 0; i < bytes; i++) {
+                mosi = (rnd[2 + i / 8] >> (i % 8 * 8)) & 0xff;
+                miso = (rnd[4 + i / 8] >> (i % 8 * 8)) & 0xff;
+                for (b = 0; b < 8; b++) {
+                    logic_put(ring, base + 2, pos, 2 * h, (mosi >> (7 - b)) & 1);
+                    logic_put(ring, base + 3, pos, 2 * h, (miso >> (7 - b)) & 1);
+                    logic_put(ring, base + 1, pos + h, h, 1);
+                    pos += 2 * h;
                 }
             }
-            if (devc->trigger_stage == 0) {
-                struct ds_trigger_pos demo_trigger_pos;
-                demo_trigger_pos.real_pos = i;
-                packet.type = SR_DF_TRIGGER;
-                packet.payload = &demo_trigger_pos;
-                sr_session_send(sdi, &packet);
-            }
+            pos += 2 * h;
         }
+    }
+}
 
-        devc->samples_counter += sending_now;
-        if (sdi->mode == DSO && !devc->instant &&
-            devc->samples_counter > devc->limit_samples)
-            devc->samples_counter = devc->limit_samples;
-
-        if (devc->trigger_stage == 0){
-            //samples_to_send -= sending_now;
-            if (sdi->mode == LOGIC) {
-                packet.type = SR_DF_LOGIC;
-                packet.payload = &logic;
-                logic.length = sending_now * (channel_modes[devc->ch_mode].num >> 3);
-                logic.format = LA_CROSS_DATA;
-                logic.data = devc->buf;
-            } else if (sdi->mode == DSO) {
-                packet.type = SR_DF_DSO;
-                packet.payload = &dso;
-                dso.probes = sdi->channels;
-                if (devc->instant)
-                    dso.num_samples = sending_now;
-                else
-                    dso.num_samples = devc->samples_counter;
-                if (en_ch_num(sdi) == 1)
-                    dso.num_samples *= 2;
-                dso.mq = SR_MQ_VOLTAGE;
-                dso.unit = SR_UNIT_VOLT;
-                dso.mqflags = SR_MQFLAG_AC;
-                dso.data = devc->buf;
-            }else {
-                packet.type = SR_DF_ANALOG;
-                packet.payload = &analog;
-                analog.probes = sdi->channels;
-                analog.num_samples = sending_now;
-                analog.unit_bits = channel_modes[devc->ch_mode].unit_bits;;
-                analog.mq = SR_MQ_VOLTAGE;
-                analog.unit = SR_UNIT_VOLT;
-                analog.mqflags = SR_MQFLAG_AC;
-                analog.data = devc->buf;
+static void logic_gen_uart(struct demo_context *devc,
+                           const struct logic_ring *ring)
+{
+    const uint64_t w = devc->logic_width;
+    uint64_t rnd[RNG_LANES], pos, gap;
+    unsigned int ch, b, byte;
+
+    for (ch = 0; ch < ring->ch_num; ch++) {
+        logic_put(ring, ch, 0, ring->samples, 1);
+        pos = 0;
+        for (;;) {
+            rng_fill(devc, rnd, RNG_LANES);
+            gap = rnd[0] % (20 * w);
+            if (pos + gap + 10 * w > ring->samples)
+                break;
+            pos += gap;
+            byte = rnd[1] & 0xff;
+            logic_put(ring, ch, pos, w, 0);
+            pos += w;
+            for (b = 0; b < 8; b++) {
+                logic_put(ring, ch, pos, w, (byte >> b) & 1);
+                pos += w;
             }
+            /* stop bit */
+            pos += w;
+        }
+    }
+}
 
-            if (sdi->mode == DSO && !devc->instant) {
-                devc->pre_index += sending_now;
-                if (devc->pre_index >= devc->limit_samples)
-                    devc->pre_index = 0;
-            } else if (sdi->mode == ANALOG) {
-                devc->pre_index =(devc->pre_index + sending_now) % devc->limit_samples;
+static void logic_gen_i2c(struct demo_context *devc,
+                          const struct logic_ring *ring)
+{
+    const uint64_t h = devc->logic_width;
+    /* start, address and 8 bytes at most with their acks, stop */
+    const uint64_t frame_max = h + 9 * 9 * 2 * h + 2 * h;
+    uint64_t rnd[2 * RNG_LANES], pos, gap;
+    unsigned int base, bytes, i, b, byte, bit;
+
+    for (base = 0; base < ring->ch_num; base += 2) {
+        logic_put(ring, base, 0, ring->samples, 1);
+        logic_put(ring, base + 1, 0, ring->samples, 1);
+        pos = 0;
+        for (;;) {
+            rng_fill(devc, rnd, 2 * RNG_LANES);
+            gap = 4 * h + rnd[0] % (16 * h);
+            if (pos + gap + frame_max > ring->samples)
+                break;
+            pos += gap;
+            bytes = 1 + rnd[1] % 8;
+
+            /* SDA falls while SCL is high */
+            logic_put(ring, base + 1, pos, h, 0);
+            pos += h;
+            /* the address with R/W#, then the data, each acked */
+            for (i = 0; i <= bytes; i++) {
+                byte = (rnd[2 + i / 8] >> (i % 8 * 8)) & 0xff;
+                for (b = 0; b < 9; b++) {
+                    bit = (b < 8) ? (byte >> (7 - b)) & 1 : 0;
+                    logic_put(ring, base, pos, h, 0);
+                    logic_put(ring, base + 1, pos, 2 * h, bit);
+                    pos += 2 * h;
+                }
             }
+            /* SDA rises while SCL is high */
+            logic_put(ring, base, pos, h, 0);
+            logic_put(ring, base + 1, pos, 2 * h, 0);
+            pos += 2 * h;
+        }
+    }
+}
 
-            sr_session_send(sdi, &packet);
-
-            devc->mstatus.trig_hit = (devc->trigger_stage == 0);
-            devc->mstatus.captured_cnt0 = devc->samples_counter;
-            devc->mstatus.captured_cnt1 = devc->samples_counter >> 8;
-            devc->mstatus.captured_cnt2 = devc->samples_counter >> 16;
-            devc->mstatus.captured_cnt3 = devc->samples_counter >> 32;
+static int logic_build(const struct sr_dev_inst *sdi,
+                       struct demo_context *devc)
+{
+    struct logic_ring ring;
+
+    ring.ch_num = en_ch_num(sdi) ? en_ch_num(sdi) : 1;
+    ring.samples = LOGIC_RING_SAMPLES;
+    if (!(ring.words = g_try_malloc0(ring.samples / 64 * ring.ch_num *
+                                     sizeof(uint64_t))))
+        return SR_ERR_MALLOC;
+
+    switch (devc->logic_generator) {
+    case LOGIC_PRBS:
+        if (logic_gen_prbs(&ring) != SR_OK) {
+            g_free(ring.words);
+            return SR_ERR_MALLOC;
         }
-	}
+        break;
+    case LOGIC_SPI:
+        logic_gen_spi(devc, &ring);
+        break;
+    case LOGIC_UART:
+        logic_gen_uart(devc, &ring);
+        break;
+    case LOGIC_I2C:
+        logic_gen_i2c(devc, &ring);
+        break;
+    default:
+        logic_gen_random(devc, &ring);
+        break;
+    }
+
+    devc->logic_ring = ring.words;
+    devc->logic_ring_samples = ring.samples;
+    devc->logic_pos = 0;
+    devc->logic_bytes = 0;
+
+    return SR_OK;
+}
+
+/* Send the ring on, at the samplerate or as fast as it is taken */
+static int receive_logic(int fd, int revents, const struct sr_dev_inst *sdi)
+{
+    struct demo_context *devc = sdi->priv;
+    struct sr_datafeed_packet packet;
+    struct sr_datafeed_logic logic;
+    const unsigned int ch_num = en_ch_num(sdi) ? en_ch_num(sdi) : 1;
+    uint64_t samples_to_send, sending_now;
+    int64_t time, deadline;
+
+    (void)fd;
+    (void)revents;
+
+    time = g_get_monotonic_time();
+    if (devc->logic_unpaced) {
+        samples_to_send = UINT64_MAX;
+        deadline = time + LOGIC_UNPACED_TIME;
+    } else {
+        samples_to_send = ceil((time - devc->starttime) / 1000000.0 *
+                               devc->cur_samplerate);
+        samples_to_send += devc->samples_not_sent;
+        devc->samples_not_sent = samples_to_send & 63;
+        samples_to_send &= ~63;
+        deadline = INT64_MAX;
+    }
+    devc->starttime = time;
+    if (devc->limit_samples)
+        samples_to_send = MIN(samples_to_send,
+                              devc->limit_samples - devc->samples_counter);
+
+    packet.type = SR_DF_LOGIC;
+    packet.status = SR_PKT_OK;
+    packet.payload = &logic;
+    logic.format = LA_CROSS_DATA;
+    logic.data_error = 0;
+    while (samples_to_send > 0 && !devc->stop) {
+        sending_now = MIN(samples_to_send, LOGIC_CHUNK_SAMPLES);
+        sending_now = MIN(sending_now,
+                          devc->logic_ring_samples - devc->logic_pos);
+        /* whole blocks of 64 samples, the limit may end within one */
+        logic.length = (sending_now + 63) / 64 * ch_num * sizeof(uint64_t);
+        logic.data = devc->logic_ring + devc->logic_pos / 64 * ch_num;
+        sr_session_send(sdi, &packet);
+
+        devc->logic_pos = (devc->logic_pos + sending_now) %
+                          devc->logic_ring_samples;
+        devc->logic_bytes += logic.length;
+        devc->samples_counter += sending_now;
+        samples_to_send -= sending_now;
+        if (g_get_monotonic_time() >= deadline)
+            break;
+    }
+
+    devc->mstatus.trig_hit = 1;
+    devc->mstatus.captured_cnt0 = devc->samples_counter;
+    devc->mstatus.captured_cnt1 = devc->samples_counter >> 8;
+    devc->mstatus.captured_cnt2 = devc->samples_counter >> 16;
+    devc->mstatus.captured_cnt3 = devc->samples_counter >> 32;
 
-    if ((sdi->mode == LOGIC || devc->instant) && devc->limit_samples &&
+    if (devc->limit_samples &&
         devc->samples_counter >= devc->limit_samples) {
         sr_info("Requested number of samples reached.");
         hw_dev_acquisition_stop(sdi, NULL);
-        return TRUE;
     }
 
     return TRUE;
@@ -927,6 +1717,8 @@ static int hw_dev_acquisition_start(struct sr_dev_inst *sdi,
 		void *cb_data)
 {
     struct demo_context *const devc = sdi->priv;
+    struct sr_datafeed_packet packet;
+    struct ds_trigger_pos trigger_pos;
 
     (void)cb_data;
 
@@ -967,20 +1759,50 @@ static int hw_dev_acquisition_start(struct sr_dev_inst *sdi,
 	 * up a timeout-based polling mechanism.
 	 */
 
-    sr_session_source_add_channel(devc->channel, G_IO_IN | G_IO_ERR,
-            50, receive_data, sdi);
+    if (sdi->mode == LOGIC) {
+        if (logic_build(sdi, devc) != SR_OK) {
+            sr_err("logic ring malloc failed.");
+            return SR_ERR_MALLOC;
+        }
+        sr_session_source_add_channel(devc->channel, G_IO_IN | G_IO_ERR,
+                devc->logic_unpaced ? 1 : 50, receive_logic, sdi);
+    } else {
+        sr_session_source_add_channel(devc->channel, G_IO_IN | G_IO_ERR,
+                (sdi->mode == DSO && devc->sample_generator == PATTERN_AES &&
+                 devc->aes_unpaced) ? 1 : 50, receive_data, sdi);
+    }
 
 	/* Send header packet to the session bus. */
     //std_session_send_df_header(cb_data, LOG_PREFIX);
     std_session_send_df_header(sdi, LOG_PREFIX);
 
+    /*
+     * LOGIC has no trigger, the capture starts with the first sample.
+     * Say so the way the DSLogic does, before the data.
+     */
+    if (sdi->mode == LOGIC) {
+        memset(&trigger_pos, 0, sizeof(trigger_pos));
+        packet.type = SR_DF_TRIGGER;
+        packet.status = SR_PKT_OK;
+        packet.payload = &trigger_pos;
+        sr_session_send(sdi, &packet);
+    }
+
     if (!(devc->buf = g_try_malloc(((sdi->mode == DSO ) ? DSO_BUFSIZE : (sdi->mode == ANALOG ) ? 2*BUFSIZE : BUFSIZE)*sizeof(uint16_t)))) {
         sr_err("buf for receive_data malloc failed.");
         return FALSE;
     }
 
+    if (sdi->mode == DSO && devc->sample_generator == PATTERN_AES) {
+        if (!(devc->aes_trace = g_try_malloc(DSO_BUFSIZE*sizeof(float)))) {
+            sr_err("aes_trace for receive_data malloc failed.");
+            return FALSE;
+        }
+    }
+
 	/* We use this timestamp to decide how many more samples to send. */
 	devc->starttime = g_get_monotonic_time();
+    devc->logic_start = devc->starttime;
 
 	return SR_OK;
 }
@@ -991,6 +1813,8 @@ static int hw_dev_acquisition_stop(const struct sr_dev_inst *sdi, void *cb_data)
 
     struct demo_context *const devc = sdi->priv;
     struct sr_datafeed_packet packet;
+    int64_t elapsed;
+
     if (devc->stop)
         return SR_OK;
 
@@ -1001,6 +1825,16 @@ static int hw_dev_acquisition_stop(const struct sr_dev_inst *sdi, void *cb_data)
     sr_session_source_remove_channel(devc->channel);
 
     g_free(devc->buf);
+    g_free(devc->aes_trace);
+    devc->aes_trace = NULL;
+    if (devc->logic_ring) {
+        elapsed = g_get_monotonic_time() - devc->logic_start;
+        sr_info("Sent %" PRIu64 " bytes of logic in %.3f s, %.1f MB/s.",
+                devc->logic_bytes, elapsed / 1000000.0,
+                elapsed ? (double)devc->logic_bytes / elapsed : 0);
+        g_free(devc->logic_ring);
+        devc->logic_ring = NULL;
+    }
 
 	/* Send last packet. */
     packet.type = SR_DF_END;
@@ -72,6 +72,9 @@ static struct sr_dev_mode mode_list[] = {
     {"OSC", DSO},
 };
 
+/* Independent xorshift128+ generators behind the random patterns */
+#define RNG_LANES 4
+
 /* Supported patterns which we can generate */
 enum DEMO_PATTERN {
     PATTERN_SINE = 0,
@@ -79,6 +82,7 @@ enum DEMO_PATTERN {
     PATTERN_TRIANGLE = 2,
     PATTERN_SAWTOOTH = 3,
     PATTERN_RANDOM = 4,
+    PATTERN_AES = 5,
 };
 
 static const char *pattern_strings[] = {
@@ -87,6 +91,24 @@ static const char *pattern_strings[] = {
     "Triangle",
     "Sawtooth",
     "Random",
+    "AES",
+};
+
+/* Logic patterns, generated once when the acquisition starts */
+enum DEMO_LOGIC_PATTERN {
+    LOGIC_RANDOM = 0,
+    LOGIC_PRBS = 1,
+    LOGIC_SPI = 2,
+    LOGIC_UART = 3,
+    LOGIC_I2C = 4,
+};
+
+static const char *logic_pattern_strings[] = {
+    "Random",
+    "PRBS",
+    "SPI",
+    "UART",
+    "I2C",
 };
 
 struct DEMO_caps {
@@ -213,6 +235,33 @@ struct demo_context {
     uint16_t trigger_edge;
     uint8_t trigger_slope;
     uint8_t trigger_source;
+
+    uint64_t rng[2][RNG_LANES];
+
+    /* LOGIC, see logic_setup() */
+    uint8_t logic_generator;
+    double logic_density;
+    unsigned int logic_width;
+    gboolean logic_unpaced;
+    uint64_t *logic_ring;
+    uint64_t logic_ring_samples;
+    uint64_t logic_pos;
+    uint64_t logic_bytes;
+    int64_t logic_start;
+
+    /* PATTERN_AES, see aes_setup() */
+    uint8_t aes_rk[176];
+    uint16_t aes_leak_hw;
+    uint16_t aes_leak_hd;
+    double aes_gain;
+    double aes_noise;
+    double aes_drift;
+    unsigned int aes_jitter;
+    uint8_t aes_pt[16];
+    uint8_t aes_ct[16];
+    uint64_t aes_traces;
+    float *aes_trace;
+    gboolean aes_unpaced;
 };
 
 static const uint64_t samplerates[] = {
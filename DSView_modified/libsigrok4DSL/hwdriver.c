@@ -108,6 +108,12 @@ static struct sr_config_info sr_config_info_data[] = {
         "Threshold Level", "Threshold Level", NULL},
     {SR_CONF_RLE_SUPPORT, SR_T_BOOL, "rle",
         "Enable RLE Compress", "Enable RLE Compress", NULL},
+    {SR_CONF_REARM, SR_T_BOOL, "rearm",
+        "Rapid Re-arm", "Rapid Re-arm", NULL},
+    {SR_CONF_TRACE_INDEX, SR_T_UINT64, "trace",
+        "Trace", "Trace", NULL},
+    {SR_CONF_TRACE_MEAN, SR_T_BOOL, "tracemean",
+        "Mean Trace", "Mean Trace", NULL},
 
     {SR_CONF_PROBE_COUPLING, SR_T_CHAR, "coupling",
         "Coupling", "Coupling", NULL},
@@ -131,7 +137,9 @@ extern SR_PRIV struct sr_dev_driver demo_driver_info;
 #ifdef HAVE_DSL_DEVICE
 extern SR_PRIV struct sr_dev_driver DSLogic_driver_info;
 extern SR_PRIV struct sr_dev_driver DSCope_driver_info;
+extern SR_PRIV struct sr_dev_driver DSReplay_driver_info;
 #endif
+extern SR_PRIV struct sr_dev_driver sync_driver;
 /** @endcond */
 
 static struct sr_dev_driver *drivers_list[] = {
@@ -141,7 +149,10 @@ static struct sr_dev_driver *drivers_list[] = {
 #ifdef HAVE_DSL_DEVICE
     &DSLogic_driver_info,
     &DSCope_driver_info,
+    &DSReplay_driver_info,
 #endif
+    /* Last, it groups devices of the drivers before it. */
+    &sync_driver,
 	NULL,
 };
 
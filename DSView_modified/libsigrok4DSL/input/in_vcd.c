@@ -75,34 +75,65 @@
 
 #define DEFAULT_NUM_PROBES 8
 
-/* Read until specific type of character occurs in file.
+/* Samples per probe collected before they are sent as LA_SPLIT_DATA. */
+#define BLOCK_SAMPLES (1 << 20)
+
+/* Approximate size of the value change text tokenized by one thread. */
+#define CHUNK_SIZE (16 << 20)
+
+/* Tokens handed from a tokenizer thread to the merge at a time. */
+#define TOKEN_BLOCK_LEN (64 * 1024)
+
+/* Token blocks a tokenizer thread may fill ahead of the merge. */
+#define MAX_QUEUED_BLOCKS 4
+
+/* Maximum length of a supported signal identifier. */
+#define MAX_IDENTIFIER_LEN 32
+
+/*
+ * Entries of the token stream produced by the tokenizer threads:
+ * a timestamp is stored as (timestamp << 1), a value change of a
+ * probe as (probe << 2 | bit << 1 | 1).
+ */
+#define TOKEN_IS_CHANGE(t) ((t) & 1)
+#define TOKEN_TIMESTAMP(t) ((t) >> 1)
+#define TOKEN_PROBE(t) ((t) >> 2)
+#define TOKEN_BIT(t) (((t) >> 1) & 1)
+
+/* Part of the memory mapped input file. */
+struct buffer
+{
+	const char *pos;
+	const char *end;
+};
+
+/* Read until specific type of character occurs in buffer.
  * Skip input if dest is NULL.
  * Modes:
  * 'W' read until whitespace
- * 'N' read until non-whitespace, and ungetc() the character
+ * 'N' read until non-whitespace, and leave the character unread
  * '$' read until $end
  */
-static gboolean read_until(FILE *file, GString *dest, char mode)
+static gboolean read_until(struct buffer *buf, GString *dest, char mode)
 {
 	char prev[4] = "";
-	long startpos = ftell(file);
 	for(;;)
 	{
-		int c = fgetc(file);
-
-		if (c == EOF)
+		if (buf->pos >= buf->end)
 		{
 			if (mode == '$')
-				sr_err("Unexpected EOF, read started at %ld.", startpos);
+				sr_err("Unexpected EOF.");
 			return FALSE;
 		}
-		
+
+		char c = *buf->pos++;
+
 		if (mode == 'W' && g_ascii_isspace(c))
 			return TRUE;
 		
 		if (mode == 'N' && !g_ascii_isspace(c))
 		{
-			ungetc(c, file);
+			buf->pos--;
 			return TRUE;
 		}
 		
@@ -123,19 +154,35 @@ static gboolean read_until(FILE *file, GString *dest, char mode)
 	}
 }
 
-/* Reads a single VCD section from input file and parses it to structure.
+/* Find the next whitespace-delimited token without copying it. */
+static gboolean next_token(struct buffer *buf, const char **token, size_t *len)
+{
+	const char *pos = buf->pos;
+
+	while (pos < buf->end && g_ascii_isspace(*pos))
+		pos++;
+	*token = pos;
+	while (pos < buf->end && !g_ascii_isspace(*pos))
+		pos++;
+	*len = pos - *token;
+	buf->pos = pos;
+
+	return *len != 0;
+}
+
+/* Reads a single VCD section from input buffer and parses it to structure.
  * e.g. $timescale 1ps $end  => "timescale" "1ps"
  */
-static gboolean parse_section(FILE *file, gchar **name, gchar **contents)
+static gboolean parse_section(struct buffer *buf, gchar **name, gchar **contents)
 {
 	gboolean status;
 	GString *sname, *scontents;
 	
 	/* Skip any initial white-space */
-	if (!read_until(file, NULL, 'N')) return FALSE;
+	if (!read_until(buf, NULL, 'N')) return FALSE;
 	
 	/* Section tag should start with $. */
-	if (fgetc(file) != '$')
+	if (*buf->pos++ != '$')
 	{
 		sr_err("Expected $ at beginning of section.");
 		return FALSE;
@@ -143,14 +190,14 @@ static gboolean parse_section(FILE *file, gchar **name, gchar **contents)
 	
 	/* Read the section tag */	
 	sname = g_string_sized_new(32);
-	status = read_until(file, sname, 'W');
+	status = read_until(buf, sname, 'W');
 	
 	/* Skip whitespace before content */
-	status = status && read_until(file, NULL, 'N');
+	status = status && read_until(buf, NULL, 'N');
 	
 	/* Read the content */
 	scontents = g_string_sized_new(128);
-	status = status && read_until(file, scontents, '$');
+	status = status && read_until(buf, scontents, '$');
 	g_strchomp(scontents->str);
 
 	/* Release strings if status is FALSE, return them if status is TRUE */	
@@ -174,6 +221,56 @@ struct context
 	unsigned compress;
 	int64_t skip;
 	GSList *probes;
+	/* Probe number + 1 for each identifier. */
+	GHashTable *identifiers;
+};
+
+struct token_block
+{
+	guint len;
+	uint64_t tokens[TOKEN_BLOCK_LEN];
+};
+
+/* Samples generated by the timestamps of one chunk, see count_chunk(). */
+struct chunk_count
+{
+	gboolean has_first;
+	/* First timestamp of the chunk. */
+	uint64_t first;
+	/* Samples generated by the timestamps after the first one. */
+	uint64_t samples;
+	/* prev_timestamp after the last timestamp of the chunk. */
+	uint64_t last;
+};
+
+/* Value change text tokenized by one thread.
+ * In the counting pass only the timestamps are summed up in count.
+ * Otherwise the tokens are streamed to the merge in blocks, of which
+ * at most MAX_QUEUED_BLOCKS wait in the queue.
+ */
+struct chunk
+{
+	struct buffer buf;
+	const struct context *ctx;
+	gboolean count_only;
+	struct chunk_count count;
+	struct token_block *cur;
+	GMutex mutex;
+	GCond cond;
+	GQueue blocks;
+	gboolean done;
+};
+
+/* Per probe sample blocks waiting to be sent. */
+struct sample_writer
+{
+	const struct sr_dev_inst *sdi;
+	int num_probes;
+	uint8_t **blocks;
+	uint64_t fill;
+	/* Samples sent so far, and the total announced in SR_DF_META. */
+	uint64_t sent;
+	uint64_t total;
 };
 
 static void free_probe(void *data)
@@ -187,6 +284,8 @@ static void free_probe(void *data)
 static void release_context(struct context *ctx)
 {
 	g_slist_free_full(ctx->probes, free_probe);
+	if (ctx->identifiers)
+		g_hash_table_destroy(ctx->identifiers);
 	g_free(ctx);
 }
 
@@ -211,14 +310,14 @@ static void remove_empty_parts(gchar **parts)
 /* Parse VCD header to get values for context structure.
  * The context structure should be zeroed before calling this.
  */
-static gboolean parse_header(FILE *file, struct context *ctx)
+static gboolean parse_header(struct buffer *buf, struct context *ctx)
 {
 	uint64_t p, q;
 	gchar *name = NULL, *contents = NULL;
 	gboolean status = FALSE;
 	struct probe *probe;
 
-	while (parse_section(file, &name, &contents))
+	while (parse_section(buf, &name, &contents))
 	{
 		sr_dbg("Section '%s', contents '%s'.", name, contents);
 	
@@ -266,6 +365,10 @@ static gboolean parse_header(FILE *file, struct context *ctx)
 			{
 				sr_info("Unsupported signal size: '%s'", parts[1]);
 			}
+			else if (strlen(parts[2]) > MAX_IDENTIFIER_LEN)
+			{
+				sr_info("Unsupported signal identifier: '%s'", parts[2]);
+			}
 			else if (ctx->probecount >= ctx->maxprobes)
 			{
 				sr_warn("Skipping '%s' because only %d probes requested.", parts[3], ctx->maxprobes);
@@ -277,6 +380,10 @@ static gboolean parse_header(FILE *file, struct context *ctx)
 				probe->identifier = g_strdup(parts[2]);
 				probe->name = g_strdup(parts[3]);
 				ctx->probes = g_slist_append(ctx->probes, probe);
+				/* The first probe wins if an identifier is used twice. */
+				if (!g_hash_table_lookup(ctx->identifiers, probe->identifier))
+					g_hash_table_insert(ctx->identifiers, probe->identifier,
+							GINT_TO_POINTER(ctx->probecount + 1));
 				ctx->probecount++;
 			}
 			
@@ -295,23 +402,26 @@ static gboolean parse_header(FILE *file, struct context *ctx)
 
 static int format_match(const char *filename)
 {
-	FILE *file;
+	GMappedFile *file;
+	struct buffer buf;
 	gchar *name = NULL, *contents = NULL;
 	gboolean status;
 	
-    file = fopen(filename, "r");
+	file = g_mapped_file_new(filename, FALSE, NULL);
 	if (file == NULL)
 		return FALSE;
+	buf.pos = g_mapped_file_get_contents(file);
+	buf.end = buf.pos + g_mapped_file_get_length(file);
 
 	/* If we can parse the first section correctly,
 	 * then it is assumed to be a VCD file.
 	 */
-	status = parse_section(file, &name, &contents);
+	status = parse_section(&buf, &name, &contents);
 	status = status && (*name != '\0');
 	
 	g_free(name);
 	g_free(contents);
-	fclose(file);
+	g_mapped_file_unref(file);
 	
 	return status;
 }
@@ -335,12 +445,13 @@ static int init(struct sr_input *in, const char *filename)
 	ctx->samplerate = 0;
 	ctx->downsample = 1;
 	ctx->skip = -1;
+	ctx->identifiers = g_hash_table_new(g_str_hash, g_str_equal);
 
 	if (in->param) {
 		param = g_hash_table_lookup(in->param, "numprobes");
 		if (param) {
 			num_probes = strtoul(param, NULL, 10);
-			if (num_probes < 1)
+			if (num_probes < 1 || num_probes > 64)
 			{
 				release_context(ctx);
 				return SR_ERR;
@@ -389,168 +500,512 @@ static int init(struct sr_input *in, const char *filename)
 	return SR_OK;
 }
 
-#define CHUNKSIZE 1024
-
-/* Send N samples of the given value. */
-static void send_samples(const struct sr_dev_inst *sdi, uint64_t sample, uint64_t count)
+/* Send the collected sample blocks, one LA_SPLIT_DATA packet per probe. */
+static void flush_samples(struct sample_writer *writer)
 {
 	struct sr_datafeed_packet packet;
 	struct sr_datafeed_logic logic;
-	uint64_t buffer[CHUNKSIZE];
-	uint64_t i;
-	unsigned chunksize = CHUNKSIZE;
-		
-	if (count < chunksize)
-		chunksize = count;
+	int i;
 
-	for (i = 0; i < chunksize; i++)
+	if (writer->fill == 0)
+		return;
+
+	packet.type = SR_DF_LOGIC;
+	packet.status = SR_PKT_OK;
+	packet.payload = &logic;
+	memset(&logic, 0, sizeof(logic));
+	logic.format = LA_SPLIT_DATA;
+	logic.unitsize = 1;
+	/* The bits of the last byte beyond the total sample count are
+	 * padding, the total was announced with SR_CONF_LIMIT_SAMPLES. */
+	logic.length = (writer->fill + 7) / 8;
+
+	for (i = 0; i < writer->num_probes; i++)
 	{
-		buffer[i] = sample;
+		logic.index = i;
+		logic.order = i;
+		logic.data = writer->blocks[i];
+		sr_session_send(writer->sdi, &packet);
 	}
-	
-	packet.type = SR_DF_LOGIC;
-	packet.payload = &logic;	
-	logic.unitsize = sizeof(uint64_t);
-	logic.data = buffer;
-	
+
+	writer->sent += writer->fill;
+	writer->fill = 0;
+}
+
+/* Set count bits starting at bit offset start to the given value. */
+static void fill_bits(uint8_t *block, uint64_t start, uint64_t count, int bit)
+{
+	while (count != 0 && (start & 7) != 0)
+	{
+		if (bit)
+			block[start / 8] |= 1 << (start & 7);
+		else
+			block[start / 8] &= ~(1 << (start & 7));
+		start++;
+		count--;
+	}
+
+	memset(block + start / 8, bit ? 0xff : 0x00, count / 8);
+	start += count & ~7ULL;
+	count &= 7;
+
+	while (count != 0)
+	{
+		if (bit)
+			block[start / 8] |= 1 << (start & 7);
+		else
+			block[start / 8] &= ~(1 << (start & 7));
+		start++;
+		count--;
+	}
+}
+
+/* Append N samples of the given value. */
+static void send_samples(struct sample_writer *writer, uint64_t sample, uint64_t count)
+{
+	uint64_t n;
+	int i;
+
+	/* The count was made on the timestamps alone; never go past it. */
+	count = MIN(count, writer->total - writer->sent - writer->fill);
+
 	while (count)
 	{
-		if (count < chunksize)
-			chunksize = count;
-	
-		logic.length = sizeof(uint64_t) * chunksize;
-	
-		sr_session_send(sdi, &packet);
-		count -= chunksize;
+		n = MIN(count, BLOCK_SAMPLES - writer->fill);
+		for (i = 0; i < writer->num_probes; i++)
+			fill_bits(writer->blocks[i], writer->fill, n, (sample >> i) & 1);
+		writer->fill += n;
+		count -= n;
+
+		if (writer->fill == BLOCK_SAMPLES)
+			flush_samples(writer);
 	}
 }
 
-/* Parse the data section of VCD */
-static void parse_contents(FILE *file, const struct sr_dev_inst *sdi, struct context *ctx)
+/* Parse a decimal number which is not followed by a terminating NUL. */
+static uint64_t parse_uint64(const char *str, size_t len)
 {
-	GString *token = g_string_sized_new(32);
-	
-	uint64_t prev_timestamp = 0;
-	uint64_t prev_values = 0;
-	
-	/* Read one space-delimited token at a time. */
-	while (read_until(file, NULL, 'N') && read_until(file, token, 'W'))
+	uint64_t value = 0;
+
+	while (len-- && g_ascii_isdigit(*str))
+		value = value * 10 + (*str++ - '0');
+
+	return value;
+}
+
+/* Apply one timestamp to prev_timestamp the way the merge does it and
+ * return the number of samples that are generated up to it.
+ * Skip < 0 => skip until first timestamp.
+ * Skip = 0 => don't skip
+ * Skip > 0 => skip until timestamp >= skip.
+ */
+static uint64_t advance_timestamp(int64_t *skip, unsigned compress,
+		uint64_t *prev_timestamp, uint64_t timestamp)
+{
+	uint64_t samples;
+
+	if (*skip < 0)
+	{
+		*skip = timestamp;
+		*prev_timestamp = timestamp;
+		return 0;
+	}
+	if (*skip > 0 && timestamp < (uint64_t)*skip)
+	{
+		*prev_timestamp = *skip;
+		return 0;
+	}
+	if (timestamp == *prev_timestamp)
 	{
-		if (token->str[0] == '#' && g_ascii_isdigit(token->str[1]))
+		/* Ignore repeated timestamps (e.g. sigrok outputs these) */
+		return 0;
+	}
+
+	if (compress != 0 && timestamp - *prev_timestamp > compress)
+	{
+		/* Compress long idle periods */
+		*prev_timestamp = timestamp - compress;
+	}
+
+	samples = timestamp - *prev_timestamp;
+	*prev_timestamp = timestamp;
+	return samples;
+}
+
+/* Sum up the samples of a chunk's timestamps. The first timestamp is
+ * only recorded, what it generates depends on the chunks before.
+ * Once a skip < 0 is resolved to the first timestamp of the file, it
+ * behaves as no skip for the (increasing) timestamps that follow.
+ */
+static void count_timestamp(struct chunk *chunk, uint64_t timestamp)
+{
+	struct chunk_count *count = &chunk->count;
+	int64_t skip = MAX(chunk->ctx->skip, 0);
+
+	if (chunk->ctx->downsample > 1)
+		timestamp /= chunk->ctx->downsample;
+
+	if (!count->has_first)
+	{
+		count->has_first = TRUE;
+		count->first = timestamp;
+		count->last = (skip > 0 && timestamp < (uint64_t)skip) ? (uint64_t)skip : timestamp;
+		return;
+	}
+
+	count->samples += advance_timestamp(&skip, chunk->ctx->compress,
+			&count->last, timestamp);
+}
+
+/* Hand the current token block to the merge, waiting while it is
+ * MAX_QUEUED_BLOCKS blocks behind. */
+static void queue_block(struct chunk *chunk)
+{
+	g_mutex_lock(&chunk->mutex);
+	while (g_queue_get_length(&chunk->blocks) >= MAX_QUEUED_BLOCKS)
+		g_cond_wait(&chunk->cond, &chunk->mutex);
+	g_queue_push_tail(&chunk->blocks, chunk->cur);
+	g_cond_broadcast(&chunk->cond);
+	g_mutex_unlock(&chunk->mutex);
+	chunk->cur = NULL;
+}
+
+static void emit_token(struct chunk *chunk, uint64_t entry)
+{
+	if (chunk->count_only)
+	{
+		if (!TOKEN_IS_CHANGE(entry))
+			count_timestamp(chunk, TOKEN_TIMESTAMP(entry));
+		return;
+	}
+
+	if (chunk->cur == NULL)
+	{
+		chunk->cur = g_malloc(sizeof(struct token_block));
+		chunk->cur->len = 0;
+	}
+	chunk->cur->tokens[chunk->cur->len++] = entry;
+	if (chunk->cur->len == TOKEN_BLOCK_LEN)
+		queue_block(chunk);
+}
+
+/* Tokenize one chunk of the value change section. */
+static gpointer tokenize_chunk(gpointer data)
+{
+	struct chunk *chunk = data;
+	struct buffer *buf = &chunk->buf;
+	char identifier[MAX_IDENTIFIER_LEN + 1];
+	const char *token;
+	size_t len;
+	gpointer probe;
+	uint64_t entry;
+	int bit;
+
+	while (next_token(buf, &token, &len))
+	{
+		if (token[0] == '#' && len > 1 && g_ascii_isdigit(token[1]))
 		{
 			/* Numeric value beginning with # is a new timestamp value */
-			uint64_t timestamp;
-			timestamp = strtoull(token->str + 1, NULL, 10);
-			
-			if (ctx->downsample > 1)
-				timestamp /= ctx->downsample;
-			
-			/* Skip < 0 => skip until first timestamp.
-			 * Skip = 0 => don't skip
-			 * Skip > 0 => skip until timestamp >= skip.
-			 */
-			if (ctx->skip < 0)
-			{
-				ctx->skip = timestamp;
-				prev_timestamp = timestamp;
-			}
-			else if (ctx->skip > 0 && timestamp < (uint64_t)ctx->skip)
-			{
-				prev_timestamp = ctx->skip;
-			}
-			else if (timestamp == prev_timestamp)
-			{
-				/* Ignore repeated timestamps (e.g. sigrok outputs these) */
-			}
-			else
-			{
-				if (ctx->compress != 0 && timestamp - prev_timestamp > ctx->compress)
-				{
-					/* Compress long idle periods */
-					prev_timestamp = timestamp - ctx->compress;
-				}
-			
-				sr_dbg("New timestamp: %" PRIu64, timestamp);
-			
-				/* Generate samples from prev_timestamp up to timestamp - 1. */
-				send_samples(sdi, prev_values, timestamp - prev_timestamp);
-				prev_timestamp = timestamp;
-			}
+			entry = parse_uint64(token + 1, len - 1) << 1;
+			emit_token(chunk, entry);
 		}
-		else if (token->str[0] == '$' && token->len > 1)
+		else if (token[0] == '$' && len > 1)
 		{
 			/* This is probably a $dumpvars, $comment or similar.
 			 * $dump* contain useful data, but other tags will be skipped until $end. */
-			if (g_strcmp0(token->str, "$dumpvars") == 0 ||
-			    g_strcmp0(token->str, "$dumpon") == 0 ||
-			    g_strcmp0(token->str, "$dumpoff") == 0 ||
-			    g_strcmp0(token->str, "$end") == 0)
+			if ((len == 9 && strncmp(token, "$dumpvars", len) == 0) ||
+			    (len == 7 && strncmp(token, "$dumpon", len) == 0) ||
+			    (len == 8 && strncmp(token, "$dumpoff", len) == 0) ||
+			    (len == 4 && strncmp(token, "$end", len) == 0))
 			{
 				/* Ignore, parse contents as normally. */
 			}
 			else
 			{
 				/* Skip until $end */
-				read_until(file, NULL, '$');
+				read_until(buf, NULL, '$');
 			}
 		}
-		else if (strchr("bBrR", token->str[0]) != NULL)
+		else if (token[0] == 'b' || token[0] == 'B' ||
+			 token[0] == 'r' || token[0] == 'R')
 		{
 			/* A vector value. Skip it and also the following identifier. */
-			read_until(file, NULL, 'N');
-			read_until(file, NULL, 'W');
+			next_token(buf, &token, &len);
 		}
-		else if (strchr("01xXzZ", token->str[0]) != NULL)
+		else if (strchr("01xXzZ", token[0]) != NULL)
 		{
 			/* A new 1-bit sample value */
-			int i, bit;
-			GSList *l;
-			struct probe *probe;
+			bit = (token[0] == '1');
 
-			bit = (token->str[0] == '1');
-		
-			g_string_erase(token, 0, 1);
-			if (token->len == 0)
+			token++;
+			len--;
+			if (len == 0)
 			{
 				/* There was a space between value and identifier.
 				 * Read in the rest.
 				 */
-				read_until(file, NULL, 'N');
-				read_until(file, token, 'W');
+				next_token(buf, &token, &len);
 			}
-			
-			for (i = 0, l = ctx->probes; i < ctx->probecount && l; i++, l = l->next)
-			{
-				probe = l->data;
 
-				if (g_strcmp0(token->str, probe->identifier) == 0)
-				{
-					sr_dbg("Probe %d new value %d.", i, bit);
-				
-					/* Found our probe */
-					if (bit)
-						prev_values |= (1 << i);
-					else
-						prev_values &= ~(1 << i);
-					
-					break;
-				}
+			if (len == 0 || len > MAX_IDENTIFIER_LEN)
+				continue;
+			memcpy(identifier, token, len);
+			identifier[len] = '\0';
+
+			probe = g_hash_table_lookup(chunk->ctx->identifiers, identifier);
+			if (probe)
+			{
+				entry = ((uint64_t)(GPOINTER_TO_INT(probe) - 1) << 2) |
+					((uint64_t)bit << 1) | 1;
+				emit_token(chunk, entry);
 			}
-			
-			if (i == ctx->probecount)
+			else
 			{
-				sr_dbg("Did not find probe for identifier '%s'.", token->str);
+				sr_dbg("Did not find probe for identifier '%s'.", identifier);
 			}
 		}
 		else
 		{
-			sr_warn("Skipping unknown token '%s'.", token->str);
+			sr_warn("Skipping unknown token '%.*s'.", (int)len, token);
 		}
-		
-		g_string_truncate(token, 0);
 	}
-	
-	g_string_free(token, TRUE);
+
+	if (chunk->cur != NULL)
+		queue_block(chunk);
+	g_mutex_lock(&chunk->mutex);
+	chunk->done = TRUE;
+	g_cond_broadcast(&chunk->cond);
+	g_mutex_unlock(&chunk->mutex);
+
+	return chunk;
+}
+
+/* Take the next token block of a chunk, NULL once it is tokenized. */
+static struct token_block *next_block(struct chunk *chunk)
+{
+	struct token_block *block;
+
+	g_mutex_lock(&chunk->mutex);
+	while (g_queue_is_empty(&chunk->blocks) && !chunk->done)
+		g_cond_wait(&chunk->cond, &chunk->mutex);
+	block = g_queue_pop_head(&chunk->blocks);
+	g_cond_broadcast(&chunk->cond);
+	g_mutex_unlock(&chunk->mutex);
+
+	return block;
+}
+
+/* Find the start of the next line holding a timestamp.
+ * Chunks start there, so that they can be tokenized on their own.
+ */
+static const char *next_timestamp_line(const char *pos, const char *end)
+{
+	const char *nl;
+
+	while (pos < end - 1)
+	{
+		nl = memchr(pos, '\n', end - 1 - pos);
+		if (nl == NULL)
+			break;
+		if (nl[1] == '#')
+			return nl + 1;
+		pos = nl + 1;
+	}
+
+	return end;
+}
+
+/* Resolve the timestamps of a chunk into samples as its tokens come in. */
+static void merge_chunk(struct chunk *chunk, struct sample_writer *writer,
+		struct context *ctx, uint64_t *prev_timestamp, uint64_t *prev_values)
+{
+	struct token_block *block;
+	uint64_t timestamp, token;
+	guint i;
+
+	while ((block = next_block(chunk)) != NULL)
+	{
+		for (i = 0; i < block->len; i++)
+		{
+			token = block->tokens[i];
+			if (TOKEN_IS_CHANGE(token))
+			{
+				if (TOKEN_BIT(token))
+					*prev_values |= (1ULL << TOKEN_PROBE(token));
+				else
+					*prev_values &= ~(1ULL << TOKEN_PROBE(token));
+				continue;
+			}
+
+			timestamp = TOKEN_TIMESTAMP(token);
+			if (ctx->downsample > 1)
+				timestamp /= ctx->downsample;
+
+			/* Generate samples from prev_timestamp up to timestamp - 1. */
+			send_samples(writer, *prev_values, advance_timestamp(&ctx->skip,
+					ctx->compress, prev_timestamp, timestamp));
+		}
+		g_free(block);
+	}
+}
+
+/* Tokenize the value change section in rounds of at most one chunk per
+ * thread, handing every chunk of a round to process() in file order.
+ */
+static void run_chunks(struct buffer *buf, struct context *ctx, gboolean count_only,
+		void (*process)(struct chunk *chunk, void *data), void *data)
+{
+	struct chunk *chunks;
+	GThread **threads;
+	const char *pos;
+	int num_threads, n, i;
+
+#if GLIB_CHECK_VERSION(2, 36, 0)
+	num_threads = MAX(g_get_num_processors(), 1);
+#else
+	num_threads = 4;
+#endif
+
+	chunks = g_malloc0(sizeof(struct chunk) * num_threads);
+	threads = g_malloc0(sizeof(GThread *) * num_threads);
+	for (i = 0; i < num_threads; i++)
+	{
+		g_mutex_init(&chunks[i].mutex);
+		g_cond_init(&chunks[i].cond);
+	}
+
+	pos = buf->pos;
+	while (pos < buf->end)
+	{
+		for (n = 0; n < num_threads && pos < buf->end; n++)
+		{
+			chunks[n].ctx = ctx;
+			chunks[n].count_only = count_only;
+			memset(&chunks[n].count, 0, sizeof(chunks[n].count));
+			chunks[n].cur = NULL;
+			g_queue_init(&chunks[n].blocks);
+			chunks[n].done = FALSE;
+			chunks[n].buf.pos = pos;
+			if ((uint64_t)(buf->end - pos) > CHUNK_SIZE)
+				pos = next_timestamp_line(pos + CHUNK_SIZE, buf->end);
+			else
+				pos = buf->end;
+			chunks[n].buf.end = pos;
+		}
+
+		/* Tokenizers always get a thread of their own: the merge
+		 * takes their tokens while they run. */
+		for (i = 0; i < n; i++)
+			threads[i] = g_thread_new("vcd-tokenizer", tokenize_chunk, &chunks[i]);
+		for (i = 0; i < n; i++)
+			process(&chunks[i], data);
+		for (i = 0; i < n; i++)
+			g_thread_join(threads[i]);
+	}
+
+	for (i = 0; i < num_threads; i++)
+	{
+		g_mutex_clear(&chunks[i].mutex);
+		g_cond_clear(&chunks[i].cond);
+	}
+	g_free(chunks);
+	g_free(threads);
+}
+
+struct count_state
+{
+	const struct context *ctx;
+	int64_t skip;
+	uint64_t prev_timestamp;
+	uint64_t total;
+};
+
+/* Add the count of a chunk to the ones before it. */
+static void add_chunk_count(struct chunk *chunk, void *data)
+{
+	struct count_state *state = data;
+
+	/* The count is complete once the thread says it is done. */
+	while (next_block(chunk) != NULL);
+
+	if (!chunk->count.has_first)
+		return;
+	state->total += advance_timestamp(&state->skip, state->ctx->compress,
+			&state->prev_timestamp, chunk->count.first);
+	state->total += chunk->count.samples;
+	state->prev_timestamp = chunk->count.last;
+}
+
+struct merge_state
+{
+	struct sample_writer *writer;
+	struct context *ctx;
+	uint64_t prev_timestamp;
+	uint64_t prev_values;
+};
+
+static void merge_chunk_cb(struct chunk *chunk, void *data)
+{
+	struct merge_state *state = data;
+
+	merge_chunk(chunk, state->writer, state->ctx,
+			&state->prev_timestamp, &state->prev_values);
+}
+
+/* Count the samples the value change section generates. LA_SPLIT_DATA
+ * consumers size their buffers before the first block, so the total is
+ * known before any sample is sent. Only timestamps are looked at.
+ */
+static uint64_t count_samples(struct buffer *buf, struct context *ctx)
+{
+	struct count_state state;
+
+	state.ctx = ctx;
+	state.skip = ctx->skip;
+	state.prev_timestamp = 0;
+	state.total = 0;
+	run_chunks(buf, ctx, TRUE, add_chunk_count, &state);
+
+	return state.total;
+}
+
+/* Parse the data section of VCD.
+ * Chunks of the section are tokenized in parallel, and their tokens
+ * merged in file order as they come in.
+ */
+static void parse_contents(struct buffer *buf, const struct sr_dev_inst *sdi,
+		struct context *ctx, uint64_t total)
+{
+	struct sample_writer writer;
+	struct merge_state state;
+	int i;
+
+	writer.sdi = sdi;
+	writer.num_probes = g_slist_length(sdi->channels);
+	writer.fill = 0;
+	writer.sent = 0;
+	writer.total = total;
+	writer.blocks = g_malloc0(sizeof(uint8_t *) * writer.num_probes);
+	for (i = 0; i < writer.num_probes; i++)
+		writer.blocks[i] = g_malloc0(BLOCK_SAMPLES / 8);
+
+	state.writer = &writer;
+	state.ctx = ctx;
+	state.prev_timestamp = 0;
+	state.prev_values = 0;
+	run_chunks(buf, ctx, FALSE, merge_chunk_cb, &state);
+
+	if (writer.sent + writer.fill != total)
+	{
+		sr_warn("Generated %" PRIu64 " of %" PRIu64 " counted samples, padding.",
+			writer.sent + writer.fill, total);
+		send_samples(&writer, state.prev_values, total);
+	}
+	flush_samples(&writer);
+
+	for (i = 0; i < writer.num_probes; i++)
+		g_free(writer.blocks[i]);
+	g_free(writer.blocks);
 }
 
 static int loadfile(struct sr_input *in, const char *filename)
@@ -558,43 +1013,50 @@ static int loadfile(struct sr_input *in, const char *filename)
 	struct sr_datafeed_packet packet;
 	struct sr_datafeed_meta meta;
 	struct sr_config *src;
-	FILE *file;
+	GMappedFile *file;
+	struct buffer buf;
 	struct context *ctx;
-	uint64_t samplerate;
+	uint64_t samplerate, total;
 
 	ctx = in->internal;
     packet.status = SR_PKT_OK;
 
-    if ((file = fopen(filename, "r")) == NULL)
+	if ((file = g_mapped_file_new(filename, FALSE, NULL)) == NULL)
 		return SR_ERR;
+	buf.pos = g_mapped_file_get_contents(file);
+	buf.end = buf.pos + g_mapped_file_get_length(file);
 
-	if (!parse_header(file, ctx))
+	if (!parse_header(&buf, ctx))
 	{
 		sr_err("VCD parsing failed");
-		fclose(file);
+		g_mapped_file_unref(file);
 		return SR_ERR;
 	}
 
 	/* Send header packet to the session bus. */
 	std_session_send_df_header(in->sdi, LOG_PREFIX);
 
+	total = count_samples(&buf, ctx);
+
 	/* Send metadata about the SR_DF_LOGIC packets to come. */
 	packet.type = SR_DF_META;
 	packet.payload = &meta;
 	samplerate = ctx->samplerate / ctx->downsample;
 	src = sr_config_new(SR_CONF_SAMPLERATE, g_variant_new_uint64(samplerate));
 	meta.config = g_slist_append(NULL, src);
+	src = sr_config_new(SR_CONF_LIMIT_SAMPLES, g_variant_new_uint64(total));
+	meta.config = g_slist_append(meta.config, src);
 	sr_session_send(in->sdi, &packet);
-	sr_config_free(src);
+	g_slist_free_full(meta.config, (GDestroyNotify)sr_config_free);
 
 	/* Parse the contents of the VCD file */
-	parse_contents(file, in->sdi, ctx);
+	parse_contents(&buf, in->sdi, ctx, total);
 	
 	/* Send end packet to the session bus. */
 	packet.type = SR_DF_END;
 	sr_session_send(in->sdi, &packet);
 
-	fclose(file);
+	g_mapped_file_unref(file);
 	release_context(ctx);
 	in->internal = NULL;
 
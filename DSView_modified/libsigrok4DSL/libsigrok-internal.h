@@ -46,6 +46,13 @@
 struct sr_context {
 #ifdef HAVE_LIBUSB_1_0
 	libusb_context *libusb_ctx;
+	/* The session sources of the libusb descriptors, see usb_source_add(). */
+	gboolean usb_source_present;
+	int usb_source_timeout;
+	/* The callbacks registered for them, one per device. */
+	GSList *usb_sources;
+	/* What the session sources pass on, its priv is the context. */
+	struct sr_dev_inst *usb_dispatcher;
 #endif
 };
 
@@ -117,7 +124,29 @@ SR_PRIV int sr_source_add(int fd, int events, int timeout,
 
 SR_PRIV int sr_session_send(const struct sr_dev_inst *sdi,
 		const struct sr_datafeed_packet *packet);
+SR_PRIV int sr_session_send_buffer(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void **buf, uint64_t *size);
 SR_PRIV int sr_session_stop_sync(void);
+SR_PRIV int sr_session_source_defer(int fd, gint64 until);
+SR_PRIV int sr_session_feed_hook_add(const struct sr_dev_inst *sdi,
+		sr_datafeed_callback_t cb, void *cb_data);
+SR_PRIV int sr_session_feed_hook_remove(const struct sr_dev_inst *sdi);
+
+/*--- traceset.c ------------------------------------------------------------*/
+
+struct sr_traceset;
+
+/* Selects the mean trace of a set instead of one trace. */
+#define SR_TRACESET_MEAN -1
+
+SR_PRIV int sr_traceset_check(const char *filename);
+SR_PRIV int sr_traceset_load(const char *filename);
+SR_PRIV uint64_t sr_traceset_count(const char *filename);
+SR_PRIV struct sr_traceset *sr_traceset_open(const char *filename, int64_t trace);
+SR_PRIV void sr_traceset_close(struct sr_traceset *ts);
+SR_PRIV void sr_traceset_range(const struct sr_traceset *ts, double *min, double *max);
+SR_PRIV uint64_t sr_traceset_read(const struct sr_traceset *ts, uint8_t *buf,
+		uint64_t start, uint64_t count);
 
 /*--- std.c -----------------------------------------------------------------*/
 
@@ -185,6 +214,10 @@ SR_PRIV int ezusb_upload_firmware(libusb_device *dev, int configuration,
 #ifdef HAVE_LIBUSB_1_0
 SR_PRIV GSList *sr_usb_find(libusb_context *usb_ctx, const char *conn);
 SR_PRIV int sr_usb_open(libusb_context *usb_ctx, struct sr_usb_dev_inst *usb);
+SR_PRIV int usb_source_add(struct sr_context *ctx, int timeout,
+		sr_receive_data_callback_t cb, const struct sr_dev_inst *sdi);
+SR_PRIV int usb_source_remove(struct sr_context *ctx,
+		const struct sr_dev_inst *sdi);
 #endif
 
 
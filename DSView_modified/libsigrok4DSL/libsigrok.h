@@ -195,6 +195,7 @@ enum {
 	SR_DF_FRAME_BEGIN,
 	SR_DF_FRAME_END,
     SR_DF_OVERFLOW,
+    SR_DF_LOGIC_EDGE,
 };
 
 /** Values for sr_datafeed_analog.mq. */
@@ -357,6 +358,19 @@ struct sr_datafeed_logic {
 	void *data;
 };
 
+/**
+ * Sparse logic data, only the samples where at least one channel
+ * changed. The first entry of a stream carries the initial state.
+ */
+struct sr_datafeed_logic_edge {
+    uint64_t num_edges;
+    uint16_t unitsize;
+    /** sample index of each entry */
+    const uint64_t *index;
+    /** channel values at each index, unitsize bytes per entry */
+    void *data;
+};
+
 struct sr_datafeed_dso {
     /** The probes for which data is included in this packet. */
     GSList *probes;
@@ -876,6 +890,30 @@ enum {
     SR_CONF_MAX_DSO_SAMPLELIMITS,
     SR_CONF_HW_DEPTH,
 
+    /** Keep transfers and settings between captures to re-arm faster */
+    SR_CONF_REARM,
+
+    /**
+     * Transfer counters of the capture, "(uuuttt)": transfers in flight,
+     * the most in flight, transfer size, overflows, the longest gap
+     * between two completions and the longest a packet took downstream,
+     * both in us.
+     */
+    SR_CONF_TRANSFER_STATS,
+
+    /**
+     * Plaintext and ciphertext of the trace whose samples follow, "ay"
+     * of 16 bytes each. Sent in an SR_DF_META packet.
+     */
+    SR_CONF_TRACE_TEXTS,
+
+    /**
+     * Trace of a trace set to show, and whether to show the mean trace
+     * instead. Taken on the next acquisition start.
+     */
+    SR_CONF_TRACE_INDEX,
+    SR_CONF_TRACE_MEAN,
+
     /*--- Probe configuration -------------------------------------------*/
     /** Probe options */
     SR_CONF_PROBE_CONFIGS,
@@ -1129,6 +1167,8 @@ struct sr_session {
 	GSList *devs;
 	/** List of struct datafeed_callback pointers. */
 	GSList *datafeed_callbacks;
+	/** List of struct feed_hook pointers, see sr_session_feed_hook_add(). */
+	GSList *feed_hooks;
 	GTimeVal starttime;
 	gboolean running;
 
@@ -1138,11 +1178,11 @@ struct sr_session {
 	 * Both "sources" and "pollfds" are of the same size and contain pairs
 	 * of descriptor and callback function. We can not embed the GPollFD
 	 * into the source struct since we want to be able to pass the array
-	 * of all poll descriptors to g_poll().
+	 * of all poll descriptors to g_poll(). "pollfds" has one more entry
+	 * at the end for the wakeup pipe.
 	 */
 	struct source *sources;
 	GPollFD *pollfds;
-	int source_timeout;
 
 	/*
 	 * These are our synchronization primitives for stopping the session in
@@ -1151,6 +1191,12 @@ struct sr_session {
 	 */
     GMutex stop_mutex;
 	gboolean abort_session;
+	/*
+	 * A pipe polled together with the sources, written to by
+	 * sr_session_stop() so a session blocked in g_poll() stops
+	 * without waiting for a source to fire. -1 where there is none.
+	 */
+	int wakeup_fds[2];
 };
 
 enum {
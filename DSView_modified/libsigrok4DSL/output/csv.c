@@ -186,6 +186,7 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 {
 	const struct sr_datafeed_meta *meta;
 	const struct sr_datafeed_logic *logic;
+    const struct sr_datafeed_logic_edge *edge;
     const struct sr_datafeed_dso *dso;
     const struct sr_datafeed_analog *analog;
 	const struct sr_config *src;
@@ -238,6 +239,29 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
             ctx->pre_data = (*(uint64_t *)(logic->data + i) & ctx->mask);
 		}
 		break;
+    case SR_DF_LOGIC_EDGE:
+        /* Rows are only emitted on changes, so each entry is one row. */
+        edge = packet->payload;
+        if (!ctx->header_done) {
+            *out = gen_header(o);
+            ctx->header_done = TRUE;
+        } else {
+            *out = g_string_sized_new(512);
+        }
+
+        for (i = 0; i < edge->num_edges; i++) {
+            g_string_append_printf(*out, "%0.10g", edge->index[i]*1.0/ctx->samplerate);
+            for (j = 0; j < ctx->num_enabled_channels; j++) {
+                p = (unsigned char *)edge->data + i * edge->unitsize + j / 8;
+                c = *p & (1 << (j % 8));
+                g_string_append_c(*out, ctx->separator);
+                g_string_append_c(*out, c ? '1' : '0');
+            }
+            g_string_append_printf(*out, "\n");
+        }
+        if (edge->num_edges != 0)
+            ctx->index = edge->index[edge->num_edges - 1] + 1;
+        break;
      case SR_DF_DSO:
         dso = packet->payload;
         if (!ctx->header_done) {
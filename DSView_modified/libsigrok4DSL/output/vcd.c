@@ -158,6 +158,7 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 {
 	const struct sr_datafeed_meta *meta;
 	const struct sr_datafeed_logic *logic;
+	const struct sr_datafeed_logic_edge *edge;
 	const struct sr_config *src;
 	GSList *l;
 	struct context *ctx;
@@ -234,6 +235,50 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 			memcpy(ctx->prevsample, sample, logic->unitsize);
 		}
 		break;
+	case SR_DF_LOGIC_EDGE:
+		edge = packet->payload;
+
+		if (!ctx->header_done) {
+			*out = gen_header(o);
+			ctx->header_done = TRUE;
+		} else {
+			*out = g_string_sized_new(512);
+		}
+
+		if (!ctx->prevsample)
+			ctx->prevsample = g_malloc0(edge->unitsize);
+
+		for (i = 0; i < edge->num_edges; i++) {
+			sample = (uint8_t *)edge->data + i * edge->unitsize;
+			timestamp_written = FALSE;
+
+			for (p = 0; p < ctx->num_enabled_channels; p++) {
+				curbit = ((unsigned)sample[p / 8] >> (p % 8)) & 1;
+				prevbit = ((unsigned)ctx->prevsample[p / 8] >> (p % 8)) & 1;
+
+				/* The first entry dumps the initial state of all signals. */
+				if (prevbit == curbit && ctx->samplecount > 0)
+					continue;
+
+				if (!timestamp_written)
+					g_string_append_printf(*out, "#%.0f",
+						(double)edge->index[i] /
+							ctx->samplerate * ctx->period);
+
+				g_string_append_c(*out, ' ');
+				g_string_append_c(*out, '0' + curbit);
+				g_string_append_c(*out, '!' + p);
+
+				timestamp_written = TRUE;
+			}
+
+			if (timestamp_written)
+				g_string_append_c(*out, '\n');
+
+			ctx->samplecount = edge->index[i] + 1;
+			memcpy(ctx->prevsample, sample, edge->unitsize);
+		}
+		break;
 	case SR_DF_END:
 		/* Write final timestamp as length indicator. */
 		*out = g_string_sized_new(512);
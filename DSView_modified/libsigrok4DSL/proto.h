@@ -116,6 +116,14 @@ SR_API int sr_session_source_add_channel(GIOChannel *channel, int events,
 SR_API int sr_session_source_remove(int fd);
 SR_API int sr_session_source_remove_pollfd(GPollFD *pollfd);
 SR_API int sr_session_source_remove_channel(GIOChannel *channel);
+SR_API gboolean sr_session_swap_data(const void *data, uint64_t min_size,
+		void **buf, uint64_t *size);
+
+/*--- sync_driver.c ---------------------------------------------------------*/
+
+SR_API int sr_sync_group_new(GSList *devs, struct sr_dev_inst **sdi);
+SR_API gboolean sr_sync_group_uses(const struct sr_dev_inst *sdi,
+		const struct sr_dev_driver *driver);
 
 /*--- input/input.c ---------------------------------------------------------*/
 
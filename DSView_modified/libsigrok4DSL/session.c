@@ -23,6 +23,10 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
+#include <errno.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#endif
 #include <glib.h>
 
 /* Message logging helpers with subsystem-specific prefix string. */
@@ -53,6 +57,16 @@ struct source {
 	sr_receive_data_callback_t cb;
     const void *cb_data;
 
+	/* Monotonic time the timeout runs out at, -1 without a timeout. */
+	gint64 due;
+	/*
+	 * Monotonic time a source without a descriptor is not ready
+	 * before, see sr_session_source_defer().
+	 */
+	gint64 defer;
+	/* Ready in the current iteration and not dispatched yet. */
+	gboolean pending;
+
 	/* This is used to keep track of the object (fd, pollfd or channel) which is
 	 * being polled and will be used to match the source when removing it again.
 	 */
@@ -64,6 +78,25 @@ struct datafeed_callback {
 	void *cb_data;
 };
 
+/* Takes the packets of one device instead of the datafeed callbacks. */
+struct feed_hook {
+	const struct sr_dev_inst *sdi;
+	sr_datafeed_callback_t cb;
+	void *cb_data;
+};
+
+static int _sr_session_source_remove(gintptr poll_object);
+
+/* The buffer of a packet sent by sr_session_send_buffer(). */
+struct send_buffer {
+	const void *data;
+	void *buf;
+	uint64_t size;
+};
+
+/* Per thread, a driver may send from a thread of its own. */
+static GPrivate send_buffer_key = G_PRIVATE_INIT(NULL);
+
 /* There can only be one session at a time. */
 /* 'session' is not static, it's used elsewhere (via 'extern'). */
 struct sr_session *session;
@@ -83,11 +116,22 @@ SR_API struct sr_session *sr_session_new(void)
 		return NULL;
 	}
 
-	session->source_timeout = -1;
     session->running = FALSE;
 	session->abort_session = FALSE;
     g_mutex_init(&session->stop_mutex);
 
+	session->wakeup_fds[0] = session->wakeup_fds[1] = -1;
+#ifndef _WIN32
+	if (pipe(session->wakeup_fds) == 0) {
+		fcntl(session->wakeup_fds[0], F_SETFL, O_NONBLOCK);
+		fcntl(session->wakeup_fds[1], F_SETFL, O_NONBLOCK);
+	} else {
+		sr_warn("Failed to create the wakeup pipe, stopping a "
+			"session waits for its sources.");
+		session->wakeup_fds[0] = session->wakeup_fds[1] = -1;
+	}
+#endif
+
 	return session;
 }
 
@@ -109,6 +153,9 @@ SR_API int sr_session_destroy(void)
 
     sr_session_datafeed_callback_remove_all();
 
+    g_slist_free_full(session->feed_hooks, g_free);
+    session->feed_hooks = NULL;
+
     if (session->sources) {
         g_free(session->sources);
         session->sources = NULL;
@@ -123,6 +170,11 @@ SR_API int sr_session_destroy(void)
 
     g_mutex_clear(&session->stop_mutex);
 
+	if (session->wakeup_fds[0] != -1) {
+		close(session->wakeup_fds[0]);
+		close(session->wakeup_fds[1]);
+	}
+
 	g_free(session);
 	session = NULL;
 
@@ -283,6 +335,194 @@ SR_API int sr_session_datafeed_callback_add(sr_datafeed_callback_t cb, void *cb_
 	return SR_OK;
 }
 
+/**
+ * Take the packets a device sends, instead of passing them on to the
+ * datafeed callbacks. This is how a device made of several others sees
+ * the packets of its members, to send packets of its own instead.
+ *
+ * Hooks are only to be added or removed while the device is not
+ * acquiring, the packets may be sent from a thread of the driver.
+ *
+ * @param sdi The device whose packets to take. Must not be NULL.
+ * @param cb Function to call with each of them. Must not be NULL.
+ * @param cb_data Opaque pointer passed to cb.
+ *
+ * @return SR_OK upon success, SR_ERR_ARG upon invalid arguments,
+ *         SR_ERR_BUG if no session exists.
+ *
+ * @private
+ */
+SR_PRIV int sr_session_feed_hook_add(const struct sr_dev_inst *sdi,
+		sr_datafeed_callback_t cb, void *cb_data)
+{
+	struct feed_hook *hook;
+
+	if (!session) {
+		sr_err("%s: session was NULL", __func__);
+		return SR_ERR_BUG;
+	}
+
+	if (!sdi || !cb) {
+		sr_err("%s: sdi or cb was NULL", __func__);
+		return SR_ERR_ARG;
+	}
+
+	sr_session_feed_hook_remove(sdi);
+
+	hook = g_malloc0(sizeof(struct feed_hook));
+	hook->sdi = sdi;
+	hook->cb = cb;
+	hook->cb_data = cb_data;
+	session->feed_hooks = g_slist_append(session->feed_hooks, hook);
+
+	return SR_OK;
+}
+
+/**
+ * Remove the hook added for a device by sr_session_feed_hook_add(),
+ * if there is one.
+ *
+ * @param sdi The device passed to sr_session_feed_hook_add().
+ *
+ * @return SR_OK upon success, SR_ERR_BUG if no session exists.
+ *
+ * @private
+ */
+SR_PRIV int sr_session_feed_hook_remove(const struct sr_dev_inst *sdi)
+{
+	struct feed_hook *hook;
+	GSList *l;
+
+	if (!session) {
+		sr_err("%s: session was NULL", __func__);
+		return SR_ERR_BUG;
+	}
+
+	for (l = session->feed_hooks; l; l = l->next) {
+		hook = l->data;
+		if (hook->sdi == sdi) {
+			session->feed_hooks =
+			    g_slist_delete_link(session->feed_hooks, l);
+			g_free(hook);
+			break;
+		}
+	}
+
+	return SR_OK;
+}
+
+/* Number of entries of session->pollfds to hand to g_poll(). */
+static unsigned int session_num_pollfds(void)
+{
+	if (!session->pollfds)
+		return 0;
+
+	return session->num_sources + (session->wakeup_fds[0] != -1);
+}
+
+/* Put the wakeup pipe after the sources in session->pollfds. */
+static void session_set_wakeup_pollfd(void)
+{
+	GPollFD *p;
+
+	if (session->wakeup_fds[0] == -1 || !session->pollfds)
+		return;
+
+	p = &session->pollfds[session->num_sources];
+	p->fd = session->wakeup_fds[0];
+	p->events = G_IO_IN;
+	p->revents = 0;
+}
+
+static void session_drain_wakeup(void)
+{
+	char buf[16];
+
+	if (session->wakeup_fds[0] == -1)
+		return;
+
+	while (read(session->wakeup_fds[0], buf, sizeof(buf)) > 0)
+		;
+}
+
+/*
+ * How long g_poll() may block: until the first timeout of a source runs
+ * out, not at all while there is a source without a descriptor, which
+ * is always ready unless deferred, or for good if no source has a
+ * timeout.
+ */
+static int session_poll_timeout(gint64 now)
+{
+	unsigned int i;
+	gint64 due, remaining, timeout;
+
+	timeout = -1;
+	for (i = 0; i < session->num_sources; i++) {
+		if (session->pollfds[i].fd == -1)
+			due = session->sources[i].defer;
+		else
+			due = session->sources[i].due;
+		if (due == -1)
+			continue;
+		remaining = due - now;
+		if (remaining <= 0)
+			return 0;
+		/* Round up, a timeout waking up early would only poll again. */
+		remaining = (remaining + 999) / 1000;
+		if (timeout == -1 || remaining < timeout)
+			timeout = remaining;
+	}
+
+	return timeout > G_MAXINT ? G_MAXINT : (int)timeout;
+}
+
+/*
+ * Give the sources without a descriptor a last call with revents -1,
+ * they are not polled and only learn about an abort this way.
+ */
+static void session_abort_sources(void)
+{
+	unsigned int i;
+	struct source *s;
+
+	i = session->num_sources;
+	while (i-- > 0) {
+		if (session->pollfds[i].fd != -1)
+			continue;
+		s = &session->sources[i];
+		if (!s->cb(-1, -1, s->cb_data))
+			sr_session_source_remove(-1);
+		if (i > session->num_sources)
+			i = session->num_sources;
+	}
+}
+
+static void session_check_abort(void)
+{
+	gboolean abort_session;
+
+	/*
+	 * We want to take as little time as possible to stop
+	 * the session if we have been told to do so. Therefore,
+	 * we check the flag after processing every source, not
+	 * just once per main event loop.
+	 */
+	g_mutex_lock(&session->stop_mutex);
+	abort_session = session->abort_session;
+	/* But once is enough. */
+	session->abort_session = FALSE;
+	g_mutex_unlock(&session->stop_mutex);
+
+	/*
+	 * The sources and drivers are called without the lock, they
+	 * may well stop the session themselves.
+	 */
+	if (abort_session) {
+		session_abort_sources();
+		sr_session_stop_sync();
+	}
+}
+
 /**
  * Call every device in the session's callback.
  *
@@ -290,6 +530,12 @@ SR_API int sr_session_datafeed_callback_add(sr_datafeed_callback_t cb, void *cb_
  * but driven by another scheduler, this can be used to poll the devices
  * from within that scheduler.
  *
+ * A source is ready if its descriptor has an event, if its timeout ran
+ * out since its callback was last run, or always if it has no descriptor,
+ * unless it has deferred its next call.
+ * Each source keeps its own timeout, so a source with a long timeout
+ * still gets called next to one with a short one.
+ *
  * @param block If TRUE, this call will wait for any of the session's
  *              sources to fire an event on the file descriptors, or
  *              any of their timeouts to activate. In other words, this
@@ -301,37 +547,68 @@ SR_API int sr_session_datafeed_callback_add(sr_datafeed_callback_t cb, void *cb_
  */
 static int sr_session_iteration(gboolean block)
 {
-	unsigned int i;
-	int ret;
+	unsigned int i, num_sources;
+	struct source *s;
+	GPollFD *p;
+	gintptr poll_object;
+	gint64 now;
+	int ret, revents;
+
+	ret = g_poll(session->pollfds, session_num_pollfds(),
+			block ? session_poll_timeout(g_get_monotonic_time()) : 0);
+	if (ret < 0 && errno != EINTR) {
+		sr_err("%s: g_poll failed: %s", __func__, g_strerror(errno));
+		return SR_ERR;
+	}
 
-	ret = g_poll(session->pollfds, session->num_sources,
-			block ? session->source_timeout : 0);
+	session_drain_wakeup();
+	session_check_abort();
+
+	now = g_get_monotonic_time();
 	for (i = 0; i < session->num_sources; i++) {
-		if (session->pollfds[i].revents > 0 || (ret == 0
-			&& session->source_timeout == session->sources[i].timeout)) {
-			/*
-			 * Invoke the source's callback on an event,
-			 * or if the poll timed out and this source
-			 * asked for that timeout.
-			 */
-			if (!session->sources[i].cb(session->pollfds[i].fd,
-					session->pollfds[i].revents,
-					session->sources[i].cb_data))
-				sr_session_source_remove(session->sources[i].poll_object);
+		s = &session->sources[i];
+		p = &session->pollfds[i];
+		s->pending = !block || (ret > 0 && p->revents > 0) ||
+			(p->fd == -1 && s->defer <= now) ||
+			(s->due != -1 && s->due <= now);
+	}
+
+	i = 0;
+	while (i < session->num_sources) {
+		s = &session->sources[i];
+		p = &session->pollfds[i];
+		if (!s->pending) {
+			i++;
+			continue;
 		}
+
+		s->pending = FALSE;
+		revents = ret > 0 ? p->revents : 0;
+		p->revents = 0;
+		if (s->timeout > 0)
+			s->due = now + (gint64)s->timeout * 1000;
+		s->defer = 0;
+
 		/*
-		 * We want to take as little time as possible to stop
-		 * the session if we have been told to do so. Therefore,
-		 * we check the flag after processing every source, not
-		 * just once per main event loop.
+		 * Invoke the source's callback on an event,
+		 * or if its timeout ran out.
 		 */
-        g_mutex_lock(&session->stop_mutex);
-		if (session->abort_session) {
-			sr_session_stop_sync();
-			/* But once is enough. */
-			session->abort_session = FALSE;
-		}
-        g_mutex_unlock(&session->stop_mutex);
+		poll_object = s->poll_object;
+		num_sources = session->num_sources;
+		if (!s->cb(p->fd, revents, s->cb_data))
+			_sr_session_source_remove(poll_object);
+
+		/*
+		 * The callback may have added or removed sources, look for
+		 * the ones still pending from the start then.
+		 */
+		if (session->num_sources != num_sources ||
+		    session->sources[i].poll_object != poll_object)
+			i = 0;
+		else
+			i++;
+
+		session_check_abort();
 	}
 
 	return SR_OK;
@@ -403,28 +680,21 @@ SR_API int sr_session_run(void)
 
 	sr_info("Running...");
 
-	/* Do we have real sources? */
-	if (session->num_sources == 1 && session->pollfds[0].fd == -1) {
-		/* Dummy source, freewheel over it. */
-        while (session->num_sources) {
-            if (session->abort_session) {
-                session->sources[0].cb(-1, -1, session->sources[0].cb_data);
-                break;
-            } else {
-                session->sources[0].cb(-1, 0, session->sources[0].cb_data);
-            }
-        }
-	} else {
-		/* Real sources, use g_poll() main loop. */
-        while (session->num_sources)
-            sr_session_iteration(TRUE);
+	/*
+	 * Sources without a descriptor, like the one of a session file,
+	 * are always ready and keep g_poll() from blocking, all others
+	 * wait for their events or timeouts.
+	 */
+	while (session->num_sources) {
+		if (sr_session_iteration(TRUE) != SR_OK)
+			break;
 	}
 
     g_mutex_lock(&session->stop_mutex);
-    sr_session_stop_sync();
     session->running = FALSE;
     session->abort_session = FALSE;
     g_mutex_unlock(&session->stop_mutex);
+    sr_session_stop_sync();
 	return SR_OK;
 }
 
@@ -483,8 +753,13 @@ SR_API int sr_session_stop(void)
 	}
 
     g_mutex_lock(&session->stop_mutex);
-    if (session->running)
+    if (session->running) {
         session->abort_session = TRUE;
+        /* Wake up the session thread if it is blocked in g_poll(). */
+        if (session->wakeup_fds[1] != -1 &&
+            write(session->wakeup_fds[1], "", 1) < 0 && errno != EAGAIN)
+            sr_warn("%s: failed to wake up the session", __func__);
+    }
     g_mutex_unlock(&session->stop_mutex);
 
 	return SR_OK;
@@ -561,6 +836,7 @@ SR_PRIV int sr_session_send(const struct sr_dev_inst *sdi,
 {
 	GSList *l;
 	struct datafeed_callback *cb_struct;
+	struct feed_hook *hook;
 
 	if (!sdi) {
 		sr_err("%s: sdi was NULL", __func__);
@@ -572,6 +848,14 @@ SR_PRIV int sr_session_send(const struct sr_dev_inst *sdi,
 		return SR_ERR_ARG;
 	}
 
+	for (l = session->feed_hooks; l; l = l->next) {
+		hook = l->data;
+		if (hook->sdi == sdi) {
+			hook->cb(sdi, packet, hook->cb_data);
+			return SR_OK;
+		}
+	}
+
 	for (l = session->datafeed_callbacks; l; l = l->next) {
 		if (sr_log_loglevel_get() >= SR_LOG_DBG)
 			datafeed_dump(packet);
@@ -582,6 +866,79 @@ SR_PRIV int sr_session_send(const struct sr_dev_inst *sdi,
 	return SR_OK;
 }
 
+/**
+ * Send a packet whose data is in a buffer of its own, which the
+ * datafeed callbacks may take over with sr_session_swap_data() instead
+ * of copying the data out of it.
+ *
+ * @param sdi The device instance sending the packet.
+ * @param packet The datafeed packet, its data at the start of *buf.
+ * @param buf The buffer, allocated with g_malloc(). On return the buffer
+ *            to reuse, which is one given in exchange if the buffer was
+ *            taken over, or NULL if it was taken without one.
+ * @param size The size of *buf, updated along with it.
+ *
+ * @return SR_OK upon success, SR_ERR_ARG upon invalid arguments.
+ *
+ * @private
+ */
+SR_PRIV int sr_session_send_buffer(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void **buf, uint64_t *size)
+{
+	struct send_buffer sb;
+	int ret;
+
+	sb.data = *buf;
+	sb.buf = *buf;
+	sb.size = *size;
+	g_private_set(&send_buffer_key, &sb);
+	ret = sr_session_send(sdi, packet);
+	g_private_set(&send_buffer_key, NULL);
+
+	*buf = sb.buf;
+	*size = sb.size;
+
+	return ret;
+}
+
+/**
+ * Take over the buffer holding the data of the packet being sent,
+ * instead of copying the data. This can only be done from within a
+ * datafeed callback, for a packet whose driver hands out its buffers,
+ * and once per packet.
+ *
+ * @param data The data of the packet, as in its payload.
+ * @param min_size Only take a buffer of at least this many bytes.
+ * @param buf A buffer given in exchange, which the driver fills again,
+ *            allocated with g_malloc(). Can be NULL. On success this
+ *            is the buffer of the packet, to be freed with g_free().
+ * @param size The size of *buf, updated along with it.
+ *
+ * @return TRUE if the buffers were exchanged, FALSE if the data has to
+ *         be copied.
+ */
+SR_API gboolean sr_session_swap_data(const void *data, uint64_t min_size,
+		void **buf, uint64_t *size)
+{
+	struct send_buffer *sb;
+	void *tmp;
+	uint64_t tmp_size;
+
+	sb = g_private_get(&send_buffer_key);
+	if (!sb || !data || data != sb->data || sb->size < min_size)
+		return FALSE;
+
+	tmp = sb->buf;
+	tmp_size = sb->size;
+	sb->buf = *buf;
+	sb->size = *buf ? *size : 0;
+	sb->data = NULL;
+	*buf = tmp;
+	*size = tmp_size;
+
+	return TRUE;
+}
+
 /**
  * Add an event source for a file descriptor.
  *
@@ -607,12 +964,14 @@ static int _sr_session_source_add(GPollFD *pollfd, int timeout,
 
 	/* Note: cb_data can be NULL, that's not a bug. */
 
+	/* One more for the wakeup pipe. */
 	new_pollfds = g_try_realloc(session->pollfds,
-			sizeof(GPollFD) * (session->num_sources + 1));
+			sizeof(GPollFD) * (session->num_sources + 2));
 	if (!new_pollfds) {
 		sr_err("%s: new_pollfds malloc failed", __func__);
 		return SR_ERR_MALLOC;
 	}
+	session->pollfds = new_pollfds;
 
 	new_sources = g_try_realloc(session->sources, sizeof(struct source) *
 			(session->num_sources + 1));
@@ -622,17 +981,18 @@ static int _sr_session_source_add(GPollFD *pollfd, int timeout,
 	}
 
 	new_pollfds[session->num_sources] = *pollfd;
+	new_pollfds[session->num_sources].revents = 0;
 	s = &new_sources[session->num_sources++];
 	s->timeout = timeout;
 	s->cb = cb;
 	s->cb_data = sdi;
+	s->due = timeout > 0 ?
+		g_get_monotonic_time() + (gint64)timeout * 1000 : -1;
+	s->defer = 0;
+	s->pending = FALSE;
 	s->poll_object = poll_object;
-	session->pollfds = new_pollfds;
 	session->sources = new_sources;
-
-	if (timeout != session->source_timeout && timeout > 0
-	    && (session->source_timeout == -1 || timeout < session->source_timeout))
-		session->source_timeout = timeout;
+	session_set_wakeup_pollfd();
 
 	return SR_OK;
 }
@@ -739,7 +1099,6 @@ static int _sr_session_source_remove(gintptr poll_object)
     session->num_sources -= 1;
 
     if (session->num_sources == 0) {
-        session->source_timeout = -1;
         g_free(session->pollfds);
         g_free(session->sources);
         session->pollfds = NULL;
@@ -752,7 +1111,8 @@ static int _sr_session_source_remove(gintptr poll_object)
                 (session->num_sources - old) * sizeof(struct source));
         }
 
-        new_pollfds = g_try_realloc(session->pollfds, sizeof(GPollFD) * session->num_sources);
+        new_pollfds = g_try_realloc(session->pollfds,
+            sizeof(GPollFD) * (session->num_sources + 1));
         if (!new_pollfds && session->num_sources > 0) {
             sr_err("%s: new_pollfds malloc failed", __func__);
             return SR_ERR_MALLOC;
@@ -766,6 +1126,7 @@ static int _sr_session_source_remove(gintptr poll_object)
 
         session->pollfds = new_pollfds;
         session->sources = new_sources;
+        session_set_wakeup_pollfd();
     }
 
 	return SR_OK;
@@ -813,4 +1174,36 @@ SR_API int sr_session_source_remove_channel(GIOChannel *channel)
 	return _sr_session_source_remove((gintptr)channel);
 }
 
+/**
+ * Hold back the next call of a source without a descriptor until a
+ * deadline, the session blocks in the meantime instead of spinning.
+ * Only its next call, it is always ready again afterwards. A stop still
+ * wakes the session up and aborts the source straight away.
+ *
+ * @param fd The descriptor the source was added for, -1.
+ * @param until The monotonic time of the next call.
+ *
+ * @return SR_OK upon success, SR_ERR_BUG if there is no session,
+ *         SR_ERR_ARG if the source was not found.
+ */
+SR_PRIV int sr_session_source_defer(int fd, gint64 until)
+{
+	unsigned int i;
+
+	if (!session) {
+		sr_err("%s: session was NULL", __func__);
+		return SR_ERR_BUG;
+	}
+
+	for (i = 0; i < session->num_sources; i++) {
+		if (session->sources[i].poll_object == (gintptr)fd &&
+		    session->pollfds[i].fd == -1) {
+			session->sources[i].defer = until;
+			return SR_OK;
+		}
+	}
+
+	return SR_ERR_ARG;
+}
+
 /** @} */
@@ -87,6 +87,11 @@ struct session_vdev {
     uint8_t unit_bits;
     uint8_t max_height;
     struct sr_status mstatus;
+    struct sr_traceset *traceset;
+    /* Only trace sets have a trace to select. */
+    gboolean is_traceset;
+    uint64_t trace;
+    gboolean trace_mean;
 };
 
 static GSList *dev_insts = NULL;
@@ -95,6 +100,12 @@ static const int hwoptions[] = {
     SR_CONF_MAX_HEIGHT,
 };
 
+static const int tracesetoptions[] = {
+    SR_CONF_MAX_HEIGHT,
+    SR_CONF_TRACE_INDEX,
+    SR_CONF_TRACE_MEAN,
+};
+
 static const int32_t probeOptions[] = {
     SR_CONF_PROBE_MAP_UNIT,
     SR_CONF_PROBE_MAP_MIN,
@@ -176,6 +187,27 @@ static int receive_data(int fd, int revents, const struct sr_dev_inst *cb_sdi)
 
         assert(vdev->unit_bits > 0);
         assert(vdev->cur_channel >= 0);
+        if (vdev->traceset) {
+            ret = sr_traceset_read(vdev->traceset, vdev->buf,
+                                   vdev->bytes_read, CHUNKSIZE);
+            if (ret > 0) {
+                packet.type = SR_DF_DSO;
+                packet.payload = &dso;
+                dso.num_samples = ret;
+                dso.data = vdev->buf;
+                dso.probes = sdi->channels;
+                dso.mq = SR_MQ_VOLTAGE;
+                dso.unit = SR_UNIT_VOLT;
+                dso.mqflags = SR_MQFLAG_AC;
+                dso.samplerate_tog = FALSE;
+                dso.trig_flag = FALSE;
+                vdev->bytes_read += ret;
+                sr_session_send(cb_sdi, &packet);
+            } else {
+                vdev->cur_channel = vdev->num_probes;
+            }
+            continue;
+        }
         if (vdev->cur_channel < vdev->num_probes) {
             if (vdev->version == 1) {
                 ret = zip_fread(vdev->capfile, vdev->buf, CHUNKSIZE);
@@ -339,6 +371,7 @@ static int dev_close(struct sr_dev_inst *sdi)
     g_free(vdev->buf);
     if (vdev->logic_buf)
         g_free(vdev->logic_buf);
+    sr_traceset_close(vdev->traceset);
 
     g_free(sdi->priv);
     sdi->priv = NULL;
@@ -376,6 +409,22 @@ static int config_get(int id, GVariant **data, const struct sr_dev_inst *sdi,
         } else
             return SR_ERR;
         break;
+    case SR_CONF_TRACE_INDEX:
+        if (!sdi)
+            return SR_ERR;
+        vdev = sdi->priv;
+        if (!vdev->is_traceset)
+            return SR_ERR;
+        *data = g_variant_new_uint64(vdev->trace);
+        break;
+    case SR_CONF_TRACE_MEAN:
+        if (!sdi)
+            return SR_ERR;
+        vdev = sdi->priv;
+        if (!vdev->is_traceset)
+            return SR_ERR;
+        *data = g_variant_new_boolean(vdev->trace_mean);
+        break;
     case SR_CONF_TIMEBASE:
         if (sdi) {
             vdev = sdi->priv;
@@ -550,6 +599,16 @@ static int config_set(int id, GVariant *data, struct sr_dev_inst *sdi,
         vdev->num_blocks = g_variant_get_uint64(data);
         sr_info("Setting block number to %" PRIu64 ".", vdev->num_blocks);
         break;
+    case SR_CONF_TRACE_INDEX:
+        vdev->is_traceset = TRUE;
+        vdev->trace = g_variant_get_uint64(data);
+        sr_info("Setting trace to %" PRIu64 ".", vdev->trace);
+        break;
+    case SR_CONF_TRACE_MEAN:
+        vdev->is_traceset = TRUE;
+        vdev->trace_mean = g_variant_get_boolean(data);
+        sr_info("Setting mean trace to %d.", vdev->trace_mean);
+        break;
     case SR_CONF_CAPTURE_NUM_PROBES:
 		vdev->num_probes = g_variant_get_uint64(data);
         if (sdi->mode == LOGIC) {
@@ -636,15 +695,28 @@ static int config_list(int key, GVariant **data,
 
     GVariant *gvar;
     GVariantBuilder gvb;
+    const struct session_vdev *vdev;
+    uint64_t num_traces;
 
-	(void)sdi;
+    vdev = sdi ? sdi->priv : NULL;
 
 	switch (key) {
     case SR_CONF_DEVICE_OPTIONS:
 //		*data = g_variant_new_fixed_array(G_VARIANT_TYPE_INT32,
 //				hwcaps, ARRAY_SIZE(hwcaps), sizeof(int32_t));
-        *data = g_variant_new_from_data(G_VARIANT_TYPE("ai"),
-                hwoptions, ARRAY_SIZE(hwoptions)*sizeof(int32_t), TRUE, NULL, NULL);
+        if (vdev && vdev->is_traceset)
+            *data = g_variant_new_from_data(G_VARIANT_TYPE("ai"),
+                    tracesetoptions, ARRAY_SIZE(tracesetoptions)*sizeof(int32_t), TRUE, NULL, NULL);
+        else
+            *data = g_variant_new_from_data(G_VARIANT_TYPE("ai"),
+                    hwoptions, ARRAY_SIZE(hwoptions)*sizeof(int32_t), TRUE, NULL, NULL);
+        break;
+    case SR_CONF_TRACE_INDEX:
+        /* The range of the trace index, "(tt)". */
+        if (!vdev || !vdev->is_traceset ||
+            !(num_traces = sr_traceset_count(vdev->sessionfile)))
+            return SR_ERR_ARG;
+        *data = g_variant_new("(tt)", (uint64_t)0, num_traces - 1);
         break;
     case SR_CONF_SAMPLERATE:
         g_variant_builder_init(&gvb, G_VARIANT_TYPE("a{sv}"));
@@ -720,6 +792,25 @@ static int dev_acquisition_start(struct sr_dev_inst *sdi,
     vdev->enabled_probes = 0;
     packet.status = SR_PKT_OK;
 
+    if (vdev->is_traceset) {
+        sr_info("Opening trace set %s", vdev->sessionfile);
+        sr_traceset_close(vdev->traceset);
+        if (!(vdev->traceset = sr_traceset_open(vdev->sessionfile,
+                vdev->trace_mean ? SR_TRACESET_MEAN : (int64_t)vdev->trace)))
+            return SR_ERR;
+        vdev->bytes_read = 0;
+        vdev->cur_channel = 0;
+        vdev->enabled_probes = vdev->num_probes;
+        for (l = sdi->channels; l; l = l->next) {
+            probe = l->data;
+            sr_traceset_range(vdev->traceset, &probe->map_min, &probe->map_max);
+        }
+
+        std_session_send_df_header(sdi, LOG_PREFIX);
+        sr_session_source_add(-1, 0, 0, receive_data, sdi);
+        return SR_OK;
+    }
+
 	sr_info("Opening archive %s file %s", vdev->sessionfile,
 		vdev->capturefile);
 
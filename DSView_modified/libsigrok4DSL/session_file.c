@@ -138,6 +138,10 @@ SR_API int sr_session_load(const char *filename)
 		return SR_ERR_ARG;
 	}
 
+	/* Raw trace sets are opened as a DSO session as well. */
+	if (sr_traceset_check(filename) == SR_OK)
+		return sr_traceset_load(filename);
+
 	if (!(archive = zip_open(filename, 0, &ret))) {
 		sr_dbg("Failed to open session file: zip error %d", ret);
 		return SR_ERR;
@@ -0,0 +1,1278 @@
+/*
+ * This file is part of the DSView project.
+ * DSView is based on PulseView.
+ *
+ * Copyright (C) 2016 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "libsigrok.h"
+#include "libsigrok-internal.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Message logging helpers with subsystem-specific prefix string. */
+#define LOG_PREFIX "virtual-sync: "
+#define sr_log(l, s, args...) sr_log(l, LOG_PREFIX s, ## args)
+#define sr_spew(s, args...) sr_spew(LOG_PREFIX s, ## args)
+#define sr_dbg(s, args...) sr_dbg(LOG_PREFIX s, ## args)
+#define sr_info(s, args...) sr_info(LOG_PREFIX s, ## args)
+#define sr_warn(s, args...) sr_warn(LOG_PREFIX s, ## args)
+#define sr_err(s, args...) sr_err(LOG_PREFIX s, ## args)
+
+/*
+ * A group of devices acquiring together, seen as one device with the
+ * channels of all of them: the channels of the first member, then those
+ * of the second one, and so on, named after the member, "A0", "B0".
+ *
+ * Each member acquires with its own driver, and sends its packets from
+ * its own thread or source as usual. The session hands them to the
+ * group instead of the datafeed callbacks, see sr_session_feed_hook_add(),
+ * and the group merges them into packets on one time base:
+ *
+ *  LOGIC  the samples of all members side by side, block by block of
+ *         64 samples. A member which triggered later than the others is
+ *         moved back by the difference of the trigger positions, so the
+ *         samples of the trigger line up. Unless all of them triggered,
+ *         the members are lined up on the time they started instead,
+ *         the one which started first drops the samples it took before
+ *         the last one started.
+ *  DSO    a frame of all members, once each of them sent a new one,
+ *         the samples of the members side by side.
+ *
+ * A group may mix logic analyzers and oscilloscopes, a DSLogic on a bus
+ * along with a DSCope on the power lines. Such a group is a LOGIC device
+ * with the channels of the oscilloscopes first, then the logic ones, so
+ * the DSO data keeps the channel indexes it has on its own. The logic
+ * members are merged as above, and the first frame of the oscilloscopes
+ * goes out as a DSO packet of the group, lined up with the logic samples
+ * by the shared trigger position. Once the logic members ended and the
+ * frame is out, the group stops the session, the oscilloscopes would go
+ * on with frames otherwise.
+ *
+ * The trigger is shared the way the hardware is wired, every member
+ * arms with the same trigger settings, the lead last, so it is the one
+ * the others wait for. The lead is the first member in the mode of the
+ * group. Settings of the group are those of the lead and are set on all
+ * members. An acquisition only starts if all members have the same
+ * samplerate and sample limit.
+ *
+ * The drivers to group are given by SR_SYNC_DEVICES in the environment,
+ * a comma separated list of driver names, "virtual-demo,virtual-demo"
+ * for two demo devices (with DEMO_DEVICES=2). The devices are taken in
+ * the order their drivers list them.
+ */
+
+/* The samples of a block of LA_CROSS_DATA. */
+#define SYNC_BLOCK_SAMPLES 64
+
+struct sync_member {
+    struct sr_dev_inst *sdi;
+
+    /*
+     * Per acquisition: the type of its channels after its mode, whether
+     * it is the first member of that type, the enabled channels, words
+     * per block for LOGIC or bytes per sample for DSO, and the data not
+     * merged yet.
+     */
+    int type;
+    gboolean primary;
+    unsigned int en_ch;
+    GByteArray *queue;
+    gboolean started;
+    gboolean ended;
+    gboolean triggered;
+    uint64_t trig_pos;
+    /* When its header came, us. */
+    int64_t start_time;
+    /* LOGIC: samples still to drop to line up with the others. */
+    uint64_t skip;
+    /* DSO: a frame since the last merged one. */
+    gboolean fresh;
+};
+
+struct sync_group {
+    int num_members;
+    struct sync_member *members;
+    /* The member whose settings the group shows, see the top. */
+    int lead;
+    /* Members in LOGIC and in DSO mode. */
+    gboolean mixed;
+
+    /* For each channel of the group, its member and member channel. */
+    int num_channels;
+    int *map_member;
+    struct sr_channel **map_ch;
+
+    /* Taken by the member threads sending packets. */
+    GMutex mutex;
+    gboolean acquiring;
+    gboolean instant;
+    uint64_t samplerate;
+    gboolean header_sent;
+    gboolean aligned;
+    gboolean warned;
+    /* A mixed group: the frame is out, the session is being stopped. */
+    gboolean dso_done;
+    gboolean stopping;
+    int num_ended;
+    uint16_t end_status;
+    gboolean have_trigger;
+    struct ds_trigger_pos trigger;
+    struct sr_datafeed_dso dso;
+    void *buf;
+    uint64_t buf_size;
+};
+
+SR_PRIV struct sr_dev_driver sync_driver;
+static struct sr_dev_driver *di = &sync_driver;
+
+static GSList *dev_insts = NULL;
+
+static unsigned int en_ch_num(const struct sr_dev_inst *sdi, int type)
+{
+    const struct sr_channel *probe;
+    const GSList *l;
+    unsigned int num = 0;
+
+    for (l = sdi->channels; l; l = l->next) {
+        probe = l->data;
+        if (probe->enabled && probe->type == type)
+            num++;
+    }
+
+    return num;
+}
+
+/* The settings the driver keeps in a channel of a member. */
+static void sync_channel_pull(struct sr_channel *ch,
+                              const struct sr_channel *mch)
+{
+    ch->type = mch->type;
+    ch->enabled = mch->enabled;
+    ch->vdiv = mch->vdiv;
+    ch->vfactor = mch->vfactor;
+    ch->vpos = mch->vpos;
+    ch->vpos_trans = mch->vpos_trans;
+    ch->coupling = mch->coupling;
+    ch->trig_value = mch->trig_value;
+    ch->comb_diff_top = mch->comb_diff_top;
+    ch->comb_diff_bom = mch->comb_diff_bom;
+    ch->map_unit = mch->map_unit;
+    ch->map_min = mch->map_min;
+    ch->map_max = mch->map_max;
+    ch->vga_ptr = mch->vga_ptr;
+}
+
+static void sync_channels_free(struct sr_dev_inst *sdi)
+{
+    struct sync_group *grp = sdi->priv;
+    struct sr_channel *ch;
+    GSList *l;
+
+    for (l = sdi->channels; l; l = l->next) {
+        ch = l->data;
+        g_free(ch->name);
+        g_free(ch->trigger);
+        g_free(ch);
+    }
+    g_slist_free(sdi->channels);
+    sdi->channels = NULL;
+
+    g_free(grp->map_member);
+    g_free(grp->map_ch);
+    grp->map_member = NULL;
+    grp->map_ch = NULL;
+    grp->num_channels = 0;
+}
+
+/* The mode of the group and its lead, after the modes of the members. */
+static void sync_mode_update(struct sr_dev_inst *sdi)
+{
+    struct sync_group *grp = sdi->priv;
+    int i;
+
+    grp->mixed = FALSE;
+    for (i = 1; i < grp->num_members; i++) {
+        if (grp->members[i].sdi->mode != grp->members[0].sdi->mode)
+            grp->mixed = TRUE;
+    }
+    sdi->mode = grp->mixed ? LOGIC : grp->members[0].sdi->mode;
+
+    grp->lead = 0;
+    for (i = 0; i < grp->num_members; i++) {
+        if (grp->members[i].sdi->mode == sdi->mode) {
+            grp->lead = i;
+            break;
+        }
+    }
+}
+
+/* The DSO channels go first, in pass 0, the others in pass 1. */
+static gboolean sync_channel_in_pass(const struct sr_channel *mch, int pass)
+{
+    return (mch->type == SR_CHANNEL_DSO) == (pass == 0);
+}
+
+/* Make the channels of the group after those of the members. */
+static int sync_channels_build(struct sr_dev_inst *sdi)
+{
+    struct sync_group *grp = sdi->priv;
+    struct sr_channel *ch, *mch;
+    char *name;
+    GSList *l;
+    int i, n, pass;
+
+    sync_channels_free(sdi);
+
+    n = 0;
+    for (i = 0; i < grp->num_members; i++)
+        n += g_slist_length(grp->members[i].sdi->channels);
+    grp->map_member = g_malloc(n * sizeof(int));
+    grp->map_ch = g_malloc(n * sizeof(struct sr_channel *));
+
+    n = 0;
+    for (pass = 0; pass < 2; pass++) {
+        for (i = 0; i < grp->num_members; i++) {
+            for (l = grp->members[i].sdi->channels; l; l = l->next) {
+                mch = l->data;
+                if (!sync_channel_in_pass(mch, pass))
+                    continue;
+                name = g_strdup_printf("%c%s", 'A' + i,
+                                       mch->name ? mch->name : "");
+                ch = sr_channel_new(n, mch->type, mch->enabled, name);
+                g_free(name);
+                if (!ch)
+                    return SR_ERR_MALLOC;
+                sync_channel_pull(ch, mch);
+                ch->ms_show = mch->ms_show;
+                memcpy(ch->ms_en, mch->ms_en, sizeof(ch->ms_en));
+                sdi->channels = g_slist_append(sdi->channels, ch);
+                grp->map_member[n] = i;
+                grp->map_ch[n] = mch;
+                n++;
+            }
+        }
+    }
+    grp->num_channels = n;
+
+    return SR_OK;
+}
+
+/* Build the channels again if those of a member changed, with its mode. */
+static int sync_channels_update(struct sr_dev_inst *sdi)
+{
+    struct sync_group *grp = sdi->priv;
+    GSList *l;
+    int i, n, pass;
+
+    sync_mode_update(sdi);
+
+    n = 0;
+    for (pass = 0; pass < 2; pass++) {
+        for (i = 0; i < grp->num_members; i++) {
+            for (l = grp->members[i].sdi->channels; l; l = l->next) {
+                if (!sync_channel_in_pass(l->data, pass))
+                    continue;
+                if (n >= grp->num_channels || grp->map_member[n] != i ||
+                    grp->map_ch[n] != l->data)
+                    return sync_channels_build(sdi);
+                n++;
+            }
+        }
+    }
+    if (n != grp->num_channels)
+        return sync_channels_build(sdi);
+
+    n = 0;
+    for (l = sdi->channels; l; l = l->next)
+        sync_channel_pull(l->data, grp->map_ch[n++]);
+
+    return SR_OK;
+}
+
+/* The channels are enabled on the group, the members have to follow. */
+static void sync_channels_push(const struct sr_dev_inst *sdi)
+{
+    struct sync_group *grp = sdi->priv;
+    struct sr_channel *ch;
+    GSList *l;
+
+    for (l = sdi->channels; l; l = l->next) {
+        ch = l->data;
+        if (ch->index < grp->num_channels)
+            grp->map_ch[ch->index]->enabled = ch->enabled;
+    }
+}
+
+static struct sr_channel *sync_channel_map(const struct sr_dev_inst *sdi,
+        const struct sr_channel *ch, struct sync_member **m)
+{
+    struct sync_group *grp = sdi->priv;
+
+    if (ch->index >= grp->num_channels)
+        return NULL;
+    *m = &grp->members[grp->map_member[ch->index]];
+
+    return grp->map_ch[ch->index];
+}
+
+static void sync_group_free(struct sr_dev_inst *sdi)
+{
+    struct sync_group *grp = sdi->priv;
+
+    if (grp) {
+        sync_channels_free(sdi);
+        g_free(grp->members);
+        g_free(grp->buf);
+        g_mutex_clear(&grp->mutex);
+    }
+    g_free(sdi->vendor);
+    g_free(sdi->model);
+    g_free(sdi->version);
+    g_free(sdi->priv);
+    g_free(sdi);
+}
+
+/**
+ * Group devices to acquire together, as one device with the channels
+ * of all of them.
+ *
+ * @param devs The device instances, the first one the one whose
+ *             settings the group shows. At least two.
+ * @param sdi The device instance of the group on return.
+ *
+ * @return SR_OK upon success, SR_ERR_ARG upon invalid arguments.
+ */
+SR_API int sr_sync_group_new(GSList *devs, struct sr_dev_inst **sdi)
+{
+    struct sr_dev_inst *gsdi, *msdi;
+    struct sync_group *grp;
+    GString *model;
+    GSList *l;
+    int i;
+
+    if (!sdi || g_slist_length(devs) < 2) {
+        sr_err("%s: at least two devices are needed", __func__);
+        return SR_ERR_ARG;
+    }
+
+    for (l = devs; l; l = l->next) {
+        msdi = l->data;
+        if (!msdi || !msdi->driver || msdi->driver == di ||
+            !msdi->driver->dev_acquisition_start) {
+            sr_err("%s: not a device to group", __func__);
+            return SR_ERR_ARG;
+        }
+    }
+
+    grp = g_malloc0(sizeof(struct sync_group));
+    g_mutex_init(&grp->mutex);
+    grp->num_members = g_slist_length(devs);
+    grp->members = g_malloc0(grp->num_members * sizeof(struct sync_member));
+
+    model = g_string_new("Sync");
+    for (l = devs, i = 0; l; l = l->next, i++) {
+        msdi = l->data;
+        grp->members[i].sdi = msdi;
+        g_string_append_printf(model, "%s%s", i ? " + " : " ",
+                               msdi->model ? msdi->model : msdi->driver->name);
+    }
+
+    msdi = grp->members[0].sdi;
+    gsdi = sr_dev_inst_new(msdi->mode, g_slist_length(dev_insts),
+                           SR_ST_INITIALIZING, msdi->vendor, model->str, NULL);
+    g_string_free(model, TRUE);
+    if (!gsdi) {
+        g_free(grp->members);
+        g_mutex_clear(&grp->mutex);
+        g_free(grp);
+        return SR_ERR_MALLOC;
+    }
+    gsdi->driver = di;
+    gsdi->priv = grp;
+    sync_mode_update(gsdi);
+
+    if (sync_channels_build(gsdi) != SR_OK) {
+        sync_group_free(gsdi);
+        return SR_ERR_MALLOC;
+    }
+
+    dev_insts = g_slist_append(dev_insts, gsdi);
+    *sdi = gsdi;
+
+    return SR_OK;
+}
+
+/**
+ * Tell if a device is a group with a member of the driver, which can
+ * no longer be used once the driver scanned again.
+ *
+ * @param sdi The device instance.
+ * @param driver The driver.
+ *
+ * @return TRUE if sdi is a group using the driver.
+ */
+SR_API gboolean sr_sync_group_uses(const struct sr_dev_inst *sdi,
+        const struct sr_dev_driver *driver)
+{
+    struct sync_group *grp;
+    int i;
+
+    if (!sdi || sdi->driver != di || !(grp = sdi->priv))
+        return FALSE;
+
+    for (i = 0; i < grp->num_members; i++) {
+        if (grp->members[i].sdi->driver == driver)
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+/* Send a packet of the group itself, with the buffer of the group. */
+static void sync_send(const struct sr_dev_inst *sdi,
+                      struct sr_datafeed_packet *packet, gboolean buffer)
+{
+    struct sync_group *grp = sdi->priv;
+
+    if (buffer)
+        sr_session_send_buffer(sdi, packet, &grp->buf, &grp->buf_size);
+    else
+        sr_session_send(sdi, packet);
+}
+
+static gboolean sync_buf_reserve(struct sync_group *grp, uint64_t size)
+{
+    void *buf;
+
+    if (grp->buf && grp->buf_size >= size)
+        return TRUE;
+
+    if (!(buf = g_try_realloc(grp->buf, size))) {
+        sr_err("%s: merge buffer malloc failed", __func__);
+        return FALSE;
+    }
+    grp->buf = buf;
+    grp->buf_size = size;
+
+    return TRUE;
+}
+
+/*
+ * Line up the members once all of them started. If all of them
+ * triggered, the earliest trigger is that of the group, and the members
+ * which triggered later drop the samples before theirs lines up with it.
+ * Otherwise the members which started before the last one drop the
+ * samples of the time in between.
+ */
+static void sync_logic_align(const struct sr_dev_inst *sdi)
+{
+    struct sync_group *grp = sdi->priv;
+    struct sync_member *m;
+    struct sr_datafeed_packet packet;
+    uint64_t trig_pos;
+    int64_t start_time;
+    gboolean all_triggered;
+    int i;
+
+    trig_pos = UINT64_MAX;
+    start_time = INT64_MIN;
+    all_triggered = TRUE;
+    for (i = 0; i < grp->num_members; i++) {
+        m = &grp->members[i];
+        if (m->type != SR_CHANNEL_LOGIC)
+            continue;
+        if (m->triggered)
+            trig_pos = MIN(trig_pos, m->trig_pos);
+        else
+            all_triggered = FALSE;
+        if (m->start_time)
+            start_time = MAX(start_time, m->start_time);
+    }
+
+    for (i = 0; i < grp->num_members; i++) {
+        m = &grp->members[i];
+        if (m->type != SR_CHANNEL_LOGIC)
+            continue;
+        if (all_triggered) {
+            m->skip = m->trig_pos - trig_pos;
+            if (m->skip)
+                sr_info("Member %c triggered %" PRIu64 " samples later.",
+                        'A' + i, m->skip);
+        } else if (m->start_time) {
+            m->skip = (start_time - m->start_time) / 1000000.0 *
+                      grp->samplerate + 0.5;
+            if (m->skip)
+                sr_info("Member %c started %" PRIu64 " samples earlier.",
+                        'A' + i, m->skip);
+        }
+    }
+
+    if (grp->have_trigger) {
+        if (trig_pos != UINT64_MAX)
+            grp->trigger.real_pos = trig_pos;
+        packet.type = SR_DF_TRIGGER;
+        packet.status = SR_PKT_OK;
+        packet.payload = &grp->trigger;
+        sync_send(sdi, &packet, FALSE);
+    }
+
+    grp->aligned = TRUE;
+}
+
+/*
+ * Merge the blocks all logic members have, the words of the channels
+ * of a member shifted by the samples it still has to drop.
+ */
+static void sync_logic_merge(const struct sr_dev_inst *sdi)
+{
+    struct sync_group *grp = sdi->priv;
+    struct sync_member *m;
+    struct sr_datafeed_packet packet;
+    struct sr_datafeed_logic logic;
+    const uint64_t *words;
+    uint64_t *out;
+    uint64_t n, avail, block, w;
+    unsigned int i, j, s, en_total;
+    gboolean starved;
+
+    for (i = 0; i < (unsigned int)grp->num_members; i++) {
+        m = &grp->members[i];
+        if (m->type == SR_CHANNEL_LOGIC && !m->started && !m->ended)
+            return;
+    }
+    if (!grp->aligned)
+        sync_logic_align(sdi);
+
+    n = UINT64_MAX;
+    en_total = 0;
+    starved = FALSE;
+    for (i = 0; i < (unsigned int)grp->num_members; i++) {
+        m = &grp->members[i];
+        if (m->type != SR_CHANNEL_LOGIC || m->en_ch == 0)
+            continue;
+        block = m->en_ch * sizeof(uint64_t);
+        while (m->skip >= SYNC_BLOCK_SAMPLES && m->queue->len >= block) {
+            g_byte_array_remove_range(m->queue, 0, block);
+            m->skip -= SYNC_BLOCK_SAMPLES;
+        }
+        avail = m->queue->len / block;
+        /* the bits shifted in come from the next block */
+        if (m->skip >= SYNC_BLOCK_SAMPLES)
+            avail = 0;
+        else if (m->skip && avail)
+            avail--;
+        n = MIN(n, avail);
+        en_total += m->en_ch;
+        starved |= (m->ended && avail == 0);
+    }
+
+    /* the samples of the others have nothing to go with any more */
+    if (starved) {
+        for (i = 0; i < (unsigned int)grp->num_members; i++) {
+            m = &grp->members[i];
+            if (m->type == SR_CHANNEL_LOGIC)
+                g_byte_array_set_size(m->queue, 0);
+        }
+        return;
+    }
+    if (n == 0 || n == UINT64_MAX)
+        return;
+
+    if (!sync_buf_reserve(grp, n * en_total * sizeof(uint64_t)))
+        return;
+
+    for (i = 0; i < (unsigned int)grp->num_members; i++) {
+        m = &grp->members[i];
+        if (m->type != SR_CHANNEL_LOGIC || m->en_ch == 0)
+            continue;
+        words = (const uint64_t *)m->queue->data;
+        out = (uint64_t *)grp->buf;
+        for (j = 0; j < i; j++) {
+            if (grp->members[j].type == SR_CHANNEL_LOGIC)
+                out += grp->members[j].en_ch;
+        }
+        s = m->skip;
+        for (block = 0; block < n; block++) {
+            for (j = 0; j < m->en_ch; j++) {
+                w = words[j];
+                if (s)
+                    w = (w >> s) | (words[m->en_ch + j] << (64 - s));
+                out[j] = w;
+            }
+            words += m->en_ch;
+            out += en_total;
+        }
+        g_byte_array_remove_range(m->queue, 0,
+                                  n * m->en_ch * sizeof(uint64_t));
+    }
+
+    memset(&logic, 0, sizeof(logic));
+    logic.format = LA_CROSS_DATA;
+    logic.length = n * en_total * sizeof(uint64_t);
+    logic.data = grp->buf;
+    packet.type = SR_DF_LOGIC;
+    packet.status = SR_PKT_OK;
+    packet.payload = &logic;
+    sync_send(sdi, &packet, TRUE);
+}
+
+/*
+ * Merge the frames of the DSO members once each of them sent a new one,
+ * or in instant mode the samples all of them have. Whether a frame went
+ * out.
+ */
+static gboolean sync_dso_merge(const struct sr_dev_inst *sdi)
+{
+    struct sync_group *grp = sdi->priv;
+    struct sync_member *m;
+    struct sr_datafeed_packet packet;
+    struct sr_datafeed_dso dso;
+    uint8_t *out;
+    const uint8_t *in;
+    uint64_t n, k;
+    unsigned int i, en_total;
+    gboolean mismatch;
+
+    n = UINT64_MAX;
+    en_total = 0;
+    mismatch = FALSE;
+    for (i = 0; i < (unsigned int)grp->num_members; i++) {
+        m = &grp->members[i];
+        if (m->type != SR_CHANNEL_DSO || m->en_ch == 0)
+            continue;
+        if (!m->fresh)
+            return FALSE;
+        if (n != UINT64_MAX && n != m->queue->len / m->en_ch)
+            mismatch = TRUE;
+        n = MIN(n, m->queue->len / m->en_ch);
+        en_total += m->en_ch;
+    }
+    if (n == UINT64_MAX)
+        return FALSE;
+    if (mismatch && !grp->warned) {
+        sr_warn("The members sent frames of different lengths, "
+                "merging the first %" PRIu64 " samples.", n);
+        grp->warned = TRUE;
+    }
+
+    if (!sync_buf_reserve(grp, MAX(n * en_total, 1)))
+        return FALSE;
+
+    out = grp->buf;
+    for (k = 0; k < n; k++) {
+        for (i = 0; i < (unsigned int)grp->num_members; i++) {
+            m = &grp->members[i];
+            if (m->type != SR_CHANNEL_DSO || m->en_ch == 0)
+                continue;
+            in = m->queue->data + k * m->en_ch;
+            memcpy(out, in, m->en_ch);
+            out += m->en_ch;
+        }
+    }
+
+    for (i = 0; i < (unsigned int)grp->num_members; i++) {
+        m = &grp->members[i];
+        if (m->type != SR_CHANNEL_DSO || m->en_ch == 0)
+            continue;
+        if (grp->instant) {
+            g_byte_array_remove_range(m->queue, 0, n * m->en_ch);
+            m->fresh = m->queue->len >= m->en_ch;
+        } else {
+            g_byte_array_set_size(m->queue, 0);
+            m->fresh = FALSE;
+        }
+    }
+
+    dso = grp->dso;
+    dso.probes = sdi->channels;
+    dso.num_samples = n;
+    dso.data = grp->buf;
+    packet.type = SR_DF_DSO;
+    packet.status = SR_PKT_OK;
+    packet.payload = &dso;
+    sync_send(sdi, &packet, TRUE);
+
+    return TRUE;
+}
+
+static struct sync_member *sync_member_find(struct sync_group *grp,
+                                            const struct sr_dev_inst *msdi)
+{
+    int i;
+
+    for (i = 0; i < grp->num_members; i++) {
+        if (grp->members[i].sdi == msdi)
+            return &grp->members[i];
+    }
+
+    return NULL;
+}
+
+static void sync_end(const struct sr_dev_inst *sdi)
+{
+    struct sync_group *grp = sdi->priv;
+    struct sr_datafeed_packet packet;
+    int i;
+
+    for (i = 0; i < grp->num_members; i++) {
+        sr_session_feed_hook_remove(grp->members[i].sdi);
+        g_byte_array_free(grp->members[i].queue, TRUE);
+        grp->members[i].queue = NULL;
+    }
+    grp->acquiring = FALSE;
+
+    packet.type = SR_DF_END;
+    packet.status = grp->end_status;
+    packet.payload = NULL;
+    sync_send(sdi, &packet, FALSE);
+}
+
+/*
+ * A mixed group is done once its logic members ended and the frame is
+ * out, stop the session and with it the oscilloscopes.
+ */
+static void sync_mixed_check(const struct sr_dev_inst *sdi)
+{
+    struct sync_group *grp = sdi->priv;
+    struct sync_member *m;
+    int i;
+
+    if (!grp->mixed || !grp->acquiring || grp->stopping)
+        return;
+
+    for (i = 0; i < grp->num_members; i++) {
+        m = &grp->members[i];
+        if (m->ended)
+            continue;
+        if (m->type == SR_CHANNEL_LOGIC)
+            return;
+        if (m->en_ch != 0 && !grp->dso_done)
+            return;
+    }
+
+    sr_info("The logic members ended and the frame is out, stopping.");
+    grp->stopping = TRUE;
+    sr_session_stop();
+}
+
+/* The packets of the members, from their threads or sources. */
+static void sync_feed(const struct sr_dev_inst *msdi,
+                      const struct sr_datafeed_packet *packet, void *cb_data)
+{
+    const struct sr_dev_inst *sdi = cb_data;
+    struct sync_group *grp = sdi->priv;
+    struct sync_member *m;
+    struct sr_datafeed_packet p;
+    const struct sr_datafeed_logic *logic;
+    const struct ds_trigger_pos *trigger_pos;
+    const struct sr_datafeed_dso *dso;
+
+    g_mutex_lock(&grp->mutex);
+
+    if (!grp->acquiring || !(m = sync_member_find(grp, msdi)) || m->ended) {
+        g_mutex_unlock(&grp->mutex);
+        return;
+    }
+
+    /* Data errors are the group's too, there is nothing to merge. */
+    if (packet->type != SR_DF_END && packet->status != SR_PKT_OK) {
+        p = *packet;
+        sync_send(sdi, &p, FALSE);
+        g_mutex_unlock(&grp->mutex);
+        return;
+    }
+
+    switch (packet->type) {
+    case SR_DF_HEADER:
+        m->start_time = g_get_monotonic_time();
+        if (!grp->header_sent) {
+            p = *packet;
+            sync_send(sdi, &p, FALSE);
+            grp->header_sent = TRUE;
+        }
+        break;
+    case SR_DF_TRIGGER:
+        trigger_pos = packet->payload;
+        /* the frame of a mixed group goes by the logic trigger */
+        if (m->type == SR_CHANNEL_DSO) {
+            if (m->primary && !grp->mixed) {
+                p = *packet;
+                sync_send(sdi, &p, FALSE);
+            }
+            break;
+        }
+        m->started = TRUE;
+        if (trigger_pos->status & 0x01) {
+            m->triggered = TRUE;
+            m->trig_pos = trigger_pos->real_pos;
+        }
+        if (m->primary || !grp->have_trigger) {
+            grp->trigger = *trigger_pos;
+            grp->have_trigger = TRUE;
+        }
+        break;
+    case SR_DF_LOGIC:
+        logic = packet->payload;
+        if (logic->format != LA_CROSS_DATA) {
+            sr_err("%s: only cross data can be merged", __func__);
+            break;
+        }
+        m->started = TRUE;
+        g_byte_array_append(m->queue, logic->data, logic->length);
+        sync_logic_merge(sdi);
+        break;
+    case SR_DF_DSO:
+        dso = packet->payload;
+        if (grp->dso_done)
+            break;
+        if (!grp->instant)
+            g_byte_array_set_size(m->queue, 0);
+        g_byte_array_append(m->queue, dso->data,
+                            (guint)dso->num_samples * m->en_ch);
+        m->fresh = m->queue->len >= m->en_ch;
+        if (m->primary)
+            grp->dso = *dso;
+        if (sync_dso_merge(sdi) && grp->mixed) {
+            grp->dso_done = TRUE;
+            sync_mixed_check(sdi);
+        }
+        break;
+    case SR_DF_OVERFLOW:
+        p = *packet;
+        sync_send(sdi, &p, FALSE);
+        break;
+    case SR_DF_END:
+        m->ended = TRUE;
+        if (packet->status != SR_PKT_OK)
+            grp->end_status = packet->status;
+        if (++grp->num_ended == grp->num_members)
+            sync_end(sdi);
+        else if (sdi->mode == LOGIC)
+            sync_logic_merge(sdi);
+        sync_mixed_check(sdi);
+        break;
+    default:
+        if (m == &grp->members[grp->lead]) {
+            p = *packet;
+            sync_send(sdi, &p, FALSE);
+        }
+        break;
+    }
+
+    g_mutex_unlock(&grp->mutex);
+}
+
+/* driver callbacks */
+
+static int init(struct sr_context *sr_ctx)
+{
+    (void)sr_ctx;
+
+    return SR_OK;
+}
+
+static int dev_clear(void)
+{
+    GSList *l;
+
+    for (l = dev_insts; l; l = l->next)
+        sync_group_free(l->data);
+    g_slist_free(dev_insts);
+    dev_insts = NULL;
+
+    return SR_OK;
+}
+
+/* Group the devices SR_SYNC_DEVICES names, see the top of the file. */
+static GSList *scan(GSList *options)
+{
+    struct sr_dev_driver **drivers, **driver;
+    struct sr_dev_inst *sdi;
+    GSList *devs, *l;
+    gchar **names;
+    const char *s;
+    int i;
+
+    (void)options;
+
+    if (!(s = getenv("SR_SYNC_DEVICES")) || !*s)
+        return NULL;
+
+    devs = NULL;
+    drivers = sr_driver_list();
+    names = g_strsplit(s, ",", 0);
+    for (i = 0; names[i]; i++) {
+        g_strstrip(names[i]);
+        for (driver = drivers; *driver; driver++) {
+            if (*driver != di && !strcmp((*driver)->name, names[i]))
+                break;
+        }
+        if (!*driver) {
+            sr_err("No driver %s to group.", names[i]);
+            break;
+        }
+        /* the first device of the driver not grouped yet */
+        for (l = sr_dev_list(*driver); l; l = l->next) {
+            if (!g_slist_find(devs, l->data))
+                break;
+        }
+        if (!l) {
+            sr_err("No device of %s left to group.", names[i]);
+            break;
+        }
+        devs = g_slist_append(devs, l->data);
+    }
+    if (names[i]) {
+        g_slist_free(devs);
+        devs = NULL;
+    }
+    g_strfreev(names);
+
+    l = NULL;
+    if (devs && sr_sync_group_new(devs, &sdi) == SR_OK)
+        l = g_slist_append(NULL, sdi);
+    g_slist_free(devs);
+
+    return l;
+}
+
+static GSList *dev_list(void)
+{
+    return dev_insts;
+}
+
+static const GSList *dev_mode_list(const struct sr_dev_inst *sdi)
+{
+    struct sync_group *grp = sdi->priv;
+
+    return sr_dev_mode_list(grp->members[grp->lead].sdi);
+}
+
+static int dev_open(struct sr_dev_inst *sdi)
+{
+    struct sync_group *grp = sdi->priv;
+    struct sr_dev_inst *msdi;
+    int i, ret;
+
+    sdi->status = SR_ST_ACTIVE;
+    for (i = 0; i < grp->num_members; i++) {
+        msdi = grp->members[i].sdi;
+        if ((ret = sr_dev_open(msdi)) != SR_OK ||
+            msdi->status != SR_ST_ACTIVE) {
+            sr_err("Member %c (%s) failed to open.", 'A' + i,
+                   msdi->driver->name);
+            sdi->status = SR_ST_INACTIVE;
+        }
+    }
+
+    return sync_channels_update(sdi);
+}
+
+static int dev_close(struct sr_dev_inst *sdi)
+{
+    struct sync_group *grp = sdi->priv;
+    int i;
+
+    for (i = 0; i < grp->num_members; i++)
+        sr_dev_close(grp->members[i].sdi);
+    sdi->status = SR_ST_INACTIVE;
+
+    return SR_OK;
+}
+
+static int config_get(int id, GVariant **data, const struct sr_dev_inst *sdi,
+                      const struct sr_channel *ch,
+                      const struct sr_channel_group *cg)
+{
+    struct sync_group *grp;
+    struct sync_member *m;
+    struct sr_channel *mch;
+    GVariant *gvar;
+    int16_t num;
+    int i;
+
+    if (!sdi || !(grp = sdi->priv))
+        return SR_ERR;
+    sync_channels_push(sdi);
+
+    if (ch) {
+        if (!(mch = sync_channel_map(sdi, ch, &m)))
+            return SR_ERR_ARG;
+        return m->sdi->driver->config_get(id, data, m->sdi, mch, cg);
+    }
+
+    switch (id) {
+    case SR_CONF_VLD_CH_NUM:
+        num = 0;
+        for (i = 0; i < grp->num_members; i++) {
+            m = &grp->members[i];
+            if (m->sdi->driver->config_get(id, &gvar, m->sdi,
+                                           NULL, cg) != SR_OK)
+                return SR_ERR;
+            num += g_variant_get_int16(gvar);
+            g_variant_unref(g_variant_ref_sink(gvar));
+        }
+        *data = g_variant_new_int16(num);
+        return SR_OK;
+    default:
+        m = &grp->members[grp->lead];
+        return m->sdi->driver->config_get(id, data, m->sdi, NULL, cg);
+    }
+}
+
+static int config_set(int id, GVariant *data, struct sr_dev_inst *sdi,
+                      struct sr_channel *ch,
+                      struct sr_channel_group *cg)
+{
+    struct sync_group *grp = sdi->priv;
+    struct sync_member *m;
+    struct sr_channel *mch;
+    int i, ret, r;
+
+    sync_channels_push(sdi);
+
+    if (ch) {
+        if (!(mch = sync_channel_map(sdi, ch, &m)))
+            return SR_ERR_ARG;
+        ret = m->sdi->driver->config_set(id, data, m->sdi, mch, cg);
+        sync_channel_pull(ch, mch);
+        return ret;
+    }
+
+    /* the lead decides, the others follow as far as they can */
+    ret = SR_OK;
+    for (i = 0; i < grp->num_members; i++) {
+        m = &grp->members[i];
+        if (!m->sdi->driver->config_set)
+            continue;
+        r = m->sdi->driver->config_set(id, data, m->sdi, NULL, cg);
+        if (i == grp->lead)
+            ret = r;
+        else if (r != SR_OK && r != SR_ERR_NA && ret == SR_OK)
+            sr_warn("Member %c does not take setting %d.", 'A' + i, id);
+    }
+
+    if (sync_channels_update(sdi) != SR_OK)
+        return SR_ERR_MALLOC;
+
+    return ret;
+}
+
+static int config_list(int key, GVariant **data,
+                       const struct sr_dev_inst *sdi,
+                       const struct sr_channel_group *cg)
+{
+    struct sync_group *grp;
+    struct sr_dev_inst *msdi;
+
+    if (!sdi || !(grp = sdi->priv))
+        return SR_ERR_ARG;
+    sync_channels_push(sdi);
+
+    msdi = grp->members[grp->lead].sdi;
+    return msdi->driver->config_list(key, data, msdi, cg);
+}
+
+static int dev_status_get(const struct sr_dev_inst *sdi,
+                          struct sr_status *status,
+                          gboolean prg, int begin, int end)
+{
+    struct sync_group *grp = sdi->priv;
+
+    return sr_status_get(grp->members[grp->lead].sdi, status, prg, begin, end);
+}
+
+static int dev_acquisition_stop(const struct sr_dev_inst *sdi, void *cb_data)
+{
+    struct sync_group *grp = sdi->priv;
+    struct sr_dev_inst *msdi;
+    int i;
+
+    (void)cb_data;
+
+    for (i = 0; i < grp->num_members; i++) {
+        msdi = grp->members[i].sdi;
+        if (msdi->driver->dev_acquisition_stop)
+            msdi->driver->dev_acquisition_stop(msdi, NULL);
+    }
+
+    return SR_OK;
+}
+
+/* A setting of all members, which has to be the same for all of them. */
+static int sync_setting_get(const struct sr_dev_inst *sdi, int id,
+                            const char *name, uint64_t *value)
+{
+    struct sync_group *grp = sdi->priv;
+    struct sr_dev_inst *msdi;
+    GVariant *gvar;
+    uint64_t v;
+    int i;
+
+    for (i = 0; i < grp->num_members; i++) {
+        msdi = grp->members[i].sdi;
+        if (msdi->driver->config_get(id, &gvar, msdi, NULL, NULL) != SR_OK) {
+            sr_err("Member %c has no %s.", 'A' + i, name);
+            return SR_ERR;
+        }
+        v = g_variant_get_uint64(gvar);
+        g_variant_unref(g_variant_ref_sink(gvar));
+        if (i == 0) {
+            *value = v;
+        } else if (v != *value) {
+            sr_err("Member %c has a %s of %" PRIu64 ", member A of %"
+                   PRIu64 ", they can not be merged.", 'A' + i, name,
+                   v, *value);
+            return SR_ERR;
+        }
+    }
+
+    return SR_OK;
+}
+
+/* The member to start k-th, the lead last, the others wait for it. */
+static int sync_start_order(const struct sync_group *grp, int k)
+{
+    int i;
+
+    if (k == grp->num_members - 1)
+        return grp->lead;
+    i = grp->num_members - 1 - k;
+    if (i <= grp->lead)
+        i--;
+
+    return i;
+}
+
+static int dev_acquisition_start(struct sr_dev_inst *sdi, void *cb_data)
+{
+    struct sync_group *grp = sdi->priv;
+    struct sync_member *m;
+    struct sr_dev_inst *msdi;
+    GVariant *gvar;
+    uint64_t limit_samples;
+    int i, j, k, ret;
+
+    (void)cb_data;
+
+    if (sdi->status != SR_ST_ACTIVE)
+        return SR_ERR_DEV_CLOSED;
+
+    for (i = 0; i < grp->num_members; i++) {
+        msdi = grp->members[i].sdi;
+        if (msdi->mode != LOGIC && msdi->mode != DSO) {
+            sr_err("Only logic and oscilloscope data can be merged.");
+            return SR_ERR;
+        }
+    }
+
+    sync_channels_push(sdi);
+
+    if (sync_setting_get(sdi, SR_CONF_SAMPLERATE, "samplerate",
+                         &grp->samplerate) != SR_OK ||
+        sync_setting_get(sdi, SR_CONF_LIMIT_SAMPLES, "sample limit",
+                         &limit_samples) != SR_OK)
+        return SR_ERR;
+
+    grp->instant = FALSE;
+    if (sdi->mode == DSO &&
+        config_get(SR_CONF_INSTANT, &gvar, sdi, NULL, NULL) == SR_OK) {
+        grp->instant = g_variant_get_boolean(gvar);
+        g_variant_unref(g_variant_ref_sink(gvar));
+    }
+    grp->header_sent = FALSE;
+    grp->aligned = FALSE;
+    grp->warned = FALSE;
+    grp->dso_done = FALSE;
+    grp->stopping = FALSE;
+    grp->num_ended = 0;
+    grp->end_status = SR_PKT_OK;
+    grp->have_trigger = FALSE;
+    memset(&grp->dso, 0, sizeof(grp->dso));
+    for (i = 0; i < grp->num_members; i++) {
+        m = &grp->members[i];
+        m->type = m->sdi->mode == DSO ? SR_CHANNEL_DSO : SR_CHANNEL_LOGIC;
+        m->primary = TRUE;
+        for (j = 0; j < i; j++) {
+            if (grp->members[j].type == m->type)
+                m->primary = FALSE;
+        }
+        m->en_ch = en_ch_num(m->sdi, m->type);
+        m->queue = g_byte_array_new();
+        m->started = FALSE;
+        m->ended = FALSE;
+        m->triggered = FALSE;
+        m->trig_pos = 0;
+        m->start_time = 0;
+        m->skip = 0;
+        m->fresh = FALSE;
+        sr_session_feed_hook_add(m->sdi, sync_feed, sdi);
+    }
+    grp->acquiring = TRUE;
+
+    for (k = 0; k < grp->num_members; k++) {
+        i = sync_start_order(grp, k);
+        msdi = grp->members[i].sdi;
+        if ((ret = msdi->driver->dev_acquisition_start(msdi,
+                                                       msdi)) != SR_OK) {
+            sr_err("Member %c failed to start (%d).", 'A' + i, ret);
+            break;
+        }
+    }
+    if (k < grp->num_members) {
+        while (--k >= 0) {
+            msdi = grp->members[sync_start_order(grp, k)].sdi;
+            if (msdi->driver->dev_acquisition_stop)
+                msdi->driver->dev_acquisition_stop(msdi, NULL);
+        }
+        g_mutex_lock(&grp->mutex);
+        if (grp->acquiring) {
+            for (i = 0; i < grp->num_members; i++) {
+                sr_session_feed_hook_remove(grp->members[i].sdi);
+                g_byte_array_free(grp->members[i].queue, TRUE);
+                grp->members[i].queue = NULL;
+            }
+            grp->acquiring = FALSE;
+        }
+        g_mutex_unlock(&grp->mutex);
+        return ret;
+    }
+
+    return SR_OK;
+}
+
+/** @private */
+SR_PRIV struct sr_dev_driver sync_driver = {
+    .name = "virtual-sync",
+    .longname = "Devices acquiring together",
+    .api_version = 1,
+    .init = init,
+    .cleanup = dev_clear,
+    .scan = scan,
+    .dev_list = dev_list,
+    .dev_mode_list = dev_mode_list,
+    .dev_clear = dev_clear,
+    .config_get = config_get,
+    .config_set = config_set,
+    .config_list = config_list,
+    .dev_open = dev_open,
+    .dev_close = dev_close,
+    .dev_status_get = dev_status_get,
+    .dev_acquisition_start = dev_acquisition_start,
+    .dev_acquisition_stop = dev_acquisition_stop,
+    .priv = NULL,
+};
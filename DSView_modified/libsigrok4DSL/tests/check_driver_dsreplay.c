@@ -0,0 +1,300 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2017 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <glib/gstdio.h>
+#include <check.h>
+#include "../libsigrok.h"
+#include "../hardware/DSL/dsl.h"
+#include "../hardware/DSL/command.h"
+#include "lib.h"
+
+/* A capture of two of the 16 channels, in the buffer mode. */
+#define CH_ENABLE 0x3
+#define LIMIT_SAMPLES (1024 * 1024)
+#define ACTUAL_BYTES (LIMIT_SAMPLES / 64 * 2 * 8)
+#define NUM_DATA 3
+#define DATA_LENGTH 100000
+/* us between the recorded transfers */
+#define DATA_PERIOD 50000
+
+static struct sr_context *sr_ctx;
+
+/* What the replay sent to the session bus. */
+struct feed
+{
+	gboolean trigger;
+	int overflows;
+	gboolean end;
+	GByteArray *logic;
+};
+
+static struct feed feed;
+
+static void datafeed_in(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	const struct sr_datafeed_logic *logic;
+	struct feed *f = cb_data;
+
+	(void)sdi;
+
+	switch (packet->type) {
+	case SR_DF_TRIGGER:
+		f->trigger = (packet->status == SR_PKT_OK);
+		break;
+	case SR_DF_LOGIC:
+		logic = packet->payload;
+		g_byte_array_append(f->logic, logic->data, logic->length);
+		break;
+	case SR_DF_OVERFLOW:
+		f->overflows++;
+		break;
+	case SR_DF_END:
+		f->end = TRUE;
+		break;
+	}
+}
+
+static void setup(void)
+{
+	int ret;
+
+	ret = sr_init(&sr_ctx);
+	fail_unless(ret == SR_OK, "sr_init() failed: %d.", ret);
+	fail_unless(sr_session_new() != NULL);
+
+	memset(&feed, 0, sizeof(feed));
+	feed.logic = g_byte_array_new();
+	sr_session_datafeed_callback_add(datafeed_in, &feed);
+}
+
+static void teardown(void)
+{
+	int ret;
+
+	g_byte_array_free(feed.logic, TRUE);
+	sr_session_destroy();
+
+	ret = sr_exit(sr_ctx);
+	fail_unless(ret == SR_OK, "sr_exit() failed: %d.", ret);
+
+	g_unsetenv("DSL_REPLAY");
+	g_unsetenv("DSL_REPLAY_SPEED");
+}
+
+static uint8_t data_byte(uint64_t index)
+{
+	return (index * 7) ^ (index >> 8);
+}
+
+static void write_record(FILE *file, uint64_t time, uint32_t type,
+		int32_t status, const void *head, uint32_t head_len,
+		const void *data, uint32_t length)
+{
+	struct dsl_record_transfer rec;
+
+	memset(&rec, 0, sizeof(rec));
+	rec.time = time;
+	rec.length = head_len + length;
+	rec.status = status;
+	rec.type = type;
+	fail_unless(fwrite(&rec, sizeof(rec), 1, file) == 1);
+	fail_unless(fwrite(head, 1, head_len, file) == head_len);
+	fail_unless(fwrite(data, 1, length, file) == length);
+}
+
+/*
+ * Record a DSLogic capture the way dsl.c does: the trigger position,
+ * then the data, which runs on past the end of the capture. With
+ * overflow the device reports one after the first data transfer.
+ */
+static char *write_recording(gboolean overflow)
+{
+	struct dsl_record_header header;
+	struct ds_trigger_pos trigger_pos;
+	struct ctl_header ctl;
+	GError *error = NULL;
+	uint8_t data[DATA_LENGTH], hw_info;
+	char *filename;
+	FILE *file;
+	uint64_t time, index;
+	int fd, i, j;
+
+	fd = g_file_open_tmp("check_dsreplay_XXXXXX.dsl", &filename, &error);
+	fail_unless(fd >= 0, "Cannot create temporary file.");
+	close(fd);
+	file = g_fopen(filename, "wb");
+	fail_unless(file != NULL);
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, DSL_RECORD_MAGIC, sizeof(header.magic));
+	header.vid = supported_DSLogic[0].vid;
+	header.pid = supported_DSLogic[0].pid;
+	header.mode = LOGIC;
+	header.ch_mode = DSL_BUFFER100x16;
+	header.ch_enable = CH_ENABLE;
+	header.samplerate = SR_MHZ(100);
+	header.limit_samples = LIMIT_SAMPLES;
+	header.actual_samples = LIMIT_SAMPLES;
+	header.actual_bytes = ACTUAL_BYTES;
+	header.buf_size = DATA_LENGTH;
+	header.num_transfers = 1;
+	header.unit_pitch = 1;
+	fail_unless(fwrite(&header, sizeof(header), 1, file) == 1);
+
+	memset(&trigger_pos, 0, sizeof(trigger_pos));
+	trigger_pos.check_id = TRIG_CHECKID;
+	write_record(file, 0, DSL_RECORD_TRIGGER, LIBUSB_TRANSFER_COMPLETED,
+		     NULL, 0, &trigger_pos, sizeof(trigger_pos));
+
+	index = 0;
+	time = 0;
+	for (i = 0; i < NUM_DATA; i++) {
+		time += DATA_PERIOD;
+		for (j = 0; j < DATA_LENGTH; j++)
+			data[j] = data_byte(index++);
+		write_record(file, time, DSL_RECORD_DATA,
+			     LIBUSB_TRANSFER_COMPLETED, NULL, 0, data, DATA_LENGTH);
+
+		if (overflow && i == 0) {
+			ctl.dest = DSL_CTL_HW_STATUS;
+			ctl.offset = 0;
+			ctl.size = 1;
+			hw_info = bmSYS_OVERFLOW;
+			write_record(file, time, DSL_RECORD_CTL_RD, SR_OK,
+				     &ctl, sizeof(ctl), &hw_info, 1);
+		}
+	}
+
+	fail_unless(fclose(file) == 0);
+
+	return filename;
+}
+
+/* Replay a recording as sigrok-cli would run the device. */
+static void replay(const char *filename, const char *speed)
+{
+	struct sr_dev_driver *driver;
+	struct sr_dev_inst *sdi;
+	GSList *devices;
+	int ret;
+
+	g_setenv("DSL_REPLAY", filename, TRUE);
+	if (speed)
+		g_setenv("DSL_REPLAY_SPEED", speed, TRUE);
+
+	driver = srtest_driver_get("DSReplay");
+	srtest_driver_init(sr_ctx, driver);
+	devices = sr_driver_scan(driver, NULL);
+	fail_unless(g_slist_length(devices) == 1, "The recording was not found.");
+	sdi = devices->data;
+	g_slist_free(devices);
+
+	ret = sr_dev_open(sdi);
+	fail_unless(ret == SR_OK, "sr_dev_open() failed: %d.", ret);
+	ret = sr_session_dev_add(sdi);
+	fail_unless(ret == SR_OK, "sr_session_dev_add() failed: %d.", ret);
+	ret = sr_session_start();
+	fail_unless(ret == SR_OK, "sr_session_start() failed: %d.", ret);
+	ret = sr_session_run();
+	fail_unless(ret == SR_OK, "sr_session_run() failed: %d.", ret);
+	sr_dev_close(sdi);
+
+	fail_unless(feed.trigger, "No SR_DF_TRIGGER sent.");
+	fail_unless(feed.end, "No SR_DF_END sent.");
+}
+
+/* The recorded data is sent as recorded, up to the end of the capture. */
+START_TEST(test_replay_data)
+{
+	char *filename;
+	guint i;
+
+	filename = write_recording(FALSE);
+	replay(filename, NULL);
+	g_unlink(filename);
+	g_free(filename);
+
+	fail_unless(feed.overflows == 0);
+	fail_unless(feed.logic->len == ACTUAL_BYTES,
+		    "Got %u bytes.", feed.logic->len);
+	for (i = 0; i < feed.logic->len; i++)
+		fail_unless(feed.logic->data[i] == data_byte(i),
+			    "Data wrong at %u.", i);
+}
+END_TEST
+
+/* The recorded control reads are answered, an overflow drops the data. */
+START_TEST(test_replay_overflow)
+{
+	char *filename;
+
+	filename = write_recording(TRUE);
+	replay(filename, NULL);
+	g_unlink(filename);
+	g_free(filename);
+
+	fail_unless(feed.logic->len == DATA_LENGTH,
+		    "Got %u bytes.", feed.logic->len);
+	fail_unless(feed.overflows == NUM_DATA - 1,
+		    "Got %d overflows.", feed.overflows);
+}
+END_TEST
+
+/* At the recorded speed the replay takes as long as the recording. */
+START_TEST(test_replay_speed)
+{
+	char *filename;
+	gint64 start, elapsed;
+
+	filename = write_recording(FALSE);
+	start = g_get_monotonic_time();
+	replay(filename, "1");
+	elapsed = g_get_monotonic_time() - start;
+	g_unlink(filename);
+	g_free(filename);
+
+	fail_unless(elapsed >= NUM_DATA * DATA_PERIOD,
+		    "Replayed in %" PRId64 " us.", elapsed);
+	fail_unless(feed.logic->len == ACTUAL_BYTES);
+}
+END_TEST
+
+Suite *suite_driver_dsreplay(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("driver-dsreplay");
+
+	tc = tcase_create("replay");
+	tcase_add_checked_fixture(tc, setup, teardown);
+	tcase_set_timeout(tc, 30);
+	tcase_add_test(tc, test_replay_data);
+	tcase_add_test(tc, test_replay_overflow);
+	tcase_add_test(tc, test_replay_speed);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
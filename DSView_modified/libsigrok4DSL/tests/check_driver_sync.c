@@ -0,0 +1,288 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2017 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <check.h>
+#include "../libsigrok.h"
+#include "lib.h"
+
+/*
+ * The demo devices are unpaced, so a capture takes no longer than it
+ * takes to send. At the lowest samplerate the time between the starts
+ * of the members is worth a few samples only.
+ */
+#define SAMPLERATE SR_KHZ(10)
+#define LIMIT_SAMPLES (256 * 1024)
+/* The most samples the member started first may drop */
+#define MAX_SKIP (64 * 64)
+
+static struct sr_context *sr_ctx;
+
+/* What the group sent to the session bus. */
+struct feed
+{
+	gboolean trigger;
+	gboolean end;
+	uint64_t bytes;
+	gboolean bad_length;
+	unsigned int dso_frames;
+	uint64_t dso_samples;
+};
+
+static struct feed feed;
+
+/* The enabled channels of the group, all of them. */
+static unsigned int en_total;
+
+static void datafeed_in(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	const struct sr_datafeed_logic *logic;
+	const struct sr_datafeed_dso *dso;
+	struct feed *f = cb_data;
+
+	(void)sdi;
+
+	switch (packet->type) {
+	case SR_DF_TRIGGER:
+		f->trigger = TRUE;
+		break;
+	case SR_DF_LOGIC:
+		logic = packet->payload;
+		if (logic->length % (en_total * sizeof(uint64_t)))
+			f->bad_length = TRUE;
+		f->bytes += logic->length;
+		break;
+	case SR_DF_DSO:
+		dso = packet->payload;
+		f->dso_frames++;
+		f->dso_samples = dso->num_samples;
+		break;
+	case SR_DF_END:
+		f->end = TRUE;
+		break;
+	}
+}
+
+static void setup(void)
+{
+	int ret;
+
+	g_setenv("DEMO_DEVICES", "2", TRUE);
+	g_setenv("DEMO_LOGIC_UNPACED", "1", TRUE);
+	g_setenv("SR_SYNC_DEVICES", "virtual-demo,virtual-demo", TRUE);
+
+	ret = sr_init(&sr_ctx);
+	fail_unless(ret == SR_OK, "sr_init() failed: %d.", ret);
+	fail_unless(sr_session_new() != NULL);
+
+	memset(&feed, 0, sizeof(feed));
+	sr_session_datafeed_callback_add(datafeed_in, &feed);
+}
+
+static void teardown(void)
+{
+	int ret;
+
+	sr_session_destroy();
+
+	ret = sr_exit(sr_ctx);
+	fail_unless(ret == SR_OK, "sr_exit() failed: %d.", ret);
+
+	g_unsetenv("DEMO_DEVICES");
+	g_unsetenv("DEMO_LOGIC_UNPACED");
+	g_unsetenv("SR_SYNC_DEVICES");
+}
+
+static void config_set_uint64(struct sr_dev_inst *sdi, int key, uint64_t value)
+{
+	int ret;
+
+	ret = sr_config_set(sdi, NULL, NULL, key, g_variant_new_uint64(value));
+	fail_unless(ret == SR_OK, "sr_config_set(%d) failed: %d.", key, ret);
+}
+
+/*
+ * Group the two demo devices, the second one in the given mode, open
+ * and add the group to the session.
+ */
+static struct sr_dev_inst *group_open(GSList **members, int mode_b)
+{
+	struct sr_dev_driver *demo, *sync;
+	struct sr_dev_inst *sdi;
+	GSList *devices;
+	int ret;
+
+	demo = srtest_driver_get("virtual-demo");
+	sync = srtest_driver_get("virtual-sync");
+	srtest_driver_init(sr_ctx, demo);
+	srtest_driver_init(sr_ctx, sync);
+
+	*members = sr_driver_scan(demo, NULL);
+	fail_unless(g_slist_length(*members) == 2,
+		    "Got %u demo devices.", g_slist_length(*members));
+	if (mode_b != LOGIC) {
+		sdi = (*members)->next->data;
+		ret = sr_dev_open(sdi);
+		fail_unless(ret == SR_OK, "sr_dev_open() failed: %d.", ret);
+		ret = sr_config_set(sdi, NULL, NULL, SR_CONF_DEVICE_MODE,
+				    g_variant_new_int16(mode_b));
+		fail_unless(ret == SR_OK, "Setting the mode failed: %d.", ret);
+		sr_dev_close(sdi);
+	}
+	devices = sr_driver_scan(sync, NULL);
+	fail_unless(g_slist_length(devices) == 1, "The group was not made.");
+	sdi = devices->data;
+	g_slist_free(devices);
+
+	ret = sr_dev_open(sdi);
+	fail_unless(ret == SR_OK, "sr_dev_open() failed: %d.", ret);
+	fail_unless(sdi->mode == LOGIC);
+	config_set_uint64(sdi, SR_CONF_SAMPLERATE, SAMPLERATE);
+	config_set_uint64(sdi, SR_CONF_LIMIT_SAMPLES, LIMIT_SAMPLES);
+	ret = sr_session_dev_add(sdi);
+	fail_unless(ret == SR_OK, "sr_session_dev_add() failed: %d.", ret);
+
+	return sdi;
+}
+
+static unsigned int channels_enabled(const struct sr_dev_inst *sdi)
+{
+	const struct sr_channel *ch;
+	const GSList *l;
+	unsigned int n = 0;
+
+	for (l = sdi->channels; l; l = l->next) {
+		ch = l->data;
+		if (ch->enabled && ch->type == SR_CHANNEL_LOGIC)
+			n++;
+	}
+
+	return n;
+}
+
+/* The channels of both members side by side, on the shorter capture. */
+START_TEST(test_sync_merge)
+{
+	struct sr_dev_inst *sdi;
+	GSList *members;
+	uint64_t samples;
+	int ret;
+
+	sdi = group_open(&members, LOGIC);
+	en_total = channels_enabled(sdi);
+	fail_unless(g_slist_length(sdi->channels) ==
+		    g_slist_length(((struct sr_dev_inst *)members->data)->channels) +
+		    g_slist_length(((struct sr_dev_inst *)members->next->data)->channels));
+	fail_unless(en_total == channels_enabled(members->data) +
+		    channels_enabled(members->next->data),
+		    "The group has %u channels enabled.", en_total);
+	g_slist_free(members);
+
+	ret = sr_session_start();
+	fail_unless(ret == SR_OK, "sr_session_start() failed: %d.", ret);
+	ret = sr_session_run();
+	fail_unless(ret == SR_OK, "sr_session_run() failed: %d.", ret);
+	sr_dev_close(sdi);
+
+	fail_unless(feed.trigger, "No SR_DF_TRIGGER sent.");
+	fail_unless(feed.end, "No SR_DF_END sent.");
+	fail_unless(!feed.bad_length, "A packet has part of a block.");
+
+	samples = feed.bytes / (en_total * sizeof(uint64_t)) * 64;
+	fail_unless(samples <= LIMIT_SAMPLES && samples + MAX_SKIP >= LIMIT_SAMPLES,
+		    "Got %" PRIu64 " samples.", samples);
+}
+END_TEST
+
+/* Members at different samplerates don't start. */
+START_TEST(test_sync_settings)
+{
+	struct sr_dev_inst *sdi;
+	GSList *members;
+	int ret;
+
+	sdi = group_open(&members, LOGIC);
+	config_set_uint64(members->next->data, SR_CONF_SAMPLERATE,
+			  SAMPLERATE * 2);
+	g_slist_free(members);
+
+	ret = sr_session_start();
+	fail_unless(ret != SR_OK, "The group started.");
+	sr_dev_close(sdi);
+}
+END_TEST
+
+/*
+ * A logic analyzer with an oscilloscope: the logic samples of the one and
+ * a single frame of the other, the session stopped once both are in.
+ */
+START_TEST(test_sync_mixed)
+{
+	struct sr_dev_inst *sdi;
+	const struct sr_channel *ch;
+	GSList *members;
+	uint64_t samples;
+	int ret;
+
+	sdi = group_open(&members, DSO);
+	ch = sdi->channels->data;
+	fail_unless(ch->type == SR_CHANNEL_DSO,
+		    "The group does not list the DSO channels first.");
+	en_total = channels_enabled(sdi);
+	fail_unless(en_total == channels_enabled(members->data),
+		    "The group has %u channels enabled.", en_total);
+	g_slist_free(members);
+
+	ret = sr_session_start();
+	fail_unless(ret == SR_OK, "sr_session_start() failed: %d.", ret);
+	ret = sr_session_run();
+	fail_unless(ret == SR_OK, "sr_session_run() failed: %d.", ret);
+	sr_dev_close(sdi);
+
+	fail_unless(feed.end, "No SR_DF_END sent.");
+	fail_unless(feed.dso_frames == 1, "Got %u frames.", feed.dso_frames);
+	fail_unless(feed.dso_samples > 0, "The frame is empty.");
+	fail_unless(!feed.bad_length, "A packet has part of a block.");
+
+	samples = feed.bytes / (en_total * sizeof(uint64_t)) * 64;
+	fail_unless(samples <= LIMIT_SAMPLES && samples + MAX_SKIP >= LIMIT_SAMPLES,
+		    "Got %" PRIu64 " samples.", samples);
+}
+END_TEST
+
+Suite *suite_driver_sync(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("driver-sync");
+
+	tc = tcase_create("group");
+	tcase_add_checked_fixture(tc, setup, teardown);
+	tcase_set_timeout(tc, 30);
+	tcase_add_test(tc, test_sync_merge);
+	tcase_add_test(tc, test_sync_settings);
+	tcase_add_test(tc, test_sync_mixed);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
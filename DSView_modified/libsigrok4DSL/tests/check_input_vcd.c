@@ -0,0 +1,277 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2016 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <glib/gstdio.h>
+#include <check.h>
+#include "../libsigrok.h"
+#include "lib.h"
+
+#define NUM_PROBES 2
+
+static struct sr_context *sr_ctx;
+
+/* What the VCD input module sent to the session bus. */
+struct feed
+{
+	uint64_t samplerate;
+	uint64_t limit;
+	gboolean meta_before_logic;
+	gboolean end;
+	GByteArray *bits[NUM_PROBES];
+};
+
+static struct feed feed;
+
+static void datafeed_in(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	const struct sr_datafeed_meta *meta;
+	const struct sr_datafeed_logic *logic;
+	const struct sr_config *src;
+	struct feed *f = cb_data;
+	GSList *l;
+
+	(void)sdi;
+
+	switch (packet->type) {
+	case SR_DF_META:
+		meta = packet->payload;
+		for (l = meta->config; l; l = l->next) {
+			src = l->data;
+			if (src->key == SR_CONF_SAMPLERATE)
+				f->samplerate = g_variant_get_uint64(src->data);
+			else if (src->key == SR_CONF_LIMIT_SAMPLES)
+				f->limit = g_variant_get_uint64(src->data);
+		}
+		break;
+	case SR_DF_LOGIC:
+		logic = packet->payload;
+		fail_unless(logic->format == LA_SPLIT_DATA);
+		fail_unless(logic->index < NUM_PROBES);
+		if (logic->index == 0 && f->bits[0]->len == 0)
+			f->meta_before_logic = (f->limit != 0);
+		g_byte_array_append(f->bits[logic->index], logic->data, logic->length);
+		break;
+	case SR_DF_END:
+		f->end = TRUE;
+		break;
+	}
+}
+
+static int get_bit(int probe, uint64_t sample)
+{
+	return (feed.bits[probe]->data[sample / 8] >> (sample & 7)) & 1;
+}
+
+static void setup(void)
+{
+	int i, ret;
+
+	ret = sr_init(&sr_ctx);
+	fail_unless(ret == SR_OK, "sr_init() failed: %d.", ret);
+	fail_unless(sr_session_new() != NULL);
+
+	memset(&feed, 0, sizeof(feed));
+	for (i = 0; i < NUM_PROBES; i++)
+		feed.bits[i] = g_byte_array_new();
+	sr_session_datafeed_callback_add(datafeed_in, &feed);
+}
+
+static void teardown(void)
+{
+	int i, ret;
+
+	for (i = 0; i < NUM_PROBES; i++)
+		g_byte_array_free(feed.bits[i], TRUE);
+	sr_session_destroy();
+
+	ret = sr_exit(sr_ctx);
+	fail_unless(ret == SR_OK, "sr_exit() failed: %d.", ret);
+}
+
+static struct sr_input_format *vcd_format(void)
+{
+	struct sr_input_format **formats;
+	int i;
+
+	formats = sr_input_list();
+	for (i = 0; formats[i]; i++) {
+		if (strcmp(formats[i]->id, "vcd") == 0)
+			return formats[i];
+	}
+
+	fail("VCD input format not found.");
+	return NULL;
+}
+
+/* Load a VCD file through the input module, the way sigrok-cli does. */
+static void load_vcd(const char *filename, const char *compress)
+{
+	struct sr_input *in;
+	int ret;
+
+	in = g_malloc0(sizeof(struct sr_input));
+	in->format = vcd_format();
+	in->param = g_hash_table_new(g_str_hash, g_str_equal);
+	g_hash_table_insert(in->param, "numprobes", "2");
+	if (compress)
+		g_hash_table_insert(in->param, "compress", (gpointer)compress);
+
+	fail_unless(in->format->format_match(filename));
+	ret = in->format->init(in, filename);
+	fail_unless(ret == SR_OK, "init() failed: %d.", ret);
+	ret = in->format->loadfile(in, filename);
+	fail_unless(ret == SR_OK, "loadfile() failed: %d.", ret);
+
+	fail_unless(feed.end, "No SR_DF_END sent.");
+	fail_unless(feed.meta_before_logic,
+		    "SR_CONF_LIMIT_SAMPLES not sent before the samples.");
+
+	g_hash_table_destroy(in->param);
+	g_free(in);
+}
+
+static char *write_vcd(const char *contents)
+{
+	GError *error = NULL;
+	char *filename;
+	int fd;
+
+	fd = g_file_open_tmp("check_input_XXXXXX.vcd", &filename, &error);
+	fail_unless(fd >= 0, "Cannot create temporary file.");
+	close(fd);
+	fail_unless(g_file_set_contents(filename, contents, -1, &error));
+
+	return filename;
+}
+
+static const char *small_vcd =
+	"$timescale 1 us $end\n"
+	"$scope module top $end\n"
+	"$var wire 1 ! a $end\n"
+	"$var wire 1 \" b $end\n"
+	"$upscope $end\n"
+	"$enddefinitions $end\n"
+	"#10\n"
+	"1!\n"
+	"0\"\n"
+	"#13\n"
+	"0!\n"
+	"1\"\n"
+	"#14\n"
+	"1!\n"
+	"#14\n"
+	"#20\n";
+
+/*
+ * Check the samples generated from a short file: the file starts at its
+ * first timestamp, repeated timestamps add nothing, and the count sent
+ * ahead is the number of samples that follow.
+ */
+START_TEST(test_vcd_samples)
+{
+	const int a[] = { 1, 1, 1, 0, 1, 1, 1, 1, 1, 1 };
+	const int b[] = { 0, 0, 0, 1, 1, 1, 1, 1, 1, 1 };
+	char *filename;
+	int i;
+
+	filename = write_vcd(small_vcd);
+	load_vcd(filename, NULL);
+	g_unlink(filename);
+	g_free(filename);
+
+	fail_unless(feed.samplerate == SR_MHZ(1));
+	fail_unless(feed.limit == 10, "Got %" PRIu64 " samples.", feed.limit);
+	fail_unless(feed.bits[0]->len == 2);
+	for (i = 0; i < 10; i++) {
+		fail_unless(get_bit(0, i) == a[i], "Probe 0 wrong at %d.", i);
+		fail_unless(get_bit(1, i) == b[i], "Probe 1 wrong at %d.", i);
+	}
+}
+END_TEST
+
+/* Long idle periods are cut to the compress length, in the count too. */
+START_TEST(test_vcd_compress)
+{
+	char *filename;
+
+	filename = write_vcd(small_vcd);
+	load_vcd(filename, "4");
+	g_unlink(filename);
+	g_free(filename);
+
+	fail_unless(feed.limit == 8, "Got %" PRIu64 " samples.", feed.limit);
+	fail_unless(get_bit(0, 7) == 1 && get_bit(1, 7) == 1);
+}
+END_TEST
+
+/*
+ * A file of several tokenizer chunks and sample blocks: the chunks
+ * have to be stitched in order, both when counting and when merging.
+ */
+START_TEST(test_vcd_chunks)
+{
+	const uint64_t timestamps = 4000000;
+	uint64_t i, samples;
+	GString *vcd;
+	char *filename;
+
+	vcd = g_string_new(small_vcd);
+	g_string_truncate(vcd, strstr(small_vcd, "#10") - small_vcd);
+	for (i = 0; i < timestamps; i++)
+		g_string_append_printf(vcd, "#%" PRIu64 "\n%d!\n", i * 3, (int)(i & 1));
+	filename = write_vcd(vcd->str);
+	g_string_free(vcd, TRUE);
+
+	load_vcd(filename, NULL);
+	g_unlink(filename);
+	g_free(filename);
+
+	samples = (timestamps - 1) * 3;
+	fail_unless(feed.limit == samples, "Got %" PRIu64 " samples.", feed.limit);
+	fail_unless(feed.bits[0]->len == (samples + 7) / 8);
+	for (i = 0; i < samples; i += 997)
+		fail_unless(get_bit(0, i) == ((i / 3) & 1),
+			    "Probe 0 wrong at %" PRIu64 ".", i);
+	fail_unless(get_bit(0, samples - 1) == (((samples - 1) / 3) & 1));
+}
+END_TEST
+
+Suite *suite_input_vcd(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("input-vcd");
+
+	tc = tcase_create("load");
+	tcase_add_checked_fixture(tc, setup, teardown);
+	tcase_set_timeout(tc, 60);
+	tcase_add_test(tc, test_vcd_samples);
+	tcase_add_test(tc, test_vcd_compress);
+	tcase_add_test(tc, test_vcd_chunks);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
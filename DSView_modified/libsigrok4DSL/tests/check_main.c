@@ -25,6 +25,9 @@
 Suite *suite_core(void);
 Suite *suite_strutil(void);
 Suite *suite_driver_all(void);
+Suite *suite_driver_dsreplay(void);
+Suite *suite_driver_sync(void);
+Suite *suite_input_vcd(void);
 
 int main(void)
 {
@@ -39,6 +42,9 @@ int main(void)
 	srunner_add_suite(srunner, suite_core());
 	srunner_add_suite(srunner, suite_strutil());
 	srunner_add_suite(srunner, suite_driver_all());
+	srunner_add_suite(srunner, suite_driver_dsreplay());
+	srunner_add_suite(srunner, suite_driver_sync());
+	srunner_add_suite(srunner, suite_input_vcd());
 
 	srunner_run_all(srunner, CK_VERBOSE);
 	ret = srunner_ntests_failed(srunner);
@@ -0,0 +1,465 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2013 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "libsigrok.h"
+#include "libsigrok-internal.h"
+#include <string.h>
+#include <stdlib.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+
+/* Message logging helpers with subsystem-specific prefix string. */
+#define LOG_PREFIX "traceset: "
+#define sr_log(l, s, args...) sr_log(l, LOG_PREFIX s, ## args)
+#define sr_spew(s, args...) sr_spew(LOG_PREFIX s, ## args)
+#define sr_dbg(s, args...) sr_dbg(LOG_PREFIX s, ## args)
+#define sr_info(s, args...) sr_info(LOG_PREFIX s, ## args)
+#define sr_warn(s, args...) sr_warn(LOG_PREFIX s, ## args)
+#define sr_err(s, args...) sr_err(LOG_PREFIX s, ## args)
+
+/**
+ * @file
+ *
+ * Raw trace sets, as written by the offline DPA tools, opened as a
+ * read-only DSO session.
+ *
+ * A trace set is described by a small key file:
+ *
+ *   [traceset]
+ *   format=float32        ; or uint8
+ *   samples=5000          ; samples per trace
+ *   samplerate=1G
+ *   data=traces.bin       ; all traces back to back in one container, or
+ *   dir=bin               ; one trace per file, ordered by the leading
+ *                         ; number of the file name (csv2bin.py output)
+ *   trace=123456          ; trace to show, or "mean" for the mean trace
+ *
+ * The trace in the key file is the one shown when the set is opened.
+ * SR_CONF_TRACE_INDEX and SR_CONF_TRACE_MEAN of the session device
+ * select another one, which is mapped on the next acquisition start.
+ *
+ * Relative paths are taken from the directory of the key file. Only the
+ * file holding the selected trace is mapped, so any trace of a large set
+ * opens without reading the others; the mean trace has to visit all of
+ * them once. Samples are scaled to the 8-bit DSO range, with the probe
+ * map range set to the minimum and maximum of the trace.
+ */
+
+/** @cond PRIVATE */
+#define TRACESET_GROUP "traceset"
+/** @endcond */
+
+enum {
+	TRACE_FLOAT32 = 0,
+	TRACE_UINT8,
+};
+
+struct sr_traceset {
+	int format;
+	uint64_t samples;
+	uint64_t samplerate;
+	int64_t trace;
+	uint64_t num_traces;
+	/* Container holding every trace, or NULL if files is used. */
+	char *data;
+	/* One file per trace, sorted by trace number. */
+	GPtrArray *files;
+	/* Mapping of the file holding the selected trace. */
+	GMappedFile *map;
+	const uint8_t *base;
+	/* Mean trace, if selected. */
+	float *mean;
+	float min;
+	float max;
+};
+
+static size_t sample_size(const struct sr_traceset *ts)
+{
+	return ts->format == TRACE_FLOAT32 ? sizeof(float) : sizeof(uint8_t);
+}
+
+static float sample_value(const struct sr_traceset *ts, const uint8_t *trace,
+		uint64_t index)
+{
+	float value;
+
+	if (ts->format == TRACE_UINT8)
+		return trace[index];
+
+	/* Traces are not necessarily aligned inside the container. */
+	memcpy(&value, trace + index * sizeof(float), sizeof(float));
+	return value;
+}
+
+static gint compare_trace_files(gconstpointer a, gconstpointer b)
+{
+	const char *name_a = g_path_get_basename(*(const char **)a);
+	const char *name_b = g_path_get_basename(*(const char **)b);
+	const uint64_t num_a = g_ascii_strtoull(name_a, NULL, 10);
+	const uint64_t num_b = g_ascii_strtoull(name_b, NULL, 10);
+	gint ret;
+
+	ret = (num_a > num_b) - (num_a < num_b);
+	if (ret == 0)
+		ret = strcmp(name_a, name_b);
+	g_free((char *)name_a);
+	g_free((char *)name_b);
+
+	return ret;
+}
+
+static GPtrArray *list_trace_files(const char *dirname)
+{
+	GPtrArray *files;
+	GDir *dir;
+	const char *name;
+
+	if (!(dir = g_dir_open(dirname, 0, NULL))) {
+		sr_err("Failed to open trace directory '%s'.", dirname);
+		return NULL;
+	}
+
+	files = g_ptr_array_new_with_free_func(g_free);
+	while ((name = g_dir_read_name(dir))) {
+		if (g_str_has_suffix(name, ".bin"))
+			g_ptr_array_add(files, g_build_filename(dirname, name, NULL));
+	}
+	g_dir_close(dir);
+	g_ptr_array_sort(files, compare_trace_files);
+
+	return files;
+}
+
+/* Map the file holding a trace, and return its first sample. */
+static const uint8_t *map_trace(const struct sr_traceset *ts, uint64_t trace,
+		GMappedFile **map)
+{
+	const char *filename;
+	uint64_t offset, length;
+
+	filename = ts->files ? g_ptr_array_index(ts->files, trace) : ts->data;
+	offset = ts->files ? 0 : trace * ts->samples * sample_size(ts);
+
+	if (!(*map = g_mapped_file_new(filename, FALSE, NULL))) {
+		sr_err("Failed to map trace file '%s'.", filename);
+		return NULL;
+	}
+
+	length = g_mapped_file_get_length(*map);
+	if (offset + ts->samples * sample_size(ts) > length) {
+		sr_err("Trace %" PRIu64 " is truncated in '%s'.", trace, filename);
+		g_mapped_file_unref(*map);
+		*map = NULL;
+		return NULL;
+	}
+
+	return (const uint8_t *)g_mapped_file_get_contents(*map) + offset;
+}
+
+static int calc_mean(struct sr_traceset *ts)
+{
+	GMappedFile *map;
+	const uint8_t *trace;
+	uint64_t i, t;
+
+	if (!(ts->mean = g_try_malloc0(ts->samples * sizeof(float)))) {
+		sr_err("%s: mean trace malloc failed", __func__);
+		return SR_ERR_MALLOC;
+	}
+
+	/* Running mean, which does not lose precision on large sets. */
+	for (t = 0; t < ts->num_traces; t++) {
+		if (!(trace = map_trace(ts, t, &map)))
+			return SR_ERR;
+		for (i = 0; i < ts->samples; i++)
+			ts->mean[i] += (sample_value(ts, trace, i) - ts->mean[i]) / (t + 1);
+		g_mapped_file_unref(map);
+	}
+
+	return SR_OK;
+}
+
+/** @private */
+SR_PRIV int sr_traceset_check(const char *filename)
+{
+	GKeyFile *kf;
+	gboolean found;
+
+	if (!filename)
+		return SR_ERR_ARG;
+
+	kf = g_key_file_new();
+	found = g_key_file_load_from_file(kf, filename, 0, NULL) &&
+		g_key_file_has_group(kf, TRACESET_GROUP);
+	g_key_file_free(kf);
+
+	return found ? SR_OK : SR_ERR;
+}
+
+/** @private */
+SR_PRIV void sr_traceset_close(struct sr_traceset *ts)
+{
+	if (!ts)
+		return;
+
+	if (ts->map)
+		g_mapped_file_unref(ts->map);
+	if (ts->files)
+		g_ptr_array_free(ts->files, TRUE);
+	g_free(ts->data);
+	g_free(ts->mean);
+	g_free(ts);
+}
+
+/* Parse the key file and index the traces, without touching them. */
+static struct sr_traceset *parse_traceset(const char *filename)
+{
+	struct sr_traceset *ts;
+	GKeyFile *kf;
+	char *dirname, *val;
+	struct stat st;
+
+	kf = g_key_file_new();
+	if (!g_key_file_load_from_file(kf, filename, 0, NULL)) {
+		sr_err("Failed to parse trace set '%s'.", filename);
+		g_key_file_free(kf);
+		return NULL;
+	}
+
+	if (!(ts = g_try_malloc0(sizeof(struct sr_traceset)))) {
+		sr_err("%s: traceset malloc failed", __func__);
+		g_key_file_free(kf);
+		return NULL;
+	}
+
+	dirname = g_path_get_dirname(filename);
+
+	val = g_key_file_get_string(kf, TRACESET_GROUP, "format", NULL);
+	ts->format = (val && !strcmp(val, "uint8")) ? TRACE_UINT8 : TRACE_FLOAT32;
+	g_free(val);
+
+	ts->samples = g_key_file_get_uint64(kf, TRACESET_GROUP, "samples", NULL);
+
+	val = g_key_file_get_string(kf, TRACESET_GROUP, "samplerate", NULL);
+	if (!val || sr_parse_sizestring(val, &ts->samplerate) != SR_OK)
+		ts->samplerate = SR_MHZ(1);
+	g_free(val);
+
+	val = g_key_file_get_string(kf, TRACESET_GROUP, "trace", NULL);
+	ts->trace = (val && !strcmp(val, "mean")) ? SR_TRACESET_MEAN :
+		    val ? (int64_t)g_ascii_strtoull(val, NULL, 10) : 0;
+	g_free(val);
+
+	if ((val = g_key_file_get_string(kf, TRACESET_GROUP, "dir", NULL))) {
+		char *path = g_path_is_absolute(val) ? g_strdup(val) :
+			     g_build_filename(dirname, val, NULL);
+		ts->files = list_trace_files(path);
+		g_free(path);
+		g_free(val);
+		if (ts->files)
+			ts->num_traces = ts->files->len;
+		/* csv2bin.py writes one whole trace per file. */
+		if (ts->num_traces && ts->samples == 0 &&
+		    g_stat(g_ptr_array_index(ts->files, 0), &st) == 0)
+			ts->samples = st.st_size / sample_size(ts);
+	} else if ((val = g_key_file_get_string(kf, TRACESET_GROUP, "data", NULL))) {
+		ts->data = g_path_is_absolute(val) ? g_strdup(val) :
+			   g_build_filename(dirname, val, NULL);
+		g_free(val);
+		if (ts->samples != 0 && g_stat(ts->data, &st) == 0)
+			ts->num_traces = st.st_size / (ts->samples * sample_size(ts));
+	}
+	g_free(dirname);
+	g_key_file_free(kf);
+
+	if (ts->samples == 0 || ts->num_traces == 0) {
+		sr_err("Trace set '%s' holds no traces.", filename);
+		goto err;
+	}
+	if (ts->trace >= (int64_t)ts->num_traces) {
+		sr_err("Trace %" PRId64 " is beyond the %" PRIu64 " traces of the set.",
+		       ts->trace, ts->num_traces);
+		goto err;
+	}
+
+	return ts;
+
+err:
+	sr_traceset_close(ts);
+	return NULL;
+}
+
+/** @private */
+SR_PRIV uint64_t sr_traceset_count(const char *filename)
+{
+	struct sr_traceset *ts;
+	uint64_t num_traces;
+
+	if (!(ts = parse_traceset(filename)))
+		return 0;
+	num_traces = ts->num_traces;
+	sr_traceset_close(ts);
+
+	return num_traces;
+}
+
+/**
+ * Open a trace of a set for reading.
+ *
+ * @param filename The trace set key file. Must not be NULL.
+ * @param trace The trace to read, or SR_TRACESET_MEAN for the mean trace.
+ *
+ * @return The trace set, or NULL upon errors.
+ */
+SR_PRIV struct sr_traceset *sr_traceset_open(const char *filename, int64_t trace)
+{
+	struct sr_traceset *ts;
+	uint64_t i;
+	float value;
+
+	if (!(ts = parse_traceset(filename)))
+		return NULL;
+
+	if (trace >= (int64_t)ts->num_traces) {
+		sr_err("Trace %" PRId64 " is beyond the %" PRIu64 " traces of the set.",
+		       trace, ts->num_traces);
+		goto err;
+	}
+	ts->trace = trace;
+
+	if (ts->trace == SR_TRACESET_MEAN) {
+		if (calc_mean(ts) != SR_OK)
+			goto err;
+	} else if (!(ts->base = map_trace(ts, ts->trace, &ts->map))) {
+		goto err;
+	}
+
+	ts->min = ts->max = ts->mean ? ts->mean[0] : sample_value(ts, ts->base, 0);
+	for (i = 1; i < ts->samples; i++) {
+		value = ts->mean ? ts->mean[i] : sample_value(ts, ts->base, i);
+		ts->min = MIN(ts->min, value);
+		ts->max = MAX(ts->max, value);
+	}
+
+	sr_info("Opened trace %" PRId64 " of %" PRIu64 ", %" PRIu64 " samples.",
+		ts->trace, ts->num_traces, ts->samples);
+
+	return ts;
+
+err:
+	sr_traceset_close(ts);
+	return NULL;
+}
+
+/** @private */
+SR_PRIV void sr_traceset_range(const struct sr_traceset *ts, double *min, double *max)
+{
+	*min = ts->min;
+	*max = ts->max;
+}
+
+/**
+ * Read samples of the selected trace, scaled to the 8-bit DSO range.
+ * DSO samples grow downwards on the screen, so the maximum of the
+ * trace is mapped to 0.
+ *
+ * @return The number of samples read.
+ */
+SR_PRIV uint64_t sr_traceset_read(const struct sr_traceset *ts, uint8_t *buf,
+		uint64_t start, uint64_t count)
+{
+	const float range = ts->max - ts->min;
+	uint64_t i;
+	float value;
+
+	if (start >= ts->samples)
+		return 0;
+	count = MIN(count, ts->samples - start);
+
+	for (i = 0; i < count; i++) {
+		value = ts->mean ? ts->mean[start + i] : sample_value(ts, ts->base, start + i);
+		buf[i] = (range > 0) ? (uint8_t)(255.0f - (value - ts->min) * 255.0f / range + 0.5f) : 128;
+	}
+
+	return count;
+}
+
+/**
+ * Load a trace set as a session with a single DSO channel. The
+ * samples are read by the session driver on acquisition start.
+ *
+ * @param filename The trace set key file. Must not be NULL.
+ *
+ * @return SR_OK upon success, SR_ERR otherwise.
+ */
+SR_PRIV int sr_traceset_load(const char *filename)
+{
+	extern SR_PRIV struct sr_dev_driver session_driver;
+	struct sr_traceset *ts;
+	struct sr_dev_inst *sdi;
+	struct sr_channel *probe;
+
+	if (!(ts = parse_traceset(filename)))
+		return SR_ERR;
+
+	sr_session_new();
+
+	sdi = sr_dev_inst_new(DSO, 0, SR_ST_ACTIVE, NULL, NULL, NULL);
+	sdi->driver = &session_driver;
+	sdi->driver->init(NULL);
+	sr_dev_open(sdi);
+	sr_session_dev_add(sdi);
+	sdi->driver->config_set(SR_CONF_SESSIONFILE,
+			g_variant_new_bytestring(filename), sdi, NULL, NULL);
+	sdi->driver->config_set(SR_CONF_FILE_VERSION,
+			g_variant_new_int16(2), sdi, NULL, NULL);
+	sdi->driver->config_set(SR_CONF_SAMPLERATE,
+			g_variant_new_uint64(ts->samplerate), sdi, NULL, NULL);
+	sdi->driver->config_set(SR_CONF_LIMIT_SAMPLES,
+			g_variant_new_uint64(ts->samples), sdi, NULL, NULL);
+	sdi->driver->config_set(SR_CONF_UNIT_BITS,
+			g_variant_new_byte(8), sdi, NULL, NULL);
+	sdi->driver->config_set(SR_CONF_CAPTURE_NUM_PROBES,
+			g_variant_new_uint64(1), sdi, NULL, NULL);
+	sdi->driver->config_set(SR_CONF_TRACE_INDEX,
+			g_variant_new_uint64(ts->trace == SR_TRACESET_MEAN ? 0 : ts->trace),
+			sdi, NULL, NULL);
+	sdi->driver->config_set(SR_CONF_TRACE_MEAN,
+			g_variant_new_boolean(ts->trace == SR_TRACESET_MEAN), sdi, NULL, NULL);
+
+	if (!(probe = sr_channel_new(0, SR_CHANNEL_DSO, TRUE, "trace"))) {
+		sr_traceset_close(ts);
+		return SR_ERR;
+	}
+	probe->coupling = SR_DC_COUPLING;
+	probe->vdiv = 1000;
+	probe->vfactor = 1;
+	probe->vpos = 0;
+	probe->trig_value = 0x80;
+	/* The map range is known once the trace is read. */
+	probe->map_unit = "V";
+	probe->map_min = 0;
+	probe->map_max = 255;
+	sdi->channels = g_slist_append(sdi->channels, probe);
+
+	sr_traceset_close(ts);
+
+	return SR_OK;
+}
@@ -641,6 +641,7 @@ SRD_API int srd_decoder_load(const char *module_name)
 	long apiver;
 	int is_subclass;
 	const char *fail_txt;
+	PyGILState_STATE gstate;
 
 	if (!srd_check_init())
 		return SRD_ERR;
@@ -648,8 +649,11 @@ SRD_API int srd_decoder_load(const char *module_name)
 	if (!module_name)
 		return SRD_ERR_ARG;
 
+	gstate = PyGILState_Ensure();
+
 	if (PyDict_GetItemString(PyImport_GetModuleDict(), module_name)) {
 		/* Module was already imported. */
+		PyGILState_Release(gstate);
 		return SRD_OK;
 	}
 
@@ -780,6 +784,8 @@ SRD_API int srd_decoder_load(const char *module_name)
 	/* Append it to the list of loaded decoders. */
 	pd_list = g_slist_append(pd_list, d);
 
+	PyGILState_Release(gstate);
+
 	return SRD_OK;
 
 except_out:
@@ -794,6 +800,7 @@ err_out:
 	if (fail_txt)
 		srd_err("Failed to load decoder %s: %s", module_name, fail_txt);
 	decoder_free(d);
+	PyGILState_Release(gstate);
 
 	return SRD_ERR_PYTHON;
 }
@@ -812,6 +819,7 @@ SRD_API char *srd_decoder_doc_get(const struct srd_decoder *dec)
 {
 	PyObject *py_str;
 	char *doc;
+	PyGILState_STATE gstate;
 
 	if (!srd_check_init())
 		return NULL;
@@ -819,22 +827,76 @@ SRD_API char *srd_decoder_doc_get(const struct srd_decoder *dec)
 	if (!dec)
 		return NULL;
 
+	gstate = PyGILState_Ensure();
+
+	doc = NULL;
 	if (!PyObject_HasAttrString(dec->py_mod, "__doc__"))
-		return NULL;
+		goto out;
 
 	if (!(py_str = PyObject_GetAttrString(dec->py_mod, "__doc__"))) {
 		srd_exception_catch(NULL, "Failed to get docstring");
-		return NULL;
+		goto out;
 	}
 
-	doc = NULL;
 	if (py_str != Py_None)
 		py_str_as_str(py_str, &doc);
 	Py_DECREF(py_str);
 
+out:
+	PyGILState_Release(gstate);
+
 	return doc;
 }
 
+/**
+ * Return the directory a protocol decoder's scripts were loaded from.
+ *
+ * @param dec The loaded protocol decoder.
+ *
+ * @return A newly allocated buffer containing the path of the directory,
+ *         or NULL if it is not known. The caller is responsible for
+ *         free'ing the buffer.
+ *
+ * @since 0.5.0
+ */
+SRD_API char *srd_decoder_path_get(const struct srd_decoder *dec)
+{
+	PyObject *py_str;
+	char *file, *path;
+	PyGILState_STATE gstate;
+
+	if (!srd_check_init())
+		return NULL;
+
+	if (!dec)
+		return NULL;
+
+	gstate = PyGILState_Ensure();
+
+	file = NULL;
+	if (!PyObject_HasAttrString(dec->py_mod, "__file__"))
+		goto out;
+
+	if (!(py_str = PyObject_GetAttrString(dec->py_mod, "__file__"))) {
+		srd_exception_catch(NULL, "Failed to get the decoder file");
+		goto out;
+	}
+
+	if (py_str != Py_None)
+		py_str_as_str(py_str, &file);
+	Py_DECREF(py_str);
+
+out:
+	PyGILState_Release(gstate);
+	if (!file)
+		return NULL;
+
+	path = g_path_get_dirname(file);
+	g_free(file);
+
+	return path;
+}
+
 /**
  * Unload the specified protocol decoder.
  *
@@ -848,6 +910,7 @@ SRD_API int srd_decoder_unload(struct srd_decoder *dec)
 {
 	struct srd_session *sess;
 	GSList *l;
+	PyGILState_STATE gstate;
 
 	if (!srd_check_init())
 		return SRD_ERR;
@@ -857,6 +920,8 @@ SRD_API int srd_decoder_unload(struct srd_decoder *dec)
 
 	srd_dbg("Unloading protocol decoder '%s'.", dec->name);
 
+	gstate = PyGILState_Ensure();
+
 	/*
 	 * Since any instances of this decoder need to be released as well,
 	 * but they could be anywhere in the stack, just free the entire
@@ -873,6 +938,8 @@ SRD_API int srd_decoder_unload(struct srd_decoder *dec)
 
 	decoder_free(dec);
 
+	PyGILState_Release(gstate);
+
 	return SRD_OK;
 }
 
@@ -989,13 +1056,18 @@ static void srd_decoder_load_all_path(char *path)
 SRD_API int srd_decoder_load_all(void)
 {
 	GSList *l;
+	PyGILState_STATE gstate;
 
 	if (!srd_check_init())
 		return SRD_ERR;
 
+	gstate = PyGILState_Ensure();
+
 	for (l = searchpaths; l; l = l->next)
 		srd_decoder_load_all_path(l->data);
 
+	PyGILState_Release(gstate);
+
 	return SRD_OK;
 }
 
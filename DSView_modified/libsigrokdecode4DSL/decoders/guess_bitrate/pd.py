@@ -60,9 +60,8 @@ class Decoder(srd.Decoder):
             raise SamplerateError('Cannot decode without samplerate.')
         for (self.samplenum, pins) in logic:
             (data,) = pins
-            logic.logic_mask = 1
-            logic.cur_pos = self.samplenum
-            logic.edge_index = -1
+            # Skip to the next edge of the data channel.
+            logic.wait({0: 'e'})
 
             # Initialize first self.olddata with the first sample value.
             if self.olddata is None:
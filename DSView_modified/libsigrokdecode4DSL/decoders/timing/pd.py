@@ -84,41 +84,47 @@ class Decoder(srd.Decoder):
     def start(self):
         self.out_ann = self.register(srd.OUTPUT_ANN)
 
-    def decode(self, ss, es, data):
-        if not self.samplerate:
-            raise SamplerateError('Cannot decode without samplerate.')
+    def handle_edge(self, pin):
+        samples = self.samplenum - self.last_samplenum
+        t = samples / self.samplerate
+        self.chunks += 1
+
+        # Don't insert the first chunk into the averaging as it is
+        # not complete probably.
+        if self.last_samplenum is None or self.chunks < 2:
+            # Report the timing normalized.
+            self.put(self.last_samplenum, self.samplenum, self.out_ann,
+                     [0, [normalize_time(t)]])
+        else:
+            if t > 0:
+                self.last_n.append(t)
 
-        for (self.samplenum, (pin,)) in data:
-            data.itercnt += 1
-            if self.oldpin is None:
-                self.oldpin = pin
-                self.last_samplenum = self.samplenum
-                continue
+            if len(self.last_n) > self.options['avg_period']:
+                self.last_n.popleft()
 
-            if self.oldpin != pin:
-                samples = self.samplenum - self.last_samplenum
-                t = samples / self.samplerate
-                self.chunks += 1
+            # Report the timing normalized.
+            self.put(self.last_samplenum, self.samplenum, self.out_ann,
+                     [0, [normalize_time(t)]])
+            self.put(self.last_samplenum, self.samplenum, self.out_ann,
+                     [1, [normalize_time(sum(self.last_n) / len(self.last_n))]])
 
-                # Don't insert the first chunk into the averaging as it is
-                # not complete probably.
-                if self.last_samplenum is None or self.chunks < 2:
-                    # Report the timing normalized.
-                    self.put(self.last_samplenum, self.samplenum, self.out_ann,
-                             [0, [normalize_time(t)]])
-                else:
-                    if t > 0:
-                        self.last_n.append(t)
+        # Store data for next round.
+        self.last_samplenum = self.samplenum
+        self.oldpin = pin
 
-                    if len(self.last_n) > self.options['avg_period']:
-                        self.last_n.popleft()
+    def decode(self, ss, es, data):
+        if not self.samplerate:
+            raise SamplerateError('Cannot decode without samplerate.')
 
-                    # Report the timing normalized.
-                    self.put(self.last_samplenum, self.samplenum, self.out_ann,
-                             [0, [normalize_time(t)]])
-                    self.put(self.last_samplenum, self.samplenum, self.out_ann,
-                             [1, [normalize_time(sum(self.last_n) / len(self.last_n))]])
+        # Only the transitions are of interest, take them for the whole
+        # chunk at once instead of iterating over every sample.
+        (pin,) = data.samples(0, 1)
+        self.samplenum = ss
+        if self.oldpin is None:
+            self.oldpin = pin
+            self.last_samplenum = self.samplenum
+        elif self.oldpin != pin:
+            self.handle_edge(pin)
 
-                # Store data for next round.
-                self.last_samplenum = self.samplenum
-                self.oldpin = pin
+        for self.samplenum in data.edges(0):
+            self.handle_edge(1 - self.oldpin)
@@ -73,6 +73,7 @@ SRD_API int srd_inst_option_set(struct srd_decoder_inst *di,
 	gint64 val_int;
 	int ret;
 	const char *val_str;
+	PyGILState_STATE gstate;
 
 	if (!di) {
 		srd_err("Invalid decoder instance.");
@@ -84,8 +85,11 @@ SRD_API int srd_inst_option_set(struct srd_decoder_inst *di,
 		return SRD_ERR_ARG;
 	}
 
+	gstate = PyGILState_Ensure();
+
 	if (!PyObject_HasAttrString(di->decoder->py_dec, "options")) {
 		/* Decoder has no options. */
+		PyGILState_Release(gstate);
 		if (g_hash_table_size(options) == 0) {
 			/* No options provided. */
 			return SRD_OK;
@@ -169,6 +173,8 @@ err_out:
 		ret = SRD_ERR_PYTHON;
 	}
 
+	PyGILState_Release(gstate);
+
 	return ret;
 }
 
@@ -298,16 +304,21 @@ SRD_API struct srd_decoder_inst *srd_inst_new(struct srd_session *sess,
 	struct srd_decoder *dec;
 	struct srd_decoder_inst *di;
 	char *inst_id;
+	PyGILState_STATE gstate;
 
 	srd_dbg("Creating new %s instance.", decoder_id);
 
+	gstate = PyGILState_Ensure();
+
 	if (session_is_valid(sess) != SRD_OK) {
 		srd_err("Invalid session.");
+		PyGILState_Release(gstate);
 		return NULL;
 	}
 
 	if (!(dec = srd_decoder_get_by_id(decoder_id))) {
 		srd_err("Protocol decoder %s not found.", decoder_id);
+		PyGILState_Release(gstate);
 		return NULL;
 	}
 
@@ -315,6 +326,7 @@ SRD_API struct srd_decoder_inst *srd_inst_new(struct srd_session *sess,
 
 	di->decoder = dec;
 	di->sess = sess;
+	di->wait_terms = g_array_new(FALSE, FALSE, sizeof(struct srd_wait_term));
 	if (options) {
 		inst_id = g_hash_table_lookup(options, "id");
 		di->inst_id = g_strdup(inst_id ? inst_id : decoder_id);
@@ -346,19 +358,25 @@ SRD_API struct srd_decoder_inst *srd_inst_new(struct srd_session *sess,
 			srd_exception_catch(NULL, "Failed to create %s instance",
 					decoder_id);
 		g_free(di->dec_channelmap);
+		g_array_free(di->wait_terms, TRUE);
 		g_free(di);
+		PyGILState_Release(gstate);
 		return NULL;
 	}
 
 	if (options && srd_inst_option_set(di, options) != SRD_OK) {
 		g_free(di->dec_channelmap);
+		g_array_free(di->wait_terms, TRUE);
 		g_free(di);
+		PyGILState_Release(gstate);
 		return NULL;
 	}
 
 	/* Instance takes input from a frontend by default. */
 	sess->di_list = g_slist_append(sess->di_list, di);
 
+	PyGILState_Release(gstate);
+
 	return di;
 }
 
@@ -377,14 +395,18 @@ SRD_API int srd_inst_stack(struct srd_session *sess,
 		struct srd_decoder_inst *di_bottom,
 		struct srd_decoder_inst *di_top)
 {
+	PyGILState_STATE gstate;
 
-	if (session_is_valid(sess) != SRD_OK) {
-		srd_err("Invalid session.");
+	if (!di_bottom || !di_top) {
+		srd_err("Invalid from/to instance pair.");
 		return SRD_ERR_ARG;
 	}
 
-	if (!di_bottom || !di_top) {
-		srd_err("Invalid from/to instance pair.");
+	gstate = PyGILState_Ensure();
+
+	if (session_is_valid(sess) != SRD_OK) {
+		srd_err("Invalid session.");
+		PyGILState_Release(gstate);
 		return SRD_ERR_ARG;
 	}
 
@@ -398,6 +420,8 @@ SRD_API int srd_inst_stack(struct srd_session *sess,
 
 	srd_dbg("Stacked %s onto %s.", di_top->inst_id, di_bottom->inst_id);
 
+	PyGILState_Release(gstate);
+
 	return SRD_OK;
 }
 
@@ -419,9 +443,13 @@ SRD_API struct srd_decoder_inst *srd_inst_find_by_id(struct srd_session *sess,
 {
 	GSList *l;
 	struct srd_decoder_inst *tmp, *di;
+	PyGILState_STATE gstate;
+
+	gstate = PyGILState_Ensure();
 
 	if (session_is_valid(sess) != SRD_OK) {
 		srd_err("Invalid session.");
+		PyGILState_Release(gstate);
 		return NULL;
 	}
 
@@ -434,9 +462,81 @@ SRD_API struct srd_decoder_inst *srd_inst_find_by_id(struct srd_session *sess,
 		}
 	}
 
+	PyGILState_Release(gstate);
+
 	return di;
 }
 
+/**
+ * Hand OUTPUT_PYTHON data of an instance to the instances stacked on it.
+ *
+ * This is for frontends which decode the bottom of a stack natively
+ * instead of through the Python decoder of the instance: the stacked
+ * decoders get the data as if the decoder had put() it. Arrays become
+ * lists, tuples become tuples but the outermost one, which becomes a
+ * list like the ones the decoders put, and empty maybes become None.
+ *
+ * @param di The instance the data comes from. Must not be NULL.
+ * @param start_sample The first sample the data covers.
+ * @param end_sample The last sample the data covers.
+ * @param data The data. A floating reference is sunk and released.
+ *
+ * @return SRD_OK upon success, a (negative) error code otherwise.
+ *
+ * @since 0.5.0
+ */
+SRD_API int srd_inst_put_python(struct srd_decoder_inst *di,
+		uint64_t start_sample, uint64_t end_sample, GVariant *data)
+{
+	GSList *l;
+	struct srd_decoder_inst *next_di;
+	PyObject *py_data, *py_list, *py_res;
+	PyGILState_STATE gstate;
+
+	if (!di || !data) {
+		srd_err("Invalid instance or data.");
+		return SRD_ERR_ARG;
+	}
+
+	gstate = PyGILState_Ensure();
+
+	g_variant_ref_sink(data);
+	py_data = py_obj_from_variant(data);
+	g_variant_unref(data);
+	if (!py_data) {
+		PyGILState_Release(gstate);
+		return SRD_ERR_PYTHON;
+	}
+
+	if (PyTuple_Check(py_data)) {
+		py_list = PySequence_List(py_data);
+		Py_DECREF(py_data);
+		if (!(py_data = py_list)) {
+			srd_exception_catch(NULL, "Failed to convert data");
+			PyGILState_Release(gstate);
+			return SRD_ERR_PYTHON;
+		}
+	}
+
+	for (l = di->next_di; l; l = l->next) {
+		next_di = l->data;
+		srd_spew("Sending %" PRIu64 "-%" PRIu64 " to instance %s",
+			 start_sample, end_sample, next_di->inst_id);
+		if (!(py_res = PyObject_CallMethod(
+			next_di->py_inst, "decode", "KKO", start_sample,
+			end_sample, py_data))) {
+			srd_exception_catch(NULL, "Calling %s decode() failed",
+						next_di->inst_id);
+		}
+		Py_XDECREF(py_res);
+	}
+	Py_DECREF(py_data);
+
+	PyGILState_Release(gstate);
+
+	return SRD_OK;
+}
+
 static struct srd_decoder_inst *srd_sess_inst_find_by_obj(
 		struct srd_session *sess, const GSList *stack,
 		const PyObject *obj)
@@ -580,10 +680,13 @@ SRD_PRIV int srd_inst_decode(const struct srd_decoder_inst *di, uint8_t chunk_ty
 	if (chunk_type == 0) {
 		logic->itercnt = 0; // *inbuf is a byte pointer, 8bit align
 		logic->logic_mask = 0;
+		logic->matched = di->wait_matched;
+		g_array_set_size(di->wait_terms, 0);
 	}
 	logic->inbuf = (uint8_t **)inbuf;
 	logic->inbuf_const = inbuf_const;
 	logic->samplenum = end_samplenum - start_samplenum + 1;
+	logic->batched = FALSE;
 	Py_INCREF(logic);
 
 	//Py_IncRef(di->py_inst);
@@ -595,7 +698,11 @@ SRD_PRIV int srd_inst_decode(const struct srd_decoder_inst *di, uint8_t chunk_ty
 	}
 	Py_DecRef(py_res);
 
-	if (logic->logic_mask == 0) {
+	/* A batched decoder has consumed the whole chunk. */
+	if (logic->batched)
+		logic->itercnt = logic->samplenum;
+
+	if (logic->logic_mask == 0 && di->wait_terms->len == 0) {
 		logic->itercnt -= logic->samplenum;
 	}
 
@@ -622,6 +729,7 @@ SRD_PRIV void srd_inst_free(struct srd_decoder_inst *di)
 	g_free(di->inst_id);
 	g_free(di->dec_channelmap);
 	g_free(di->channel_samples);
+	g_array_free(di->wait_terms, TRUE);
 	g_slist_free(di->next_di);
 	for (l = di->pd_output; l; l = l->next) {
 		pdo = l->data;
@@ -46,6 +46,11 @@ typedef struct {
 	int edge_index;
 	uint64_t logic_mask;
 	uint64_t cur_pos;
+	/* Terms of wait() which matched, and the sample last iterated. */
+	uint64_t matched;
+	uint64_t last_samplenum;
+	/* Chunk was read through samples() / edges() instead of iterating. */
+	gboolean batched;
 } srd_logic;
 
 /* srd.c */
@@ -104,6 +109,7 @@ SRD_PRIV int py_dictitem_to_int(PyObject *py_obj, const char *key);
 SRD_PRIV int py_str_as_str(PyObject *py_str, char **outstr);
 SRD_PRIV int py_strseq_to_char(PyObject *py_strseq, char ***out_strv);
 SRD_PRIV GVariant *py_obj_to_variant(PyObject *py_obj);
+SRD_PRIV PyObject *py_obj_from_variant(GVariant *var);
 
 /* exception.c */
 #if defined(G_OS_WIN32) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 4))
@@ -240,6 +240,23 @@ struct srd_decoder_annotation_row {
 	GSList *ann_classes;
 };
 
+/**
+ * One term of the conditions passed to logic.wait(), a bit per decoder
+ * channel. All of a term have to hold at a sample for it to match, and
+ * the wait is over at the first sample at which any of the terms does.
+ */
+struct srd_wait_term {
+	uint64_t high;
+	uint64_t low;
+	uint64_t rise;
+	uint64_t fall;
+	uint64_t edge;
+	/* No edge since the sample before. */
+	uint64_t stable;
+	/* Only the sample this many after the wait began, 0 for any. */
+	uint64_t skip;
+};
+
 struct srd_decoder_inst {
 	struct srd_decoder *decoder;
 	struct srd_session *sess;
@@ -255,6 +272,10 @@ struct srd_decoder_inst {
 	uint64_t logic_mask;
 	uint64_t exp_logic;
 	int edge_index;
+	/* Terms of a logic.wait() after cur_pos, of struct srd_wait_term. */
+	GArray *wait_terms;
+	/* Bit mask of the terms which matched, set by the frontend. */
+	uint64_t wait_matched;
 };
 
 struct srd_pd_output {
@@ -315,6 +336,7 @@ SRD_API const GSList *srd_decoder_list(void);
 SRD_API struct srd_decoder *srd_decoder_get_by_id(const char *id);
 SRD_API int srd_decoder_load(const char *name);
 SRD_API char *srd_decoder_doc_get(const struct srd_decoder *dec);
+SRD_API char *srd_decoder_path_get(const struct srd_decoder *dec);
 SRD_API int srd_decoder_unload(struct srd_decoder *dec);
 SRD_API int srd_decoder_load_all(void);
 SRD_API int srd_decoder_unload_all(void);
@@ -330,6 +352,8 @@ SRD_API int srd_inst_stack(struct srd_session *sess,
 		struct srd_decoder_inst *di_from, struct srd_decoder_inst *di_to);
 SRD_API struct srd_decoder_inst *srd_inst_find_by_id(struct srd_session *sess,
 		const char *inst_id);
+SRD_API int srd_inst_put_python(struct srd_decoder_inst *di,
+		uint64_t start_sample, uint64_t end_sample, GVariant *data);
 
 /* log.c */
 typedef int (*srd_log_callback)(void *cb_data, int loglevel,
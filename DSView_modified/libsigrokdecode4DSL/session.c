@@ -71,12 +71,16 @@ SRD_PRIV int session_is_valid(struct srd_session *sess)
  */
 SRD_API int srd_session_new(struct srd_session **sess)
 {
+	PyGILState_STATE gstate;
 
 	if (!sess) {
 		srd_err("Invalid session pointer.");
 		return SRD_ERR_ARG;
 	}
 
+	/* The list of sessions is shared with Python callbacks, see the GIL. */
+	gstate = PyGILState_Ensure();
+
 	*sess = g_malloc(sizeof(struct srd_session));
 	(*sess)->session_id = ++max_session_id;
 	(*sess)->di_list = (*sess)->callbacks = NULL;
@@ -84,6 +88,8 @@ SRD_API int srd_session_new(struct srd_session **sess)
 	/* Keep a list of all sessions, so we can clean up as needed. */
 	sessions = g_slist_append(sessions, *sess);
 
+	PyGILState_Release(gstate);
+
 	srd_dbg("Created session %d.", (*sess)->session_id);
 
 	return SRD_OK;
@@ -106,9 +112,13 @@ SRD_API int srd_session_start(struct srd_session *sess, char **error)
 	GSList *d;
 	struct srd_decoder_inst *di;
 	int ret;
+	PyGILState_STATE gstate;
+
+	gstate = PyGILState_Ensure();
 
 	if (session_is_valid(sess) != SRD_OK) {
 		srd_err("Invalid session pointer.");
+		PyGILState_Release(gstate);
 		return SRD_ERR;
 	}
 
@@ -122,6 +132,8 @@ SRD_API int srd_session_start(struct srd_session *sess, char **error)
 			break;
 	}
 
+	PyGILState_Release(gstate);
+
 	return ret;
 }
 
@@ -172,11 +184,7 @@ SRD_API int srd_session_metadata_set(struct srd_session *sess, int key,
 {
 	GSList *l;
 	int ret;
-
-	if (session_is_valid(sess) != SRD_OK) {
-		srd_err("Invalid session.");
-		return SRD_ERR_ARG;
-	}
+	PyGILState_STATE gstate;
 
 	if (!key) {
 		srd_err("Invalid key.");
@@ -200,6 +208,14 @@ SRD_API int srd_session_metadata_set(struct srd_session *sess, int key,
 		return SRD_ERR_ARG;
 	}
 
+	gstate = PyGILState_Ensure();
+
+	if (session_is_valid(sess) != SRD_OK) {
+		srd_err("Invalid session.");
+		PyGILState_Release(gstate);
+		return SRD_ERR_ARG;
+	}
+
 	srd_dbg("Setting session %d samplerate to %"PRIu64".",
 			sess->session_id, g_variant_get_uint64(data));
 
@@ -209,6 +225,8 @@ SRD_API int srd_session_metadata_set(struct srd_session *sess, int key,
 			break;
 	}
 
+	PyGILState_Release(gstate);
+
 	g_variant_unref(data);
 
 	return ret;
@@ -237,19 +255,26 @@ SRD_API int srd_session_send(struct srd_session *sess, uint8_t chunk_type,
 {
 	GSList *d;
 	int ret;
+	PyGILState_STATE gstate;
+
+	gstate = PyGILState_Ensure();
 
 	if (session_is_valid(sess) != SRD_OK) {
 		srd_err("Invalid session.");
+		PyGILState_Release(gstate);
 		return SRD_ERR_ARG;
 	}
 
+	ret = SRD_OK;
 	for (d = sess->di_list; d; d = d->next) {
 		if ((ret = srd_inst_decode(d->data, chunk_type, start_samplenum,
 				end_samplenum, inbuf, inbuf_const, error)) != SRD_OK)
-			return ret;
+			break;
 	}
 
-	return SRD_OK;
+	PyGILState_Release(gstate);
+
+	return ret;
 }
 
 /**
@@ -266,12 +291,15 @@ SRD_API int srd_session_send(struct srd_session *sess, uint8_t chunk_type,
 SRD_API int srd_session_destroy(struct srd_session *sess)
 {
 	int session_id;
+	PyGILState_STATE gstate;
 
 	if (!sess) {
 		srd_err("Invalid session.");
 		return SRD_ERR_ARG;
 	}
 
+	gstate = PyGILState_Ensure();
+
 	session_id = sess->session_id;
 	if (sess->di_list)
 		srd_inst_free_all(sess, NULL);
@@ -280,6 +308,8 @@ SRD_API int srd_session_destroy(struct srd_session *sess)
 	sessions = g_slist_remove(sessions, sess);
 	g_free(sess);
 
+	PyGILState_Release(gstate);
+
 	srd_dbg("Destroyed session %d.", session_id);
 
 	return SRD_OK;
@@ -304,9 +334,13 @@ SRD_API int srd_pd_output_callback_add(struct srd_session *sess,
 		int output_type, srd_pd_output_callback cb, void *cb_data)
 {
 	struct srd_pd_callback *pd_cb;
+	PyGILState_STATE gstate;
+
+	gstate = PyGILState_Ensure();
 
 	if (session_is_valid(sess) != SRD_OK) {
 		srd_err("Invalid session.");
+		PyGILState_Release(gstate);
 		return SRD_ERR_ARG;
 	}
 
@@ -318,6 +352,8 @@ SRD_API int srd_pd_output_callback_add(struct srd_session *sess,
 	pd_cb->cb_data = cb_data;
 	sess->callbacks = g_slist_append(sess->callbacks, pd_cb);
 
+	PyGILState_Release(gstate);
+
 	return SRD_OK;
 }
 
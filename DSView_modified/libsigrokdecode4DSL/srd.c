@@ -129,6 +129,10 @@ static int searchpath_add_xdg_dir(const char *datadir)
  * Multiple calls to srd_init(), without calling srd_exit() in between,
  * are not allowed.
  *
+ * The Python GIL is released before returning. Sessions may then be run
+ * on any threads, one thread per session at a time; every call takes the
+ * GIL for as long as it runs Python code.
+ *
  * @param path Path to an extra directory containing protocol decoders
  *             which will be added to the Python sys.path. May be NULL.
  *
@@ -200,6 +204,13 @@ SRD_API int srd_init(const char *path)
 
 	max_session_id = 0;
 
+#if PY_VERSION_HEX < 0x03070000
+	/* Create the GIL, later Python versions do it on initialization. */
+	PyEval_InitThreads();
+#endif
+	/* Release the GIL, the thread state is found again by srd_exit(). */
+	(void)PyEval_SaveThread();
+
 	return SRD_OK;
 }
 
@@ -221,6 +232,9 @@ SRD_API int srd_exit(void)
 {
 	srd_dbg("Exiting libsigrokdecode.");
 
+	/* Take the GIL back for good, Py_Finalize() keeps it. */
+	(void)PyGILState_Ensure();
+
 	g_slist_foreach(sessions, (GFunc)srd_session_destroy, NULL);
 
 	srd_decoder_unload_all();
@@ -0,0 +1,419 @@
+/*
+ * This file is part of the libsigrokdecode project.
+ *
+ * Copyright (C) 2016 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+/*
+ * Decoder throughput benchmark.
+ *
+ * Each case generates a synthetic capture of one bus and decodes it the
+ * way DSView does: chunks of at most MAX_CHUNK samples are passed to
+ * srd_session_send(), and after each of them the skip hints or the
+ * wait() conditions of the decoder are followed to the sample the next
+ * chunk starts with. The samples and annotations per second of every
+ * case are reported.
+ *
+ * bench [-n samples] [-w width] [-d density] [-s seed] [case...]
+ *
+ * The cases are picked by their bus or decoder id, all by default.
+ */
+
+#include <config.h>
+#include <libsigrokdecode-internal.h> /* First, to avoid compiler warning. */
+#include <libsigrokdecode.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+
+/* As DecoderStack::MaxChunkSize in DSView. */
+#define MAX_CHUNK (1024 * 16)
+#define SAMPLERATE 100000000
+
+struct bench_case {
+	const char *bus;
+	const char *decoder;
+	gboolean set_baudrate;
+	bench_gen gen;
+	int num_channels;
+	/* Decoder channel of each channel of the capture. */
+	const char *channels[4];
+};
+
+static const struct bench_case cases[] = {
+	{"spi", "0:spi", FALSE, bench_gen_spi, 4, {"clk", "miso", "mosi", "cs"}},
+	{"spi", "1:spi", FALSE, bench_gen_spi, 4, {"clk", "miso", "mosi", "cs"}},
+	{"uart", "0:uart", TRUE, bench_gen_uart, 1, {"rxtx"}},
+	{"uart", "1:uart", TRUE, bench_gen_uart, 1, {"rxtx"}},
+	{"i2c", "0:i2c", FALSE, bench_gen_i2c, 2, {"scl", "sda"}},
+	{"i2c", "1:i2c", FALSE, bench_gen_i2c, 2, {"scl", "sda"}},
+	{"jtag", "jtag", FALSE, bench_gen_jtag, 4, {"tdi", "tdo", "tck", "tms"}},
+	{"swd", "swd", FALSE, bench_gen_swd, 2, {"swclk", "swdio"}},
+};
+
+static void ann_callback(struct srd_proto_data *pdata, void *cb_data)
+{
+	(void)pdata;
+	(*(uint64_t *)cb_data)++;
+}
+
+/* Next sample from index on, not after end, at which ch is not last. */
+static gboolean next_edge(const struct bench_capture *cap, int ch, int last,
+			  uint64_t *index, uint64_t end)
+{
+	const uint8_t same = last ? 0xff : 0x00;
+	uint64_t i;
+
+	for (i = *index; i <= end; i++) {
+		/* Constant bytes at a time. */
+		while ((i % 8) == 0 && i + 7 <= end && cap->buf[ch][i / 8] == same)
+			i += 8;
+		if (i > end)
+			break;
+		if (bench_sample(cap, ch, i) != last) {
+			*index = i;
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+static gboolean term_holds(const struct bench_capture *cap,
+			   const struct srd_wait_term *term,
+			   const int *channelmap, int num_channels,
+			   uint64_t pos, uint64_t index)
+{
+	uint64_t bit;
+	int ch, sample, last;
+
+	if (term->skip && index != pos + term->skip)
+		return FALSE;
+
+	for (ch = 0; ch < num_channels; ch++) {
+		if (channelmap[ch] == -1)
+			continue;
+		bit = 1ULL << ch;
+		sample = bench_sample(cap, channelmap[ch], index);
+		last = bench_sample(cap, channelmap[ch], index - 1);
+		if (((term->high & bit) && !sample) ||
+		    ((term->low & bit) && sample) ||
+		    ((term->rise & bit) && (last || !sample)) ||
+		    ((term->fall & bit) && (!last || sample)) ||
+		    ((term->edge & bit) && last == sample) ||
+		    ((term->stable & bit) && last != sample))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+/* First sample after pos and not after end at which term holds. */
+static gboolean term_match(const struct bench_capture *cap,
+			   const struct srd_wait_term *term,
+			   const int *channelmap, int num_channels,
+			   uint64_t pos, uint64_t end, uint64_t *index)
+{
+	uint64_t edges, levels, bit;
+	int ch, last;
+
+	if (term->skip) {
+		*index = pos + term->skip;
+		return *index <= end && term_holds(cap, term, channelmap,
+						   num_channels, pos, *index);
+	}
+
+	*index = pos + 1;
+	edges = term->rise | term->fall | term->edge;
+	for (ch = 0; ch < num_channels; ch++) {
+		if ((edges & (1ULL << ch)) && channelmap[ch] != -1)
+			break;
+	}
+	if (ch < num_channels) {
+		/* Only the edges of that channel can match. */
+		last = bench_sample(cap, channelmap[ch], pos);
+		while (next_edge(cap, channelmap[ch], last, index, end)) {
+			if (term_holds(cap, term, channelmap, num_channels,
+				       pos, *index))
+				return TRUE;
+			last = !last;
+			(*index)++;
+		}
+		return FALSE;
+	}
+
+	/* Levels: on to the next edge of a channel not at its level. */
+	levels = term->high | term->low;
+	while (*index <= end) {
+		if (term_holds(cap, term, channelmap, num_channels, pos, *index))
+			return TRUE;
+		for (ch = 0; ch < num_channels; ch++) {
+			bit = 1ULL << ch;
+			if (!(levels & bit) || channelmap[ch] == -1)
+				continue;
+			if (bench_sample(cap, channelmap[ch], *index) !=
+			    !!(term->high & bit))
+				break;
+		}
+		if (ch == num_channels) {
+			/* A channel which was to be stable was not. */
+			(*index)++;
+		} else if (!next_edge(cap, channelmap[ch], !(term->high & bit),
+				      index, end)) {
+			return FALSE;
+		}
+	}
+
+	return FALSE;
+}
+
+/*
+ * Find the sample the decoder waits for, see WaitCondition in DSView.
+ * The skip hints are turned into wait() terms.
+ */
+static gboolean wait_match(const struct bench_capture *cap,
+			   const struct srd_decoder_inst *di,
+			   uint64_t pos, uint64_t end, uint64_t *match,
+			   uint64_t *matched)
+{
+	struct srd_wait_term hints[64], *terms;
+	uint64_t limit, index;
+	int num_terms, t, ch;
+
+	if (di->wait_terms->len != 0) {
+		terms = (struct srd_wait_term *)di->wait_terms->data;
+		num_terms = di->wait_terms->len;
+	} else {
+		memset(hints, 0, sizeof(hints));
+		terms = hints;
+		num_terms = 0;
+		for (ch = 0; ch < di->dec_num_channels; ch++) {
+			if (di->edge_index != -1 &&
+			    di->dec_channelmap[ch] == di->edge_index)
+				hints[0].edge |= 1ULL << ch;
+			if (!(di->logic_mask & (1ULL << ch)))
+				continue;
+			if (di->edge_index == -1)
+				hints[num_terms++].edge = 1ULL << ch;
+			else if (di->exp_logic & (1ULL << ch))
+				hints[0].high |= 1ULL << ch;
+			else
+				hints[0].low |= 1ULL << ch;
+		}
+		if (di->edge_index != -1)
+			num_terms = 1;
+	}
+
+	limit = end;
+	*matched = 0;
+	for (t = 0; t < num_terms; t++) {
+		if (term_match(cap, &terms[t], di->dec_channelmap,
+			       di->dec_num_channels, pos, limit, &index)) {
+			*match = limit = index;
+			*matched = 1;
+		}
+	}
+	if (!*matched)
+		return FALSE;
+
+	*matched = 0;
+	for (t = 0; t < num_terms && t < 64; t++) {
+		if (term_holds(cap, &terms[t], di->dec_channelmap,
+			       di->dec_num_channels, pos, *match))
+			*matched |= 1ULL << t;
+	}
+
+	return TRUE;
+}
+
+/* Feed the whole capture to the session, as DecoderStack::decode_range. */
+static int decode(struct srd_session *sess, struct srd_decoder_inst *di,
+		  const struct bench_capture *cap)
+{
+	const uint8_t *inbuf[64];
+	uint8_t inbuf_const[64];
+	uint64_t i, chunk_end, decode_end, cur_pos, matched;
+	uint8_t chunk_type;
+	char *error;
+	int ch, ret;
+
+	decode_end = cap->num_samples - 1;
+	chunk_type = 0;
+	error = NULL;
+	i = 0;
+	while (i < decode_end) {
+		chunk_end = MIN(i + MAX_CHUNK, decode_end);
+		for (ch = 0; ch < di->dec_num_channels; ch++) {
+			if (di->dec_channelmap[ch] == -1) {
+				inbuf[ch] = NULL;
+				inbuf_const[ch] = 0;
+			} else {
+				inbuf[ch] = cap->buf[di->dec_channelmap[ch]] + i / 8;
+				inbuf_const[ch] = bench_sample(cap, di->dec_channelmap[ch], i);
+			}
+		}
+		if ((ret = srd_session_send(sess, chunk_type, i, chunk_end,
+					    inbuf, inbuf_const, &error)) != SRD_OK) {
+			fprintf(stderr, "%s\n", error ? error : srd_strerror(ret));
+			g_free(error);
+			return ret;
+		}
+
+		cur_pos = di->cur_pos;
+		if ((di->logic_mask != 0 || di->wait_terms->len != 0) &&
+		    cur_pos < decode_end) {
+			if (!wait_match(cap, di, cur_pos, decode_end, &cur_pos, &matched))
+				cur_pos = decode_end;
+			di->wait_matched = matched;
+			i = cur_pos;
+			chunk_type = 0;
+		} else {
+			i = chunk_end + 1;
+			chunk_type = 1;
+		}
+	}
+
+	return SRD_OK;
+}
+
+static int run_case(const struct bench_case *c, const struct bench_params *params)
+{
+	struct srd_session *sess;
+	struct srd_decoder_inst *di;
+	struct bench_capture *cap;
+	GHashTable *options, *channels;
+	uint64_t annotations;
+	gint64 gen_start, start, end;
+	double secs;
+	char *error;
+	int ch, ret;
+
+	gen_start = g_get_monotonic_time();
+	cap = bench_capture_new(c->num_channels, params);
+	c->gen(cap, params);
+
+	srd_session_new(&sess);
+	options = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+					(GDestroyNotify)g_variant_unref);
+	if (c->set_baudrate)
+		g_hash_table_insert(options, g_strdup("baudrate"), g_variant_ref_sink(
+			g_variant_new_int64(SAMPLERATE / params->width)));
+	di = srd_inst_new(sess, c->decoder, options);
+	g_hash_table_destroy(options);
+	if (!di) {
+		fprintf(stderr, "%s: no such decoder\n", c->decoder);
+		srd_session_destroy(sess);
+		bench_capture_free(cap);
+		return SRD_ERR_ARG;
+	}
+
+	channels = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+					 (GDestroyNotify)g_variant_unref);
+	for (ch = 0; ch < c->num_channels; ch++)
+		g_hash_table_insert(channels, g_strdup(c->channels[ch]),
+				    g_variant_ref_sink(g_variant_new_int32(ch)));
+	srd_inst_channel_set_all(di, channels);
+	g_hash_table_destroy(channels);
+
+	srd_session_metadata_set(sess, SRD_CONF_SAMPLERATE,
+				 g_variant_new_uint64(SAMPLERATE));
+	annotations = 0;
+	srd_pd_output_callback_add(sess, SRD_OUTPUT_ANN, ann_callback, &annotations);
+
+	error = NULL;
+	if ((ret = srd_session_start(sess, &error)) != SRD_OK) {
+		fprintf(stderr, "%s: %s\n", c->decoder, error ? error : srd_strerror(ret));
+		g_free(error);
+	} else {
+		start = g_get_monotonic_time();
+		ret = decode(sess, di, cap);
+		end = g_get_monotonic_time();
+		secs = MAX(end - start, 1) / 1e6;
+		printf("%-6s %-8s %12" PRIu64 " %8.2f %8.3f %12.0f %12.0f\n",
+		       c->bus, c->decoder, cap->num_samples,
+		       (start - gen_start) / 1e6, secs,
+		       cap->num_samples / secs, annotations / secs);
+	}
+
+	srd_session_destroy(sess);
+	bench_capture_free(cap);
+
+	return ret;
+}
+
+static void usage(const char *argv0)
+{
+	fprintf(stderr, "usage: %s [-n samples] [-w width] [-d density] "
+		"[-s seed] [case...]\n", argv0);
+	exit(EXIT_FAILURE);
+}
+
+int main(int argc, char **argv)
+{
+	struct bench_params params;
+	unsigned int i;
+	int arg, c, picked, ret;
+
+	params.num_samples = 10 * 1000 * 1000;
+	params.width = 10;
+	params.density = 0.5;
+	params.seed = 1;
+
+	for (arg = 1; arg < argc && argv[arg][0] == '-'; arg++) {
+		if (arg + 1 >= argc)
+			usage(argv[0]);
+		if (!strcmp(argv[arg], "-n"))
+			params.num_samples = g_ascii_strtoull(argv[++arg], NULL, 10);
+		else if (!strcmp(argv[arg], "-w"))
+			params.width = strtoul(argv[++arg], NULL, 10);
+		else if (!strcmp(argv[arg], "-d"))
+			params.density = g_ascii_strtod(argv[++arg], NULL);
+		else if (!strcmp(argv[arg], "-s"))
+			params.seed = strtoul(argv[++arg], NULL, 10);
+		else
+			usage(argv[0]);
+	}
+	if (params.num_samples < 2 || params.width < 1 ||
+	    params.density <= 0 || params.density > 1)
+		usage(argv[0]);
+
+	if (srd_init(DECODERS_TESTDIR) != SRD_OK)
+		return EXIT_FAILURE;
+	srd_log_loglevel_set(SRD_LOG_ERR);
+	srd_decoder_load_all();
+
+	printf("%-6s %-8s %12s %8s %8s %12s %12s\n", "bus", "decoder",
+	       "samples", "gen s", "decode s", "samples/s", "annots/s");
+	ret = EXIT_SUCCESS;
+	for (i = 0; i < G_N_ELEMENTS(cases); i++) {
+		picked = (arg == argc);
+		for (c = arg; c < argc; c++) {
+			if (!strcmp(argv[c], cases[i].bus) ||
+			    !strcmp(argv[c], cases[i].decoder))
+				picked = 1;
+		}
+		if (picked && run_case(&cases[i], &params) != SRD_OK)
+			ret = EXIT_FAILURE;
+	}
+
+	srd_exit();
+
+	return ret;
+}
@@ -0,0 +1,67 @@
+/*
+ * This file is part of the libsigrokdecode project.
+ *
+ * Copyright (C) 2016 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef LIBSIGROKDECODE_TESTS_BENCH_H
+#define LIBSIGROKDECODE_TESTS_BENCH_H
+
+#include <stdint.h>
+#include <glib.h>
+
+/* A synthetic capture, one bit-packed buffer per channel. */
+struct bench_capture {
+	int num_channels;
+	uint64_t num_samples;
+	uint8_t **buf;
+	/* Where the generator writes, and the levels it writes. */
+	uint64_t pos;
+	uint8_t *level;
+	GRand *rand;
+};
+
+struct bench_params {
+	uint64_t num_samples;
+	/* Samples per bit, or per half clock period. */
+	unsigned int width;
+	/* Share of the capture during which the bus is busy, 0 to 1. */
+	double density;
+	guint32 seed;
+};
+
+typedef void (*bench_gen)(struct bench_capture *cap,
+			  const struct bench_params *params);
+
+struct bench_capture *bench_capture_new(int num_channels,
+					const struct bench_params *params);
+void bench_capture_free(struct bench_capture *cap);
+
+static inline int bench_sample(const struct bench_capture *cap, int ch,
+			       uint64_t index)
+{
+	return (cap->buf[ch][index / 8] >> (index % 8)) & 1;
+}
+
+/* Channels in the order of the decoder channels, see bench.c. */
+void bench_gen_spi(struct bench_capture *cap, const struct bench_params *params);
+void bench_gen_uart(struct bench_capture *cap, const struct bench_params *params);
+void bench_gen_i2c(struct bench_capture *cap, const struct bench_params *params);
+void bench_gen_jtag(struct bench_capture *cap, const struct bench_params *params);
+void bench_gen_swd(struct bench_capture *cap, const struct bench_params *params);
+
+#endif
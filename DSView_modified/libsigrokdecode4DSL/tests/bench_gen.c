@@ -0,0 +1,331 @@
+/*
+ * This file is part of the libsigrokdecode project.
+ *
+ * Copyright (C) 2016 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <string.h>
+#include "bench.h"
+
+/*
+ * The generators write frames of random data one after another, with
+ * idle gaps in between so that the bus is busy for about the requested
+ * share of the capture, until the capture is full.
+ */
+
+struct bench_capture *bench_capture_new(int num_channels,
+					const struct bench_params *params)
+{
+	struct bench_capture *cap;
+	int ch;
+
+	cap = g_malloc0(sizeof(struct bench_capture));
+	cap->num_channels = num_channels;
+	cap->num_samples = params->num_samples;
+	cap->buf = g_malloc0(sizeof(uint8_t *) * num_channels);
+	for (ch = 0; ch < num_channels; ch++)
+		cap->buf[ch] = g_malloc0((params->num_samples + 7) / 8 + 1);
+	cap->level = g_malloc0(num_channels);
+	cap->rand = g_rand_new_with_seed(params->seed);
+
+	return cap;
+}
+
+void bench_capture_free(struct bench_capture *cap)
+{
+	int ch;
+
+	for (ch = 0; ch < cap->num_channels; ch++)
+		g_free(cap->buf[ch]);
+	g_free(cap->buf);
+	g_free(cap->level);
+	g_rand_free(cap->rand);
+	g_free(cap);
+}
+
+/* Write count samples of the current levels. */
+static void hold(struct bench_capture *cap, uint64_t count)
+{
+	uint64_t start, end, i;
+	uint8_t *buf;
+	int ch;
+
+	start = cap->pos;
+	end = MIN(cap->pos + count, cap->num_samples);
+	cap->pos = end;
+
+	/* The buffers start out zeroed, only ones are written. */
+	for (ch = 0; ch < cap->num_channels; ch++) {
+		if (!cap->level[ch])
+			continue;
+		buf = cap->buf[ch];
+		for (i = start; i < end && (i % 8) != 0; i++)
+			buf[i / 8] |= 1 << (i % 8);
+		if (end - i >= 8) {
+			memset(buf + i / 8, 0xff, (end - i) / 8);
+			i += (end - i) & ~7ULL;
+		}
+		for (; i < end; i++)
+			buf[i / 8] |= 1 << (i % 8);
+	}
+}
+
+static gboolean full(const struct bench_capture *cap)
+{
+	return cap->pos >= cap->num_samples;
+}
+
+/* Idle after a frame which started at start, keeping to the density. */
+static void gap(struct bench_capture *cap, const struct bench_params *params,
+		uint64_t start)
+{
+	double busy, idle;
+
+	busy = cap->pos - start;
+	idle = busy * (1 - params->density) / params->density;
+	idle *= g_rand_double_range(cap->rand, 0.5, 1.5);
+	hold(cap, (uint64_t)idle + 1);
+}
+
+static uint32_t rand_bits(struct bench_capture *cap, int bits)
+{
+	return g_rand_int(cap->rand) & (uint32_t)((1ULL << bits) - 1);
+}
+
+enum { SPI_CLK, SPI_MISO, SPI_MOSI, SPI_CS };
+
+/* Mode 0, MSB first, 8 bit words, CS# active low. */
+void bench_gen_spi(struct bench_capture *cap, const struct bench_params *params)
+{
+	uint64_t start;
+	uint32_t mosi, miso;
+	int words, bit;
+
+	cap->level[SPI_CS] = 1;
+	hold(cap, params->width);
+	while (!full(cap)) {
+		start = cap->pos;
+		cap->level[SPI_CS] = 0;
+		hold(cap, params->width);
+		for (words = g_rand_int_range(cap->rand, 1, 9); words > 0; words--) {
+			mosi = rand_bits(cap, 8);
+			miso = rand_bits(cap, 8);
+			for (bit = 7; bit >= 0; bit--) {
+				cap->level[SPI_MOSI] = (mosi >> bit) & 1;
+				cap->level[SPI_MISO] = (miso >> bit) & 1;
+				hold(cap, params->width);
+				cap->level[SPI_CLK] = 1;
+				hold(cap, params->width);
+				cap->level[SPI_CLK] = 0;
+			}
+		}
+		hold(cap, params->width);
+		cap->level[SPI_CS] = 1;
+		gap(cap, params, start);
+	}
+}
+
+/* 8N1, LSB first, a bit of width samples. */
+void bench_gen_uart(struct bench_capture *cap, const struct bench_params *params)
+{
+	uint64_t start;
+	uint32_t data;
+	int chars, bit;
+
+	cap->level[0] = 1;
+	hold(cap, params->width);
+	while (!full(cap)) {
+		start = cap->pos;
+		for (chars = g_rand_int_range(cap->rand, 1, 17); chars > 0; chars--) {
+			data = rand_bits(cap, 8);
+			cap->level[0] = 0;
+			hold(cap, params->width);
+			for (bit = 0; bit < 8; bit++) {
+				cap->level[0] = (data >> bit) & 1;
+				hold(cap, params->width);
+			}
+			cap->level[0] = 1;
+			hold(cap, params->width);
+		}
+		gap(cap, params, start);
+	}
+}
+
+enum { I2C_SCL, I2C_SDA };
+
+/* Clock low with the data bit set up, then high. */
+static void i2c_bit(struct bench_capture *cap, const struct bench_params *params,
+		    int bit)
+{
+	cap->level[I2C_SCL] = 0;
+	cap->level[I2C_SDA] = bit;
+	hold(cap, params->width);
+	cap->level[I2C_SCL] = 1;
+	hold(cap, params->width);
+}
+
+/* A write of an address and up to 8 data bytes, each acked. */
+void bench_gen_i2c(struct bench_capture *cap, const struct bench_params *params)
+{
+	uint64_t start;
+	uint32_t data;
+	int bytes, bit;
+
+	cap->level[I2C_SCL] = 1;
+	cap->level[I2C_SDA] = 1;
+	hold(cap, params->width);
+	while (!full(cap)) {
+		start = cap->pos;
+		cap->level[I2C_SDA] = 0;
+		hold(cap, params->width);
+		bytes = g_rand_int_range(cap->rand, 1, 9);
+		/* The address with the write bit first. */
+		data = rand_bits(cap, 7) << 1;
+		for (; bytes >= 0; bytes--) {
+			for (bit = 7; bit >= 0; bit--)
+				i2c_bit(cap, params, (data >> bit) & 1);
+			i2c_bit(cap, params, 0);
+			data = rand_bits(cap, 8);
+		}
+		cap->level[I2C_SCL] = 0;
+		cap->level[I2C_SDA] = 0;
+		hold(cap, params->width);
+		cap->level[I2C_SCL] = 1;
+		hold(cap, params->width);
+		cap->level[I2C_SDA] = 1;
+		gap(cap, params, start);
+	}
+}
+
+enum { JTAG_TDI, JTAG_TDO, JTAG_TCK, JTAG_TMS };
+
+/* A TCK cycle, TMS and TDI set up while it is low. */
+static void jtag_cycle(struct bench_capture *cap,
+		       const struct bench_params *params, int tms, int tdi, int tdo)
+{
+	cap->level[JTAG_TCK] = 0;
+	cap->level[JTAG_TMS] = tms;
+	cap->level[JTAG_TDI] = tdi;
+	cap->level[JTAG_TDO] = tdo;
+	hold(cap, params->width);
+	cap->level[JTAG_TCK] = 1;
+	hold(cap, params->width);
+}
+
+/* Scans of a 4 bit IR and a 32 bit DR in turn, from and to Run-Test/Idle. */
+void bench_gen_jtag(struct bench_capture *cap, const struct bench_params *params)
+{
+	uint64_t start;
+	uint32_t tdi, tdo;
+	int ir, len, i;
+
+	/* Test-Logic-Reset, then Run-Test/Idle. */
+	for (i = 0; i < 5; i++)
+		jtag_cycle(cap, params, 1, 0, 0);
+	jtag_cycle(cap, params, 0, 0, 0);
+
+	ir = 1;
+	while (!full(cap)) {
+		start = cap->pos;
+		len = ir ? 4 : 32;
+		/* Select-DR-Scan, Select-IR-Scan, Capture, Shift. */
+		jtag_cycle(cap, params, 1, 0, 0);
+		if (ir)
+			jtag_cycle(cap, params, 1, 0, 0);
+		jtag_cycle(cap, params, 0, 0, 0);
+		jtag_cycle(cap, params, 0, 0, 0);
+		tdi = rand_bits(cap, len);
+		tdo = rand_bits(cap, len);
+		/* Leave for Exit1 with the last bit. */
+		for (i = 0; i < len; i++)
+			jtag_cycle(cap, params, i == len - 1, (tdi >> i) & 1,
+				   (tdo >> i) & 1);
+		/* Update, Run-Test/Idle. */
+		jtag_cycle(cap, params, 1, 0, 0);
+		jtag_cycle(cap, params, 0, 0, 0);
+		cap->level[JTAG_TCK] = 0;
+		ir = !ir;
+		gap(cap, params, start);
+	}
+}
+
+enum { SWD_CLK, SWD_DIO };
+
+/* SWDIO set up while SWCLK is low, sampled on the rising edge. */
+static void swd_cycle(struct bench_capture *cap,
+		      const struct bench_params *params, int dio)
+{
+	cap->level[SWD_CLK] = 0;
+	cap->level[SWD_DIO] = dio;
+	hold(cap, params->width);
+	cap->level[SWD_CLK] = 1;
+	hold(cap, params->width);
+}
+
+static int parity(uint32_t value)
+{
+	value ^= value >> 16;
+	value ^= value >> 8;
+	value ^= value >> 4;
+	value ^= value >> 2;
+	value ^= value >> 1;
+	return value & 1;
+}
+
+/* A line reset, then OK acked reads and writes of the AP registers. */
+void bench_gen_swd(struct bench_capture *cap, const struct bench_params *params)
+{
+	uint64_t start;
+	uint32_t req, data;
+	int rnw, i;
+
+	for (i = 0; i < 56; i++)
+		swd_cycle(cap, params, 1);
+	for (i = 0; i < 2; i++)
+		swd_cycle(cap, params, 0);
+
+	while (!full(cap)) {
+		start = cap->pos;
+		rnw = g_rand_boolean(cap->rand);
+		/* APnDP, RnW and A[3:2], LSB first. */
+		req = 1 | (rnw << 1) | (rand_bits(cap, 2) << 2);
+		swd_cycle(cap, params, 1);
+		for (i = 0; i < 4; i++)
+			swd_cycle(cap, params, (req >> i) & 1);
+		swd_cycle(cap, params, parity(req));
+		swd_cycle(cap, params, 0);
+		swd_cycle(cap, params, 1);
+		/* Turnaround, ACK OK. */
+		swd_cycle(cap, params, 1);
+		swd_cycle(cap, params, 1);
+		swd_cycle(cap, params, 0);
+		swd_cycle(cap, params, 0);
+		if (!rnw)
+			swd_cycle(cap, params, 1);
+		data = g_rand_int(cap->rand);
+		for (i = 0; i < 32; i++)
+			swd_cycle(cap, params, (data >> i) & 1);
+		swd_cycle(cap, params, parity(data));
+		if (rnw)
+			swd_cycle(cap, params, 1);
+		/* Idle cycles. */
+		for (i = 0; i < 2; i++)
+			swd_cycle(cap, params, 0);
+		cap->level[SWD_CLK] = 0;
+		gap(cap, params, start);
+	}
+}
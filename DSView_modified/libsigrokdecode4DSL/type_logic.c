@@ -24,6 +24,22 @@
 #include <inttypes.h>
 #include <string.h>
 
+/* Value of decoder channel ch at the given offset into the chunk. */
+static uint8_t logic_sample(const srd_logic *logic, int ch, uint64_t offset)
+{
+	uint64_t inbuf_offset;
+
+	/* A channelmap value of -1 means "unused optional channel". */
+	/* Value of unused channel is 0xff, instead of 0 or 1. */
+	if (logic->di->dec_channelmap[ch] == -1)
+		return 0xff;
+	if (*(logic->inbuf + ch) == NULL)
+		return *(logic->inbuf_const + ch) ? 1 : 0;
+
+	inbuf_offset = offset + (logic->start_samplenum % 8);
+	return *(*(logic->inbuf + ch) + inbuf_offset / 8) & (1 << (inbuf_offset % 8)) ? 1 : 0;
+}
+
 static PyObject *srd_logic_iter(PyObject *self)
 {
 	return self;
@@ -44,7 +60,8 @@ static PyObject *srd_logic_iternext(PyObject *self)
 	if (logic->logic_mask != 0 && logic->edge_index != -1)
 		logic->di->edge_index = logic->di->dec_channelmap[logic->edge_index];
 
-	if (offset > logic->samplenum || logic->logic_mask != 0) {
+	if (offset > logic->samplenum || logic->logic_mask != 0 ||
+	    logic->di->wait_terms->len != 0) {
 		/* End iteration loop. */
 		return NULL;
 	}
@@ -53,23 +70,11 @@ static PyObject *srd_logic_iternext(PyObject *self)
 	 * Convert the bit-packed sample to an array of bytes, with only 0x01
 	 * and 0x00 values, so the PD doesn't need to do any bitshifting.
 	 */
-	for (i = 0; i < logic->di->dec_num_channels; i++) {
-		/* A channelmap value of -1 means "unused optional channel". */
-		if (logic->di->dec_channelmap[i] == -1) {
-			/* Value of unused channel is 0xff, instead of 0 or 1. */
-			logic->di->channel_samples[i] = 0xff;
-		} else {
-			if (*(logic->inbuf + i) == NULL) {
-				logic->di->channel_samples[i] = *(logic->inbuf_const + i) ? 1 : 0;
-			} else {
-				uint64_t inbuf_offset = (offset + (logic->start_samplenum % 8));
-				uint8_t *ptr = *(logic->inbuf + i) + (inbuf_offset / 8);
-				logic->di->channel_samples[i] = *ptr & (1 << (inbuf_offset % 8)) ? 1 : 0;
-			}
-		}
-	}
+	for (i = 0; i < logic->di->dec_num_channels; i++)
+		logic->di->channel_samples[i] = logic_sample(logic, i, offset);
 
 	/* Prepare the next samplenum/sample list in this iteration. */
+	logic->last_samplenum = logic->start_samplenum + offset;
 	py_samplenum = PyLong_FromUnsignedLongLong(logic->start_samplenum + offset);
 	PyList_SetItem(logic->sample, 0, py_samplenum);
 	py_samples = PyBytes_FromStringAndSize((const char *)logic->di->channel_samples,
@@ -80,6 +85,253 @@ static PyObject *srd_logic_iternext(PyObject *self)
 	return logic->sample;
 }
 
+/*
+ * samples([start[, count]]) -> memoryview
+ *
+ * Unpacked samples of the current chunk, one byte per channel and
+ * sample, laid out like the pins of the iterator. The whole chunk is
+ * returned by default.
+ */
+static PyObject *srd_logic_samples(PyObject *self, PyObject *args)
+{
+	srd_logic *logic;
+	PyObject *py_bytes, *py_view;
+	unsigned long long start, count;
+	uint64_t i;
+	uint8_t *dest;
+	int ch, num_channels;
+
+	logic = (srd_logic *)self;
+	num_channels = logic->di->dec_num_channels;
+	start = 0;
+	count = logic->samplenum;
+	if (!PyArg_ParseTuple(args, "|KK", &start, &count))
+		return NULL;
+	if (start > logic->samplenum)
+		start = logic->samplenum;
+	if (count > logic->samplenum - start)
+		count = logic->samplenum - start;
+
+	if (!(py_bytes = PyBytes_FromStringAndSize(NULL, count * num_channels)))
+		return NULL;
+	dest = (uint8_t *)PyBytes_AsString(py_bytes);
+	for (ch = 0; ch < num_channels; ch++) {
+		for (i = 0; i < count; i++)
+			dest[i * num_channels + ch] = logic_sample(logic, ch, start + i);
+	}
+
+	logic->batched = TRUE;
+	py_view = PyMemoryView_FromObject(py_bytes);
+	Py_DecRef(py_bytes);
+
+	return py_view;
+}
+
+/*
+ * edges(channel) -> memoryview of 'Q'
+ *
+ * Absolute sample numbers of the transitions of a decoder channel
+ * within the current chunk, i.e. every sample which differs from the
+ * sample before it. The first sample of the chunk is not compared
+ * with the previous chunk. Constant stretches are skipped a byte at a
+ * time.
+ */
+static PyObject *srd_logic_edges(PyObject *self, PyObject *args)
+{
+	srd_logic *logic;
+	PyObject *py_bytes, *py_view, *py_edges;
+	const uint8_t *buf;
+	GArray *edges;
+	uint64_t first, last, pos, edge;
+	uint8_t diff, prev;
+	int ch, bit;
+
+	logic = (srd_logic *)self;
+	if (!PyArg_ParseTuple(args, "i", &ch))
+		return NULL;
+	if (ch < 0 || ch >= logic->di->dec_num_channels) {
+		PyErr_SetString(PyExc_IndexError, "channel index out of range");
+		return NULL;
+	}
+
+	edges = g_array_new(FALSE, FALSE, sizeof(uint64_t));
+	if (logic->di->dec_channelmap[ch] != -1 && *(logic->inbuf + ch) != NULL &&
+	    logic->samplenum > 1) {
+		buf = *(logic->inbuf + ch);
+		/* Bit positions in buf of the second and the last sample. */
+		first = (logic->start_samplenum % 8) + 1;
+		last = (logic->start_samplenum % 8) + logic->samplenum - 1;
+		for (pos = first & ~7ULL; pos <= last; pos += 8) {
+			prev = (pos == 0) ? (buf[0] & 1) : (buf[pos / 8 - 1] >> 7);
+			diff = buf[pos / 8] ^ (uint8_t)((buf[pos / 8] << 1) | prev);
+			if (diff == 0)
+				continue;
+			for (bit = 0; bit < 8; bit++) {
+				if (!(diff & (1 << bit)) || pos + bit < first || pos + bit > last)
+					continue;
+				edge = logic->start_samplenum + pos + bit -
+				       (logic->start_samplenum % 8);
+				g_array_append_val(edges, edge);
+			}
+		}
+	}
+
+	py_bytes = PyBytes_FromStringAndSize(edges->data,
+					     edges->len * sizeof(uint64_t));
+	g_array_free(edges, TRUE);
+	if (!py_bytes)
+		return NULL;
+
+	logic->batched = TRUE;
+	py_view = PyMemoryView_FromObject(py_bytes);
+	Py_DecRef(py_bytes);
+	if (!py_view)
+		return NULL;
+	py_edges = PyObject_CallMethod(py_view, "cast", "s", "Q");
+	Py_DecRef(py_view);
+
+	return py_edges;
+}
+
+/* Add the conditions of one dict to term, see srd_logic_wait(). */
+static int logic_wait_term(srd_logic *logic, PyObject *py_dict,
+			   struct srd_wait_term *term)
+{
+	static const char kinds[] = "hlrfen";
+	PyObject *py_key, *py_value;
+	Py_ssize_t pos;
+	char str[2] = "";
+	long long skip;
+	long ch;
+	int kind;
+
+	if (!PyDict_Check(py_dict)) {
+		PyErr_SetString(PyExc_TypeError, "wait() takes dicts of conditions");
+		return -1;
+	}
+
+	memset(term, 0, sizeof(*term));
+	pos = 0;
+	while (PyDict_Next(py_dict, &pos, &py_key, &py_value)) {
+		if (PyUnicode_Check(py_key) &&
+		    PyUnicode_CompareWithASCIIString(py_key, "skip") == 0) {
+			skip = PyLong_AsLongLong(py_value);
+			if (skip == -1 && PyErr_Occurred())
+				return -1;
+			if (skip < 1) {
+				PyErr_SetString(PyExc_ValueError, "skip must be at least 1");
+				return -1;
+			}
+			term->skip = skip;
+			continue;
+		}
+
+		ch = PyLong_AsLong(py_key);
+		if (ch == -1 && PyErr_Occurred())
+			return -1;
+		if (ch < 0 || ch >= logic->di->dec_num_channels) {
+			PyErr_SetString(PyExc_IndexError, "channel index out of range");
+			return -1;
+		}
+		for (kind = 0; kinds[kind]; kind++) {
+			str[0] = kinds[kind];
+			if (PyUnicode_Check(py_value) &&
+			    PyUnicode_CompareWithASCIIString(py_value, str) == 0)
+				break;
+		}
+		switch (kinds[kind]) {
+		case 'h': term->high |= 1ULL << ch; break;
+		case 'l': term->low |= 1ULL << ch; break;
+		case 'r': term->rise |= 1ULL << ch; break;
+		case 'f': term->fall |= 1ULL << ch; break;
+		case 'e': term->edge |= 1ULL << ch; break;
+		case 'n': term->stable |= 1ULL << ch; break;
+		default:
+			PyErr_SetString(PyExc_ValueError,
+				"condition must be one of 'h', 'l', 'r', 'f', 'e' or 'n'");
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * wait([conds])
+ *
+ * Wait for the first sample after the one last iterated at which any of
+ * conds holds: a dict, or a list of dicts, of channel index to 'h' (high),
+ * 'l' (low), 'r' (rising edge), 'f' (falling edge), 'e' (either edge) or
+ * 'n' (no edge), and 'skip' to the number of samples to skip. A dict
+ * matches when all its conditions do, an empty one at the next sample.
+ *
+ * Like setting logic_mask, this ends the iteration. The frontend looks
+ * for the match without handing out the samples in between, and the
+ * next chunk starts with it, logic.matched having a bit set for each of
+ * the dicts which held there.
+ */
+static PyObject *srd_logic_wait(PyObject *self, PyObject *args)
+{
+	srd_logic *logic;
+	PyObject *py_conds, *py_dict;
+	struct srd_wait_term term;
+	Py_ssize_t i, num_terms;
+	int ret;
+
+	logic = (srd_logic *)self;
+	py_conds = NULL;
+	if (!PyArg_ParseTuple(args, "|O", &py_conds))
+		return NULL;
+
+	g_array_set_size(logic->di->wait_terms, 0);
+	if (!py_conds || py_conds == Py_None) {
+		memset(&term, 0, sizeof(term));
+		g_array_append_val(logic->di->wait_terms, term);
+	} else if (PyDict_Check(py_conds)) {
+		if (logic_wait_term(logic, py_conds, &term) < 0)
+			return NULL;
+		g_array_append_val(logic->di->wait_terms, term);
+	} else {
+		num_terms = PySequence_Size(py_conds);
+		if (num_terms < 0) {
+			PyErr_SetString(PyExc_TypeError,
+				"wait() takes a dict or a list of dicts");
+			return NULL;
+		}
+		if (num_terms < 1 || num_terms > 64) {
+			PyErr_SetString(PyExc_ValueError,
+				"wait() takes from 1 to 64 conditions");
+			return NULL;
+		}
+		for (i = 0; i < num_terms; i++) {
+			if (!(py_dict = PySequence_GetItem(py_conds, i)))
+				return NULL;
+			ret = logic_wait_term(logic, py_dict, &term);
+			Py_DecRef(py_dict);
+			if (ret < 0) {
+				g_array_set_size(logic->di->wait_terms, 0);
+				return NULL;
+			}
+			g_array_append_val(logic->di->wait_terms, term);
+		}
+	}
+
+	logic->cur_pos = logic->last_samplenum;
+	logic->logic_mask = 0;
+
+	Py_RETURN_NONE;
+}
+
+static PyMethodDef srd_logic_methods[] = {
+	{"samples", srd_logic_samples, METH_VARARGS,
+	 "unpacked samples of the current chunk"},
+	{"edges", srd_logic_edges, METH_VARARGS,
+	 "transitions of one channel in the current chunk"},
+	{"wait", srd_logic_wait, METH_VARARGS,
+	 "skip to the first sample matching the conditions"},
+	{NULL, NULL, 0, NULL}  /* Sentinel */
+};
+
 static PyMemberDef srd_logic_members[] = {
 	{"itercnt", T_FLOAT, offsetof(srd_logic, itercnt), 0,
 	 "next expacted samples offset"},
@@ -91,6 +343,8 @@ static PyMemberDef srd_logic_members[] = {
 	 "channel index of next expacted edge"},
 	{"cur_pos", T_ULONGLONG, offsetof(srd_logic, cur_pos), 0,
 	 "current sample position"},
+	{"matched", T_ULONGLONG, offsetof(srd_logic, matched), READONLY,
+	 "terms of the last wait() which matched"},
 	{NULL}  /* Sentinel */
 };
 
@@ -122,6 +376,7 @@ SRD_PRIV PyObject *srd_logic_type_new(void)
 		{ Py_tp_iternext, (void *)&srd_logic_iternext },
 		{ Py_tp_new, (void *)&PyType_GenericNew },
 		{ Py_tp_members, srd_logic_members },
+		{ Py_tp_methods, srd_logic_methods },
 		{ 0, NULL }
 	};
 	spec.name = "srd_logic";
@@ -298,3 +298,85 @@ SRD_PRIV GVariant *py_obj_to_variant(PyObject *py_obj)
 
 	return var;
 }
+
+/**
+ * Convert a GLib variant to a Python object.
+ * Arrays become lists, tuples become tuples and maybes become None or
+ * their value. Supported scalar types are boolean, string, double and
+ * the integer types.
+ *
+ * @param[in] var The variant. Must not be NULL.
+ * @return A new reference to the Python object, or NULL on failure.
+ *
+ * @private
+ */
+SRD_PRIV PyObject *py_obj_from_variant(GVariant *var)
+{
+	PyObject *py_obj, *py_item;
+	GVariant *child;
+	gsize i, n;
+
+	switch (g_variant_classify(var)) {
+	case G_VARIANT_CLASS_VARIANT:
+		child = g_variant_get_variant(var);
+		py_obj = py_obj_from_variant(child);
+		g_variant_unref(child);
+		return py_obj;
+	case G_VARIANT_CLASS_MAYBE:
+		if (!(child = g_variant_get_maybe(var)))
+			Py_RETURN_NONE;
+		py_obj = py_obj_from_variant(child);
+		g_variant_unref(child);
+		return py_obj;
+	case G_VARIANT_CLASS_ARRAY:
+	case G_VARIANT_CLASS_TUPLE:
+		n = g_variant_n_children(var);
+		if (g_variant_classify(var) == G_VARIANT_CLASS_TUPLE)
+			py_obj = PyTuple_New(n);
+		else
+			py_obj = PyList_New(n);
+		if (!py_obj)
+			break;
+		for (i = 0; i < n; i++) {
+			child = g_variant_get_child_value(var, i);
+			py_item = py_obj_from_variant(child);
+			g_variant_unref(child);
+			if (!py_item) {
+				Py_DECREF(py_obj);
+				return NULL;
+			}
+			if (PyTuple_Check(py_obj))
+				PyTuple_SET_ITEM(py_obj, i, py_item);
+			else
+				PyList_SET_ITEM(py_obj, i, py_item);
+		}
+		return py_obj;
+	case G_VARIANT_CLASS_BOOLEAN:
+		return PyBool_FromLong(g_variant_get_boolean(var));
+	case G_VARIANT_CLASS_BYTE:
+		return PyLong_FromLong(g_variant_get_byte(var));
+	case G_VARIANT_CLASS_INT16:
+		return PyLong_FromLong(g_variant_get_int16(var));
+	case G_VARIANT_CLASS_UINT16:
+		return PyLong_FromLong(g_variant_get_uint16(var));
+	case G_VARIANT_CLASS_INT32:
+		return PyLong_FromLong(g_variant_get_int32(var));
+	case G_VARIANT_CLASS_UINT32:
+		return PyLong_FromUnsignedLong(g_variant_get_uint32(var));
+	case G_VARIANT_CLASS_INT64:
+		return PyLong_FromLongLong(g_variant_get_int64(var));
+	case G_VARIANT_CLASS_UINT64:
+		return PyLong_FromUnsignedLongLong(g_variant_get_uint64(var));
+	case G_VARIANT_CLASS_DOUBLE:
+		return PyFloat_FromDouble(g_variant_get_double(var));
+	case G_VARIANT_CLASS_STRING:
+		return PyUnicode_FromString(g_variant_get_string(var, NULL));
+	default:
+		srd_err("Failed to convert variant of unsupported type %s.",
+			g_variant_get_type_string(var));
+		return NULL;
+	}
+
+	srd_exception_catch(NULL, "Failed to convert variant");
+	return NULL;
+}
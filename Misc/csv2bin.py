@@ -19,3 +19,7 @@ for filename in os.listdir(sys.argv[1]):
         outfile.write(struct.pack('f', float(line)))
     outfile.close()
 
+# index to open the traces as a DSO session in DSView
+index = open(os.path.join(sys.argv[2], "traces.dstrace"), "w")
+index.write("[traceset]\nformat=float32\ndir=.\ntrace=0\n")
+index.close()